@@ -0,0 +1,70 @@
+#include "pch.h"
+#include "AOBakeBenchmark.h"
+
+namespace
+{
+	const std::string s_SharkModel = "Models/Shark.obj";
+
+	//Bakes every mesh of the model and returns the time in milliseconds.
+	double BakeModel(AOBaker& baker, const std::shared_ptr<Model>& pModel, std::vector<std::vector<uint8_t>>& occlusion) noexcept
+	{
+		const std::vector<std::unique_ptr<Mesh>>& meshes = pModel->GetMeshes();
+		occlusion.resize(meshes.size());
+		double bakeTime = 0.0;
+		for (uint32_t i{ 0u }; i < meshes.size(); ++i)
+		{
+			baker.Bake(pModel->GetBVH(), pModel->GetBoundingSphere().Radius, meshes[i]->GetVertices(), occlusion[i]);
+			bakeTime += baker.GetBakeTime();
+		}
+		return bakeTime;
+	}
+}
+
+void AOBakeBenchmark::Run(const Scene& scene) noexcept
+{
+	m_Results.clear();
+	const std::vector<VertexObject*>& objects = scene.GetObjectList();
+	auto sharkIt = std::find_if(objects.begin(), objects.end(), [](const VertexObject* pObject) noexcept { return pObject->GetModel()->GetName() == s_SharkModel; });
+	if (sharkIt == objects.end())
+		return;
+
+	const std::shared_ptr<Model>& pShark = (*sharkIt)->GetModel();
+	AOBakeSettings settings = {};
+	settings.NrOfSamples = s_NrOfReferenceSamples;
+	AOBaker referenceBaker(settings);
+	std::vector<std::vector<uint8_t>> reference;
+	m_ReferenceBakeTime = BakeModel(referenceBaker, pShark, reference);
+	m_NrOfVertices = 0u;
+	for (const std::vector<uint8_t>& meshReference : reference)
+	{
+		m_NrOfVertices += static_cast<uint32_t>(meshReference.size());
+	}
+
+	std::vector<std::vector<uint8_t>> occlusion, rebake;
+	for (uint32_t nrOfSamples{ s_MinNrOfSamples }; nrOfSamples < s_NrOfReferenceSamples; nrOfSamples *= 2u)
+	{
+		settings.NrOfSamples = nrOfSamples;
+		AOBaker baker(settings);
+		AOBakeBenchmarkResult result;
+		result.NrOfSamples = nrOfSamples;
+		result.BakeTime = BakeModel(baker, pShark, occlusion);
+		result.RaysPerSecond = result.BakeTime > 0.0 ? static_cast<double>(nrOfSamples) * m_NrOfVertices / (result.BakeTime * 0.001) : 0.0;
+
+		double squaredErrorSum = 0.0;
+		for (uint32_t meshIndex{ 0u }; meshIndex < occlusion.size(); ++meshIndex)
+		{
+			for (uint32_t i{ 0u }; i < occlusion[meshIndex].size(); ++i)
+			{
+				const int error = static_cast<int>(occlusion[meshIndex][i]) - static_cast<int>(reference[meshIndex][i]);
+				squaredErrorSum += static_cast<double>(error * error);
+				result.MaxError = std::max(result.MaxError, static_cast<uint32_t>(std::abs(error)));
+			}
+		}
+		result.RMSError = m_NrOfVertices > 0u ? std::sqrt(squaredErrorSum / m_NrOfVertices) : 0.0;
+
+		BakeModel(baker, pShark, rebake);
+		result.IsDeterministic = rebake == occlusion;
+		DBG_ASSERT(result.IsDeterministic, "Error! The ambient occlusion bake is not deterministic.");
+		m_Results.push_back(result);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Scene.h"
+
+struct AOBakeBenchmarkResult
+{
+	uint32_t NrOfSamples = 0u;
+	//In milliseconds.
+	double BakeTime = 0.0;
+	double RaysPerSecond = 0.0;
+	//Difference to the reference bake in 8 bit steps.
+	double RMSError = 0.0;
+	uint32_t MaxError = 0u;
+	//The bake promises the same result every time, this checks it against a second bake.
+	bool IsDeterministic = true;
+};
+
+//Times the ambient occlusion bake of the Shark model against the number of samples, and measures the quality against a bake with the most samples.
+//Only the CPU copies of the model are used, nothing is uploaded or drawn.
+class AOBakeBenchmark
+{
+public:
+	static constexpr uint32_t s_MinNrOfSamples = 8u;
+	static constexpr uint32_t s_NrOfReferenceSamples = AOBaker::s_MaxNrOfSamples;
+public:
+	AOBakeBenchmark() noexcept = default;
+	~AOBakeBenchmark() noexcept = default;
+
+	void Run(const Scene& scene) noexcept;
+
+	[[nodiscard]] const std::vector<AOBakeBenchmarkResult>& GetResults() const noexcept { return m_Results; }
+	[[nodiscard]] constexpr uint32_t GetNrOfVertices() const noexcept { return m_NrOfVertices; }
+	[[nodiscard]] constexpr double GetReferenceBakeTime() const noexcept { return m_ReferenceBakeTime; }
+private:
+	std::vector<AOBakeBenchmarkResult> m_Results = {};
+	uint32_t m_NrOfVertices = 0u;
+	double m_ReferenceBakeTime = 0.0;
+};
@@ -0,0 +1,227 @@
+#include "pch.h"
+#include "AOBaker.h"
+
+namespace
+{
+	constexpr uint32_t s_CacheVersion = 2u;
+
+	//Start of the cache file. The vertex count and the bounds of the model are checked next to the hash,
+	//so a file baked for other geometry is never used, also when the hashes happen to be equal.
+	struct CacheHeader
+	{
+		uint64_t Hash;
+		uint32_t NrOfMeshes;
+		uint32_t NrOfVertices;
+		DirectX::XMFLOAT3 BoundsCenter;
+		DirectX::XMFLOAT3 BoundsExtents;
+	};
+	static_assert(sizeof(CacheHeader) == 40u, "The cache header is compared as raw bytes and can not have padding.");
+
+	CacheHeader MakeCacheHeader(uint64_t hash, uint32_t nrOfMeshes, uint32_t nrOfVertices, const DirectX::BoundingBox& bounds) noexcept
+	{
+		return { hash, nrOfMeshes, nrOfVertices, bounds.Center, bounds.Extents };
+	}
+
+	//Integer hash with good avalanche, turns the vertex index into the rotation of its sample set.
+	uint32_t HashIndex(uint32_t value) noexcept
+	{
+		value ^= value >> 16u;
+		value *= 0x7feb352du;
+		value ^= value >> 15u;
+		value *= 0x846ca68bu;
+		value ^= value >> 16u;
+		return value;
+	}
+
+	float RadicalInverse(uint32_t value) noexcept
+	{
+		value = (value << 16u) | (value >> 16u);
+		value = ((value & 0x55555555u) << 1u) | ((value & 0xAAAAAAAAu) >> 1u);
+		value = ((value & 0x33333333u) << 2u) | ((value & 0xCCCCCCCCu) >> 2u);
+		value = ((value & 0x0F0F0F0Fu) << 4u) | ((value & 0xF0F0F0F0u) >> 4u);
+		value = ((value & 0x00FF00FFu) << 8u) | ((value & 0xFF00FF00u) >> 8u);
+		return static_cast<float>(value) * 2.3283064365386963e-10f;
+	}
+
+	//FNV-1a over raw bytes.
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t size) noexcept
+	{
+		const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+		for (size_t i{ 0u }; i < size; ++i)
+		{
+			hash ^= pBytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+}
+
+AOBaker::AOBaker(const AOBakeSettings& settings) noexcept
+	: m_Settings{ settings }
+{
+	DBG_ASSERT(m_Settings.NrOfSamples > 0u && m_Settings.NrOfSamples <= s_MaxNrOfSamples, "Error! The number of ambient occlusion samples is out of range.");
+	m_Settings.NrOfSamples = std::clamp(m_Settings.NrOfSamples, 1u, s_MaxNrOfSamples);
+}
+
+void AOBaker::Bake(const ModelBVH& bvh, float modelRadius, const std::vector<Vertex>& vertices, std::vector<uint8_t>& occlusion) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//The cosine weighted directions in tangent space are the same for every vertex, only their rotation differs.
+	const uint32_t nrOfSamples = m_Settings.NrOfSamples;
+	float sampleU[s_MaxNrOfSamples];
+	float sampleV[s_MaxNrOfSamples];
+	for (uint32_t i{ 0u }; i < nrOfSamples; ++i)
+	{
+		sampleU[i] = (static_cast<float>(i) + 0.5f) / nrOfSamples;
+		sampleV[i] = RadicalInverse(i);
+	}
+	const float maxDistance = m_Settings.MaxDistance * modelRadius;
+	const float bias = m_Settings.Bias * modelRadius;
+
+	const uint32_t nrOfVertices = static_cast<uint32_t>(vertices.size());
+	occlusion.resize(nrOfVertices);
+	std::atomic<uint64_t> nrOfRays = 0u;
+	ThreadPool::Get().ParallelFor(nrOfVertices, s_GrainSize, [&](uint32_t begin, uint32_t end)
+		{
+			uint64_t rangeRays = 0u;
+			for (uint32_t vertexIndex{ begin }; vertexIndex < end; ++vertexIndex)
+			{
+				const Vertex& vertex = vertices[vertexIndex];
+				const DirectX::XMVECTOR normalVector = DirectX::XMLoadFloat3(&vertex.normal);
+				if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(normalVector)) < 1.0e-12f)
+				{
+					//Without a normal there is no hemisphere to sample.
+					occlusion[vertexIndex] = 255u;
+					continue;
+				}
+				DirectX::XMFLOAT3 normal;
+				DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(normalVector));
+
+				//Orthonormal basis around the normal without branches on its direction, from Duff et al.
+				const float sign = std::copysign(1.0f, normal.z);
+				const float a = -1.0f / (sign + normal.z);
+				const float b = normal.x * normal.y * a;
+				const DirectX::XMFLOAT3 tangent = { 1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+				const DirectX::XMFLOAT3 bitangent = { b, sign + normal.y * normal.y * a, -normal.y };
+				const DirectX::XMFLOAT3 origin = { vertex.pos.x + normal.x * bias, vertex.pos.y + normal.y * bias, vertex.pos.z + normal.z * bias };
+
+				const uint32_t hash = HashIndex(vertexIndex ^ HashIndex(m_Settings.Seed));
+				const float rotationU = static_cast<float>(hash & 0xFFFFu) / 65536.0f;
+				const float rotationV = static_cast<float>(hash >> 16u) / 65536.0f;
+
+				uint32_t nrOfHits = 0u;
+				for (uint32_t first{ 0u }; first < nrOfSamples; first += RayPacket::s_Size)
+				{
+					RayPacket packet;
+					packet.ActiveMask = 0u;
+					for (uint32_t lane{ 0u }; lane < RayPacket::s_Size; ++lane)
+					{
+						//Lanes past the last sample repeat it and stay inactive.
+						const uint32_t sampleIndex = std::min(first + lane, nrOfSamples - 1u);
+						float u = sampleU[sampleIndex] + rotationU;
+						float v = sampleV[sampleIndex] + rotationV;
+						u -= u >= 1.0f ? 1.0f : 0.0f;
+						v -= v >= 1.0f ? 1.0f : 0.0f;
+						const float radius = std::sqrt(u);
+						const float phi = DirectX::XM_2PI * v;
+						const float x = radius * std::cos(phi);
+						const float y = radius * std::sin(phi);
+						const float z = std::sqrt(std::max(0.0f, 1.0f - u));
+						const DirectX::XMFLOAT3 direction = {
+							tangent.x * x + bitangent.x * y + normal.x * z,
+							tangent.y * x + bitangent.y * y + normal.y * z,
+							tangent.z * x + bitangent.z * y + normal.z * z };
+						packet.Set(lane, origin, direction, bias, maxDistance);
+						if (first + lane < nrOfSamples)
+						{
+							packet.ActiveMask |= 1u << lane;
+						}
+					}
+					nrOfHits += static_cast<uint32_t>(_mm_popcnt_u32(bvh.IntersectAny(packet)));
+				}
+				rangeRays += nrOfSamples;
+
+				//The cosine weighting is in the sample directions, so the open fraction of the rays is the ambient term.
+				const float visibility = 1.0f - static_cast<float>(nrOfHits) / nrOfSamples;
+				occlusion[vertexIndex] = static_cast<uint8_t>(visibility * 255.0f + 0.5f);
+			}
+			nrOfRays += rangeRays;
+		});
+
+	m_NrOfRays = nrOfRays;
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BakeTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+uint64_t AOBaker::Hash(const std::vector<std::unique_ptr<Mesh>>& meshes) const noexcept
+{
+	static_assert(sizeof(Vertex) == 6u * sizeof(float), "The vertices are hashed as raw bytes and can not have padding.");
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = HashBytes(hash, &s_CacheVersion, sizeof(s_CacheVersion));
+	hash = HashBytes(hash, &m_Settings.NrOfSamples, sizeof(m_Settings.NrOfSamples));
+	hash = HashBytes(hash, &m_Settings.MaxDistance, sizeof(m_Settings.MaxDistance));
+	hash = HashBytes(hash, &m_Settings.Bias, sizeof(m_Settings.Bias));
+	hash = HashBytes(hash, &m_Settings.Seed, sizeof(m_Settings.Seed));
+	for (const std::unique_ptr<Mesh>& pMesh : meshes)
+	{
+		const std::vector<Vertex>& vertices = pMesh->GetVertices();
+		const std::vector<uint32_t>& indices = pMesh->GetIndices();
+		hash = HashBytes(hash, vertices.data(), sizeof(Vertex) * vertices.size());
+		hash = HashBytes(hash, indices.data(), sizeof(uint32_t) * indices.size());
+	}
+	return hash;
+}
+
+bool AOBaker::ReadCache(const std::string& path, uint64_t hash, const std::vector<std::unique_ptr<Mesh>>& meshes, const DirectX::BoundingBox& bounds, std::vector<std::vector<uint8_t>>& occlusion) noexcept
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	uint32_t nrOfVertices = 0u;
+	for (const std::unique_ptr<Mesh>& pMesh : meshes)
+	{
+		nrOfVertices += pMesh->GetVertexCount();
+	}
+	const CacheHeader expected = MakeCacheHeader(hash, static_cast<uint32_t>(meshes.size()), nrOfVertices, bounds);
+	CacheHeader header = {};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || std::memcmp(&header, &expected, sizeof(header)) != 0)
+		return false;
+
+	occlusion.resize(header.NrOfMeshes);
+	for (uint32_t i{ 0u }; i < header.NrOfMeshes; ++i)
+	{
+		uint32_t nrOfMeshVertices = 0u;
+		file.read(reinterpret_cast<char*>(&nrOfMeshVertices), sizeof(nrOfMeshVertices));
+		if (!file || nrOfMeshVertices != meshes[i]->GetVertexCount())
+			return false;
+
+		occlusion[i].resize(nrOfMeshVertices);
+		file.read(reinterpret_cast<char*>(occlusion[i].data()), static_cast<std::streamsize>(nrOfMeshVertices));
+	}
+	return static_cast<bool>(file);
+}
+
+bool AOBaker::WriteCache(const std::string& path, uint64_t hash, const DirectX::BoundingBox& bounds, const std::vector<std::vector<uint8_t>>& occlusion) noexcept
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	uint32_t nrOfVertices = 0u;
+	for (const std::vector<uint8_t>& meshOcclusion : occlusion)
+	{
+		nrOfVertices += static_cast<uint32_t>(meshOcclusion.size());
+	}
+	const CacheHeader header = MakeCacheHeader(hash, static_cast<uint32_t>(occlusion.size()), nrOfVertices, bounds);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const std::vector<uint8_t>& meshOcclusion : occlusion)
+	{
+		const uint32_t nrOfMeshVertices = static_cast<uint32_t>(meshOcclusion.size());
+		file.write(reinterpret_cast<const char*>(&nrOfMeshVertices), sizeof(nrOfMeshVertices));
+		file.write(reinterpret_cast<const char*>(meshOcclusion.data()), static_cast<std::streamsize>(nrOfMeshVertices));
+	}
+	return static_cast<bool>(file);
+}
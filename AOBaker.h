@@ -0,0 +1,44 @@
+#pragma once
+#include "ModelBVH.h"
+
+//Quality knobs of the bake. The distances are fractions of the model's bounding sphere radius so that the same settings fit any model.
+struct AOBakeSettings
+{
+	uint32_t NrOfSamples = 64u;
+	float MaxDistance = 0.5f;
+	//Offset of the ray origins along the normal and the closest distance a hit can have, keeps the rays from hitting the triangles around the vertex.
+	float Bias = 0.001f;
+	uint32_t Seed = 0u;
+};
+
+//Import time baker of a per vertex ambient occlusion term, traced on the CPU with cosine weighted hemisphere rays against the model's BVH.
+//Every vertex uses the same Hammersley set rotated by a hash of its index, so the result is the same on every run and for any number of threads.
+//The rays of a vertex all start at the vertex and are traced as packets of eight.
+class AOBaker
+{
+public:
+	static constexpr uint32_t s_MaxNrOfSamples = 1024u;
+	static constexpr uint32_t s_GrainSize = 64u;
+public:
+	AOBaker(const AOBakeSettings& settings = {}) noexcept;
+	~AOBaker() noexcept = default;
+
+	//Writes one byte per vertex, 255 is fully open and 0 fully occluded. The vertices have to be in the model space of the BVH.
+	void Bake(const ModelBVH& bvh, float modelRadius, const std::vector<Vertex>& vertices, std::vector<uint8_t>& occlusion) noexcept;
+
+	//Hash of everything a bake of the meshes depends on, tells if a cached bake is still valid.
+	[[nodiscard]] uint64_t Hash(const std::vector<std::unique_ptr<Mesh>>& meshes) const noexcept;
+	//The cache holds one bake per mesh, after the hash, the vertex count and the bounds of the model it was baked for.
+	//Reading fails if the file is missing, was written for other data or does not match the meshes and their bounds, the model is then baked again.
+	static bool ReadCache(const std::string& path, uint64_t hash, const std::vector<std::unique_ptr<Mesh>>& meshes, const DirectX::BoundingBox& bounds, std::vector<std::vector<uint8_t>>& occlusion) noexcept;
+	static bool WriteCache(const std::string& path, uint64_t hash, const DirectX::BoundingBox& bounds, const std::vector<std::vector<uint8_t>>& occlusion) noexcept;
+
+	[[nodiscard]] constexpr const AOBakeSettings& GetSettings() const noexcept { return m_Settings; }
+	//Time the last bake took in milliseconds.
+	[[nodiscard]] constexpr double GetBakeTime() const noexcept { return m_BakeTime; }
+	[[nodiscard]] constexpr uint64_t GetNrOfRays() const noexcept { return m_NrOfRays; }
+private:
+	AOBakeSettings m_Settings = {};
+	double m_BakeTime = 0.0;
+	uint64_t m_NrOfRays = 0u;
+};
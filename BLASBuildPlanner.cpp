@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "BLASBuildPlanner.h"
+
+BLASBuildPlanner::BLASBuildPlanner(uint64_t scratchBudget) noexcept
+	: m_ScratchBudget{ scratchBudget }
+{
+}
+
+void BLASBuildPlanner::Clear() noexcept
+{
+	m_Builds.clear();
+	m_Placements.clear();
+	m_NrOfBatches = 0u;
+	m_ResultBufferSize = 0u;
+	m_ScratchBufferSize = 0u;
+	m_UnpooledScratchSize = 0u;
+}
+
+uint32_t BLASBuildPlanner::Add(uint64_t resultBytes, uint64_t scratchBytes) noexcept
+{
+	m_Builds.push_back({ resultBytes, scratchBytes });
+	return static_cast<uint32_t>(m_Builds.size() - 1u);
+}
+
+void BLASBuildPlanner::Plan() noexcept
+{
+	const uint32_t nrOfBuilds = GetNrOfBuilds();
+	m_Placements.assign(nrOfBuilds, {});
+	m_NrOfBatches = 0u;
+	m_ResultBufferSize = 0u;
+	m_ScratchBufferSize = 0u;
+	m_UnpooledScratchSize = 0u;
+	if (nrOfBuilds == 0u)
+	{
+		return;
+	}
+
+	uint64_t scratchOffset = 0u;
+	m_NrOfBatches = 1u;
+	for (uint32_t i{ 0u }; i < nrOfBuilds; ++i)
+	{
+		const uint64_t resultBytes = AlignUp(m_Builds[i].ResultBytes);
+		const uint64_t scratchBytes = AlignUp(m_Builds[i].ScratchBytes);
+
+		//Start a new batch from the beginning of the pool when this build's scratch memory does not fit in what is left of the budget.
+		if (scratchOffset != 0u && scratchOffset + scratchBytes > m_ScratchBudget)
+		{
+			m_NrOfBatches++;
+			scratchOffset = 0u;
+		}
+
+		BLASBuildPlacement& placement = m_Placements[i];
+		placement.ResultOffset = m_ResultBufferSize;
+		placement.ScratchOffset = scratchOffset;
+		placement.Batch = m_NrOfBatches - 1u;
+
+		m_ResultBufferSize += resultBytes;
+		scratchOffset += scratchBytes;
+		m_ScratchBufferSize = std::max(m_ScratchBufferSize, scratchOffset);
+		m_UnpooledScratchSize += scratchBytes;
+	}
+}
+
+uint64_t BLASBuildPlanner::PlaceBuffers(const uint64_t* pSizes, uint32_t count, uint64_t* pOffsets) noexcept
+{
+	uint64_t size = 0u;
+	for (uint32_t i{ 0u }; i < count; ++i)
+	{
+		pOffsets[i] = size;
+		size += AlignUp(pSizes[i]);
+	}
+	return size;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+//Where a bottom level acceleration structure is built.
+struct BLASBuildPlacement
+{
+	//Offset of the structure in the shared result buffer.
+	uint64_t ResultOffset = 0u;
+	//Offset of the structure's scratch memory in the scratch pool.
+	uint64_t ScratchOffset = 0u;
+	//Builds in the same batch use separate scratch memory and can run at the same time.
+	//The next batch reuses the scratch memory, so it has to wait for a UAV barrier on the scratch pool.
+	uint32_t Batch = 0u;
+};
+
+//Plans the building of all bottom level acceleration structures into one result buffer and one pooled scratch buffer.
+//The structures are placed one after the other in the result buffer. Their scratch memory is packed into batches that fit the scratch budget,
+//and every batch reuses the pool from the start, so the pool only has to be as large as the largest batch instead of the sum of all builds.
+//A single build that is larger than the budget gets a batch of its own and the pool grows to fit it.
+//Only offsets and sizes are computed here so it runs without a device.
+class BLASBuildPlanner
+{
+public:
+	static constexpr uint64_t s_Alignment = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+	static constexpr uint64_t s_DefaultScratchBudget = 32ull * 1024ull * 1024ull;
+public:
+	BLASBuildPlanner(uint64_t scratchBudget = s_DefaultScratchBudget) noexcept;
+	~BLASBuildPlanner() noexcept = default;
+
+	void Clear() noexcept;
+	//Adds a build with the sizes from its prebuild info and returns its index. Builds are placed and batched in the order they are added.
+	uint32_t Add(uint64_t resultBytes, uint64_t scratchBytes) noexcept;
+	void Plan() noexcept;
+
+	//Places buffers of the given sizes one after the other and returns the size of the buffer that holds them all.
+	static uint64_t PlaceBuffers(const uint64_t* pSizes, uint32_t count, uint64_t* pOffsets) noexcept;
+	[[nodiscard]] static constexpr uint64_t AlignUp(uint64_t size) noexcept { return (size + s_Alignment - 1u) & ~(s_Alignment - 1u); }
+
+	[[nodiscard]] const BLASBuildPlacement& GetPlacement(uint32_t index) const noexcept { return m_Placements[index]; }
+	[[nodiscard]] uint32_t GetNrOfBuilds() const noexcept { return static_cast<uint32_t>(m_Builds.size()); }
+	[[nodiscard]] constexpr uint32_t GetNrOfBatches() const noexcept { return m_NrOfBatches; }
+	[[nodiscard]] constexpr uint64_t GetResultBufferSize() const noexcept { return m_ResultBufferSize; }
+	[[nodiscard]] constexpr uint64_t GetScratchBufferSize() const noexcept { return m_ScratchBufferSize; }
+	//The scratch memory that separate buffers for every build would have used.
+	[[nodiscard]] constexpr uint64_t GetUnpooledScratchSize() const noexcept { return m_UnpooledScratchSize; }
+private:
+	struct Build
+	{
+		uint64_t ResultBytes = 0u;
+		uint64_t ScratchBytes = 0u;
+	};
+private:
+	uint64_t m_ScratchBudget;
+	std::vector<Build> m_Builds = {};
+	std::vector<BLASBuildPlacement> m_Placements = {};
+	uint32_t m_NrOfBatches = 0u;
+	uint64_t m_ResultBufferSize = 0u;
+	uint64_t m_ScratchBufferSize = 0u;
+	uint64_t m_UnpooledScratchSize = 0u;
+};
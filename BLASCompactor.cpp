@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "BLASCompactor.h"
+
+BLASCompactor::BLASCompactor(uint64_t minSavedBytes) noexcept
+	: m_MinSavedBytes{ minSavedBytes }
+{
+}
+
+void BLASCompactor::Clear() noexcept
+{
+	m_Structures.clear();
+}
+
+uint32_t BLASCompactor::Add(const std::string& modelName, uint64_t resultBytes, uint64_t scratchBytes) noexcept
+{
+	Structure& structure = m_Structures.emplace_back();
+	structure.ModelName = modelName;
+	structure.ResultBytes = resultBytes;
+	structure.ScratchBytes = scratchBytes;
+	return static_cast<uint32_t>(m_Structures.size() - 1u);
+}
+
+uint32_t BLASCompactor::SetCompactedSizes(const uint64_t* pCompactedSizes, uint32_t count) noexcept
+{
+	DBG_ASSERT(count == m_Structures.size(), "Error! Expected one compacted size per bottom level acceleration structure.");
+
+	uint32_t nrToCompact = 0u;
+	for (uint32_t i{ 0u }; i < count; ++i)
+	{
+		Structure& structure = m_Structures[i];
+		DBG_ASSERT(structure.Stage == BLASStage::BUILT, "Error! The compacted size of a structure has already been set.");
+		DBG_ASSERT(pCompactedSizes[i] != 0u && pCompactedSizes[i] <= structure.ResultBytes, "Error! The read back compacted size is not valid.");
+
+		structure.CompactedBytes = pCompactedSizes[i];
+		structure.Stage = BLASStage::SIZE_KNOWN;
+		if (ShouldCompact(i))
+		{
+			nrToCompact++;
+		}
+	}
+	return nrToCompact;
+}
+
+void BLASCompactor::FinishCompaction() noexcept
+{
+	for (uint32_t i{ 0u }; i < m_Structures.size(); ++i)
+	{
+		Structure& structure = m_Structures[i];
+		DBG_ASSERT(structure.Stage == BLASStage::SIZE_KNOWN, "Error! Finishing the compaction of a structure without a known compacted size.");
+		structure.Stage = ShouldCompact(i) ? BLASStage::COMPACTED : BLASStage::KEPT;
+	}
+}
+
+bool BLASCompactor::ShouldCompact(uint32_t index) const noexcept
+{
+	const Structure& structure = m_Structures[index];
+	if (structure.Stage == BLASStage::BUILT)
+	{
+		return false;
+	}
+	return structure.ResultBytes - structure.CompactedBytes >= m_MinSavedBytes;
+}
+
+uint64_t BLASCompactor::GetResultBytes(uint32_t index) const noexcept
+{
+	const Structure& structure = m_Structures[index];
+	return structure.Stage == BLASStage::COMPACTED ? structure.CompactedBytes : structure.ResultBytes;
+}
+
+std::vector<BLASMemoryReportEntry> BLASCompactor::GetMemoryReport() const noexcept
+{
+	std::vector<BLASMemoryReportEntry> report;
+	for (const Structure& structure : m_Structures)
+	{
+		auto it = std::find_if(report.begin(), report.end(), [&structure](const BLASMemoryReportEntry& entry) { return entry.ModelName == structure.ModelName; });
+		if (it == report.end())
+		{
+			it = report.insert(report.end(), BLASMemoryReportEntry{});
+			it->ModelName = structure.ModelName;
+		}
+		AddToEntry(structure, *it);
+	}
+	std::sort(report.begin(), report.end(), [](const BLASMemoryReportEntry& a, const BLASMemoryReportEntry& b) { return a.ModelName < b.ModelName; });
+	return report;
+}
+
+BLASMemoryReportEntry BLASCompactor::GetMemoryTotals() const noexcept
+{
+	BLASMemoryReportEntry totals = {};
+	totals.ModelName = "Total";
+	for (const Structure& structure : m_Structures)
+	{
+		AddToEntry(structure, totals);
+	}
+	return totals;
+}
+
+void BLASCompactor::AddToEntry(const Structure& structure, BLASMemoryReportEntry& entry) noexcept
+{
+	entry.NrOfStructures++;
+	entry.ResultBytesBefore += structure.ResultBytes;
+	entry.ScratchBytesBefore += structure.ScratchBytes;
+	//The scratch buffers are released together with the original result buffers once the compaction has finished.
+	const bool finished = structure.Stage == BLASStage::COMPACTED || structure.Stage == BLASStage::KEPT;
+	entry.ResultBytesAfter += structure.Stage == BLASStage::COMPACTED ? structure.CompactedBytes : structure.ResultBytes;
+	entry.ScratchBytesAfter += finished ? 0u : structure.ScratchBytes;
+}
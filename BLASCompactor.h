@@ -0,0 +1,73 @@
+#pragma once
+
+//Where a bottom level acceleration structure is in its lifetime.
+enum class BLASStage : uint32_t
+{
+	BUILT = 0,				//Built into a buffer of the worst case size. The compacted size is not known yet.
+	SIZE_KNOWN,				//The compacted size has been read back.
+	COMPACTED,				//Copied into a buffer of the compacted size, the original result buffer has been released.
+	KEPT					//Compacting would not save enough, the original result buffer is kept.
+};
+
+//Memory used by the bottom level acceleration structures of one model, in bytes.
+struct BLASMemoryReportEntry
+{
+	std::string ModelName = "";
+	uint32_t NrOfStructures = 0u;
+	uint64_t ResultBytesBefore = 0u;
+	uint64_t ScratchBytesBefore = 0u;
+	uint64_t ResultBytesAfter = 0u;
+	uint64_t ScratchBytesAfter = 0u;
+};
+
+//Bookkeeping for compacting the bottom level acceleration structures.
+//The structures are built with ALLOW_COMPACTION into buffers of ResultDataMaxSizeInBytes and emit their compacted size as post build info,
+//one 64 bit value per structure at GetPostbuildInfoOffset. Once the sizes have been read back, every structure that saves enough
+//is copied into a buffer of the compacted size and the original result buffer and all scratch buffers are released.
+//Only sizes and stages are tracked here, the buffers themselves are owned by the RayTracingManager, so this runs without a device.
+class BLASCompactor
+{
+public:
+	//Structures that would shrink by less than this are not worth the copy.
+	static constexpr uint64_t s_DefaultMinSavedBytes = 4096u;
+	static constexpr uint64_t s_PostbuildInfoStride = sizeof(uint64_t);
+public:
+	BLASCompactor(uint64_t minSavedBytes = s_DefaultMinSavedBytes) noexcept;
+	~BLASCompactor() noexcept = default;
+
+	void Clear() noexcept;
+	//Registers a structure that has been built with the sizes from its prebuild info and returns its index.
+	uint32_t Add(const std::string& modelName, uint64_t resultBytes, uint64_t scratchBytes) noexcept;
+	//Sets the read back compacted sizes, one per structure in the order they were added.
+	//Returns the number of structures that should be compacted.
+	uint32_t SetCompactedSizes(const uint64_t* pCompactedSizes, uint32_t count) noexcept;
+	//Call once the compacting copies have finished on the GPU and the old buffers have been released.
+	void FinishCompaction() noexcept;
+
+	[[nodiscard]] static constexpr uint64_t GetPostbuildInfoOffset(uint32_t index) noexcept { return s_PostbuildInfoStride * index; }
+	[[nodiscard]] uint64_t GetPostbuildInfoSize() const noexcept { return s_PostbuildInfoStride * GetNrOfStructures(); }
+	[[nodiscard]] bool ShouldCompact(uint32_t index) const noexcept;
+	//Size of the buffer the structure lives in, the compacted size once it has been compacted.
+	[[nodiscard]] uint64_t GetResultBytes(uint32_t index) const noexcept;
+	[[nodiscard]] uint64_t GetCompactedBytes(uint32_t index) const noexcept { return m_Structures[index].CompactedBytes; }
+	[[nodiscard]] BLASStage GetStage(uint32_t index) const noexcept { return m_Structures[index].Stage; }
+	[[nodiscard]] uint32_t GetNrOfStructures() const noexcept { return static_cast<uint32_t>(m_Structures.size()); }
+
+	//Bytes per model before and after compaction, sorted by model name.
+	[[nodiscard]] std::vector<BLASMemoryReportEntry> GetMemoryReport() const noexcept;
+	[[nodiscard]] BLASMemoryReportEntry GetMemoryTotals() const noexcept;
+private:
+	struct Structure
+	{
+		std::string ModelName = "";
+		uint64_t ResultBytes = 0u;
+		uint64_t ScratchBytes = 0u;
+		uint64_t CompactedBytes = 0u;
+		BLASStage Stage = BLASStage::BUILT;
+	};
+
+	static void AddToEntry(const Structure& structure, BLASMemoryReportEntry& entry) noexcept;
+private:
+	uint64_t m_MinSavedBytes;
+	std::vector<Structure> m_Structures = {};
+};
@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "BVHBuildBenchmark.h"
+
+void BVHBuildBenchmark::Run(const Scene& scene, const BVHBuildSettings& settings) noexcept
+{
+	m_Results.clear();
+	std::vector<ModelBVH::Triangle> triangles;
+	scene.GatherWorldTriangles(triangles);
+	const uint32_t nrOfTriangles = static_cast<uint32_t>(triangles.size());
+	if (nrOfTriangles == 0u)
+		return;
+
+	std::vector<DirectX::XMFLOAT3> triangleMin(nrOfTriangles);
+	std::vector<DirectX::XMFLOAT3> triangleMax(nrOfTriangles);
+	for (uint32_t i{ 0u }; i < nrOfTriangles; ++i)
+	{
+		const ModelBVH::Triangle& triangle = triangles[i];
+		DirectX::XMVECTOR v0 = DirectX::XMLoadFloat3(&triangle.Vertex0);
+		DirectX::XMVECTOR v1 = DirectX::XMVectorAdd(v0, DirectX::XMLoadFloat3(&triangle.Edge1));
+		DirectX::XMVECTOR v2 = DirectX::XMVectorAdd(v0, DirectX::XMLoadFloat3(&triangle.Edge2));
+		DirectX::XMStoreFloat3(&triangleMin[i], DirectX::XMVectorMin(v0, DirectX::XMVectorMin(v1, v2)));
+		DirectX::XMStoreFloat3(&triangleMax[i], DirectX::XMVectorMax(v0, DirectX::XMVectorMax(v1, v2)));
+	}
+
+	//1, 2, 4, ... threads and finally all of them.
+	std::vector<uint32_t> threadCounts;
+	const uint32_t nrOfPoolThreads = ThreadPool::Get().GetNrOfThreads();
+	for (uint32_t nrOfThreads{ 1u }; nrOfThreads < nrOfPoolThreads; nrOfThreads *= 2u)
+	{
+		threadCounts.push_back(nrOfThreads);
+	}
+	threadCounts.push_back(nrOfPoolThreads);
+
+	std::vector<BVHNode> singleThreadedNodes, nodes;
+	std::vector<uint32_t> singleThreadedOrder, order;
+	for (uint32_t size{ 0u }; size < s_NrOfSizes; ++size)
+	{
+		const uint32_t count = std::max(1u, nrOfTriangles >> (s_NrOfSizes - 1u - size));
+		for (uint32_t nrOfThreads : threadCounts)
+		{
+			BVHBuildSettings threadSettings = settings;
+			threadSettings.NrOfThreads = nrOfThreads;
+			BVHBuilder builder(threadSettings);
+			const bool singleThreaded = nrOfThreads == 1u;
+			builder.Build(triangleMin.data(), triangleMax.data(), count, singleThreaded ? singleThreadedNodes : nodes, singleThreaded ? singleThreadedOrder : order);
+
+			BVHBuildBenchmarkResult result;
+			result.NrOfTriangles = count;
+			result.NrOfThreads = builder.GetNrOfThreadsUsed();
+			result.NrOfNodes = static_cast<uint32_t>((singleThreaded ? singleThreadedNodes : nodes).size());
+			result.BuildTime = builder.GetBuildTime();
+			if (!singleThreaded)
+			{
+				result.MatchesSingleThreaded = order == singleThreadedOrder && nodes.size() == singleThreadedNodes.size() &&
+					std::memcmp(nodes.data(), singleThreadedNodes.data(), nodes.size() * sizeof(BVHNode)) == 0;
+			}
+			DBG_ASSERT(result.MatchesSingleThreaded, "Error! The BVH depends on the number of threads it was built with.");
+			m_Results.push_back(result);
+		}
+	}
+}
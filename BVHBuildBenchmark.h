@@ -0,0 +1,30 @@
+#pragma once
+#include "Scene.h"
+
+struct BVHBuildBenchmarkResult
+{
+	uint32_t NrOfTriangles = 0u;
+	uint32_t NrOfThreads = 0u;
+	uint32_t NrOfNodes = 0u;
+	//In milliseconds.
+	double BuildTime = 0.0;
+	//The builder promises the same node array for every thread count, this checks it against the single threaded build.
+	bool MatchesSingleThreaded = true;
+};
+
+//Times the BVH builder on the world space triangles of the scene, against the number of triangles and the number of threads.
+//Smaller triangle counts use the first part of the scene's triangles.
+class BVHBuildBenchmark
+{
+public:
+	static constexpr uint32_t s_NrOfSizes = 4u;
+public:
+	BVHBuildBenchmark() noexcept = default;
+	~BVHBuildBenchmark() noexcept = default;
+
+	void Run(const Scene& scene, const BVHBuildSettings& settings) noexcept;
+
+	[[nodiscard]] const std::vector<BVHBuildBenchmarkResult>& GetResults() const noexcept { return m_Results; }
+private:
+	std::vector<BVHBuildBenchmarkResult> m_Results = {};
+};
@@ -0,0 +1,429 @@
+#include "pch.h"
+#include "BVHBuilder.h"
+
+namespace
+{
+	//Ranges smaller than this are not worth a task of their own.
+	constexpr uint32_t s_MinGrainSize = 4096u;
+
+	struct SAHBin
+	{
+		DirectX::XMFLOAT3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		DirectX::XMFLOAT3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		DirectX::XMFLOAT3 CentroidMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+		DirectX::XMFLOAT3 CentroidMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t Count = 0u;
+	};
+
+	//Bins of all three axes for one range of primitives.
+	struct BinSet
+	{
+		SAHBin Bins[3][BVHBuilder::s_MaxNrOfBins];
+	};
+
+	void GrowBounds(DirectX::XMFLOAT3& min, DirectX::XMFLOAT3& max, const DirectX::XMFLOAT3& otherMin, const DirectX::XMFLOAT3& otherMax) noexcept
+	{
+		min = { std::min(min.x, otherMin.x), std::min(min.y, otherMin.y), std::min(min.z, otherMin.z) };
+		max = { std::max(max.x, otherMax.x), std::max(max.y, otherMax.y), std::max(max.z, otherMax.z) };
+	}
+
+	float GetComponent(const DirectX::XMFLOAT3& vector, uint32_t axis) noexcept
+	{
+		return axis == 0u ? vector.x : (axis == 1u ? vector.y : vector.z);
+	}
+
+	float SurfaceArea(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) noexcept
+	{
+		float x = max.x - min.x;
+		float y = max.y - min.y;
+		float z = max.z - min.z;
+		return 2.0f * (x * y + y * z + z * x);
+	}
+
+	void MergeBin(SAHBin& bin, const SAHBin& other) noexcept
+	{
+		GrowBounds(bin.Min, bin.Max, other.Min, other.Max);
+		GrowBounds(bin.CentroidMin, bin.CentroidMax, other.CentroidMin, other.CentroidMax);
+		bin.Count += other.Count;
+	}
+
+	//Bin index of a centroid along an axis. Axes without extent have a scale of 0 and put everything in the first bin.
+	uint32_t GetBin(const DirectX::XMFLOAT3& centroid, uint32_t axis, float axisMin, float scale, uint32_t nrOfBins) noexcept
+	{
+		return std::min(nrOfBins - 1u, static_cast<uint32_t>((GetComponent(centroid, axis) - axisMin) * scale));
+	}
+}
+
+BVHBuilder::BVHBuilder(const BVHBuildSettings& settings) noexcept
+	: m_Settings{ settings }
+{
+	m_Settings.NrOfBins = std::clamp(m_Settings.NrOfBins, 2u, s_MaxNrOfBins);
+	m_Settings.MaxLeafSize = std::max(m_Settings.MaxLeafSize, 1u);
+}
+
+void BVHBuilder::Build(const DirectX::XMFLOAT3* pMin, const DirectX::XMFLOAT3* pMax, uint32_t count, std::vector<BVHNode>& nodes, std::vector<uint32_t>& primitiveOrder) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint32_t nrOfPoolThreads = ThreadPool::Get().GetNrOfThreads();
+	m_NrOfThreads = m_Settings.NrOfThreads == 0u ? nrOfPoolThreads : std::min(m_Settings.NrOfThreads, nrOfPoolThreads);
+	m_pMin = pMin;
+	m_pMax = pMax;
+	m_pNodes = &nodes;
+	m_pOrder = &primitiveOrder;
+	nodes.clear();
+	primitiveOrder.resize(count);
+	if (count > 0u)
+	{
+		m_Centroids.resize(count);
+		m_Scratch.resize(count);
+		ThreadPool::Get().ParallelFor(count, GetGrainSize(count), [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i{ begin }; i < end; ++i)
+				{
+					m_Centroids[i] = { (pMin[i].x + pMax[i].x) * 0.5f, (pMin[i].y + pMax[i].y) * 0.5f, (pMin[i].z + pMax[i].z) * 0.5f };
+					primitiveOrder[i] = i;
+				}
+			});
+
+		//A binary tree with at least one primitive per leaf never has more than 2n - 1 nodes.
+		nodes.resize(2u * static_cast<size_t>(count) - 1u);
+		m_NrOfNodes = 1u;
+		m_NrOfTasks = 0u;
+		Bounds bounds, centroidBounds;
+		ComputeBounds(0u, count, bounds, centroidBounds);
+		BuildNode(0u, 1u, 0u, count, bounds, centroidBounds);
+		ThreadPool::Get().Wait(m_TaskCounter);
+
+		//The tasks allocate children in whatever order they run, so put the nodes in depth first order to get the same array every time.
+		std::vector<BVHNode> ordered;
+		ordered.reserve(m_NrOfNodes);
+		ordered.push_back(nodes[0]);
+		std::vector<std::pair<uint32_t, uint32_t>> stack;
+		stack.push_back({ 0u, 0u });
+		while (!stack.empty())
+		{
+			auto [orderedIndex, nodeIndex] = stack.back();
+			stack.pop_back();
+			if (nodes[nodeIndex].Count > 0u)
+				continue;
+
+			const uint32_t child = nodes[nodeIndex].LeftFirst;
+			const uint32_t orderedChild = static_cast<uint32_t>(ordered.size());
+			ordered.push_back(nodes[child]);
+			ordered.push_back(nodes[child + 1u]);
+			ordered[orderedIndex].LeftFirst = orderedChild;
+			stack.push_back({ orderedChild + 1u, child + 1u });
+			stack.push_back({ orderedChild, child });
+		}
+		nodes = std::move(ordered);
+	}
+
+	m_pMin = nullptr;
+	m_pMax = nullptr;
+	m_pNodes = nullptr;
+	m_pOrder = nullptr;
+	m_Centroids = {};
+	m_Scratch = {};
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BuildTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+void BVHBuilder::BuildNode(uint32_t nodeIndex, uint32_t depth, uint32_t first, uint32_t count, const Bounds& bounds, const Bounds& centroidBounds) noexcept
+{
+	BVHNode& node = (*m_pNodes)[nodeIndex];
+	node.Min = bounds.Min;
+	node.Max = bounds.Max;
+	node.LeftFirst = first;
+	node.Count = count;
+	if (count <= m_Settings.MaxLeafSize)
+		return;
+
+	//SAH can peel off a few primitives per level on skewed input, so deep nodes are halved to stay within the depth cap.
+	if (depth >= s_MedianSplitDepth)
+	{
+		Split split = FindMedianSplit(first, count, centroidBounds);
+		const uint32_t leftChild = m_NrOfNodes.fetch_add(2u, std::memory_order_relaxed);
+		node.LeftFirst = leftChild;
+		node.Count = 0u;
+		BuildNode(leftChild + 1u, depth + 1u, first + split.LeftCount, count - split.LeftCount, split.Right, split.RightCentroids);
+		BuildNode(leftChild, depth + 1u, first, split.LeftCount, split.Left, split.LeftCentroids);
+		return;
+	}
+
+	Split split = FindSplit(first, count, centroidBounds);
+
+	//Keep the leaf when no split is cheaper than testing all of its primitives.
+	if (split.Cost >= SurfaceArea(bounds.Min, bounds.Max) * count && count <= 4u * m_Settings.MaxLeafSize)
+		return;
+
+	if (split.Cost < FLT_MAX)
+	{
+		Partition(first, count, split, centroidBounds);
+	}
+	else
+	{
+		//All centroids are in the same spot, so just split the primitives in half.
+		split.LeftCount = count / 2u;
+		ComputeBounds(first, split.LeftCount, split.Left, split.LeftCentroids);
+		ComputeBounds(first + split.LeftCount, count - split.LeftCount, split.Right, split.RightCentroids);
+	}
+
+	const uint32_t leftChild = m_NrOfNodes.fetch_add(2u, std::memory_order_relaxed);
+	node.LeftFirst = leftChild;
+	node.Count = 0u;
+
+	const uint32_t rightCount = count - split.LeftCount;
+	if (rightCount >= s_TaskThreshold && TryReserveTask())
+	{
+		ThreadPool::Get().Submit([this, leftChild, depth, first, split, rightCount]()
+			{
+				BuildNode(leftChild + 1u, depth + 1u, first + split.LeftCount, rightCount, split.Right, split.RightCentroids);
+				m_NrOfTasks.fetch_sub(1u, std::memory_order_relaxed);
+			}, m_TaskCounter);
+	}
+	else
+	{
+		BuildNode(leftChild + 1u, depth + 1u, first + split.LeftCount, rightCount, split.Right, split.RightCentroids);
+	}
+	BuildNode(leftChild, depth + 1u, first, split.LeftCount, split.Left, split.LeftCentroids);
+}
+
+BVHBuilder::Split BVHBuilder::FindSplit(uint32_t first, uint32_t count, const Bounds& centroidBounds) noexcept
+{
+	const uint32_t nrOfBins = m_Settings.NrOfBins;
+	float axisMin[3], scale[3];
+	for (uint32_t axis{ 0u }; axis < 3u; ++axis)
+	{
+		axisMin[axis] = GetComponent(centroidBounds.Min, axis);
+		const float axisExtent = GetComponent(centroidBounds.Max, axis) - axisMin[axis];
+		scale[axis] = axisExtent > 0.0f ? static_cast<float>(nrOfBins) / axisExtent : 0.0f;
+	}
+
+	auto binRange = [&](uint32_t begin, uint32_t end, BinSet& binSet) noexcept
+	{
+		for (uint32_t i{ begin }; i < end; ++i)
+		{
+			const uint32_t primitive = (*m_pOrder)[i];
+			const DirectX::XMFLOAT3& centroid = m_Centroids[primitive];
+			for (uint32_t axis{ 0u }; axis < 3u; ++axis)
+			{
+				SAHBin& bin = binSet.Bins[axis][GetBin(centroid, axis, axisMin[axis], scale[axis], nrOfBins)];
+				GrowBounds(bin.Min, bin.Max, m_pMin[primitive], m_pMax[primitive]);
+				GrowBounds(bin.CentroidMin, bin.CentroidMax, centroid, centroid);
+				bin.Count++;
+			}
+		}
+	};
+
+	//Large nodes bin every range into its own set and merge them afterwards.
+	BinSet binSet;
+	if (count >= s_ParallelThreshold && m_NrOfThreads > 1u)
+	{
+		const uint32_t grainSize = GetGrainSize(count);
+		std::vector<BinSet> rangeBinSets((count + grainSize - 1u) / grainSize);
+		ThreadPool::Get().ParallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+			{
+				binRange(first + begin, first + end, rangeBinSets[begin / grainSize]);
+			});
+		for (const BinSet& rangeBinSet : rangeBinSets)
+		{
+			for (uint32_t axis{ 0u }; axis < 3u; ++axis)
+			{
+				for (uint32_t bin{ 0u }; bin < nrOfBins; ++bin)
+				{
+					MergeBin(binSet.Bins[axis][bin], rangeBinSet.Bins[axis][bin]);
+				}
+			}
+		}
+	}
+	else
+	{
+		binRange(first, first + count, binSet);
+	}
+
+	//Sweep from both sides to get the bins on each side of every split plane, and pick the cheapest plane.
+	Split split;
+	for (uint32_t axis{ 0u }; axis < 3u; ++axis)
+	{
+		if (scale[axis] == 0.0f)
+			continue;
+
+		const SAHBin* pBins = binSet.Bins[axis];
+		SAHBin left[s_MaxNrOfBins - 1u], right[s_MaxNrOfBins - 1u];
+		SAHBin leftSweep, rightSweep;
+		for (uint32_t i{ 0u }; i < nrOfBins - 1u; ++i)
+		{
+			MergeBin(leftSweep, pBins[i]);
+			left[i] = leftSweep;
+			const uint32_t j = nrOfBins - 1u - i;
+			MergeBin(rightSweep, pBins[j]);
+			right[j - 1u] = rightSweep;
+		}
+
+		for (uint32_t i{ 0u }; i < nrOfBins - 1u; ++i)
+		{
+			if (left[i].Count == 0u || right[i].Count == 0u)
+				continue;
+
+			const float cost = SurfaceArea(left[i].Min, left[i].Max) * left[i].Count + SurfaceArea(right[i].Min, right[i].Max) * right[i].Count;
+			if (cost < split.Cost)
+			{
+				split.Cost = cost;
+				split.Axis = axis;
+				split.Bin = i;
+				split.LeftCount = left[i].Count;
+				split.Left = { left[i].Min, left[i].Max };
+				split.LeftCentroids = { left[i].CentroidMin, left[i].CentroidMax };
+				split.Right = { right[i].Min, right[i].Max };
+				split.RightCentroids = { right[i].CentroidMin, right[i].CentroidMax };
+			}
+		}
+	}
+	return split;
+}
+
+BVHBuilder::Split BVHBuilder::FindMedianSplit(uint32_t first, uint32_t count, const Bounds& centroidBounds) noexcept
+{
+	//Split the longest axis of the centroids, the primitive index breaks ties so that the result is the same every time.
+	uint32_t axis = 0u;
+	float longestExtent = -1.0f;
+	for (uint32_t i{ 0u }; i < 3u; ++i)
+	{
+		const float extent = GetComponent(centroidBounds.Max, i) - GetComponent(centroidBounds.Min, i);
+		if (extent > longestExtent)
+		{
+			longestExtent = extent;
+			axis = i;
+		}
+	}
+
+	std::vector<uint32_t>& order = *m_pOrder;
+	Split split;
+	split.Axis = axis;
+	split.LeftCount = count / 2u;
+	std::nth_element(order.begin() + first, order.begin() + first + split.LeftCount, order.begin() + first + count, [&](uint32_t a, uint32_t b) noexcept
+		{
+			const float centroidA = GetComponent(m_Centroids[a], axis);
+			const float centroidB = GetComponent(m_Centroids[b], axis);
+			return centroidA < centroidB || (centroidA == centroidB && a < b);
+		});
+	ComputeBounds(first, split.LeftCount, split.Left, split.LeftCentroids);
+	ComputeBounds(first + split.LeftCount, count - split.LeftCount, split.Right, split.RightCentroids);
+	return split;
+}
+
+void BVHBuilder::Partition(uint32_t first, uint32_t count, const Split& split, const Bounds& centroidBounds) noexcept
+{
+	const uint32_t nrOfBins = m_Settings.NrOfBins;
+	const float axisMin = GetComponent(centroidBounds.Min, split.Axis);
+	const float scale = static_cast<float>(nrOfBins) / (GetComponent(centroidBounds.Max, split.Axis) - axisMin);
+	auto isLeft = [&](uint32_t primitive) noexcept
+	{
+		return GetBin(m_Centroids[primitive], split.Axis, axisMin, scale, nrOfBins) <= split.Bin;
+	};
+
+	//Stable partition through the scratch range of the node, then copied back.
+	std::vector<uint32_t>& order = *m_pOrder;
+	if (count < s_ParallelThreshold || m_NrOfThreads == 1u)
+	{
+		uint32_t left = first;
+		uint32_t right = first + split.LeftCount;
+		for (uint32_t i{ first }; i < first + count; ++i)
+		{
+			const uint32_t primitive = order[i];
+			m_Scratch[isLeft(primitive) ? left++ : right++] = primitive;
+		}
+		std::copy(m_Scratch.begin() + first, m_Scratch.begin() + first + count, order.begin() + first);
+		return;
+	}
+
+	//Count the left primitives of every range, so that each range knows where to write its primitives.
+	const uint32_t grainSize = GetGrainSize(count);
+	const uint32_t nrOfRanges = (count + grainSize - 1u) / grainSize;
+	std::vector<uint32_t> leftOffsets(nrOfRanges);
+	ThreadPool::Get().ParallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t nrOfLeft = 0u;
+			for (uint32_t i{ first + begin }; i < first + end; ++i)
+			{
+				nrOfLeft += isLeft(order[i]) ? 1u : 0u;
+			}
+			leftOffsets[begin / grainSize] = nrOfLeft;
+		});
+	uint32_t nrOfLeft = 0u;
+	for (uint32_t& offset : leftOffsets)
+	{
+		const uint32_t rangeLeft = offset;
+		offset = nrOfLeft;
+		nrOfLeft += rangeLeft;
+	}
+	DBG_ASSERT(nrOfLeft == split.LeftCount, "Error! The partition does not match the bins.");
+
+	ThreadPool::Get().ParallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t left = first + leftOffsets[begin / grainSize];
+			uint32_t right = first + nrOfLeft + (begin - leftOffsets[begin / grainSize]);
+			for (uint32_t i{ first + begin }; i < first + end; ++i)
+			{
+				const uint32_t primitive = order[i];
+				m_Scratch[isLeft(primitive) ? left++ : right++] = primitive;
+			}
+		});
+	ThreadPool::Get().ParallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+		{
+			std::copy(m_Scratch.begin() + first + begin, m_Scratch.begin() + first + end, order.begin() + first + begin);
+		});
+}
+
+void BVHBuilder::ComputeBounds(uint32_t first, uint32_t count, Bounds& bounds, Bounds& centroidBounds) noexcept
+{
+	auto boundRange = [&](uint32_t begin, uint32_t end, Bounds& rangeBounds, Bounds& rangeCentroidBounds) noexcept
+	{
+		for (uint32_t i{ begin }; i < end; ++i)
+		{
+			const uint32_t primitive = (*m_pOrder)[i];
+			GrowBounds(rangeBounds.Min, rangeBounds.Max, m_pMin[primitive], m_pMax[primitive]);
+			GrowBounds(rangeCentroidBounds.Min, rangeCentroidBounds.Max, m_Centroids[primitive], m_Centroids[primitive]);
+		}
+	};
+
+	bounds = {};
+	centroidBounds = {};
+	if (count < s_ParallelThreshold || m_NrOfThreads == 1u)
+	{
+		boundRange(first, first + count, bounds, centroidBounds);
+		return;
+	}
+
+	const uint32_t grainSize = GetGrainSize(count);
+	std::vector<std::pair<Bounds, Bounds>> rangeBounds((count + grainSize - 1u) / grainSize);
+	ThreadPool::Get().ParallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+		{
+			std::pair<Bounds, Bounds>& range = rangeBounds[begin / grainSize];
+			boundRange(first + begin, first + end, range.first, range.second);
+		});
+	for (const auto& [rangeBound, rangeCentroidBound] : rangeBounds)
+	{
+		GrowBounds(bounds.Min, bounds.Max, rangeBound.Min, rangeBound.Max);
+		GrowBounds(centroidBounds.Min, centroidBounds.Max, rangeCentroidBound.Min, rangeCentroidBound.Max);
+	}
+}
+
+uint32_t BVHBuilder::GetGrainSize(uint32_t count) const noexcept
+{
+	return std::max(s_MinGrainSize, (count + m_NrOfThreads - 1u) / m_NrOfThreads);
+}
+
+bool BVHBuilder::TryReserveTask() noexcept
+{
+	//The building thread counts as one, so at most m_NrOfThreads - 1 subtrees run as tasks at the same time.
+	uint32_t nrOfTasks = m_NrOfTasks.load(std::memory_order_relaxed);
+	while (nrOfTasks + 1u < m_NrOfThreads)
+	{
+		if (m_NrOfTasks.compare_exchange_weak(nrOfTasks, nrOfTasks + 1u, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
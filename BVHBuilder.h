@@ -0,0 +1,92 @@
+#pragma once
+#include "ThreadPool.h"
+
+//Flat BVH node, the children of an inner node are stored next to each other and always after their parent.
+//Plain data without pointers so that a node array can be written to and read from disk as is.
+struct BVHNode
+{
+	DirectX::XMFLOAT3 Min;
+	uint32_t LeftFirst;		//Inner node: index of the left child, the right child follows it. Leaf: first primitive.
+	DirectX::XMFLOAT3 Max;
+	uint32_t Count;			//Number of primitives in a leaf, 0 for inner nodes.
+};
+static_assert(sizeof(BVHNode) == 32u && std::is_trivially_copyable_v<BVHNode>, "BVH nodes are cached on disk as raw bytes.");
+
+//Quality knobs of the build. More bins find better splits, larger leaves give smaller trees that are slower to trace.
+struct BVHBuildSettings
+{
+	uint32_t NrOfBins = 16u;
+	uint32_t MaxLeafSize = 4u;
+	//Threads of the pool that may work on the build, 0 uses all of them.
+	uint32_t NrOfThreads = 0u;
+};
+
+//Top down binned SAH builder over primitive bounds.
+//Large nodes near the top bin and partition their primitives in parallel, further down whole subtrees become tasks on the thread pool.
+//The partition is stable and the nodes are put in depth first order at the end, so the result does not depend on the number of threads.
+class BVHBuilder
+{
+public:
+	static constexpr uint32_t s_MaxNrOfBins = 64u;
+	//Nodes with at least this many primitives are binned and partitioned in parallel.
+	static constexpr uint32_t s_ParallelThreshold = 16384u;
+	//Subtrees with at least this many primitives are handed to another thread if one is free.
+	static constexpr uint32_t s_TaskThreshold = 1024u;
+	//No node is more than this many levels deep, the root being the first, so traversals can use a fixed size stack.
+	//Nodes from s_MedianSplitDepth on are split at the median instead of with SAH, which halves them and reaches a leaf within 32 more levels.
+	static constexpr uint32_t s_MaxDepth = 64u;
+	static constexpr uint32_t s_MedianSplitDepth = s_MaxDepth - 32u;
+public:
+	BVHBuilder(const BVHBuildSettings& settings = {}) noexcept;
+	~BVHBuilder() noexcept = default;
+
+	//Builds over the bounds of count primitives. The leaves refer to ranges of primitiveOrder, which holds the primitive indices in leaf order.
+	void Build(const DirectX::XMFLOAT3* pMin, const DirectX::XMFLOAT3* pMax, uint32_t count, std::vector<BVHNode>& nodes, std::vector<uint32_t>& primitiveOrder) noexcept;
+
+	[[nodiscard]] constexpr const BVHBuildSettings& GetSettings() const noexcept { return m_Settings; }
+	//Time the last build took in milliseconds.
+	[[nodiscard]] constexpr double GetBuildTime() const noexcept { return m_BuildTime; }
+	[[nodiscard]] constexpr uint32_t GetNrOfThreadsUsed() const noexcept { return m_NrOfThreads; }
+private:
+	struct Bounds
+	{
+		DirectX::XMFLOAT3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		DirectX::XMFLOAT3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	};
+
+	struct Split
+	{
+		float Cost = FLT_MAX;
+		uint32_t Axis = 0u;
+		uint32_t Bin = 0u;
+		uint32_t LeftCount = 0u;
+		Bounds Left = {};
+		Bounds LeftCentroids = {};
+		Bounds Right = {};
+		Bounds RightCentroids = {};
+	};
+
+	void BuildNode(uint32_t nodeIndex, uint32_t depth, uint32_t first, uint32_t count, const Bounds& bounds, const Bounds& centroidBounds) noexcept;
+	Split FindSplit(uint32_t first, uint32_t count, const Bounds& centroidBounds) noexcept;
+	Split FindMedianSplit(uint32_t first, uint32_t count, const Bounds& centroidBounds) noexcept;
+	void Partition(uint32_t first, uint32_t count, const Split& split, const Bounds& centroidBounds) noexcept;
+	void ComputeBounds(uint32_t first, uint32_t count, Bounds& bounds, Bounds& centroidBounds) noexcept;
+	[[nodiscard]] uint32_t GetGrainSize(uint32_t count) const noexcept;
+	[[nodiscard]] bool TryReserveTask() noexcept;
+private:
+	BVHBuildSettings m_Settings = {};
+	uint32_t m_NrOfThreads = 1u;
+
+	//Only valid during a build.
+	const DirectX::XMFLOAT3* m_pMin = nullptr;
+	const DirectX::XMFLOAT3* m_pMax = nullptr;
+	std::vector<DirectX::XMFLOAT3> m_Centroids = {};
+	std::vector<uint32_t> m_Scratch = {};
+	std::vector<BVHNode>* m_pNodes = nullptr;
+	std::vector<uint32_t>* m_pOrder = nullptr;
+	std::atomic<uint32_t> m_NrOfNodes = 0u;
+	std::atomic<uint32_t> m_NrOfTasks = 0u;
+	TaskCounter m_TaskCounter;
+
+	double m_BuildTime = 0.0;
+};
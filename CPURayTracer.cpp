@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "CPURayTracer.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	//Same modifiers as PixelShader.hlsl, the lights come from the scene's light manager.
+	constexpr float s_Ambient = 0.2f;
+	constexpr float s_Specular = 0.8f;
+	constexpr float s_Diffuse = 0.7f;
+	//Range of the shadow rays in the shader.
+	constexpr float s_ShadowMinDistance = 0.1f;
+	constexpr float s_ShadowMaxDistance = 10000.0f;
+	//Primary rays start at the near plane and end around the far plane, like the rasterized geometry.
+	constexpr float s_PrimaryMaxDistance = 10000.0f;
+}
+
+void CPURayTracer::Render(const Scene& scene, const DirectX::XMFLOAT4X4& viewProjection, const DirectX::XMFLOAT3& cameraPosition, uint32_t width, uint32_t height, const CPURayTracerSettings& settings) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_ViewProjection = viewProjection;
+	DirectX::XMStoreFloat4x4(&m_InverseViewProjection, DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&viewProjection)));
+	m_CameraPosition = cameraPosition;
+	m_Settings = settings;
+
+	m_Stats = {};
+	m_Stats.Width = width;
+	m_Stats.Height = height;
+	m_Image.assign(static_cast<size_t>(width) * height * 3u, 0u);
+	m_NrOfTilesX = (width + s_TileSize - 1u) / s_TileSize;
+	const uint32_t nrOfTilesY = (height + s_TileSize - 1u) / s_TileSize;
+
+	std::atomic<uint64_t> nrOfShadowRays = 0u;
+	std::atomic<uint64_t> nrOfBakedShadows = 0u;
+	ThreadPool::Get().ParallelFor(m_NrOfTilesX * nrOfTilesY, 1u, [&](uint32_t begin, uint32_t end)
+		{
+			uint64_t tileShadowRays = 0u;
+			uint64_t tileBakedShadows = 0u;
+			for (uint32_t tile{ begin }; tile < end; ++tile)
+			{
+				RenderTile(scene, tile, tileShadowRays, tileBakedShadows);
+			}
+			nrOfShadowRays += tileShadowRays;
+			nrOfBakedShadows += tileBakedShadows;
+		});
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_Stats.RenderTime = static_cast<double>(dif.count()) * 0.001;
+	m_Stats.NrOfPrimaryRays = static_cast<uint64_t>(width) * height;
+	m_Stats.NrOfShadowRays = nrOfShadowRays;
+	m_Stats.NrOfBakedShadows = nrOfBakedShadows;
+	if (m_Stats.RenderTime > 0.0)
+	{
+		m_Stats.RaysPerSecond = static_cast<double>(m_Stats.NrOfPrimaryRays + m_Stats.NrOfShadowRays) / (m_Stats.RenderTime * 0.001);
+	}
+}
+
+bool CPURayTracer::WritePPM(const std::string& path) const noexcept
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	file << "P6\n" << m_Stats.Width << " " << m_Stats.Height << "\n255\n";
+	file.write(reinterpret_cast<const char*>(m_Image.data()), static_cast<std::streamsize>(m_Image.size()));
+	return static_cast<bool>(file);
+}
+
+bool CPURayTracer::CompareToPPM(const std::string& path, uint32_t tolerance, uint32_t& nrOfMismatches) const noexcept
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string format;
+	uint32_t width = 0u;
+	uint32_t height = 0u;
+	uint32_t maxValue = 0u;
+	file >> format >> width >> height >> maxValue;
+	//A single whitespace character separates the header from the pixels.
+	file.get();
+	if (!file || format != "P6" || maxValue != 255u || width != m_Stats.Width || height != m_Stats.Height)
+		return false;
+
+	std::vector<uint8_t> image(m_Image.size());
+	file.read(reinterpret_cast<char*>(image.data()), static_cast<std::streamsize>(image.size()));
+	if (!file)
+		return false;
+
+	nrOfMismatches = 0u;
+	for (size_t i{ 0u }; i < image.size(); i += 3u)
+	{
+		bool mismatch = false;
+		for (uint32_t channel{ 0u }; channel < 3u; ++channel)
+		{
+			mismatch |= static_cast<uint32_t>(std::abs(static_cast<int>(image[i + channel]) - static_cast<int>(m_Image[i + channel]))) > tolerance;
+		}
+		nrOfMismatches += mismatch ? 1u : 0u;
+	}
+	return true;
+}
+
+void CPURayTracer::RenderTile(const Scene& scene, uint32_t tileIndex, uint64_t& nrOfShadowRays, uint64_t& nrOfBakedShadows) noexcept
+{
+	const uint32_t beginX = (tileIndex % m_NrOfTilesX) * s_TileSize;
+	const uint32_t beginY = (tileIndex / m_NrOfTilesX) * s_TileSize;
+	const uint32_t endX = std::min(beginX + s_TileSize, m_Stats.Width);
+	const uint32_t endY = std::min(beginY + s_TileSize, m_Stats.Height);
+	const DirectX::XMMATRIX inverseViewProjection = DirectX::XMLoadFloat4x4(&m_InverseViewProjection);
+
+	for (uint32_t y{ beginY }; y < endY; ++y)
+	{
+		for (uint32_t x{ beginX }; x < endX; ++x)
+		{
+			//Unproject the pixel center onto the near and far plane.
+			const float ndcX = (static_cast<float>(x) + 0.5f) / m_Stats.Width * 2.0f - 1.0f;
+			const float ndcY = 1.0f - (static_cast<float>(y) + 0.5f) / m_Stats.Height * 2.0f;
+			DirectX::XMVECTOR nearPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), inverseViewProjection);
+			DirectX::XMVECTOR farPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), inverseViewProjection);
+			SceneRay ray = {};
+			DirectX::XMStoreFloat3(&ray.Origin, nearPoint);
+			DirectX::XMStoreFloat3(&ray.Direction, DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(farPoint, nearPoint)));
+			ray.MaxDistance = s_PrimaryMaxDistance;
+
+			//Nothing hit is left as the clear color.
+			SceneRayHit hit = {};
+			if (!scene.RayCast(ray, hit))
+				continue;
+
+			const DirectX::XMFLOAT3 color = Shade(scene, ray, hit, x, y, nrOfShadowRays, nrOfBakedShadows);
+			uint8_t* pPixel = &m_Image[(static_cast<size_t>(y) * m_Stats.Width + x) * 3u];
+			pPixel[0] = static_cast<uint8_t>(std::clamp(color.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+			pPixel[1] = static_cast<uint8_t>(std::clamp(color.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+			pPixel[2] = static_cast<uint8_t>(std::clamp(color.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+DirectX::XMFLOAT3 CPURayTracer::Shade(const Scene& scene, const SceneRay& ray, const SceneRayHit& hit, uint32_t x, uint32_t y, uint64_t& nrOfShadowRays, uint64_t& nrOfBakedShadows) const noexcept
+{
+	const VertexObject& object = *hit.pObject;
+	const Mesh& mesh = *object.GetModel()->GetMeshes()[hit.MeshIndex];
+	const std::vector<Vertex>& vertices = mesh.GetVertices();
+	const std::vector<uint32_t>& indices = mesh.GetIndices();
+	const uint32_t firstIndex = hit.TriangleIndex * 3u;
+
+	//The vertex shader moves the normalized normals into world space and the pixel shader normalizes the interpolated result.
+	const DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&object.GetTransform());
+	auto worldNormal = [&](uint32_t index) noexcept
+	{
+		DirectX::XMVECTOR normal = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&vertices[indices[firstIndex + index]].normal));
+		return DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(normal, world));
+	};
+	const float u = hit.U;
+	const float v = hit.V;
+	DirectX::XMVECTOR normal = DirectX::XMVectorScale(worldNormal(0u), 1.0f - u - v);
+	normal = DirectX::XMVectorMultiplyAdd(worldNormal(1u), DirectX::XMVectorReplicate(u), normal);
+	normal = DirectX::XMVectorMultiplyAdd(worldNormal(2u), DirectX::XMVectorReplicate(v), normal);
+	normal = DirectX::XMVector3Normalize(normal);
+	//The baked ambient occlusion is interpolated like the normals.
+	const std::vector<uint8_t>& occlusion = mesh.GetAmbientOcclusion();
+	float ambientOcclusion = 1.0f;
+	if (!occlusion.empty())
+	{
+		ambientOcclusion = ((1.0f - u - v) * occlusion[indices[firstIndex]] + u * occlusion[indices[firstIndex + 1u]] + v * occlusion[indices[firstIndex + 2u]]) / 255.0f;
+	}
+
+	const DirectX::XMVECTOR position = DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat3(&ray.Direction), DirectX::XMVectorReplicate(hit.Distance), DirectX::XMLoadFloat3(&ray.Origin));
+	const DirectX::XMVECTOR viewDirection = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&m_CameraPosition), position));
+	const DirectX::XMVECTOR objectColor = DirectX::XMLoadFloat4(&object.GetColor());
+	SceneRay shadowRay = {};
+	DirectX::XMStoreFloat3(&shadowRay.Origin, position);
+	shadowRay.MinDistance = s_ShadowMinDistance;
+
+	//The same light list as the pixel shader loops over, the lights of the pixel's cluster or those of the object.
+	const LightManager& lightManager = scene.GetLightManager();
+	const std::vector<PointLight>& lights = lightManager.GetLights();
+	LightRange lightRange = lightManager.GetLightRange(hit.ObjectIndex);
+	const uint32_t* pLightIndices = lightManager.GetLightIndices().data() + lightRange.Offset;
+	if (m_Settings.pLightClusters)
+	{
+		//The shader's cluster lookup, with the pixel center and the view depth, which is w after the projection.
+		const LightClusterBuilder& clusters = *m_Settings.pLightClusters;
+		DirectX::XMFLOAT3 worldPosition = {};
+		DirectX::XMStoreFloat3(&worldPosition, position);
+		const DirectX::XMFLOAT4X4& vp = m_ViewProjection;
+		const float viewDepth = worldPosition.x * vp._14 + worldPosition.y * vp._24 + worldPosition.z * vp._34 + vp._44;
+		const uint32_t clusterX = std::min(static_cast<uint32_t>((static_cast<float>(x) + 0.5f) * LightClusterBuilder::s_DimX / m_Stats.Width), LightClusterBuilder::s_DimX - 1u);
+		const uint32_t clusterY = std::min(static_cast<uint32_t>((static_cast<float>(y) + 0.5f) * LightClusterBuilder::s_DimY / m_Stats.Height), LightClusterBuilder::s_DimY - 1u);
+		const float slice = std::floor(std::log(viewDepth) * clusters.GetDepthScale() + clusters.GetDepthBias());
+		const uint32_t clusterZ = static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(LightClusterBuilder::s_DimZ - 1u)));
+		lightRange = clusters.GetClusterRanges()[LightClusterBuilder::GetClusterIndex(clusterX, clusterY, clusterZ)];
+		pLightIndices = clusters.GetLightIndices().data() + lightRange.Offset;
+	}
+
+	//The baked shadow state of a light for the object, as the shader reads it from the object's row. Lights past the row are traced.
+	const LightVisibilityBaker& lightVisibility = scene.GetLightVisibility();
+	const LightRange visibilityRange = lightVisibility.GetVisibilityRange(hit.ObjectIndex);
+	const std::vector<uint32_t>& visibilityMasks = lightVisibility.GetMasks();
+	auto getShadowState = [&](uint32_t lightIndex) noexcept
+	{
+		if (lightIndex >= visibilityRange.Count)
+			return LightVisibility::Partial;
+
+		const uint32_t mask = visibilityMasks[visibilityRange.Offset + lightIndex / LightVisibilityBaker::s_StatesPerWord];
+		return static_cast<LightVisibility>((mask >> ((lightIndex % LightVisibilityBaker::s_StatesPerWord) * 2u)) & 3u);
+	};
+
+	DirectX::XMVECTOR result = DirectX::XMVectorZero();
+	for (uint32_t i{ 0u }; i < lightRange.Count; ++i)
+	{
+		const uint32_t lightIndex = pLightIndices[i];
+		const PointLight& light = lights[lightIndex];
+		const DirectX::XMVECTOR toLight = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&light.Position), position);
+		const float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(toLight));
+		if (distance > light.Radius)
+			continue;
+
+		const DirectX::XMVECTOR lightColor = DirectX::XMLoadFloat3(&light.Color);
+		const float attenuation = 1.0f / (1.0f + 0.0f * distance + 0.0001f * (distance * distance));
+		const DirectX::XMVECTOR lightDirection = DirectX::XMVector3Normalize(toLight);
+
+		//Ambient
+		const DirectX::XMVECTOR ambientColor = DirectX::XMVectorScale(DirectX::XMVectorMultiply(DirectX::XMVectorScale(lightColor, s_Ambient * ambientOcclusion), objectColor), attenuation);
+
+		//Shadows, the shader accepts the first hit and compares its distance to the light's, which is the same as looking for any hit up to the light.
+		//With the baked states only the partial pairs are traced.
+		bool traceShadow = m_Settings.Shadows == ShadowMode::Traced;
+		bool shadowed = false;
+		if (m_Settings.Shadows == ShadowMode::Baked)
+		{
+			const LightVisibility shadowState = getShadowState(lightIndex);
+			traceShadow = shadowState == LightVisibility::Partial;
+			shadowed = shadowState == LightVisibility::Occluded;
+			nrOfBakedShadows += traceShadow ? 0u : 1u;
+		}
+		if (traceShadow)
+		{
+			DirectX::XMStoreFloat3(&shadowRay.Direction, lightDirection);
+			shadowRay.MaxDistance = std::min(distance, s_ShadowMaxDistance);
+			nrOfShadowRays++;
+			shadowed = scene.RayCastAny(shadowRay);
+		}
+		if (shadowed)
+		{
+			result = DirectX::XMVectorAdd(result, ambientColor);
+			continue;
+		}
+
+		//Diffuse
+		const float diff = std::max(DirectX::XMVectorGetX(DirectX::XMVector3Dot(lightDirection, normal)), 0.0f);
+		DirectX::XMVECTOR diffuseColor = DirectX::XMVectorScale(lightColor, diff * s_Diffuse);
+
+		//Specular
+		const DirectX::XMVECTOR reflectDirection = DirectX::XMVector3Reflect(DirectX::XMVectorNegate(lightDirection), normal);
+		const float spec = std::pow(std::max(DirectX::XMVectorGetX(DirectX::XMVector3Dot(viewDirection, reflectDirection)), 0.0f), 64.0f);
+		DirectX::XMVECTOR specularColor = DirectX::XMVectorScale(lightColor, s_Specular * spec);
+
+		diffuseColor = DirectX::XMVectorScale(DirectX::XMVectorMultiply(diffuseColor, objectColor), attenuation);
+		specularColor = DirectX::XMVectorScale(DirectX::XMVectorMultiply(specularColor, objectColor), attenuation);
+
+		result = DirectX::XMVectorAdd(result, DirectX::XMVectorAdd(ambientColor, DirectX::XMVectorAdd(diffuseColor, specularColor)));
+	}
+
+	DirectX::XMFLOAT3 color = {};
+	DirectX::XMStoreFloat3(&color, result);
+	return color;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "Renderer.h"
+
+struct CPURayTracerStats
+{
+	uint32_t Width = 0u;
+	uint32_t Height = 0u;
+	uint64_t NrOfPrimaryRays = 0u;
+	uint64_t NrOfShadowRays = 0u;
+	//Lights whose baked visibility decided the shadow without a ray.
+	uint64_t NrOfBakedShadows = 0u;
+	//Timings in milliseconds.
+	double RenderTime = 0.0;
+	double RaysPerSecond = 0.0;
+};
+
+//The variant of the pixel shader to match, set like the renderer's to compare against its frame.
+struct CPURayTracerSettings
+{
+	ShadowMode Shadows = ShadowMode::Traced;
+	//Shades with the lights of the pixel's cluster instead of the object's light list. The clusters have to be built for the same view.
+	const LightClusterBuilder* pLightClusters = nullptr;
+};
+
+//Reference renderer that runs the lighting of the pixel shader on the CPU.
+//Primary rays replace the rasterizer and shadow rays replace the RayQuery against the top level acceleration structure.
+//The shadows and the light lists follow the shader's SHADOW_MODE and CLUSTERED_LIGHTING keys, the baked states come from the scene's light visibility.
+//The rays go through the scene's ray cast queries, so the scene has to be culled before rendering to have them up to date.
+//The image is split into tiles that are rendered in parallel on the thread pool.
+class CPURayTracer
+{
+public:
+	static constexpr uint32_t s_TileSize = 16u;
+public:
+	CPURayTracer() noexcept = default;
+	~CPURayTracer() noexcept = default;
+
+	//Renders the scene as seen through the view projection matrix.
+	void Render(const Scene& scene, const DirectX::XMFLOAT4X4& viewProjection, const DirectX::XMFLOAT3& cameraPosition, uint32_t width, uint32_t height, const CPURayTracerSettings& settings) noexcept;
+	//Writes the last image as a binary PPM. Returns false if the file could not be written.
+	bool WritePPM(const std::string& path) const noexcept;
+	//Counts the pixels of the last image where a channel differs by more than the tolerance from the PPM, as written by WritePPM.
+	//Returns false if the file could not be read or has another size.
+	bool CompareToPPM(const std::string& path, uint32_t tolerance, uint32_t& nrOfMismatches) const noexcept;
+
+	//The last image, 8 bit RGB, row by row from the top.
+	[[nodiscard]] const std::vector<uint8_t>& GetImage() const noexcept { return m_Image; }
+	[[nodiscard]] const CPURayTracerStats& GetStats() const noexcept { return m_Stats; }
+private:
+	void RenderTile(const Scene& scene, uint32_t tileIndex, uint64_t& nrOfShadowRays, uint64_t& nrOfBakedShadows) noexcept;
+	DirectX::XMFLOAT3 Shade(const Scene& scene, const SceneRay& ray, const SceneRayHit& hit, uint32_t x, uint32_t y, uint64_t& nrOfShadowRays, uint64_t& nrOfBakedShadows) const noexcept;
+private:
+	DirectX::XMFLOAT4X4 m_ViewProjection = {};
+	DirectX::XMFLOAT4X4 m_InverseViewProjection = {};
+	DirectX::XMFLOAT3 m_CameraPosition = {};
+	uint32_t m_NrOfTilesX = 0u;
+	CPURayTracerSettings m_Settings = {};
+
+	std::vector<uint8_t> m_Image = {};
+	CPURayTracerStats m_Stats = {};
+};
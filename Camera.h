@@ -3,12 +3,16 @@ static const DirectX::XMFLOAT3 WorldUpVector = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0
 static const DirectX::XMFLOAT3 CameraStartPosition = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
 class Camera
 {
+public:
+	static constexpr float s_NearPlane = 0.1f;
+	static constexpr float s_FarPlane = 10000.0f;
 public:
 	Camera(const DirectX::XMFLOAT3& position, const uint32_t width, const uint32_t height) noexcept;
 	~Camera() noexcept = default;
 	void RecalculateViewProjectionMatrix() noexcept;
 	void Update(const float deltaTime) noexcept;
 	[[nodiscard]] constexpr DirectX::XMFLOAT4X4& GetVPMatrix() noexcept { return m_ViewProjectionMatrix; }
+	[[nodiscard]] constexpr DirectX::XMFLOAT4X4& GetViewMatrix() noexcept { return m_ViewMatrix; }
 	[[nodiscard]] float GetElement1PMatrix() noexcept { return m_ProjectionMatrix._11; }
 	[[nodiscard]] float GetElement2PMatrix() noexcept { return m_ProjectionMatrix._22; }
 	[[nodiscard]] constexpr DirectX::XMFLOAT3& GetPosition() noexcept { return m_Position; }
@@ -0,0 +1,34 @@
+#include "pch.h"
+#include "CommandListPool.h"
+#include "DXCore.h"
+
+void D3D12CommandListBackend::Create(CommandList& commandList) noexcept
+{
+	HR(DXCore::GetDevice()->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandList.pAllocator)));
+	//CreateCommandList1 creates the list closed, the same state a recycled list is in.
+	HR(DXCore::GetDevice()->CreateCommandList1(0u, D3D12_COMMAND_LIST_TYPE_DIRECT, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&commandList.pCommandList)));
+
+	std::wstring name{ L"Pooled Command List #" + std::to_wstring(m_NrOfCreated++) };
+	HR(commandList.pAllocator->SetName(name.c_str()));
+	HR(commandList.pCommandList->SetName(name.c_str()));
+}
+
+//Reset and Close may run on the recording threads. They check the result themselves instead of using HR,
+//which clears and reads the info queue that the main thread shares. Its messages are left for the main thread's next HR or STDCALL.
+void D3D12CommandListBackend::Reset(CommandList& commandList) noexcept
+{
+	if (FAILED(commandList.pAllocator->Reset()) || FAILED(commandList.pCommandList->Reset(commandList.pAllocator.Get(), nullptr)))
+	{
+		m_NrOfFailed.fetch_add(1u, std::memory_order_relaxed);
+		DBG_ASSERT(false, "Could not reset a pooled command list.");
+	}
+}
+
+void D3D12CommandListBackend::Close(CommandList& commandList) noexcept
+{
+	if (FAILED(commandList.pCommandList->Close()))
+	{
+		m_NrOfFailed.fetch_add(1u, std::memory_order_relaxed);
+		DBG_ASSERT(false, "Could not close a pooled command list.");
+	}
+}
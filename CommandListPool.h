@@ -0,0 +1,170 @@
+#pragma once
+#include "ThreadPool.h"
+
+//Command lists that are recycled once the GPU has finished with them, and recording of a range of work split over the thread pool.
+//The backend creates, resets and closes the command lists, so the pooling and chunking can run against a mock backend.
+//A backend provides a CommandList type and Create(CommandList&), Reset(CommandList&) and Close(CommandList&).
+//Create leaves the list closed, Reset makes it ready for recording.
+template<typename TBackend>
+class CommandListPoolT
+{
+public:
+	using CommandList = typename TBackend::CommandList;
+public:
+	CommandListPoolT() noexcept = default;
+	~CommandListPoolT() noexcept = default;
+
+	//Returns a list that is ready for recording. Lists whose fence value has been reached are reused before new ones are created.
+	CommandList& Acquire(uint64_t completedFenceValue) noexcept;
+	//Hands the list back. It is reused once the GPU has reached fenceValue.
+	void Release(CommandList& commandList, uint64_t fenceValue) noexcept;
+
+	//Splits [0, count) into one chunk per thread, with at least minChunkSize items in each, and records the chunks in parallel.
+	//The function is called as record(uint32_t chunkIndex, CommandList& commandList, uint32_t begin, uint32_t end).
+	//The lists are closed afterwards and GetRecorded returns them in chunk order, which is the order they have to be executed in.
+	template<typename RecordFunction>
+	void RecordParallel(uint32_t count, uint32_t minChunkSize, uint64_t completedFenceValue, RecordFunction&& record) noexcept;
+	//Releases the lists of the last RecordParallel once they have been submitted.
+	void ReleaseRecorded(uint64_t fenceValue) noexcept;
+
+	//The range of chunk chunkIndex when [0, count) is split into nrOfChunks chunks.
+	static void GetChunkRange(uint32_t count, uint32_t nrOfChunks, uint32_t chunkIndex, uint32_t& begin, uint32_t& end) noexcept;
+
+	[[nodiscard]] TBackend& GetBackend() noexcept { return m_Backend; }
+	[[nodiscard]] const TBackend& GetBackend() const noexcept { return m_Backend; }
+	[[nodiscard]] const std::vector<CommandList*>& GetRecorded() const noexcept { return m_Recorded; }
+	[[nodiscard]] uint32_t GetNrOfCommandLists() const noexcept { return static_cast<uint32_t>(m_CommandLists.size()); }
+	[[nodiscard]] uint32_t GetNrOfInFlight() const noexcept { return static_cast<uint32_t>(m_InFlight.size()); }
+	//Time spent in the last RecordParallel in milliseconds.
+	[[nodiscard]] constexpr double GetRecordTime() const noexcept { return m_RecordTime; }
+private:
+	struct InFlightCommandList
+	{
+		CommandList* pCommandList = nullptr;
+		uint64_t FenceValue = 0u;
+	};
+
+	TBackend m_Backend = {};
+	//A deque so that the lists keep their addresses when the pool grows.
+	std::deque<CommandList> m_CommandLists = {};
+	std::vector<CommandList*> m_Free = {};
+	std::vector<InFlightCommandList> m_InFlight = {};
+	std::vector<CommandList*> m_Recorded = {};
+	double m_RecordTime = 0.0;
+};
+
+template<typename TBackend>
+typename CommandListPoolT<TBackend>::CommandList& CommandListPoolT<TBackend>::Acquire(uint64_t completedFenceValue) noexcept
+{
+	//Move everything the GPU is done with back to the free lists.
+	for (uint32_t i{ 0u }; i < m_InFlight.size();)
+	{
+		if (m_InFlight[i].FenceValue <= completedFenceValue)
+		{
+			m_Free.push_back(m_InFlight[i].pCommandList);
+			m_InFlight[i] = m_InFlight.back();
+			m_InFlight.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	CommandList* pCommandList = nullptr;
+	if (m_Free.empty())
+	{
+		pCommandList = &m_CommandLists.emplace_back();
+		m_Backend.Create(*pCommandList);
+	}
+	else
+	{
+		pCommandList = m_Free.back();
+		m_Free.pop_back();
+	}
+	m_Backend.Reset(*pCommandList);
+	return *pCommandList;
+}
+
+template<typename TBackend>
+void CommandListPoolT<TBackend>::Release(CommandList& commandList, uint64_t fenceValue) noexcept
+{
+	m_InFlight.push_back({ &commandList, fenceValue });
+}
+
+template<typename TBackend>
+template<typename RecordFunction>
+void CommandListPoolT<TBackend>::RecordParallel(uint32_t count, uint32_t minChunkSize, uint64_t completedFenceValue, RecordFunction&& record) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	DBG_ASSERT(m_Recorded.empty(), "Error! The lists of the last recording have not been released.");
+	if (count == 0u)
+	{
+		m_RecordTime = 0.0;
+		return;
+	}
+
+	const uint32_t chunkSize = std::max(minChunkSize, 1u);
+	const uint32_t nrOfChunks = std::clamp((count + chunkSize - 1u) / chunkSize, 1u, ThreadPool::Get().GetNrOfThreads());
+
+	//The pool is not thread safe, so all lists are acquired before the workers start.
+	for (uint32_t i{ 0u }; i < nrOfChunks; ++i)
+	{
+		m_Recorded.push_back(&Acquire(completedFenceValue));
+	}
+
+	ThreadPool::Get().ParallelFor(nrOfChunks, 1u, [&](uint32_t chunkBegin, uint32_t chunkEnd)
+		{
+			for (uint32_t chunk{ chunkBegin }; chunk < chunkEnd; ++chunk)
+			{
+				uint32_t begin = 0u;
+				uint32_t end = 0u;
+				GetChunkRange(count, nrOfChunks, chunk, begin, end);
+				record(chunk, *m_Recorded[chunk], begin, end);
+				m_Backend.Close(*m_Recorded[chunk]);
+			}
+		});
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_RecordTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+template<typename TBackend>
+void CommandListPoolT<TBackend>::ReleaseRecorded(uint64_t fenceValue) noexcept
+{
+	for (CommandList* pCommandList : m_Recorded)
+	{
+		Release(*pCommandList, fenceValue);
+	}
+	m_Recorded.clear();
+}
+
+template<typename TBackend>
+void CommandListPoolT<TBackend>::GetChunkRange(uint32_t count, uint32_t nrOfChunks, uint32_t chunkIndex, uint32_t& begin, uint32_t& end) noexcept
+{
+	begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * chunkIndex / nrOfChunks);
+	end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (chunkIndex + 1u) / nrOfChunks);
+}
+
+//Backend that creates a direct command list with its own allocator.
+class D3D12CommandListBackend
+{
+public:
+	struct CommandList
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> pAllocator = nullptr;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> pCommandList = nullptr;
+	};
+
+	void Create(CommandList& commandList) noexcept;
+	void Reset(CommandList& commandList) noexcept;
+	void Close(CommandList& commandList) noexcept;
+	//Resets and closes that failed since the start, counted here because they may happen on any thread.
+	[[nodiscard]] uint32_t GetNrOfFailed() const noexcept { return m_NrOfFailed.load(std::memory_order_relaxed); }
+private:
+	uint32_t m_NrOfCreated = 0u;
+	std::atomic<uint32_t> m_NrOfFailed = 0u;
+};
+
+using CommandListPool = CommandListPoolT<D3D12CommandListBackend>;
@@ -0,0 +1,205 @@
+#pragma once
+
+//Thin layer in front of a command list that remembers the bound pipeline state, root signature and root parameters,
+//and drops Set calls that would bind what is already bound.
+//The command list type is a template parameter so that the filtering can be run against a mock that records the calls.
+template<typename TCommandList>
+class CommandRecorderT
+{
+public:
+	static constexpr uint32_t s_MaxNrOfRootParameters = 16u;
+	//A root signature can hold at most 64 DWORDs.
+	static constexpr uint32_t s_MaxNrOfRootConstants = 64u;
+public:
+	CommandRecorderT() noexcept = default;
+	~CommandRecorderT() noexcept = default;
+
+	//Starts recording to a command list. Nothing is assumed to be bound on it.
+	void Begin(TCommandList* pCommandList) noexcept;
+	//Forgets the tracked bindings, for example after the command list has been used without the recorder.
+	void Invalidate() noexcept;
+
+	void SetPipelineState(ID3D12PipelineState* pPipelineState) noexcept;
+	void SetGraphicsRootSignature(ID3D12RootSignature* pRootSignature) noexcept;
+	void SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) noexcept;
+	void SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) noexcept;
+	void SetGraphicsRoot32BitConstant(uint32_t rootParameterIndex, uint32_t srcData, uint32_t destOffsetIn32BitValues) noexcept;
+	void SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValuesToSet, const void* pSrcData, uint32_t destOffsetIn32BitValues) noexcept;
+	//Draws are never filtered, they are only passed through.
+	void DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation) noexcept;
+	//The command signature may change root parameters, so they are unknown afterwards.
+	void ExecuteIndirect(ID3D12CommandSignature* pCommandSignature, uint32_t maxCommandCount, ID3D12Resource* pArgumentBuffer, uint64_t argumentBufferOffset, ID3D12Resource* pCountBuffer, uint64_t countBufferOffset) noexcept;
+
+	[[nodiscard]] constexpr TCommandList* GetCommandList() const noexcept { return m_pCommandList; }
+	//Number of Set calls that reached the command list and that were dropped.
+	[[nodiscard]] constexpr uint32_t GetNrOfIssued() const noexcept { return m_NrOfIssued; }
+	[[nodiscard]] constexpr uint32_t GetNrOfElided() const noexcept { return m_NrOfElided; }
+	void ResetCounters() noexcept { m_NrOfIssued = 0u; m_NrOfElided = 0u; }
+private:
+	enum class RootBindingType : uint32_t
+	{
+		NONE = 0,
+		SRV,
+		CBV
+	};
+
+	struct RootDescriptorBinding
+	{
+		RootBindingType Type = RootBindingType::NONE;
+		D3D12_GPU_VIRTUAL_ADDRESS BufferLocation = 0u;
+	};
+
+	bool SetRootDescriptor(uint32_t rootParameterIndex, RootBindingType type, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) noexcept;
+	void InvalidateRootParameters() noexcept;
+private:
+	TCommandList* m_pCommandList = nullptr;
+	ID3D12PipelineState* m_pPipelineState = nullptr;
+	ID3D12RootSignature* m_pRootSignature = nullptr;
+	RootDescriptorBinding m_RootDescriptors[s_MaxNrOfRootParameters] = {};
+	uint32_t m_RootConstants[s_MaxNrOfRootParameters][s_MaxNrOfRootConstants] = {};
+	//One bit per root constant that holds a known value.
+	uint64_t m_RootConstantsValid[s_MaxNrOfRootParameters] = {};
+
+	uint32_t m_NrOfIssued = 0u;
+	uint32_t m_NrOfElided = 0u;
+};
+
+using CommandRecorder = CommandRecorderT<ID3D12GraphicsCommandList4>;
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::Begin(TCommandList* pCommandList) noexcept
+{
+	m_pCommandList = pCommandList;
+	Invalidate();
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::Invalidate() noexcept
+{
+	m_pPipelineState = nullptr;
+	m_pRootSignature = nullptr;
+	InvalidateRootParameters();
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::SetPipelineState(ID3D12PipelineState* pPipelineState) noexcept
+{
+	if (pPipelineState == m_pPipelineState)
+	{
+		m_NrOfElided++;
+		return;
+	}
+	m_pPipelineState = pPipelineState;
+	m_pCommandList->SetPipelineState(pPipelineState);
+	m_NrOfIssued++;
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::SetGraphicsRootSignature(ID3D12RootSignature* pRootSignature) noexcept
+{
+	if (pRootSignature == m_pRootSignature)
+	{
+		m_NrOfElided++;
+		return;
+	}
+	//Changing the root signature leaves every root parameter undefined.
+	m_pRootSignature = pRootSignature;
+	InvalidateRootParameters();
+	m_pCommandList->SetGraphicsRootSignature(pRootSignature);
+	m_NrOfIssued++;
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) noexcept
+{
+	if (SetRootDescriptor(rootParameterIndex, RootBindingType::SRV, bufferLocation))
+	{
+		m_pCommandList->SetGraphicsRootShaderResourceView(rootParameterIndex, bufferLocation);
+	}
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) noexcept
+{
+	if (SetRootDescriptor(rootParameterIndex, RootBindingType::CBV, bufferLocation))
+	{
+		m_pCommandList->SetGraphicsRootConstantBufferView(rootParameterIndex, bufferLocation);
+	}
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::SetGraphicsRoot32BitConstant(uint32_t rootParameterIndex, uint32_t srcData, uint32_t destOffsetIn32BitValues) noexcept
+{
+	DBG_ASSERT(rootParameterIndex < s_MaxNrOfRootParameters && destOffsetIn32BitValues < s_MaxNrOfRootConstants, "Error! Root constant is out of range of the recorder.");
+
+	const uint64_t bit = 1ull << destOffsetIn32BitValues;
+	uint32_t& constant = m_RootConstants[rootParameterIndex][destOffsetIn32BitValues];
+	if ((m_RootConstantsValid[rootParameterIndex] & bit) && constant == srcData)
+	{
+		m_NrOfElided++;
+		return;
+	}
+	constant = srcData;
+	m_RootConstantsValid[rootParameterIndex] |= bit;
+	m_pCommandList->SetGraphicsRoot32BitConstant(rootParameterIndex, srcData, destOffsetIn32BitValues);
+	m_NrOfIssued++;
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValuesToSet, const void* pSrcData, uint32_t destOffsetIn32BitValues) noexcept
+{
+	DBG_ASSERT(rootParameterIndex < s_MaxNrOfRootParameters && destOffsetIn32BitValues + num32BitValuesToSet <= s_MaxNrOfRootConstants, "Error! Root constants are out of range of the recorder.");
+
+	const uint64_t bits = (num32BitValuesToSet == 64u ? ~0ull : ((1ull << num32BitValuesToSet) - 1ull)) << destOffsetIn32BitValues;
+	uint32_t* pConstants = &m_RootConstants[rootParameterIndex][destOffsetIn32BitValues];
+	const size_t size = sizeof(uint32_t) * num32BitValuesToSet;
+	if ((m_RootConstantsValid[rootParameterIndex] & bits) == bits && std::memcmp(pConstants, pSrcData, size) == 0)
+	{
+		m_NrOfElided++;
+		return;
+	}
+	std::memcpy(pConstants, pSrcData, size);
+	m_RootConstantsValid[rootParameterIndex] |= bits;
+	m_pCommandList->SetGraphicsRoot32BitConstants(rootParameterIndex, num32BitValuesToSet, pSrcData, destOffsetIn32BitValues);
+	m_NrOfIssued++;
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation) noexcept
+{
+	m_pCommandList->DrawInstanced(vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::ExecuteIndirect(ID3D12CommandSignature* pCommandSignature, uint32_t maxCommandCount, ID3D12Resource* pArgumentBuffer, uint64_t argumentBufferOffset, ID3D12Resource* pCountBuffer, uint64_t countBufferOffset) noexcept
+{
+	m_pCommandList->ExecuteIndirect(pCommandSignature, maxCommandCount, pArgumentBuffer, argumentBufferOffset, pCountBuffer, countBufferOffset);
+	InvalidateRootParameters();
+}
+
+template<typename TCommandList>
+bool CommandRecorderT<TCommandList>::SetRootDescriptor(uint32_t rootParameterIndex, RootBindingType type, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) noexcept
+{
+	DBG_ASSERT(rootParameterIndex < s_MaxNrOfRootParameters, "Error! Root parameter is out of range of the recorder.");
+
+	RootDescriptorBinding& binding = m_RootDescriptors[rootParameterIndex];
+	if (binding.Type == type && binding.BufferLocation == bufferLocation)
+	{
+		m_NrOfElided++;
+		return false;
+	}
+	binding.Type = type;
+	binding.BufferLocation = bufferLocation;
+	m_NrOfIssued++;
+	return true;
+}
+
+template<typename TCommandList>
+void CommandRecorderT<TCommandList>::InvalidateRootParameters() noexcept
+{
+	for (uint32_t i{ 0u }; i < s_MaxNrOfRootParameters; ++i)
+	{
+		m_RootDescriptors[i] = {};
+		m_RootConstantsValid[i] = 0ull;
+	}
+}
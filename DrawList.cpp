@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "DrawList.h"
+#include "ThreadPool.h"
+
+uint64_t DrawList::MakeStateKey(uint32_t pipelineIndex, uint32_t meshIndex) noexcept
+{
+	DBG_ASSERT(pipelineIndex < (1u << s_PipelineBits), "Error! Pipeline index does not fit in the sort key.");
+	DBG_ASSERT(meshIndex < (1u << s_MeshBits), "Error! Mesh index does not fit in the sort key.");
+
+	return (static_cast<uint64_t>(pipelineIndex) << (s_MeshBits + s_DepthBits)) | (static_cast<uint64_t>(meshIndex) << s_DepthBits);
+}
+
+uint64_t DrawList::QuantizeDepth(float depth, float maxDepth) noexcept
+{
+	float normalizedDepth = std::clamp(depth / maxDepth, 0.0f, 1.0f);
+	return static_cast<uint64_t>(static_cast<double>(normalizedDepth) * static_cast<double>(UINT32_MAX));
+}
+
+void DrawList::Clear() noexcept
+{
+	m_Packets.clear();
+}
+
+void DrawList::Reserve(uint32_t nrOfPackets) noexcept
+{
+	m_Packets.reserve(nrOfPackets);
+	m_SortBuffer.reserve(nrOfPackets);
+}
+
+void DrawList::Sort() noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint32_t nrOfPackets = static_cast<uint32_t>(m_Packets.size());
+	m_SortBuffer.resize(nrOfPackets);
+
+	//Every chunk builds its own histogram and scatters its own packets, so the passes need no synchronization except between the two steps.
+	ThreadPool& threadPool = ThreadPool::Get();
+	const uint32_t nrOfChunks = std::max(1u, std::min(threadPool.GetNrOfThreads(), nrOfPackets / s_MinPacketsPerThread));
+	const uint32_t chunkSize = (nrOfPackets + nrOfChunks - 1u) / nrOfChunks;
+	m_Histograms.resize(nrOfChunks);
+
+	DrawPacket* pSource = m_Packets.data();
+	DrawPacket* pDestination = m_SortBuffer.data();
+	for (uint32_t shift{ 0u }; shift < 64u; shift += s_RadixBits)
+	{
+		threadPool.ParallelFor(nrOfChunks, 1u, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t chunk{ begin }; chunk < end; ++chunk)
+				{
+					std::array<uint32_t, s_NrOfBuckets>& histogram = m_Histograms[chunk];
+					histogram.fill(0u);
+					const uint32_t last = std::min(nrOfPackets, (chunk + 1u) * chunkSize);
+					for (uint32_t i{ chunk * chunkSize }; i < last; ++i)
+					{
+						histogram[(pSource[i].SortKey >> shift) & (s_NrOfBuckets - 1u)]++;
+					}
+				}
+			});
+
+		//Turn the histograms into the offset every chunk starts writing each bucket at.
+		//If all packets share the same digit the pass would not move anything and is skipped.
+		uint32_t offset = 0u;
+		bool skipPass = false;
+		for (uint32_t bucket{ 0u }; bucket < s_NrOfBuckets && !skipPass; ++bucket)
+		{
+			uint32_t bucketTotal = 0u;
+			for (uint32_t chunk{ 0u }; chunk < nrOfChunks; ++chunk)
+			{
+				uint32_t count = m_Histograms[chunk][bucket];
+				m_Histograms[chunk][bucket] = offset;
+				offset += count;
+				bucketTotal += count;
+			}
+			skipPass = bucketTotal == nrOfPackets;
+		}
+		if (skipPass)
+			continue;
+
+		threadPool.ParallelFor(nrOfChunks, 1u, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t chunk{ begin }; chunk < end; ++chunk)
+				{
+					std::array<uint32_t, s_NrOfBuckets>& offsets = m_Histograms[chunk];
+					const uint32_t last = std::min(nrOfPackets, (chunk + 1u) * chunkSize);
+					for (uint32_t i{ chunk * chunkSize }; i < last; ++i)
+					{
+						pDestination[offsets[(pSource[i].SortKey >> shift) & (s_NrOfBuckets - 1u)]++] = pSource[i];
+					}
+				}
+			});
+		std::swap(pSource, pDestination);
+	}
+
+	//An odd number of passes leaves the result in the sort buffer.
+	if (pSource != m_Packets.data())
+	{
+		m_Packets.swap(m_SortBuffer);
+	}
+
+	DBG_ASSERT(std::is_sorted(m_Packets.begin(), m_Packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.SortKey < b.SortKey; }), "Error! The draw packets are not sorted.");
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_SortTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+void DrawList::Merge(const std::vector<DrawPacket>& first, const std::vector<DrawPacket>& second) noexcept
+{
+	m_Packets.resize(first.size() + second.size());
+	std::merge(first.begin(), first.end(), second.begin(), second.end(), m_Packets.begin(), [](const DrawPacket& a, const DrawPacket& b) { return a.SortKey < b.SortKey; });
+}
+
+uint32_t DrawList::CountStateChanges() const noexcept
+{
+	uint32_t nrOfStateChanges = 0u;
+	for (size_t i{ 1u }; i < m_Packets.size(); ++i)
+	{
+		if ((m_Packets[i].SortKey & s_StateMask) != (m_Packets[i - 1u].SortKey & s_StateMask))
+		{
+			nrOfStateChanges++;
+		}
+	}
+	return nrOfStateChanges;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+//A single mesh of a single object to draw.
+struct DrawPacket
+{
+	uint64_t SortKey;
+	uint32_t ObjectIndex;
+	uint32_t MeshIndex;
+};
+
+//List of draw packets that is sorted on a 64-bit key before it is submitted.
+//The key holds, from the most significant bits: pipeline (8 bits), mesh (24 bits) and the quantized view depth (32 bits).
+//Sorting on it groups all draws that share state and orders each group front to back.
+class DrawList
+{
+public:
+	static constexpr uint32_t s_PipelineBits = 8u;
+	static constexpr uint32_t s_MeshBits = 24u;
+	static constexpr uint32_t s_DepthBits = 32u;
+	static constexpr uint64_t s_StateMask = ~((1ull << s_DepthBits) - 1ull);
+public:
+	DrawList() noexcept = default;
+	~DrawList() noexcept = default;
+
+	//The state part of the key, everything but the depth.
+	[[nodiscard]] static uint64_t MakeStateKey(uint32_t pipelineIndex, uint32_t meshIndex) noexcept;
+	//Depth is the view space depth of the object, clamped to [0, maxDepth].
+	[[nodiscard]] static uint64_t QuantizeDepth(float depth, float maxDepth) noexcept;
+	[[nodiscard]] static uint64_t MakeSortKey(uint32_t pipelineIndex, uint32_t meshIndex, float depth, float maxDepth) noexcept { return MakeStateKey(pipelineIndex, meshIndex) | QuantizeDepth(depth, maxDepth); }
+	[[nodiscard]] static constexpr uint32_t GetMeshIndex(uint64_t sortKey) noexcept { return static_cast<uint32_t>(sortKey >> s_DepthBits) & ((1u << s_MeshBits) - 1u); }
+
+	void Clear() noexcept;
+	void Reserve(uint32_t nrOfPackets) noexcept;
+	void Add(const DrawPacket& packet) noexcept { m_Packets.push_back(packet); }
+	//Sorts the packets on their key with a multithreaded LSD radix sort. The sort is stable.
+	void Sort() noexcept;
+	//Replaces the packets with the two lists merged on their key. Both have to be sorted, on equal keys the packets of the first go first.
+	void Merge(const std::vector<DrawPacket>& first, const std::vector<DrawPacket>& second) noexcept;
+
+	//Number of times pipeline or mesh changes between two consecutive packets in the current order.
+	[[nodiscard]] uint32_t CountStateChanges() const noexcept;
+
+	[[nodiscard]] const std::vector<DrawPacket>& GetPackets() const noexcept { return m_Packets; }
+	[[nodiscard]] uint32_t GetNrOfPackets() const noexcept { return static_cast<uint32_t>(m_Packets.size()); }
+	//Time the last sort took in milliseconds.
+	[[nodiscard]] constexpr double GetSortTime() const noexcept { return m_SortTime; }
+private:
+	static constexpr uint32_t s_RadixBits = 8u;
+	static constexpr uint32_t s_NrOfBuckets = 1u << s_RadixBits;
+	//Below this many packets the sort runs on the calling thread only.
+	static constexpr uint32_t s_MinPacketsPerThread = 4096u;
+
+	std::vector<DrawPacket> m_Packets = {};
+	std::vector<DrawPacket> m_SortBuffer = {};
+	//One histogram per chunk, reused between the passes.
+	std::vector<std::array<uint32_t, s_NrOfBuckets>> m_Histograms = {};
+	double m_SortTime = 0.0;
+};
@@ -0,0 +1,188 @@
+#include "pch.h"
+#include "DrawPacketCache.h"
+
+void DrawPacketCache::BeginFrame() noexcept
+{
+	m_FrameNumber++;
+	m_NrOfRebuilt = 0u;
+	m_NrOfReused = 0u;
+	m_NrOfDropped = 0u;
+	m_RetainedDrawList.BeginFrame();
+}
+
+uint32_t DrawPacketCache::Update(VertexObject& object) noexcept
+{
+	uint32_t entryIndex = object.GetDrawCacheIndex();
+	const ObjectVersions& versions = object.GetVersions();
+
+	//The object has no entry yet, its entry was dropped, or it belongs to a cache that has since been cleared.
+	if (entryIndex >= m_Entries.size() || m_Entries[entryIndex].pObject != &object)
+	{
+		if (m_FreeEntries.empty())
+		{
+			entryIndex = static_cast<uint32_t>(m_Entries.size());
+			m_Entries.emplace_back();
+			m_InstanceData.emplace_back();
+		}
+		else
+		{
+			entryIndex = m_FreeEntries.back();
+			m_FreeEntries.pop_back();
+		}
+		m_Entries[entryIndex] = { &object, versions, 0u, 0u, m_FrameNumber };
+		object.SetDrawCacheIndex(entryIndex);
+
+		BuildTransform(entryIndex, object);
+		m_InstanceData[entryIndex].Color = object.GetColor();
+		BuildStateKeys(entryIndex, object);
+		(void)m_RetainedDrawList.Submit(entryIndex, true);
+		m_NrOfRebuilt++;
+		return entryIndex;
+	}
+
+	Entry& entry = m_Entries[entryIndex];
+	entry.LastUsedFrame = m_FrameNumber;
+	bool rebuilt = false;
+	//The color only lives in the instance data, the packets stay valid.
+	bool packetsChanged = false;
+	if (entry.Versions.Transform != versions.Transform)
+	{
+		BuildTransform(entryIndex, object);
+		rebuilt = true;
+		packetsChanged = true;
+	}
+	if (entry.Versions.Color != versions.Color)
+	{
+		m_InstanceData[entryIndex].Color = object.GetColor();
+		rebuilt = true;
+	}
+	if (entry.Versions.Mesh != versions.Mesh)
+	{
+		BuildStateKeys(entryIndex, object);
+		rebuilt = true;
+		packetsChanged = true;
+	}
+	entry.Versions = versions;
+	(void)m_RetainedDrawList.Submit(entryIndex, packetsChanged);
+
+	if (rebuilt)
+		m_NrOfRebuilt++;
+	else
+		m_NrOfReused++;
+	return entryIndex;
+}
+
+void DrawPacketCache::AddPackets(uint32_t entryIndex, uint64_t depthKey) noexcept
+{
+	if (m_RetainedDrawList.IsRetained(entryIndex))
+		return;
+
+	const Entry& entry = m_Entries[entryIndex];
+	for (uint32_t i{ 0u }; i < entry.NrOfStateKeys; ++i)
+	{
+		const uint64_t stateKey = m_StateKeys[entry.FirstStateKey + i];
+		m_RetainedDrawList.Add({ stateKey | depthKey, entryIndex, DrawList::GetMeshIndex(stateKey) });
+	}
+}
+
+void DrawPacketCache::BuildDrawList(DrawList& drawList) noexcept
+{
+	DropUnusedEntries();
+	//Models that grow leave their old range behind, once that is more than what is in use the keys are packed again.
+	if (m_StateKeys.size() - m_NrOfUsedStateKeys > m_NrOfUsedStateKeys)
+	{
+		CompactStateKeys();
+	}
+	m_RetainedDrawList.Build(drawList);
+}
+
+void DrawPacketCache::SetLightRange(uint32_t entryIndex, const LightRange& lightRange) noexcept
+{
+	m_InstanceData[entryIndex].LightOffset = lightRange.Offset;
+	m_InstanceData[entryIndex].NrOfLights = lightRange.Count;
+}
+
+void DrawPacketCache::SetLightVisibility(uint32_t entryIndex, const LightRange& visibilityRange) noexcept
+{
+	m_InstanceData[entryIndex].VisibilityOffset = visibilityRange.Offset;
+	m_InstanceData[entryIndex].NrOfVisibilityLights = visibilityRange.Count;
+}
+
+void DrawPacketCache::Clear() noexcept
+{
+	m_Entries.clear();
+	m_InstanceData.clear();
+	m_FreeEntries.clear();
+	m_StateKeys.clear();
+	m_NrOfUsedStateKeys = 0u;
+	m_MeshIndices.clear();
+	m_Meshes.clear();
+	m_RetainedDrawList.Clear();
+}
+
+void DrawPacketCache::BuildTransform(uint32_t entryIndex, const VertexObject& object) noexcept
+{
+	DirectX::XMStoreFloat4x4(&m_InstanceData[entryIndex].WorldMatrix, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&object.GetTransform())));
+}
+
+void DrawPacketCache::BuildStateKeys(uint32_t entryIndex, const VertexObject& object) noexcept
+{
+	Entry& entry = m_Entries[entryIndex];
+	const std::vector<std::unique_ptr<Mesh>>& meshes = object.GetModel()->GetMeshes();
+	const uint32_t nrOfMeshes = static_cast<uint32_t>(meshes.size());
+
+	//Reuse the old range when the new model fits in it, otherwise the keys are moved to the end.
+	if (nrOfMeshes > entry.NrOfStateKeys)
+	{
+		entry.FirstStateKey = static_cast<uint32_t>(m_StateKeys.size());
+		m_StateKeys.resize(m_StateKeys.size() + nrOfMeshes);
+	}
+	m_NrOfUsedStateKeys = m_NrOfUsedStateKeys - entry.NrOfStateKeys + nrOfMeshes;
+	entry.NrOfStateKeys = nrOfMeshes;
+
+	for (uint32_t i{ 0u }; i < nrOfMeshes; ++i)
+	{
+		m_StateKeys[entry.FirstStateKey + i] = DrawList::MakeStateKey(s_OpaquePipelineIndex, GetMeshIndex(meshes[i].get()));
+	}
+}
+
+uint32_t DrawPacketCache::GetMeshIndex(const Mesh* pMesh) noexcept
+{
+	auto it = m_MeshIndices.find(pMesh);
+	if (it != m_MeshIndices.end())
+		return it->second;
+
+	uint32_t meshIndex = static_cast<uint32_t>(m_Meshes.size());
+	m_Meshes.push_back(pMesh);
+	m_MeshIndices.insert(std::pair(pMesh, meshIndex));
+	return meshIndex;
+}
+
+void DrawPacketCache::DropUnusedEntries() noexcept
+{
+	for (uint32_t i{ 0u }; i < m_Entries.size(); ++i)
+	{
+		Entry& entry = m_Entries[i];
+		if (!entry.pObject || m_FrameNumber - entry.LastUsedFrame <= s_MaxUnusedFrames)
+			continue;
+
+		m_NrOfUsedStateKeys -= entry.NrOfStateKeys;
+		entry = {};
+		m_RetainedDrawList.Remove(i);
+		m_FreeEntries.push_back(i);
+		m_NrOfDropped++;
+	}
+}
+
+void DrawPacketCache::CompactStateKeys() noexcept
+{
+	m_CompactedStateKeys.clear();
+	m_CompactedStateKeys.reserve(m_NrOfUsedStateKeys);
+	for (Entry& entry : m_Entries)
+	{
+		const uint32_t firstStateKey = static_cast<uint32_t>(m_CompactedStateKeys.size());
+		m_CompactedStateKeys.insert(m_CompactedStateKeys.end(), m_StateKeys.begin() + entry.FirstStateKey, m_StateKeys.begin() + entry.FirstStateKey + entry.NrOfStateKeys);
+		entry.FirstStateKey = firstStateKey;
+	}
+	m_StateKeys.swap(m_CompactedStateKeys);
+}
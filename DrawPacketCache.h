@@ -0,0 +1,85 @@
+#pragma once
+#include "InstanceBatcher.h"
+#include "LightManager.h"
+#include "RetainedDrawList.h"
+
+//Retained per object draw data, so that objects that have not changed since the last frame do not have to be gathered again.
+//Every entry remembers the versions of the object it was built from and only the parts whose version changed are rebuilt.
+//The depth part of the sort keys changes with the camera and is left to the caller.
+//The sorted packets of the objects that did not change are kept between frames as well, see RetainedDrawList.
+//Entries of objects that were not drawn for a while are dropped and their slots reused, so removed objects do not pile up.
+class DrawPacketCache
+{
+public:
+	//Only one pipeline is used for the scene objects so far.
+	static constexpr uint32_t s_OpaquePipelineIndex = 0u;
+	//Frames an entry is kept without its object being drawn. The object may have been removed, so it is never touched again.
+	static constexpr uint32_t s_MaxUnusedFrames = 300u;
+public:
+	DrawPacketCache() noexcept = default;
+	~DrawPacketCache() noexcept = default;
+
+	//Resets the per frame counters.
+	void BeginFrame() noexcept;
+	//Makes sure the entry of the object is up to date and returns its index.
+	uint32_t Update(VertexObject& object) noexcept;
+	//Adds the packets of the entry with the depth of this frame, unless they are retained from an earlier frame.
+	void AddPackets(uint32_t entryIndex, uint64_t depthKey) noexcept;
+	//Writes the sorted packets of every entry updated this frame to the draw list, and drops the entries that were not used for too long.
+	void BuildDrawList(DrawList& drawList) noexcept;
+	//The light lists are rebuilt every frame, so the range is set every frame rather than versioned.
+	void SetLightRange(uint32_t entryIndex, const LightRange& lightRange) noexcept;
+	//The row of the object in the baked light visibility, see LightVisibilityBaker::GetVisibilityRange.
+	void SetLightVisibility(uint32_t entryIndex, const LightRange& visibilityRange) noexcept;
+	//Drops every entry, for example when the scene is reloaded.
+	void Clear() noexcept;
+
+	//The state keys (pipeline and mesh) of every mesh of the entry, see DrawList::MakeStateKey.
+	[[nodiscard]] const uint64_t* GetStateKeys(uint32_t entryIndex) const noexcept { return m_StateKeys.data() + m_Entries[entryIndex].FirstStateKey; }
+	[[nodiscard]] uint32_t GetNrOfStateKeys(uint32_t entryIndex) const noexcept { return m_Entries[entryIndex].NrOfStateKeys; }
+	//Instance data of every entry, indexed by the entry index.
+	[[nodiscard]] const std::vector<InstanceData>& GetInstanceData() const noexcept { return m_InstanceData; }
+	//Meshes indexed by the mesh index stored in the state keys.
+	[[nodiscard]] const std::vector<const Mesh*>& GetMeshes() const noexcept { return m_Meshes; }
+
+	[[nodiscard]] uint32_t GetNrOfEntries() const noexcept { return static_cast<uint32_t>(m_Entries.size()); }
+	//Number of entries that had to be rebuilt and that were reused as they were during the last frame.
+	[[nodiscard]] constexpr uint32_t GetNrOfRebuilt() const noexcept { return m_NrOfRebuilt; }
+	[[nodiscard]] constexpr uint32_t GetNrOfReused() const noexcept { return m_NrOfReused; }
+	//Number of entries dropped because their object was not drawn for too long, during the last frame.
+	[[nodiscard]] constexpr uint32_t GetNrOfDropped() const noexcept { return m_NrOfDropped; }
+	[[nodiscard]] const RetainedDrawList& GetRetainedDrawList() const noexcept { return m_RetainedDrawList; }
+private:
+	struct Entry
+	{
+		//Only compared against, the object may no longer exist.
+		const VertexObject* pObject = nullptr;
+		ObjectVersions Versions = {};
+		uint32_t FirstStateKey = 0u;
+		uint32_t NrOfStateKeys = 0u;
+		uint32_t LastUsedFrame = 0u;
+	};
+
+	void BuildTransform(uint32_t entryIndex, const VertexObject& object) noexcept;
+	void BuildStateKeys(uint32_t entryIndex, const VertexObject& object) noexcept;
+	uint32_t GetMeshIndex(const Mesh* pMesh) noexcept;
+	void DropUnusedEntries() noexcept;
+	//Moves the state keys of the live entries to the front, leaving out the ranges that were given up.
+	void CompactStateKeys() noexcept;
+private:
+	std::vector<Entry> m_Entries = {};
+	std::vector<InstanceData> m_InstanceData = {};
+	std::vector<uint32_t> m_FreeEntries = {};
+	std::vector<uint64_t> m_StateKeys = {};
+	std::vector<uint64_t> m_CompactedStateKeys = {};
+	//State keys in the ranges of live entries, the rest of m_StateKeys is unused.
+	uint32_t m_NrOfUsedStateKeys = 0u;
+	std::unordered_map<const Mesh*, uint32_t> m_MeshIndices = {};
+	std::vector<const Mesh*> m_Meshes = {};
+	RetainedDrawList m_RetainedDrawList;
+	uint32_t m_FrameNumber = 0u;
+
+	uint32_t m_NrOfRebuilt = 0u;
+	uint32_t m_NrOfReused = 0u;
+	uint32_t m_NrOfDropped = 0u;
+};
@@ -3,25 +3,39 @@
 #include "DXCore.h"
 #include "Window.h"
 #include "ImGuiManager.h"
+#include "ThreadPool.h"
 #define USE_PIX
 #include "pix3.h"
 
-void Engine::Initialize(const std::wstring& applicationName) noexcept
+namespace
+{
+	//Prints the benchmark results to the console the engine was started from.
+	void PrintLine(const char* pFormat, ...) noexcept
+	{
+		va_list arguments;
+		va_start(arguments, pFormat);
+		vprintf(pFormat, arguments);
+		va_end(arguments);
+		printf("\n");
+	}
+}
+
+void Engine::Initialize(const std::wstring& applicationName, uint32_t sceneSeed) noexcept
 {
 	CreateConsole();
 	DXCore::Initialize();
 	Window::Get().Initialize(applicationName);
 	ImGuiManager::Initialize();
+	ThreadPool::Get().Initialize();
+	Profiler::Get().Initialize();
 
 	auto& memoryManager = MemoryManager::Get();
 	memoryManager.CreateShaderVisibleDescriptorHeap("ShaderBindables", 100'000, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
-	memoryManager.AddRangeForDescriptor("ShaderBindables", "TransformsRange", 100'000);
-	memoryManager.CreateNonShaderVisibleDescriptorHeap("Transforms", 100'000, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
 	m_pRenderer = std::make_unique<Renderer>();
 	m_pRenderer->Initialize();
 	m_pScene = std::make_unique<Scene>();
-	m_pScene->Initialize();
+	m_pScene->Initialize(sceneSeed);
 	DirectX::XMFLOAT3 cameraStartPosition = DirectX::XMFLOAT3(0.0f, 0.0f, -5.0f);
 	auto [width, height] = Window::Get().GetDimensions();
 	m_pCamera = std::make_unique<Camera>(cameraStartPosition, width, height);
@@ -39,26 +53,43 @@ void Engine::Run() noexcept
 	float currentFrameTime = 0.0f;
 	float secondTracker = 0.0f;
 	bool startProfiling = false;
+	double windowStartTime = 0.0;
+	uint32_t windowStartFrames = 0u;
 	m_pRenderer->WaitForGpu();
 	HR(DXCore::GetCommandList()->Close());
 	while (s_Window.IsRunning())
 	{
 		{
-			Profiler profiler("Render loop", [&](ProfilerData profilerData) {ProfilerManager::ProfilerDatas.emplace_back(profilerData); });
+			PROFILE_SCOPE("Render loop");
 
-			m_pScene->Update(m_pCamera->GetRayTraceBool(), deltaTime);
+			{
+				PROFILE_SCOPE("Scene update");
+				m_pScene->Update(m_pCamera->GetRayTraceBool(), deltaTime);
+			}
 			m_pRenderer->Begin(m_pCamera.get(), m_pScene->GetAccelerationStructureGPUAddress());
-			m_pRenderer->Submit(m_pScene->GetCulledVertexObjects());
+			{
+				PROFILE_SCOPE("Culling");
+				m_pScene->CullObjects(m_pCamera->GetVPMatrix());
+			}
+			{
+				PROFILE_SCOPE("Submit");
+				m_pRenderer->Submit(m_pScene->GetCulledVertexObjects(), m_pScene->GetLightManager(), m_pScene->GetLightVisibility());
+			}
+
+			if (m_MiscWindowEnabled)
+			{
+				ImGuiManager::Begin();
 
+				RenderMiscWindow(currentFramesPerSecond, currentFrameTime);
+
+				ImGuiManager::End();
+			}
 			{
-				//ImGuiManager::Begin();
-				//
-				//RenderMiscWindow(currentFramesPerSecond, currentFrameTime);
-				//
-				//ImGuiManager::End();
+				PROFILE_SCOPE("End");
+				m_pRenderer->End();
 			}
-			m_pRenderer->End();
 		}
+		Profiler::Get().EndFrame();
 
 		m_pCamera->Update(deltaTime);
 		s_Window.OnUpdate();
@@ -78,33 +109,90 @@ void Engine::Run() noexcept
 		}
 
 
+		//After a warm up the render loop is averaged over windows of frames, and over every window since the warm up.
 		frameCount++;
 		if (frameCount == 2'000 && startProfiling == false)
 		{
 			startProfiling = true;
 			frameCount = 0u;
+			Profiler::Get().ResetTotals();
 		}
 		else if (frameCount == 500 && startProfiling == true)
 		{
-			if (ProfilerManager::IsValid())
+			const ProfileNode* pRenderLoop = Profiler::Get().FindNode("Render loop");
+			if (pRenderLoop && pRenderLoop->NrOfFrames > windowStartFrames)
 			{
-				auto [currentAverage, averageSinceStart] = ProfilerManager::Report();
-				m_CurrentAverageRenderTime = currentAverage;
-				m_AverageRenderTimeSinceStart = averageSinceStart;
-				m_SummedDurationOverFrames = ProfilerManager::m_SummedDurationOverFrames;
+				m_SummedDurationOverFrames = pRenderLoop->TotalTime - windowStartTime;
+				m_CurrentAverageRenderTime = m_SummedDurationOverFrames / (pRenderLoop->NrOfFrames - windowStartFrames);
+				m_AverageRenderTimeSinceStart = pRenderLoop->TotalTime / pRenderLoop->NrOfFrames;
+				windowStartTime = pRenderLoop->TotalTime;
+				windowStartFrames = pRenderLoop->NrOfFrames;
 			}
 			frameCount = 0u;
 		}
 
 		framesPerSecond++;
 	}
+	OnShutDown();
+}
+
+bool Engine::RunBenchmarks(const std::string& name) noexcept
+{
+	//One frame is rendered first, so that the benchmarks see the culled objects, light lists and acceleration structures of the start view.
+	m_pRenderer->WaitForGpu();
+	HR(DXCore::GetCommandList()->Close());
+	m_pScene->Update(m_pCamera->GetRayTraceBool(), 0.0f);
+	m_pRenderer->Begin(m_pCamera.get(), m_pScene->GetAccelerationStructureGPUAddress());
+	m_pScene->CullObjects(m_pCamera->GetVPMatrix());
+	m_pRenderer->Submit(m_pScene->GetCulledVertexObjects(), m_pScene->GetLightManager(), m_pScene->GetLightVisibility());
+	m_pRenderer->End();
+	Profiler::Get().EndFrame();
+	m_pRenderer->WaitForGpu();
+
+	bool found = false;
+	bool passed = true;
+	for (uint32_t i{ 0u }; i < static_cast<uint32_t>(Benchmark::Count); ++i)
+	{
+		if (name != "all" && name != s_BenchmarkNames[i])
+			continue;
+
+		found = true;
+		PrintLine("Benchmark %s", s_BenchmarkNames[i]);
+		RunBenchmark(static_cast<Benchmark>(i));
+		if (!ReportBenchmark(static_cast<Benchmark>(i), &PrintLine))
+		{
+			PrintLine("  FAILED");
+			passed = false;
+		}
+	}
+	if (!found)
+	{
+		PrintLine("Unknown benchmark %s, expected all or one of:", name.c_str());
+		for (const char* pName : s_BenchmarkNames)
+		{
+			PrintLine("  %s", pName);
+		}
+	}
+	fflush(stdout);
+
+	OnShutDown();
+	return found && passed;
+}
+
+void Engine::OnShutDown() noexcept
+{
 	m_pRenderer->OnShutDown();
 	ImGuiManager::OnShutDown();
+	ThreadPool::Get().OnShutDown();
 }
 
 void Engine::CreateConsole() noexcept
 {
-	AllocConsole() && "Unable to allocate console";
+	//Benchmark results are printed to the console the engine was started from, if there is one.
+	if (!AttachConsole(ATTACH_PARENT_PROCESS))
+	{
+		AllocConsole() && "Unable to allocate console";
+	}
 	DBG_ASSERT(freopen("CONIN$", "r", stdin), "Could not freopen stdin.");
 	DBG_ASSERT(freopen("CONOUT$", "w", stdout), "Could not freopen stdout.");
 	DBG_ASSERT(freopen("CONOUT$", "w", stderr), "Could not freopen stderr.");
@@ -121,8 +209,417 @@ void Engine::RenderMiscWindow(uint64_t currentFramesPerSecond, float currentFram
 	ImGui::Text("Render pass time (Average): %.5f ms", m_CurrentAverageRenderTime);
 	ImGui::Text("Render pass time (Total summed average): %.5f ms", m_AverageRenderTimeSinceStart);
 	ImGui::Text("Summed duration over test: %.5f ms", m_SummedDurationOverFrames);
+	//The profiled scopes of the last frame, depth first.
+	const Profiler& profiler = Profiler::Get();
+	const std::vector<ProfileNode>& profileNodes = profiler.GetNodes();
+	ImGui::Text("Profiled scopes: %d events, %d dropped, aggregated in %.3f ms", profiler.GetNrOfEvents(), profiler.GetNrOfDropped(), profiler.GetAggregationTime());
+	uint32_t nodeIndex = profileNodes.empty() ? UINT32_MAX : profileNodes[Profiler::s_RootNode].FirstChild;
+	while (nodeIndex != UINT32_MAX)
+	{
+		const ProfileNode& node = profileNodes[nodeIndex];
+		const double averageTime = node.NrOfFrames == 0u ? 0.0 : node.TotalTime / node.NrOfFrames;
+		ImGui::Text("%*s%s: %.3f ms, %.3f ms average, %d calls", node.Depth * 2, "", node.pName, node.Time, averageTime, node.NrOfCalls);
+		if (node.FirstChild != UINT32_MAX)
+		{
+			nodeIndex = node.FirstChild;
+			continue;
+		}
+		while (nodeIndex != UINT32_MAX && profileNodes[nodeIndex].NextSibling == UINT32_MAX)
+		{
+			nodeIndex = profileNodes[nodeIndex].Parent;
+		}
+		nodeIndex = nodeIndex == UINT32_MAX ? UINT32_MAX : profileNodes[nodeIndex].NextSibling;
+	}
+	if (ImGui::Button("Benchmark profiler"))
+	{
+		RunBenchmark(Benchmark::Profiler);
+	}
+	ReportBenchmark(Benchmark::Profiler, &ImGui::Text);
+	const ShaderCache& shaderCache = m_pRenderer->GetShaderCache();
+	ImGui::Text("Shaders (cached / compiled): %d / %d, %.3f ms load, %.3f ms compile, %.3f ms wall", shaderCache.GetNrOfHits(), shaderCache.GetNrOfMisses(), shaderCache.GetLoadTime(), shaderCache.GetCompileTime(), shaderCache.GetBatchTime());
+	if (shaderCache.GetNrOfFailed() > 0u || shaderCache.GetNrOfWriteFailures() > 0u)
+	{
+		ImGui::Text("  %d shaders did not compile (see ShaderCache/*.errors.txt), %d could not be written to the cache", shaderCache.GetNrOfFailed(), shaderCache.GetNrOfWriteFailures());
+	}
+	if (ImGui::Button("Benchmark shader permutations"))
+	{
+		RunBenchmark(Benchmark::ShaderPermutations);
+	}
+	ReportBenchmark(Benchmark::ShaderPermutations, &ImGui::Text);
+	ImGui::Text("Culled Objects: %d / %d", m_pScene->GetNrOfCulledObjects(), m_pScene->GetTotalNrOfObjects());
+	static bool occlusionCulling = true;
+	if (ImGui::Checkbox("Occlusion Culling", &occlusionCulling))
+		m_pScene->SetOcclusionCulling(occlusionCulling);
+	const OcclusionCullerStats& occlusionStats = m_pScene->GetOcclusionStats();
+	ImGui::Text("Occluded Objects: %d / %d", occlusionStats.NrOfOccluded, occlusionStats.NrOfTested);
+	ImGui::Text("Occluders: %d (%d triangles)", occlusionStats.NrOfOccluders, occlusionStats.NrOfOccluderTriangles);
+	ImGui::Text("Occlusion setup/raster/HiZ/test: %.3f / %.3f / %.3f / %.3f ms", occlusionStats.SetupTime, occlusionStats.RasterTime, occlusionStats.HiZTime, occlusionStats.TestTime);
+	if (ImGui::Button("Benchmark occlusion culling"))
+	{
+		RunBenchmark(Benchmark::Occlusion);
+	}
+	ReportBenchmark(Benchmark::Occlusion, &ImGui::Text);
+	const InstanceBatcher& instanceBatcher = m_pRenderer->GetInstanceBatcher();
+	ImGui::Text("Draws (instanced / per object): %d / %d", instanceBatcher.GetNrOfDrawsAfter(), instanceBatcher.GetNrOfDrawsBefore());
+	ImGui::Text("Instance gather time: %.3f ms", instanceBatcher.GetBuildTime());
+	ImGui::Text("Draw packet sort time: %.3f ms (%d packets)", m_pRenderer->GetDrawList().GetSortTime(), m_pRenderer->GetDrawList().GetNrOfPackets());
+	ImGui::Text("State changes (sorted / unsorted): %d / %d", m_pRenderer->GetNrOfStateChangesSorted(), m_pRenderer->GetNrOfStateChangesUnsorted());
+	const DrawPacketCache& drawPacketCache = m_pRenderer->GetDrawPacketCache();
+	ImGui::Text("Cached draw objects (rebuilt / reused): %d / %d", drawPacketCache.GetNrOfRebuilt(), drawPacketCache.GetNrOfReused());
+	const RetainedDrawList& retainedDrawList = drawPacketCache.GetRetainedDrawList();
+	ImGui::Text("Draw packets (retained / sorted): %d / %d, %.3f ms", retainedDrawList.GetNrOfReusedPackets(), retainedDrawList.GetNrOfSortedPackets(), retainedDrawList.GetBuildTime());
+	ImGui::Text("Submit CPU time: %.3f ms", m_pRenderer->GetSubmitTime());
+	const SubmitOverflow& submitOverflow = m_pRenderer->GetSubmitOverflow();
+	if (submitOverflow.NrOfLights + submitOverflow.NrOfLightIndices + submitOverflow.NrOfVisibilityMasks + submitOverflow.NrOfClusterLightIndices + submitOverflow.NrOfInstances + submitOverflow.NrOfDraws > 0u)
+	{
+		ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.0f, 1.0f), "Warning! Dropped to fit the upload buffers: %d lights, %d light indices, %d visibility masks, %d cluster light indices, %d instances, %d draws",
+			submitOverflow.NrOfLights, submitOverflow.NrOfLightIndices, submitOverflow.NrOfVisibilityMasks, submitOverflow.NrOfClusterLightIndices, submitOverflow.NrOfInstances, submitOverflow.NrOfDraws);
+	}
+	ImGui::Text("Binding calls (issued / elided): %d / %d", m_pRenderer->GetNrOfBindingCallsIssued(), m_pRenderer->GetNrOfBindingCallsElided());
+	static bool indirectDraws = true;
+	if (ImGui::Checkbox("ExecuteIndirect", &indirectDraws))
+		m_pRenderer->SetIndirectDraws(indirectDraws);
+	ImGui::Text("Indirect argument packing: %.3f ms", m_pRenderer->GetIndirectDrawBuilder().GetBuildTime());
+	const CommandListPool& commandListPool = m_pRenderer->GetCommandListPool();
+	ImGui::Text("Draw recording: %.3f ms (%d chunks, %d pooled lists, %d failed resets or closes)", commandListPool.GetRecordTime(), m_pRenderer->GetNrOfChunks(), commandListPool.GetNrOfCommandLists(), commandListPool.GetBackend().GetNrOfFailed());
+	const RayTracingManager& rayTracingManager = m_pScene->GetRayTracingManager();
+	ImGui::Text("TLAS instances packed: %d / %d (%.3f ms)", rayTracingManager.GetNrOfPackedInstances(), rayTracingManager.GetNrOfInstances(), rayTracingManager.GetInstancePackTime());
+	const BLASCompactor& blasCompactor = rayTracingManager.GetBLASCompactor();
+	const BLASMemoryReportEntry blasTotals = blasCompactor.GetMemoryTotals();
+	ImGui::Text("BLAS memory (before / after compaction): %.1f / %.1f KB", (blasTotals.ResultBytesBefore + blasTotals.ScratchBytesBefore) / 1024.0, (blasTotals.ResultBytesAfter + blasTotals.ScratchBytesAfter) / 1024.0);
+	const BLASBuildPlanner& blasBuildPlanner = rayTracingManager.GetBLASBuildPlanner();
+	ImGui::Text("BLAS scratch pool: %.1f KB in %d batches (%.1f KB unpooled)", blasBuildPlanner.GetScratchBufferSize() / 1024.0, blasBuildPlanner.GetNrOfBatches(), blasBuildPlanner.GetUnpooledScratchSize() / 1024.0);
+	if (ImGui::TreeNode("BLAS memory per model"))
+	{
+		for (const BLASMemoryReportEntry& entry : blasCompactor.GetMemoryReport())
+		{
+			ImGui::Text("%s (%d): %.1f / %.1f KB", entry.ModelName.c_str(), entry.NrOfStructures, (entry.ResultBytesBefore + entry.ScratchBytesBefore) / 1024.0, (entry.ResultBytesAfter + entry.ScratchBytesAfter) / 1024.0);
+		}
+		ImGui::TreePop();
+	}
+	const TLASUpdatePolicy& tlasUpdatePolicy = m_pScene->GetTLASUpdatePolicy();
+	ImGui::Text("TLAS builds / refits: %d / %d", tlasUpdatePolicy.GetNrOfBuilds(), tlasUpdatePolicy.GetNrOfUpdates());
+	if (!tlasUpdatePolicy.GetDecisionLog().empty())
+	{
+		const TLASBuildDecision& decision = tlasUpdatePolicy.GetLastDecision();
+		ImGui::Text("TLAS last frame: %s (%s, %d refits since build)", decision.Type == TLASBuildType::UPDATE ? "Update" : "Build", TLASUpdatePolicy::GetReasonName(decision.Reason), decision.NrOfUpdatesSinceBuild);
+	}
+	if (ImGui::Button("Render CPU reference"))
+	{
+		RunBenchmark(Benchmark::CPUReference);
+	}
+	ReportBenchmark(Benchmark::CPUReference, &ImGui::Text);
+	if (ImGui::Button("Benchmark CPU ray queries"))
+	{
+		RunBenchmark(Benchmark::RayQueries);
+	}
+	ReportBenchmark(Benchmark::RayQueries, &ImGui::Text);
+	//Picks whatever is under the center of the screen.
+	SceneRayHit pickHit = {};
+	if (m_pScene->RayCast(GetCameraRay(0.0f, 0.0f), pickHit))
+	{
+		ImGui::Text("Picked: %s (object %d, mesh %d, triangle %d) at %.2f", pickHit.pObject->GetModel()->GetName().c_str(), pickHit.ObjectIndex, pickHit.MeshIndex, pickHit.TriangleIndex, pickHit.Distance);
+	}
+	else
+	{
+		ImGui::Text("Picked: nothing");
+	}
+	if (ImGui::Button("Ray cast 100k"))
+	{
+		RunBenchmark(Benchmark::RayCasts);
+	}
+	ReportBenchmark(Benchmark::RayCasts, &ImGui::Text);
+	int bvhBins = static_cast<int>(m_BVHBuildSettings.NrOfBins);
+	int bvhLeafSize = static_cast<int>(m_BVHBuildSettings.MaxLeafSize);
+	if (ImGui::SliderInt("BVH SAH bins", &bvhBins, 2, static_cast<int>(BVHBuilder::s_MaxNrOfBins)))
+		m_BVHBuildSettings.NrOfBins = static_cast<uint32_t>(bvhBins);
+	if (ImGui::SliderInt("BVH leaf size", &bvhLeafSize, 1, 16))
+		m_BVHBuildSettings.MaxLeafSize = static_cast<uint32_t>(bvhLeafSize);
+	if (ImGui::Button("Benchmark BVH builds"))
+	{
+		RunBenchmark(Benchmark::BVHBuilds);
+	}
+	ReportBenchmark(Benchmark::BVHBuilds, &ImGui::Text);
+	if (ImGui::Button("Benchmark AO bake"))
+	{
+		RunBenchmark(Benchmark::AOBake);
+	}
+	ReportBenchmark(Benchmark::AOBake, &ImGui::Text);
+	//Lights below the cutoff are left out of an object's light list, and the pixel shader skips them.
+	LightManager& lightManager = m_pScene->GetLightManager();
+	float lightCutoff = lightManager.GetIntensityCutoff();
+	if (ImGui::SliderFloat("Light intensity cutoff", &lightCutoff, 0.001f, 1.0f, "%.3f", ImGuiSliderFlags_Logarithmic))
+	{
+		lightManager.SetIntensityCutoff(lightCutoff);
+	}
+	ImGui::Text("Light lists: %.2f of %d lights per object, %.3f ms", lightManager.GetAverageNrOfLights(), lightManager.GetNrOfLights(), lightManager.GetUpdateTime());
+	if (ImGui::Button("Benchmark light lists"))
+	{
+		RunBenchmark(Benchmark::LightLists);
+	}
+	ReportBenchmark(Benchmark::LightLists, &ImGui::Text);
+	//With clustered lighting the pixel shader loops over the lights of its froxel instead of the lights of its object.
+	bool clusteredLighting = m_pRenderer->IsClusteredLightingEnabled();
+	if (ImGui::Checkbox("Clustered lighting", &clusteredLighting))
+	{
+		m_pRenderer->SetClusteredLighting(clusteredLighting);
+	}
+	if (clusteredLighting)
+	{
+		const LightClusterBuilder& lightClusterBuilder = m_pRenderer->GetLightClusterBuilder();
+		ImGui::Text("Light clusters: %d of %d occupied, %.2f lights per cluster, %.3f ms", lightClusterBuilder.GetNrOfOccupiedClusters(), LightClusterBuilder::s_NrOfClusters, lightClusterBuilder.GetAverageNrOfLights(), lightClusterBuilder.GetBuildTime());
+	}
+	if (ImGui::Button("Benchmark light clusters"))
+	{
+		RunBenchmark(Benchmark::LightClusters);
+	}
+	ReportBenchmark(Benchmark::LightClusters, &ImGui::Text);
+	//Shadow rays between static objects and lights are only traced where the baked visibility is partial.
+	const LightVisibilityBaker& lightVisibility = m_pScene->GetLightVisibility();
+	bool bakedLightVisibility = m_pRenderer->IsBakedLightVisibilityEnabled();
+	if (ImGui::Checkbox("Baked light visibility", &bakedLightVisibility))
+	{
+		m_pRenderer->SetBakedLightVisibility(bakedLightVisibility);
+	}
+	ImGui::Text("Light visibility: %d visible, %d occluded, %d partial, baked in %.3f ms", lightVisibility.GetNrOfBakedVisible(), lightVisibility.GetNrOfBakedOccluded(), lightVisibility.GetNrOfBakedPartial(), lightVisibility.GetBakeTime());
+	ImGui::Text("  %.1f%% of static shadow rays skipped, %d pairs crossed by moving objects, %.3f ms", lightVisibility.GetEliminatedFraction() * 100.0, lightVisibility.GetNrOfDemoted(), lightVisibility.GetUpdateTime());
+	if (ImGui::Button("Benchmark light visibility"))
+	{
+		RunBenchmark(Benchmark::LightVisibility);
+	}
+	ReportBenchmark(Benchmark::LightVisibility, &ImGui::Text);
 	ImGui::Text("Mesh Count: %d", m_pScene->GetTotalNrOfMeshes());
 	ImGui::Text("Vertex Count: %d", m_pScene->GetTotalNrOfVertices());
 	ImGui::Text("Index Count: %d", m_pScene->GetTotalNrOfIndices());
 	ImGui::End();
 }
+
+void Engine::RunBenchmark(Benchmark benchmark) noexcept
+{
+	auto [width, height] = Window::Get().GetDimensions();
+	switch (benchmark)
+	{
+	//Single rays against packets of eight on one thread, for the Shark model and for the current view of the room scene.
+	case Benchmark::RayQueries:
+		m_RayQueryBenchmark.Run(*m_pScene, m_pCamera->GetVPMatrix(), width / 2u, height / 2u);
+		break;
+	//A batch of closest hit queries the size of a frame's worth of gameplay traces, spread over the thread pool.
+	case Benchmark::RayCasts:
+	{
+		constexpr uint32_t rayCastWidth = 400u;
+		constexpr uint32_t rayCastHeight = 250u;
+		m_RayCastRays.resize(rayCastWidth * rayCastHeight);
+		m_RayCastHits.resize(rayCastWidth * rayCastHeight);
+		for (uint32_t y{ 0u }; y < rayCastHeight; ++y)
+		{
+			for (uint32_t x{ 0u }; x < rayCastWidth; ++x)
+			{
+				m_RayCastRays[y * rayCastWidth + x] = GetCameraRay((static_cast<float>(x) + 0.5f) / rayCastWidth * 2.0f - 1.0f, 1.0f - (static_cast<float>(y) + 0.5f) / rayCastHeight * 2.0f);
+			}
+		}
+		m_NrOfRayCastHits = m_pScene->RayCast(m_RayCastRays.data(), rayCastWidth * rayCastHeight, m_RayCastHits.data());
+		break;
+	}
+	//Build time of the scene's triangles against triangle and thread count, with the quality knobs of the builder.
+	case Benchmark::BVHBuilds:
+		m_BVHBuildBenchmark.Run(*m_pScene, m_BVHBuildSettings);
+		break;
+	//Bake time and error of the Shark model's ambient occlusion against the number of samples.
+	case Benchmark::AOBake:
+		m_AOBakeBenchmark.Run(*m_pScene);
+		break;
+	case Benchmark::LightLists:
+		m_LightListBenchmark.Run(m_pScene->GetLightManager().GetIntensityCutoff());
+		break;
+	case Benchmark::LightClusters:
+		m_LightClusterBenchmark.Run(m_pScene->GetLightManager().GetIntensityCutoff());
+		break;
+	case Benchmark::LightVisibility:
+		m_LightVisibilityBenchmark.Run();
+		break;
+	case Benchmark::ShaderPermutations:
+		m_ShaderPermutationBenchmark.Run({ &m_pRenderer->GetVertexShaders(), &m_pRenderer->GetPixelShaders() });
+		break;
+	case Benchmark::Profiler:
+		m_ProfilerBenchmark.Run();
+		break;
+	//Culls the current view of the room scene with occlusion culling a few times and keeps the fastest run.
+	case Benchmark::Occlusion:
+	{
+		constexpr uint32_t nrOfRuns = 10u;
+		const bool occlusionCullingEnabled = m_pScene->IsOcclusionCullingEnabled();
+		m_pScene->SetOcclusionCulling(true);
+		double bestTime = DBL_MAX;
+		for (uint32_t run{ 0u }; run < nrOfRuns; ++run)
+		{
+			m_pScene->CullObjects(m_pCamera->GetVPMatrix());
+			const OcclusionCullerStats& stats = m_pScene->GetOcclusionStats();
+			const double time = stats.SetupTime + stats.RasterTime + stats.HiZTime + stats.TestTime;
+			if (time < bestTime)
+			{
+				bestTime = time;
+				m_OcclusionStats = stats;
+			}
+		}
+		//The culled objects are left as the renderer's setting would have them.
+		m_pScene->SetOcclusionCulling(occlusionCullingEnabled);
+		m_pScene->CullObjects(m_pCamera->GetVPMatrix());
+		break;
+	}
+	//Renders the current view on the CPU at half the window resolution, to compare against the GPU.
+	//The shadows and the light lists follow the renderer's, so the image matches the frame it drew.
+	case Benchmark::CPUReference:
+	{
+		CPURayTracerSettings settings = {};
+		settings.Shadows = m_pRenderer->GetShadowMode();
+		settings.pLightClusters = m_pRenderer->IsClusteredLightingEnabled() ? &m_pRenderer->GetLightClusterBuilder() : nullptr;
+		m_CPURayTracer.Render(*m_pScene, m_pCamera->GetVPMatrix(), m_pCamera->GetPosition(), width / 2u, height / 2u, settings);
+		m_CPUReferenceWritten = m_CPURayTracer.WritePPM("CPUReference.ppm");
+
+		//Compared against the golden image of the same settings. It is only written when asked for, so a missing one fails.
+		const std::string goldenPath = GetCPUReferenceGoldenPath();
+		m_CPUReferenceGoldenWritten = false;
+		if (m_WriteCPUReferenceGolden)
+			m_CPUReferenceGoldenWritten = m_CPURayTracer.WritePPM(goldenPath);
+		else if (!m_CPURayTracer.CompareToPPM(goldenPath, s_CPUReferenceTolerance, m_CPUReferenceMismatches))
+			m_CPUReferenceMismatches = UINT32_MAX;
+		break;
+	}
+	default:
+		DBG_ASSERT(false, "Unknown benchmark.");
+		break;
+	}
+}
+
+bool Engine::ReportBenchmark(Benchmark benchmark, PrintFunction print) const noexcept
+{
+	bool passed = true;
+	switch (benchmark)
+	{
+	case Benchmark::RayQueries:
+		for (const RayQueryBenchmarkResult& result : m_RayQueryBenchmark.GetResults())
+		{
+			print("%s (%d triangles, %d rays, %d mismatches)", result.Name.c_str(), result.NrOfTriangles, result.NrOfRays, result.NrOfMismatches);
+			print("  Closest binary / single / packet: %.2f / %.2f / %.2f Mrays/s", result.BinaryRaysPerSecond * 0.000001, result.SingleRaysPerSecond * 0.000001, result.PacketRaysPerSecond * 0.000001);
+			print("  Any hit single / packet: %.2f / %.2f Mrays/s", result.SingleAnyHitRaysPerSecond * 0.000001, result.PacketAnyHitRaysPerSecond * 0.000001);
+			passed &= result.NrOfMismatches == 0u;
+		}
+		if (!m_RayQueryBenchmark.GetResults().empty())
+		{
+			print("Scene ray casts against the flattened room: %d mismatches", m_RayQueryBenchmark.GetNrOfSceneMismatches());
+			passed &= m_RayQueryBenchmark.GetNrOfSceneMismatches() == 0u;
+		}
+		break;
+	case Benchmark::RayCasts:
+	{
+		const SceneRayCaster& rayCaster = m_pScene->GetRayCaster();
+		print("Scene ray casts: %d rays, %d hits in %.3f ms (%d transforms updated)", rayCaster.GetLastBatchSize(), m_NrOfRayCastHits, rayCaster.GetLastBatchTime(), rayCaster.GetNrOfUpdatedTransforms());
+		break;
+	}
+	case Benchmark::BVHBuilds:
+		for (const BVHBuildBenchmarkResult& result : m_BVHBuildBenchmark.GetResults())
+		{
+			print("  %d triangles, %d threads: %.3f ms (%d nodes)%s", result.NrOfTriangles, result.NrOfThreads, result.BuildTime, result.NrOfNodes, result.MatchesSingleThreaded ? "" : " MISMATCH");
+			passed &= result.MatchesSingleThreaded;
+		}
+		break;
+	case Benchmark::AOBake:
+		if (!m_AOBakeBenchmark.GetResults().empty())
+		{
+			print("AO bake, %d vertices, reference %d samples: %.3f ms", m_AOBakeBenchmark.GetNrOfVertices(), AOBakeBenchmark::s_NrOfReferenceSamples, m_AOBakeBenchmark.GetReferenceBakeTime());
+		}
+		for (const AOBakeBenchmarkResult& result : m_AOBakeBenchmark.GetResults())
+		{
+			print("  %d samples: %.3f ms, %.2f Mrays/s, error RMS %.2f max %d%s", result.NrOfSamples, result.BakeTime, result.RaysPerSecond * 0.000001, result.RMSError, result.MaxError, result.IsDeterministic ? "" : " NOT DETERMINISTIC");
+			passed &= result.IsDeterministic;
+		}
+		break;
+	case Benchmark::LightLists:
+		for (const LightListBenchmarkResult& result : m_LightListBenchmark.GetResults())
+		{
+			print("  %d lights, %d objects: %.3f ms, %.2f lights per object%s", result.NrOfLights, result.NrOfObjects, result.UpdateTime, result.AverageNrOfLights, result.NrOfMismatches == 0u ? "" : " MISMATCH");
+			passed &= result.NrOfMismatches == 0u;
+		}
+		break;
+	case Benchmark::LightClusters:
+		for (const LightClusterBenchmarkResult& result : m_LightClusterBenchmark.GetResults())
+		{
+			print("  %d lights: %.3f ms, brute force %.3f ms, %d clusters with %.2f lights%s", result.NrOfLights, result.BuildTime, result.BruteForceTime, result.NrOfOccupiedClusters, result.AverageNrOfLights, result.NrOfMismatches == 0u ? "" : " MISMATCH");
+			passed &= result.NrOfMismatches == 0u;
+		}
+		break;
+	case Benchmark::LightVisibility:
+		for (const LightVisibilityBenchmarkResult& result : m_LightVisibilityBenchmark.GetResults())
+		{
+			print("  %d samples: %.3f ms, %llu rays, %d/%d/%d, %.1f%% skipped, %.1f%% with moving objects%s", result.NrOfSamples, result.BakeTime, result.NrOfRays, result.NrOfVisible, result.NrOfOccluded, result.NrOfPartial, result.EliminatedFraction * 100.0, result.EliminatedFractionDynamic * 100.0, result.NrOfWrongPairs == 0u ? "" : " WRONG");
+			passed &= result.NrOfWrongPairs == 0u;
+		}
+		break;
+	case Benchmark::ShaderPermutations:
+		for (const ShaderPermutationBenchmarkResult& result : m_ShaderPermutationBenchmark.GetResults())
+		{
+			const double speedup = result.ParallelTime > 0.0 ? result.SerialTime / result.ParallelTime : 0.0;
+			print("  %s: %d variants, %.3f ms serial, %.3f ms on %d threads (%.2fx), %.3f ms cached, %llu bytes%s", result.Name.c_str(), result.NrOfVariants, result.SerialTime, result.ParallelTime, result.NrOfThreads, speedup, result.CachedTime, result.NrOfBytes, result.NrOfFailed == 0u && result.NrOfMismatches == 0u ? "" : " FAILED");
+			passed &= result.NrOfFailed == 0u && result.NrOfMismatches == 0u;
+		}
+		break;
+	case Benchmark::Profiler:
+		for (const ProfilerBenchmarkResult& result : m_ProfilerBenchmark.GetResults())
+		{
+			print("  %s on %d threads: %.1f ns per scope, %d dropped%s", result.Name.c_str(), result.NrOfThreads, result.ScopeCost, result.NrOfDropped, result.ScopeCost <= ProfilerBenchmark::s_MaxScopeCost ? "" : " OVER BUDGET");
+			passed &= result.ScopeCost <= ProfilerBenchmark::s_MaxScopeCost;
+		}
+		break;
+	case Benchmark::Occlusion:
+		if (m_OcclusionStats.NrOfTested > 0u || m_OcclusionStats.NrOfOccluders > 0u)
+		{
+			print("Occlusion culling, %d occluders (%d triangles): %d of %d tested objects occluded", m_OcclusionStats.NrOfOccluders, m_OcclusionStats.NrOfOccluderTriangles, m_OcclusionStats.NrOfOccluded, m_OcclusionStats.NrOfTested);
+			print("  Setup / raster / Hi-Z / test: %.3f / %.3f / %.3f / %.3f ms", m_OcclusionStats.SetupTime, m_OcclusionStats.RasterTime, m_OcclusionStats.HiZTime, m_OcclusionStats.TestTime);
+		}
+		break;
+	case Benchmark::CPUReference:
+	{
+		const CPURayTracerStats& cpuRayTracerStats = m_CPURayTracer.GetStats();
+		print("CPU reference: %.3f ms, %.2f Mrays/s (%llu primary, %llu shadow, %llu baked)%s", cpuRayTracerStats.RenderTime, cpuRayTracerStats.RaysPerSecond * 0.000001, cpuRayTracerStats.NrOfPrimaryRays, cpuRayTracerStats.NrOfShadowRays, cpuRayTracerStats.NrOfBakedShadows, m_CPUReferenceWritten ? "" : ", could not write CPUReference.ppm");
+		passed &= m_CPUReferenceWritten;
+
+		const std::string goldenPath = GetCPUReferenceGoldenPath();
+		const uint32_t maxMismatches = static_cast<uint32_t>(cpuRayTracerStats.Width * cpuRayTracerStats.Height * s_CPUReferenceMaxMismatchRatio);
+		if (m_WriteCPUReferenceGolden)
+		{
+			print(m_CPUReferenceGoldenWritten ? "  Wrote the golden image %s" : "  Could not write the golden image %s", goldenPath.c_str());
+			passed &= m_CPUReferenceGoldenWritten;
+		}
+		else if (m_CPUReferenceMismatches == UINT32_MAX)
+		{
+			print("  Could not compare to the golden image %s, -writegolden writes it", goldenPath.c_str());
+			passed = false;
+		}
+		else
+		{
+			print("  %d pixels differ from %s, at most %d allowed", m_CPUReferenceMismatches, goldenPath.c_str(), maxMismatches);
+			passed &= m_CPUReferenceMismatches <= maxMismatches;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	return passed;
+}
+
+std::string Engine::GetCPUReferenceGoldenPath() const noexcept
+{
+	return "CPUReferenceGolden_" + std::to_string(static_cast<uint32_t>(m_pRenderer->GetShadowMode())) + (m_pRenderer->IsClusteredLightingEnabled() ? "_Clustered" : "") + ".ppm";
+}
+
+SceneRay Engine::GetCameraRay(float ndcX, float ndcY) noexcept
+{
+	const DirectX::XMMATRIX inverseViewProjection = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&m_pCamera->GetVPMatrix()));
+	DirectX::XMVECTOR nearPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), inverseViewProjection);
+	DirectX::XMVECTOR farPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), inverseViewProjection);
+	SceneRay ray = {};
+	DirectX::XMStoreFloat3(&ray.Origin, nearPoint);
+	DirectX::XMStoreFloat3(&ray.Direction, DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(farPoint, nearPoint)));
+	return ray;
+}
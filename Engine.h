@@ -2,25 +2,101 @@
 #include "Renderer.h"
 
 #include "Camera.h"
-#include "Profiler.h"
+#include "CPURayTracer.h"
+#include "RayQueryBenchmark.h"
+#include "BVHBuildBenchmark.h"
+#include "AOBakeBenchmark.h"
+#include "LightListBenchmark.h"
+#include "LightClusterBenchmark.h"
+#include "LightVisibilityBenchmark.h"
+#include "ShaderPermutationBenchmark.h"
+#include "ProfilerBenchmark.h"
+
+//The benchmarks of the engine. They are run with their buttons in the miscellaneous window, or without it with -benchmark and their name.
+enum class Benchmark : uint32_t
+{
+	RayQueries = 0u,
+	RayCasts,
+	BVHBuilds,
+	AOBake,
+	LightLists,
+	LightClusters,
+	LightVisibility,
+	ShaderPermutations,
+	Profiler,
+	Occlusion,
+	CPUReference,
+	Count
+};
+
+//Writes one formatted line, ImGui::Text for the window or to the console.
+using PrintFunction = void(*)(const char* pFormat, ...);
+
 class Engine
 {
+public:
+	static constexpr const char* s_BenchmarkNames[static_cast<uint32_t>(Benchmark::Count)] =
+	{
+		"rayqueries", "raycasts", "bvhbuilds", "aobake", "lightlists", "lightclusters", "lightvisibility", "shaderpermutations", "profiler", "occlusion", "cpureference"
+	};
+	//Benchmarks run on a scene with this seed, so that their results can be compared between runs.
+	static constexpr uint32_t s_BenchmarkSceneSeed = 1u;
+	//A channel of the CPU reference may differ this much from its golden image, and this share of the pixels may differ more.
+	static constexpr uint32_t s_CPUReferenceTolerance = 2u;
+	static constexpr double s_CPUReferenceMaxMismatchRatio = 0.001;
 public:
 	Engine() noexcept = default;
 	~Engine() noexcept = default;
-	void Initialize(const std::wstring& applicationName) noexcept;
+	void Initialize(const std::wstring& applicationName, uint32_t sceneSeed) noexcept;
 	void Run() noexcept;
+	//Runs the benchmark with the name, or every benchmark with "all", on the first frame's view and prints the results to the console.
+	//Shuts the engine down afterwards. Returns false if the name is unknown or a benchmark failed its own checks.
+	[[nodiscard]] bool RunBenchmarks(const std::string& name) noexcept;
+	//Shows the window with the statistics, toggles and benchmarks while running.
+	void SetMiscWindow(bool enabled) noexcept { m_MiscWindowEnabled = enabled; }
+	//The CPU reference writes its golden image instead of comparing against it.
+	void SetWriteCPUReferenceGolden(bool enabled) noexcept { m_WriteCPUReferenceGolden = enabled; }
 
 private:
 	void CreateConsole() noexcept;
+	void OnShutDown() noexcept;
 	void RenderMiscWindow(uint64_t currentFramesPerSecond, float currentFrameTime) noexcept;
+	void RunBenchmark(Benchmark benchmark) noexcept;
+	//Writes the results of the benchmark's last run, line by line. Returns false if they failed the benchmark's checks.
+	bool ReportBenchmark(Benchmark benchmark, PrintFunction print) const noexcept;
+	//The golden image of the CPU reference for the renderer's current shadow mode and light lists.
+	[[nodiscard]] std::string GetCPUReferenceGoldenPath() const noexcept;
+	//A ray from the near plane through the point on the screen, in normalized device coordinates.
+	[[nodiscard]] SceneRay GetCameraRay(float ndcX, float ndcY) noexcept;
 private:
 	std::wstring m_AppName;
 	std::unique_ptr<Renderer> m_pRenderer;
 	std::unique_ptr<Scene> m_pScene;
 	std::unique_ptr<Camera> m_pCamera;
+	bool m_MiscWindowEnabled = false;
+	CPURayTracer m_CPURayTracer;
+	bool m_CPUReferenceWritten = true;
+	//Pixels that differ from the golden image of the same settings, UINT32_MAX if it could not be compared.
+	uint32_t m_CPUReferenceMismatches = 0u;
+	bool m_WriteCPUReferenceGolden = false;
+	bool m_CPUReferenceGoldenWritten = false;
+	RayQueryBenchmark m_RayQueryBenchmark;
+	BVHBuildBenchmark m_BVHBuildBenchmark;
+	BVHBuildSettings m_BVHBuildSettings = {};
+	AOBakeBenchmark m_AOBakeBenchmark;
+	LightListBenchmark m_LightListBenchmark;
+	LightClusterBenchmark m_LightClusterBenchmark;
+	LightVisibilityBenchmark m_LightVisibilityBenchmark;
+	ShaderPermutationBenchmark m_ShaderPermutationBenchmark;
+	ProfilerBenchmark m_ProfilerBenchmark;
+	//The fastest of the occlusion culling runs.
+	OcclusionCullerStats m_OcclusionStats = {};
+	//Camera rays spread over the screen for the batched scene ray casts.
+	std::vector<SceneRay> m_RayCastRays;
+	std::vector<SceneRayHit> m_RayCastHits;
+	uint32_t m_NrOfRayCastHits = 0u;
 
 	double m_CurrentAverageRenderTime = 0.0f;
 	double m_AverageRenderTimeSinceStart = 0.0f;
 	double m_SummedDurationOverFrames = 0.0f;
-};
\ No newline at end of file
+};
@@ -1,12 +1,44 @@
 #include "pch.h"
 #include "Engine.h"
 
-int CALLBACK wWinMain(_In_ HINSTANCE, _In_opt_ HINSTANCE, _In_ LPWSTR, _In_ int)
+int CALLBACK wWinMain(_In_ HINSTANCE, _In_opt_ HINSTANCE, _In_ LPWSTR lpCmdLine, _In_ int)
 {
 	INIT_MEMORY_LEAK_DETECTION;
 
+	//The post build step fills the shader cache so that the first launch does not have to compile.
+	if (std::wstring(lpCmdLine).find(L"-buildshadercache") != std::wstring::npos)
+	{
+		return Renderer::BuildShaderCache() ? 0 : 1;
+	}
+
+	//-benchmark <name> runs a benchmark, or all of them, on a fixed scene and prints the results instead of opening the interactive loop.
+	//With -writegolden the CPU reference writes the golden image of the current settings instead of comparing against it.
+	const std::wstring commandLine(lpCmdLine);
+	const size_t benchmarkArgument = commandLine.find(L"-benchmark");
 	Engine engine;
-	engine.Initialize(APP_NAME);
+	if (benchmarkArgument != std::wstring::npos)
+	{
+		std::wistringstream arguments(commandLine.substr(benchmarkArgument + std::char_traits<wchar_t>::length(L"-benchmark")));
+		std::wstring name;
+		//A flag right after it, as in -benchmark -writegolden, runs all of them too.
+		if (!(arguments >> name) || name[0] == L'-')
+		{
+			name = L"all";
+		}
+		//Benchmark names are plain ASCII.
+		std::string benchmarkName;
+		for (wchar_t character : name)
+		{
+			benchmarkName.push_back(static_cast<char>(character));
+		}
+		engine.SetWriteCPUReferenceGolden(commandLine.find(L"-writegolden") != std::wstring::npos);
+		engine.Initialize(APP_NAME, Engine::s_BenchmarkSceneSeed);
+		return engine.RunBenchmarks(benchmarkName) ? 0 : 1;
+	}
+
+	//-ui shows the window with the statistics, toggles and benchmark buttons.
+	engine.SetMiscWindow(commandLine.find(L"-ui") != std::wstring::npos);
+	engine.Initialize(APP_NAME, static_cast<uint32_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count()));
 	engine.Run();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "pch.h"
+#include "FrustumCuller.h"
+
+namespace
+{
+	//For every 8-bit visibility mask this holds the lanes of the set bits, packed to the front.
+	//Used to compact the visible indices without branching.
+	struct CompactionTable
+	{
+		CompactionTable() noexcept
+		{
+			for (uint32_t mask{ 0u }; mask < 256u; ++mask)
+			{
+				uint32_t count = 0u;
+				for (uint32_t lane{ 0u }; lane < 8u; ++lane)
+				{
+					if (mask & (1u << lane))
+					{
+						Lanes[mask][count++] = lane;
+					}
+				}
+				for (; count < 8u; ++count)
+				{
+					Lanes[mask][count] = 0u;
+				}
+			}
+		}
+		alignas(32) uint32_t Lanes[256][8];
+	};
+
+	const CompactionTable s_CompactionTable;
+}
+
+FrustumPlanes FrustumCuller::ExtractPlanes(const DirectX::XMFLOAT4X4& viewProjection) noexcept
+{
+	//Row vectors are used (v * M), so each clip space component is the dot product with a column of the matrix.
+	const DirectX::XMFLOAT4X4& m = viewProjection;
+	DirectX::XMVECTOR column1 = DirectX::XMVectorSet(m._11, m._21, m._31, m._41);
+	DirectX::XMVECTOR column2 = DirectX::XMVectorSet(m._12, m._22, m._32, m._42);
+	DirectX::XMVECTOR column3 = DirectX::XMVectorSet(m._13, m._23, m._33, m._43);
+	DirectX::XMVECTOR column4 = DirectX::XMVectorSet(m._14, m._24, m._34, m._44);
+
+	DirectX::XMVECTOR planes[6] =
+	{
+		DirectX::XMVectorAdd(column4, column1),			//Left
+		DirectX::XMVectorSubtract(column4, column1),	//Right
+		DirectX::XMVectorAdd(column4, column2),			//Bottom
+		DirectX::XMVectorSubtract(column4, column2),	//Top
+		column3,										//Near (D3D clip space depth starts at 0)
+		DirectX::XMVectorSubtract(column4, column3)		//Far
+	};
+
+	FrustumPlanes frustum = {};
+	for (uint32_t i{ 0u }; i < 6u; ++i)
+	{
+		DirectX::XMStoreFloat4(&frustum.Planes[i], DirectX::XMPlaneNormalize(planes[i]));
+	}
+	return frustum;
+}
+
+void FrustumCuller::Clear() noexcept
+{
+	m_CenterX.clear();
+	m_CenterY.clear();
+	m_CenterZ.clear();
+	m_ExtentX.clear();
+	m_ExtentY.clear();
+	m_ExtentZ.clear();
+	m_NrOfBoxes = 0u;
+	m_NrOfVisible = 0u;
+}
+
+void FrustumCuller::Reserve(uint32_t nrOfBoxes) noexcept
+{
+	m_CenterX.reserve(nrOfBoxes);
+	m_CenterY.reserve(nrOfBoxes);
+	m_CenterZ.reserve(nrOfBoxes);
+	m_ExtentX.reserve(nrOfBoxes);
+	m_ExtentY.reserve(nrOfBoxes);
+	m_ExtentZ.reserve(nrOfBoxes);
+	m_VisibleIndices.reserve(static_cast<size_t>(nrOfBoxes) + 8u);
+}
+
+void FrustumCuller::AddBox(const DirectX::BoundingBox& box) noexcept
+{
+	m_CenterX.push_back(box.Center.x);
+	m_CenterY.push_back(box.Center.y);
+	m_CenterZ.push_back(box.Center.z);
+	m_ExtentX.push_back(box.Extents.x);
+	m_ExtentY.push_back(box.Extents.y);
+	m_ExtentZ.push_back(box.Extents.z);
+	m_NrOfBoxes++;
+}
+
+uint32_t FrustumCuller::Cull(const FrustumPlanes& frustum) noexcept
+{
+	m_VisibleIndices.resize(static_cast<size_t>(m_NrOfBoxes) + 8u);
+
+	//Broadcast the planes once. The absolute values of the normals are used to get the projected radius of a box.
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	__m256 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+	for (uint32_t p{ 0u }; p < 6u; ++p)
+	{
+		const DirectX::XMFLOAT4& plane = frustum.Planes[p];
+		planeX[p] = _mm256_set1_ps(plane.x);
+		planeY[p] = _mm256_set1_ps(plane.y);
+		planeZ[p] = _mm256_set1_ps(plane.z);
+		planeW[p] = _mm256_set1_ps(plane.w);
+		absPlaneX[p] = _mm256_set1_ps(std::fabs(plane.x));
+		absPlaneY[p] = _mm256_set1_ps(std::fabs(plane.y));
+		absPlaneZ[p] = _mm256_set1_ps(std::fabs(plane.z));
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	uint32_t* pVisible = m_VisibleIndices.data();
+	uint32_t nrOfVisible = 0u;
+
+	const uint32_t simdEnd = m_NrOfBoxes & ~7u;
+	for (uint32_t i{ 0u }; i < simdEnd; i += 8u)
+	{
+		__m256 centerX = _mm256_loadu_ps(&m_CenterX[i]);
+		__m256 centerY = _mm256_loadu_ps(&m_CenterY[i]);
+		__m256 centerZ = _mm256_loadu_ps(&m_CenterZ[i]);
+		__m256 extentX = _mm256_loadu_ps(&m_ExtentX[i]);
+		__m256 extentY = _mm256_loadu_ps(&m_ExtentY[i]);
+		__m256 extentZ = _mm256_loadu_ps(&m_ExtentZ[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (uint32_t p{ 0u }; p < 6u; ++p)
+		{
+			//Same operation order as the scalar reference so that both give identical results.
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], centerX), _mm256_mul_ps(planeY[p], centerY)), _mm256_mul_ps(planeZ[p], centerZ)), planeW[p]);
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absPlaneX[p], extentX), _mm256_mul_ps(absPlaneY[p], extentY)), _mm256_mul_ps(absPlaneZ[p], extentZ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+		}
+
+		//Write all 8 lanes, packed, and only advance by the number of visible boxes.
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+		__m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_CompactionTable.Lanes[mask]));
+		__m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), lanes);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pVisible + nrOfVisible), indices);
+		nrOfVisible += static_cast<uint32_t>(_mm_popcnt_u32(mask));
+	}
+
+	//The remaining boxes that do not fill a full register.
+	for (uint32_t i{ simdEnd }; i < m_NrOfBoxes; ++i)
+	{
+		bool inside = true;
+		for (uint32_t p{ 0u }; p < 6u && inside; ++p)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.Planes[p];
+			float distance = plane.x * m_CenterX[i] + plane.y * m_CenterY[i] + plane.z * m_CenterZ[i] + plane.w;
+			float radius = std::fabs(plane.x) * m_ExtentX[i] + std::fabs(plane.y) * m_ExtentY[i] + std::fabs(plane.z) * m_ExtentZ[i];
+			inside = distance + radius >= 0.0f;
+		}
+		if (inside)
+		{
+			pVisible[nrOfVisible++] = i;
+		}
+	}
+
+	m_NrOfVisible = nrOfVisible;
+	return nrOfVisible;
+}
+
+uint32_t FrustumCuller::CullScalar(const FrustumPlanes& frustum, std::vector<uint32_t>& visibleIndices) const noexcept
+{
+	visibleIndices.clear();
+	for (uint32_t i{ 0u }; i < m_NrOfBoxes; ++i)
+	{
+		bool inside = true;
+		for (uint32_t p{ 0u }; p < 6u && inside; ++p)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.Planes[p];
+			float distance = plane.x * m_CenterX[i] + plane.y * m_CenterY[i] + plane.z * m_CenterZ[i] + plane.w;
+			float radius = std::fabs(plane.x) * m_ExtentX[i] + std::fabs(plane.y) * m_ExtentY[i] + std::fabs(plane.z) * m_ExtentZ[i];
+			inside = distance + radius >= 0.0f;
+		}
+		if (inside)
+		{
+			visibleIndices.push_back(i);
+		}
+	}
+	return static_cast<uint32_t>(visibleIndices.size());
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+//A plane is stored as (a, b, c, d). A point p is on the inside of the plane when dot(abc, p) + d >= 0.
+struct FrustumPlanes
+{
+	DirectX::XMFLOAT4 Planes[6];
+};
+
+//Culls world space axis aligned bounding boxes against the camera frustum.
+//The boxes are stored as structure of arrays so that the kernel can test 8 boxes per iteration using AVX2.
+class FrustumCuller
+{
+public:
+	FrustumCuller() noexcept = default;
+	~FrustumCuller() noexcept = default;
+
+	//Extracts the six frustum planes (left, right, bottom, top, near, far) from a row-major view projection matrix.
+	[[nodiscard]] static FrustumPlanes ExtractPlanes(const DirectX::XMFLOAT4X4& viewProjection) noexcept;
+
+	void Clear() noexcept;
+	void Reserve(uint32_t nrOfBoxes) noexcept;
+	void AddBox(const DirectX::BoundingBox& box) noexcept;
+
+	//Tests all added boxes and writes the indices of the visible ones to the visible list. Returns the number of visible boxes.
+	uint32_t Cull(const FrustumPlanes& frustum) noexcept;
+	//Scalar reference of the kernel above, used to validate it.
+	uint32_t CullScalar(const FrustumPlanes& frustum, std::vector<uint32_t>& visibleIndices) const noexcept;
+
+	[[nodiscard]] const uint32_t* GetVisibleIndices() const noexcept { return m_VisibleIndices.data(); }
+	[[nodiscard]] constexpr uint32_t GetNrOfBoxes() const noexcept { return m_NrOfBoxes; }
+	[[nodiscard]] constexpr uint32_t GetNrOfVisible() const noexcept { return m_NrOfVisible; }
+	[[nodiscard]] constexpr uint32_t GetNrOfCulled() const noexcept { return m_NrOfBoxes - m_NrOfVisible; }
+private:
+	std::vector<float> m_CenterX = {};
+	std::vector<float> m_CenterY = {};
+	std::vector<float> m_CenterZ = {};
+	std::vector<float> m_ExtentX = {};
+	std::vector<float> m_ExtentY = {};
+	std::vector<float> m_ExtentZ = {};
+
+	//Padded by 8 so that the kernel can always store a full compacted register.
+	std::vector<uint32_t> m_VisibleIndices = {};
+
+	uint32_t m_NrOfBoxes = 0u;
+	uint32_t m_NrOfVisible = 0u;
+};
@@ -0,0 +1,43 @@
+#include "pch.h"
+#include "IndirectDrawBuilder.h"
+#include "ThreadPool.h"
+
+static_assert(offsetof(IndirectDrawArguments, IndexBuffer) == 8u && offsetof(IndirectDrawArguments, AmbientOcclusionBuffer) == 16u && offsetof(IndirectDrawArguments, InstanceOffset) == 24u && offsetof(IndirectDrawArguments, Draw) == 28u,
+	"The arguments have to be packed the way the command signature expects them.");
+static_assert(sizeof(IndirectDrawArguments) == 48u, "The record is written with three 16 byte stores.");
+
+uint32_t IndirectDrawBuilder::Build(const std::vector<InstanceBatch>& batches, IndirectDrawArguments* pDestination) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint32_t nrOfBatches = static_cast<uint32_t>(batches.size());
+	ThreadPool::Get().ParallelFor(nrOfBatches, 1024u, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				const InstanceBatch& batch = batches[i];
+				const Mesh* pMesh = batch.pMesh;
+				WriteRecord(pMesh->GetVertexBufferGPUAddress(), pMesh->GetIndexBufferGPUAddress(), pMesh->GetAmbientOcclusionBufferGPUAddress(),
+					pMesh->GetIndexCount(), batch.InstanceOffset, batch.InstanceCount, pDestination + i);
+			}
+		});
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BuildTime = static_cast<double>(dif.count()) * 0.001;
+	return nrOfBatches;
+}
+
+void IndirectDrawBuilder::WriteRecord(D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer, D3D12_GPU_VIRTUAL_ADDRESS indexBuffer, D3D12_GPU_VIRTUAL_ADDRESS ambientOcclusionBuffer,
+	uint32_t indexCount, uint32_t instanceOffset, uint32_t instanceCount, IndirectDrawArguments* pDestination) noexcept
+{
+	__m128i buffers = _mm_set_epi64x(static_cast<int64_t>(indexBuffer), static_cast<int64_t>(vertexBuffer));
+	//AmbientOcclusionBuffer, InstanceOffset, VertexCountPerInstance.
+	__m128i occlusionAndOffset = _mm_set_epi32(static_cast<int>(indexCount), static_cast<int>(instanceOffset), static_cast<int>(ambientOcclusionBuffer >> 32u), static_cast<int>(ambientOcclusionBuffer));
+	//InstanceCount, StartVertexLocation, StartInstanceLocation and the padding at the end of the record.
+	__m128i draw = _mm_set_epi32(0, 0, 0, static_cast<int>(instanceCount));
+
+	char* pRecord = reinterpret_cast<char*>(pDestination);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pRecord), buffers);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pRecord + 16u), occlusionAndOffset);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pRecord + 32u), draw);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "InstanceBatcher.h"
+
+//One ExecuteIndirect record. The members follow the argument order of the command signature created by the renderer,
+//with the offsets the arguments get when they are packed back to back.
+struct IndirectDrawArguments
+{
+	D3D12_GPU_VIRTUAL_ADDRESS VertexBuffer;		//Root parameter 1, vertex buffer SRV.
+	D3D12_GPU_VIRTUAL_ADDRESS IndexBuffer;		//Root parameter 2, index buffer SRV.
+	D3D12_GPU_VIRTUAL_ADDRESS AmbientOcclusionBuffer;	//Root parameter 8, ambient occlusion buffer SRV.
+	uint32_t InstanceOffset;					//Root parameter 6, root constant.
+	D3D12_DRAW_ARGUMENTS Draw;
+};
+
+//Writes the instanced batches as ExecuteIndirect argument records, so that all of them can be submitted with one call.
+//The destination is meant to be a mapped upload buffer, so every record is written in full with 16 byte stores and nothing is read back.
+class IndirectDrawBuilder
+{
+public:
+	IndirectDrawBuilder() noexcept = default;
+	~IndirectDrawBuilder() noexcept = default;
+
+	//Returns the number of records written, one per batch.
+	uint32_t Build(const std::vector<InstanceBatch>& batches, IndirectDrawArguments* pDestination) noexcept;
+	//Writes one record with its three stores. The draw starts at the first vertex and instance, the instance offset is a root constant.
+	static void WriteRecord(D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer, D3D12_GPU_VIRTUAL_ADDRESS indexBuffer, D3D12_GPU_VIRTUAL_ADDRESS ambientOcclusionBuffer,
+		uint32_t indexCount, uint32_t instanceOffset, uint32_t instanceCount, IndirectDrawArguments* pDestination) noexcept;
+
+	//Time spent packing in milliseconds.
+	[[nodiscard]] constexpr double GetBuildTime() const noexcept { return m_BuildTime; }
+private:
+	double m_BuildTime = 0.0;
+};
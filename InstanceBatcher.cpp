@@ -0,0 +1,35 @@
+#include "pch.h"
+#include "InstanceBatcher.h"
+#include "ThreadPool.h"
+
+void InstanceBatcher::Build(const std::vector<InstanceData>& objectInstances, const DrawList& drawList, const std::vector<const Mesh*>& meshes) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const std::vector<DrawPacket>& packets = drawList.GetPackets();
+	const uint32_t nrOfPackets = drawList.GetNrOfPackets();
+	m_InstanceData.resize(nrOfPackets);
+	m_Batches.clear();
+	m_NrOfDrawsBefore = nrOfPackets;
+
+	ThreadPool::Get().ParallelFor(nrOfPackets, 512u, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				m_InstanceData[i] = objectInstances[packets[i].ObjectIndex];
+			}
+		});
+
+	//The list is sorted on state first, so every run of equal state becomes one draw.
+	for (uint32_t i{ 0u }; i < nrOfPackets; ++i)
+	{
+		if (i == 0u || (packets[i].SortKey & DrawList::s_StateMask) != (packets[i - 1u].SortKey & DrawList::s_StateMask))
+		{
+			m_Batches.push_back({ meshes[packets[i].MeshIndex], i, 0u });
+		}
+		m_Batches.back().InstanceCount++;
+	}
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BuildTime = static_cast<double>(dif.count()) * 0.001;
+}
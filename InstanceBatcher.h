@@ -0,0 +1,49 @@
+#pragma once
+#include "VertexObject.h"
+#include "DrawList.h"
+
+//Per instance data read by the vertex shader. The world matrix is stored transposed, ready for the shader.
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 WorldMatrix;
+	DirectX::XMFLOAT4 Color;
+	//Range of the LightManager's light indices that the pixel shader loops over.
+	uint32_t LightOffset;
+	uint32_t NrOfLights;
+	//Row of the baked light visibility as the word offset and the number of lights in it, no lights for objects that move.
+	uint32_t VisibilityOffset;
+	uint32_t NrOfVisibilityLights;
+};
+
+//One instanced draw of a mesh, covering a range of the instance data.
+struct InstanceBatch
+{
+	const Mesh* pMesh = nullptr;
+	uint32_t InstanceOffset = 0u;
+	uint32_t InstanceCount = 0u;
+};
+
+//Turns a sorted draw list into instance data and one draw for every run of packets that share pipeline and mesh.
+//The instance data follows the packet order, so the instances of a draw keep the front to back order of the list.
+class InstanceBatcher
+{
+public:
+	InstanceBatcher() noexcept = default;
+	~InstanceBatcher() noexcept = default;
+
+	//The packets index into objectInstances and meshes. The instance data of an object is copied once for every packet that refers to it.
+	void Build(const std::vector<InstanceData>& objectInstances, const DrawList& drawList, const std::vector<const Mesh*>& meshes) noexcept;
+
+	[[nodiscard]] const std::vector<InstanceData>& GetInstanceData() const noexcept { return m_InstanceData; }
+	[[nodiscard]] const std::vector<InstanceBatch>& GetBatches() const noexcept { return m_Batches; }
+	//Number of draws it would have taken with one draw per mesh of every object.
+	[[nodiscard]] constexpr uint32_t GetNrOfDrawsBefore() const noexcept { return m_NrOfDrawsBefore; }
+	[[nodiscard]] uint32_t GetNrOfDrawsAfter() const noexcept { return static_cast<uint32_t>(m_Batches.size()); }
+	//Time spent gathering and packing in milliseconds.
+	[[nodiscard]] constexpr double GetBuildTime() const noexcept { return m_BuildTime; }
+private:
+	std::vector<InstanceData> m_InstanceData = {};
+	std::vector<InstanceBatch> m_Batches = {};
+	uint32_t m_NrOfDrawsBefore = 0u;
+	double m_BuildTime = 0.0;
+};
@@ -0,0 +1,53 @@
+#include "pch.h"
+#include "LightClusterBenchmark.h"
+#include "Camera.h"
+
+void LightClusterBenchmark::Run(float intensityCutoff) noexcept
+{
+	m_Results.clear();
+
+	//The same projection as the camera, looking down the z-axis from the origin.
+	const float fovY = DirectX::XMConvertToRadians(45.0f);
+	const float aspectRatio = 16.0f / 9.0f;
+	DirectX::XMFLOAT4X4 projection;
+	DirectX::XMStoreFloat4x4(&projection, DirectX::XMMatrixPerspectiveFovLH(fovY, aspectRatio, Camera::s_NearPlane, Camera::s_FarPlane));
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMStoreFloat4x4(&view, DirectX::XMMatrixIdentity());
+	m_LightClusterBuilder.SetProjection(projection._11, projection._22, Camera::s_NearPlane, Camera::s_FarPlane);
+
+	const float halfHeight = s_Depth / projection._22;
+	const float halfWidth = s_Depth / projection._11;
+	std::default_random_engine generator(1u);
+	std::uniform_real_distribution<float> distributionX(-halfWidth, halfWidth);
+	std::uniform_real_distribution<float> distributionY(-halfHeight, halfHeight);
+	std::uniform_real_distribution<float> distributionZ(Camera::s_NearPlane, s_Depth);
+	std::uniform_real_distribution<float> distributionColor(0.05f, 1.0f);
+
+	for (uint32_t size{ 0u }; size < s_NrOfSizes; ++size)
+	{
+		m_Lights.resize(s_NrOfLights[size]);
+		for (PointLight& light : m_Lights)
+		{
+			light = {};
+			light.Position = { distributionX(generator), distributionY(generator), distributionZ(generator) };
+			light.Color = { distributionColor(generator), distributionColor(generator), distributionColor(generator) };
+			light.Radius = LightManager::ComputeRadius(light.Color, intensityCutoff);
+		}
+		//The first build sizes the buffers, the second one is timed.
+		m_LightClusterBuilder.Build(view, m_Lights);
+		m_LightClusterBuilder.Build(view, m_Lights);
+
+		LightClusterBenchmarkResult result;
+		result.NrOfLights = s_NrOfLights[size];
+		result.BuildTime = m_LightClusterBuilder.GetBuildTime();
+		result.NrOfOccupiedClusters = m_LightClusterBuilder.GetNrOfOccupiedClusters();
+		result.AverageNrOfLights = m_LightClusterBuilder.GetAverageNrOfLights();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		result.NrOfMismatches = m_LightClusterBuilder.CountMismatches(view, m_Lights);
+		auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+		result.BruteForceTime = static_cast<double>(dif.count()) * 0.001;
+		DBG_ASSERT(result.NrOfMismatches == 0u, "Error! The light clusters disagree with testing every light.");
+		m_Results.push_back(result);
+	}
+}
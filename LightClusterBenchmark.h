@@ -0,0 +1,37 @@
+#pragma once
+#include "LightClusterBuilder.h"
+
+struct LightClusterBenchmarkResult
+{
+	uint32_t NrOfLights = 0u;
+	//In milliseconds.
+	double BuildTime = 0.0;
+	//Time testing every light against every cluster takes, in milliseconds.
+	double BruteForceTime = 0.0;
+	uint32_t NrOfOccupiedClusters = 0u;
+	double AverageNrOfLights = 0.0;
+	//Clusters whose list differs from testing every light.
+	uint32_t NrOfMismatches = 0u;
+};
+
+//Times the light cluster build for a fixed camera and random lights in front of it, against the number of lights.
+//The lights are the same on every run so that the times can be compared between cutoffs.
+class LightClusterBenchmark
+{
+public:
+	static constexpr uint32_t s_NrOfSizes = 4u;
+	static constexpr uint32_t s_NrOfLights[s_NrOfSizes] = { 1000u, 2500u, 5000u, 10'000u };
+	//The lights are spread over a box this deep in front of the camera, as wide as the frustum at its far side.
+	static constexpr float s_Depth = 1000.0f;
+public:
+	LightClusterBenchmark() noexcept = default;
+	~LightClusterBenchmark() noexcept = default;
+
+	void Run(float intensityCutoff) noexcept;
+
+	[[nodiscard]] const std::vector<LightClusterBenchmarkResult>& GetResults() const noexcept { return m_Results; }
+private:
+	std::vector<LightClusterBenchmarkResult> m_Results = {};
+	LightClusterBuilder m_LightClusterBuilder;
+	std::vector<PointLight> m_Lights = {};
+};
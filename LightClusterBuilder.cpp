@@ -0,0 +1,307 @@
+#include "pch.h"
+#include "LightClusterBuilder.h"
+
+namespace
+{
+	//For every mask of eight lanes, the lanes that are set moved to the front.
+	struct CompactTable
+	{
+		uint32_t Lanes[256][8];
+	};
+
+	constexpr CompactTable MakeCompactTable() noexcept
+	{
+		CompactTable table = {};
+		for (uint32_t mask{ 0u }; mask < 256u; ++mask)
+		{
+			uint32_t nrOfSet = 0u;
+			for (uint32_t lane{ 0u }; lane < 8u; ++lane)
+			{
+				if (mask & (1u << lane))
+				{
+					table.Lanes[mask][nrOfSet++] = lane;
+				}
+			}
+		}
+		return table;
+	}
+
+	constexpr CompactTable s_CompactTable = MakeCompactTable();
+
+	uint32_t RoundUpToBlock(uint32_t count) noexcept
+	{
+		return (count + 7u) & ~7u;
+	}
+
+	void GrowBounds(DirectX::XMFLOAT3& min, DirectX::XMFLOAT3& max, const DirectX::XMFLOAT3& otherMin, const DirectX::XMFLOAT3& otherMax) noexcept
+	{
+		min = { std::min(min.x, otherMin.x), std::min(min.y, otherMin.y), std::min(min.z, otherMin.z) };
+		max = { std::max(max.x, otherMax.x), std::max(max.y, otherMax.y), std::max(max.z, otherMax.z) };
+	}
+
+	//Mask of the eight lights whose sphere touches the box.
+	uint32_t TestBlock(const float* pX, const float* pY, const float* pZ, const float* pRadiusSquared, const __m256 min[3], const __m256 max[3]) noexcept
+	{
+		const __m256 x = _mm256_loadu_ps(pX);
+		const __m256 y = _mm256_loadu_ps(pY);
+		const __m256 z = _mm256_loadu_ps(pZ);
+		const __m256 dx = _mm256_sub_ps(x, _mm256_min_ps(_mm256_max_ps(x, min[0]), max[0]));
+		const __m256 dy = _mm256_sub_ps(y, _mm256_min_ps(_mm256_max_ps(y, min[1]), max[1]));
+		const __m256 dz = _mm256_sub_ps(z, _mm256_min_ps(_mm256_max_ps(z, min[2]), max[2]));
+		const __m256 distanceSquared = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+		return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, _mm256_loadu_ps(pRadiusSquared), _CMP_LE_OQ)));
+	}
+
+	//Same test as TestBlock for one light, with the same order of operations so that both give identical results.
+	bool TestLight(const DirectX::XMFLOAT3& position, float radiusSquared, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) noexcept
+	{
+		const float dx = position.x - std::min(std::max(position.x, min.x), max.x);
+		const float dy = position.y - std::min(std::max(position.y, min.y), max.y);
+		const float dz = position.z - std::min(std::max(position.z, min.z), max.z);
+		return std::fma(dz, dz, std::fma(dy, dy, dx * dx)) <= radiusSquared;
+	}
+
+	//Moves the eight values to the front in the order of the lanes and stores all eight, the ones past the moved values are overwritten later.
+	void StoreCompacted(float* pDestination, const float* pSource, __m256i lanes) noexcept
+	{
+		_mm256_storeu_ps(pDestination, _mm256_permutevar8x32_ps(_mm256_loadu_ps(pSource), lanes));
+	}
+}
+
+void LightClusterBuilder::LightSet::Resize(uint32_t capacity) noexcept
+{
+	//Room for the last store of eight values past the padded count.
+	const size_t size = static_cast<size_t>(RoundUpToBlock(capacity)) + 8u;
+	if (X.size() < size)
+	{
+		X.resize(size);
+		Y.resize(size);
+		Z.resize(size);
+		RadiusSquared.resize(size);
+		Index.resize(size);
+	}
+}
+
+void LightClusterBuilder::LightSet::PadTail() noexcept
+{
+	for (uint32_t i{ Count }; i < RoundUpToBlock(Count); ++i)
+	{
+		X[i] = 0.0f;
+		Y[i] = 0.0f;
+		Z[i] = 0.0f;
+		RadiusSquared[i] = -1.0f;
+		Index[i] = 0u;
+	}
+}
+
+void LightClusterBuilder::SetProjection(float projectionX, float projectionY, float nearZ, float farZ) noexcept
+{
+	DBG_ASSERT(nearZ > 0.0f && farZ > nearZ, "Error! The cluster depth range is invalid.");
+	if (projectionX == m_ProjectionX && projectionY == m_ProjectionY && nearZ == m_NearZ && farZ == m_FarZ && !m_ClusterMin.empty())
+		return;
+
+	m_ProjectionX = projectionX;
+	m_ProjectionY = projectionY;
+	m_NearZ = nearZ;
+	m_FarZ = farZ;
+
+	m_ClusterMin.resize(s_NrOfClusters);
+	m_ClusterMax.resize(s_NrOfClusters);
+	m_RowMin.assign(s_DimY * s_DimZ, { FLT_MAX, FLT_MAX, FLT_MAX });
+	m_RowMax.assign(s_DimY * s_DimZ, { -FLT_MAX, -FLT_MAX, -FLT_MAX });
+	m_SliceMin.assign(s_DimZ, { FLT_MAX, FLT_MAX, FLT_MAX });
+	m_SliceMax.assign(s_DimZ, { -FLT_MAX, -FLT_MAX, -FLT_MAX });
+	for (uint32_t z{ 0u }; z < s_DimZ; ++z)
+	{
+		//Exponential slices keep the clusters about as deep as they are wide.
+		const float sliceNear = m_NearZ * std::pow(m_FarZ / m_NearZ, static_cast<float>(z) / s_DimZ);
+		const float sliceFar = m_NearZ * std::pow(m_FarZ / m_NearZ, static_cast<float>(z + 1u) / s_DimZ);
+		for (uint32_t y{ 0u }; y < s_DimY; ++y)
+		{
+			//Row 0 is at the top of the screen.
+			const float ndcTop = 1.0f - 2.0f * y / s_DimY;
+			const float ndcBottom = 1.0f - 2.0f * (y + 1u) / s_DimY;
+			for (uint32_t x{ 0u }; x < s_DimX; ++x)
+			{
+				const float ndcLeft = -1.0f + 2.0f * x / s_DimX;
+				const float ndcRight = -1.0f + 2.0f * (x + 1u) / s_DimX;
+
+				//The box around the corners of the tile at both ends of the slice.
+				DirectX::XMFLOAT3 min = { FLT_MAX, FLT_MAX, sliceNear };
+				DirectX::XMFLOAT3 max = { -FLT_MAX, -FLT_MAX, sliceFar };
+				for (float depth : { sliceNear, sliceFar })
+				{
+					for (float ndcX : { ndcLeft, ndcRight })
+					{
+						min.x = std::min(min.x, ndcX * depth / m_ProjectionX);
+						max.x = std::max(max.x, ndcX * depth / m_ProjectionX);
+					}
+					for (float ndcY : { ndcTop, ndcBottom })
+					{
+						min.y = std::min(min.y, ndcY * depth / m_ProjectionY);
+						max.y = std::max(max.y, ndcY * depth / m_ProjectionY);
+					}
+				}
+
+				const uint32_t clusterIndex = GetClusterIndex(x, y, z);
+				m_ClusterMin[clusterIndex] = min;
+				m_ClusterMax[clusterIndex] = max;
+				GrowBounds(m_RowMin[z * s_DimY + y], m_RowMax[z * s_DimY + y], min, max);
+				GrowBounds(m_SliceMin[z], m_SliceMax[z], min, max);
+			}
+		}
+	}
+}
+
+void LightClusterBuilder::Build(const DirectX::XMFLOAT4X4& view, const std::vector<PointLight>& lights) noexcept
+{
+	DBG_ASSERT(!m_ClusterMin.empty(), "Error! SetProjection has to be called before the first build.");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint32_t nrOfLights = static_cast<uint32_t>(lights.size());
+	const DirectX::XMMATRIX viewMatrix = DirectX::XMLoadFloat4x4(&view);
+	m_ViewLights.Resize(nrOfLights);
+	m_ViewLights.Count = nrOfLights;
+	for (uint32_t i{ 0u }; i < nrOfLights; ++i)
+	{
+		DirectX::XMFLOAT3 position;
+		DirectX::XMStoreFloat3(&position, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&lights[i].Position), viewMatrix));
+		m_ViewLights.X[i] = position.x;
+		m_ViewLights.Y[i] = position.y;
+		m_ViewLights.Z[i] = position.z;
+		m_ViewLights.RadiusSquared[i] = lights[i].Radius * lights[i].Radius;
+		m_ViewLights.Index[i] = i;
+	}
+	m_ViewLights.PadTail();
+
+	m_SliceScratch.resize(s_DimZ);
+	m_Ranges.resize(s_NrOfClusters);
+	ThreadPool::Get().ParallelFor(s_DimZ, 1u, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t z{ begin }; z < end; ++z)
+			{
+				BuildSlice(z);
+			}
+		});
+
+	//Put the lists of the slices after each other in cluster order.
+	uint32_t nrOfIndices = 0u;
+	m_NrOfOccupiedClusters = 0u;
+	for (uint32_t clusterIndex{ 0u }; clusterIndex < s_NrOfClusters; ++clusterIndex)
+	{
+		m_Ranges[clusterIndex].Offset = nrOfIndices;
+		nrOfIndices += m_Ranges[clusterIndex].Count;
+		m_NrOfOccupiedClusters += m_Ranges[clusterIndex].Count > 0u ? 1u : 0u;
+	}
+	m_LightIndices.resize(nrOfIndices);
+	ThreadPool::Get().ParallelFor(s_DimZ, 1u, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t z{ begin }; z < end; ++z)
+			{
+				const LightRange& first = m_Ranges[GetClusterIndex(0u, 0u, z)];
+				const LightRange& last = m_Ranges[GetClusterIndex(s_DimX - 1u, s_DimY - 1u, z)];
+				const uint32_t count = last.Offset + last.Count - first.Offset;
+				std::copy(m_SliceScratch[z].Indices.begin(), m_SliceScratch[z].Indices.begin() + count, m_LightIndices.begin() + first.Offset);
+			}
+		});
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BuildTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+void LightClusterBuilder::BuildSlice(uint32_t z) noexcept
+{
+	SliceScratch& scratch = m_SliceScratch[z];
+	scratch.SliceLights.Resize(m_ViewLights.Count);
+	Sweep(m_ViewLights, m_SliceMin[z], m_SliceMax[z], scratch.SliceLights);
+	scratch.RowLights.Resize(scratch.SliceLights.Count);
+
+	//Every cluster of the slice writes eight indices per block of its row's lights, so there has to be room for all of them in the last cluster.
+	uint32_t nrOfIndices = 0u;
+	for (uint32_t y{ 0u }; y < s_DimY; ++y)
+	{
+		Sweep(scratch.SliceLights, m_RowMin[z * s_DimY + y], m_RowMax[z * s_DimY + y], scratch.RowLights);
+		const size_t size = static_cast<size_t>(nrOfIndices) + s_DimX * (RoundUpToBlock(scratch.RowLights.Count) + 8u);
+		if (scratch.Indices.size() < size)
+		{
+			scratch.Indices.resize(2u * size);
+		}
+
+		for (uint32_t x{ 0u }; x < s_DimX; ++x)
+		{
+			const uint32_t clusterIndex = GetClusterIndex(x, y, z);
+			const uint32_t count = SweepIndices(scratch.RowLights, m_ClusterMin[clusterIndex], m_ClusterMax[clusterIndex], &scratch.Indices[nrOfIndices]);
+			m_Ranges[clusterIndex].Count = count;
+			nrOfIndices += count;
+		}
+	}
+}
+
+void LightClusterBuilder::Sweep(const LightSet& source, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, LightSet& destination) noexcept
+{
+	const __m256 boxMin[3] = { _mm256_set1_ps(min.x), _mm256_set1_ps(min.y), _mm256_set1_ps(min.z) };
+	const __m256 boxMax[3] = { _mm256_set1_ps(max.x), _mm256_set1_ps(max.y), _mm256_set1_ps(max.z) };
+	uint32_t count = 0u;
+	for (uint32_t block{ 0u }; block < source.Count; block += 8u)
+	{
+		const uint32_t mask = TestBlock(&source.X[block], &source.Y[block], &source.Z[block], &source.RadiusSquared[block], boxMin, boxMax);
+		const __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s_CompactTable.Lanes[mask]));
+		StoreCompacted(&destination.X[count], &source.X[block], lanes);
+		StoreCompacted(&destination.Y[count], &source.Y[block], lanes);
+		StoreCompacted(&destination.Z[count], &source.Z[block], lanes);
+		StoreCompacted(&destination.RadiusSquared[count], &source.RadiusSquared[block], lanes);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&destination.Index[count]),
+			_mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&source.Index[block])), lanes));
+		count += static_cast<uint32_t>(_mm_popcnt_u32(mask));
+	}
+	destination.Count = count;
+	destination.PadTail();
+}
+
+uint32_t LightClusterBuilder::SweepIndices(const LightSet& source, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, uint32_t* pIndices) noexcept
+{
+	const __m256 boxMin[3] = { _mm256_set1_ps(min.x), _mm256_set1_ps(min.y), _mm256_set1_ps(min.z) };
+	const __m256 boxMax[3] = { _mm256_set1_ps(max.x), _mm256_set1_ps(max.y), _mm256_set1_ps(max.z) };
+	uint32_t count = 0u;
+	for (uint32_t block{ 0u }; block < source.Count; block += 8u)
+	{
+		const uint32_t mask = TestBlock(&source.X[block], &source.Y[block], &source.Z[block], &source.RadiusSquared[block], boxMin, boxMax);
+		const __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s_CompactTable.Lanes[mask]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&pIndices[count]),
+			_mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&source.Index[block])), lanes));
+		count += static_cast<uint32_t>(_mm_popcnt_u32(mask));
+	}
+	return count;
+}
+
+uint32_t LightClusterBuilder::CountMismatches(const DirectX::XMFLOAT4X4& view, const std::vector<PointLight>& lights) const noexcept
+{
+	//Every light against every cluster, with the light moved into view space the same way as in Build.
+	const DirectX::XMMATRIX viewMatrix = DirectX::XMLoadFloat4x4(&view);
+	std::vector<DirectX::XMFLOAT3> viewPositions(lights.size());
+	for (size_t i{ 0u }; i < lights.size(); ++i)
+	{
+		DirectX::XMStoreFloat3(&viewPositions[i], DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&lights[i].Position), viewMatrix));
+	}
+
+	uint32_t nrOfMismatches = 0u;
+	for (uint32_t clusterIndex{ 0u }; clusterIndex < s_NrOfClusters; ++clusterIndex)
+	{
+		//The lists are sorted on the light index, so walking the lights in order has to find them in the same order.
+		const LightRange& range = m_Ranges[clusterIndex];
+		uint32_t nrOfFound = 0u;
+		bool matches = true;
+		for (uint32_t lightIndex{ 0u }; lightIndex < lights.size() && matches; ++lightIndex)
+		{
+			if (!TestLight(viewPositions[lightIndex], lights[lightIndex].Radius * lights[lightIndex].Radius, m_ClusterMin[clusterIndex], m_ClusterMax[clusterIndex]))
+				continue;
+			matches = nrOfFound < range.Count && m_LightIndices[range.Offset + nrOfFound] == lightIndex;
+			nrOfFound++;
+		}
+		if (!matches || nrOfFound != range.Count)
+		{
+			nrOfMismatches++;
+		}
+	}
+	return nrOfMismatches;
+}
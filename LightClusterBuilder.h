@@ -0,0 +1,86 @@
+#pragma once
+#include "LightManager.h"
+
+//Assigns point lights to the clusters of a froxel grid, the camera frustum sliced into tiles on screen and exponential slices in depth.
+//Every cluster gets a compact list of the lights whose sphere touches the view space box around the cluster, so the pixel shader only
+//loops over the lights of the cluster its pixel is in. The lights are narrowed down per depth slice, then per row of tiles, then per cluster,
+//every step a sweep of eight lights at a time with AVX2. The depth slices are spread over the thread pool. The lists come out in cluster order,
+//every list sorted on the light index, so the result does not depend on the number of threads.
+class LightClusterBuilder
+{
+public:
+	static constexpr uint32_t s_DimX = 16u;
+	static constexpr uint32_t s_DimY = 9u;
+	static constexpr uint32_t s_DimZ = 24u;
+	static constexpr uint32_t s_NrOfClusters = s_DimX * s_DimY * s_DimZ;
+public:
+	LightClusterBuilder() noexcept = default;
+	~LightClusterBuilder() noexcept = default;
+
+	//Elements _11 and _22 of the projection matrix and the depth range. The cluster bounds are only recomputed when these change.
+	void SetProjection(float projectionX, float projectionY, float nearZ, float farZ) noexcept;
+	//The light positions are in world space, the view matrix moves them into the space of the clusters.
+	void Build(const DirectX::XMFLOAT4X4& view, const std::vector<PointLight>& lights) noexcept;
+	//Number of clusters whose list differs from testing every light against every cluster.
+	[[nodiscard]] uint32_t CountMismatches(const DirectX::XMFLOAT4X4& view, const std::vector<PointLight>& lights) const noexcept;
+
+	[[nodiscard]] static constexpr uint32_t GetClusterIndex(uint32_t x, uint32_t y, uint32_t z) noexcept { return (z * s_DimY + y) * s_DimX + x; }
+	//The cluster of a view space depth is floor(log(depth) * scale + bias).
+	[[nodiscard]] float GetDepthScale() const noexcept { return s_DimZ / std::log(m_FarZ / m_NearZ); }
+	[[nodiscard]] float GetDepthBias() const noexcept { return -std::log(m_NearZ) * GetDepthScale(); }
+	[[nodiscard]] const std::vector<LightRange>& GetClusterRanges() const noexcept { return m_Ranges; }
+	[[nodiscard]] const std::vector<uint32_t>& GetLightIndices() const noexcept { return m_LightIndices; }
+	[[nodiscard]] const DirectX::XMFLOAT3& GetClusterMin(uint32_t clusterIndex) const noexcept { return m_ClusterMin[clusterIndex]; }
+	[[nodiscard]] const DirectX::XMFLOAT3& GetClusterMax(uint32_t clusterIndex) const noexcept { return m_ClusterMax[clusterIndex]; }
+	//Time the last build took in milliseconds.
+	[[nodiscard]] constexpr double GetBuildTime() const noexcept { return m_BuildTime; }
+	//Clusters with at least one light after the last build, and the average number of lights in them.
+	[[nodiscard]] constexpr uint32_t GetNrOfOccupiedClusters() const noexcept { return m_NrOfOccupiedClusters; }
+	[[nodiscard]] double GetAverageNrOfLights() const noexcept { return m_NrOfOccupiedClusters == 0u ? 0.0 : static_cast<double>(m_LightIndices.size()) / m_NrOfOccupiedClusters; }
+private:
+	//Lights as structure of arrays. The arrays are padded past Count with lights that reach nothing, so they can be swept eight at a time.
+	struct LightSet
+	{
+		std::vector<float> X = {};
+		std::vector<float> Y = {};
+		std::vector<float> Z = {};
+		std::vector<float> RadiusSquared = {};
+		std::vector<uint32_t> Index = {};
+		uint32_t Count = 0u;
+
+		void Resize(uint32_t capacity) noexcept;
+		void PadTail() noexcept;
+	};
+
+	//Scratch of one depth slice, kept between builds.
+	struct SliceScratch
+	{
+		LightSet SliceLights = {};
+		LightSet RowLights = {};
+		std::vector<uint32_t> Indices = {};
+	};
+
+	void BuildSlice(uint32_t z) noexcept;
+	static void Sweep(const LightSet& source, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, LightSet& destination) noexcept;
+	static uint32_t SweepIndices(const LightSet& source, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, uint32_t* pIndices) noexcept;
+private:
+	float m_ProjectionX = 0.0f;
+	float m_ProjectionY = 0.0f;
+	float m_NearZ = 0.1f;
+	float m_FarZ = 10000.0f;
+
+	//View space bounds of every cluster, every row of clusters and every depth slice.
+	std::vector<DirectX::XMFLOAT3> m_ClusterMin = {};
+	std::vector<DirectX::XMFLOAT3> m_ClusterMax = {};
+	std::vector<DirectX::XMFLOAT3> m_RowMin = {};
+	std::vector<DirectX::XMFLOAT3> m_RowMax = {};
+	std::vector<DirectX::XMFLOAT3> m_SliceMin = {};
+	std::vector<DirectX::XMFLOAT3> m_SliceMax = {};
+
+	LightSet m_ViewLights = {};
+	std::vector<SliceScratch> m_SliceScratch = {};
+	std::vector<LightRange> m_Ranges = {};
+	std::vector<uint32_t> m_LightIndices = {};
+	uint32_t m_NrOfOccupiedClusters = 0u;
+	double m_BuildTime = 0.0;
+};
@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "LightListBenchmark.h"
+
+void LightListBenchmark::Run(float intensityCutoff) noexcept
+{
+	m_Results.clear();
+
+	std::default_random_engine generator(1u);
+	std::uniform_real_distribution<float> distributionPos(-0.5f * s_WorldSize, 0.5f * s_WorldSize);
+	std::uniform_real_distribution<float> distributionExtents(0.5f, 5.0f);
+	std::uniform_real_distribution<float> distributionColor(0.05f, 1.0f);
+	m_ObjectBounds.resize(s_NrOfObjects);
+	for (DirectX::BoundingBox& bounds : m_ObjectBounds)
+	{
+		bounds.Center = { distributionPos(generator), distributionPos(generator), distributionPos(generator) };
+		bounds.Extents = { distributionExtents(generator), distributionExtents(generator), distributionExtents(generator) };
+	}
+
+	for (uint32_t size{ 0u }; size < s_NrOfSizes; ++size)
+	{
+		m_LightManager.Clear();
+		m_LightManager.SetIntensityCutoff(intensityCutoff);
+		for (uint32_t i{ 0u }; i < s_NrOfLights[size]; ++i)
+		{
+			m_LightManager.AddLight(
+				{ distributionPos(generator), distributionPos(generator), distributionPos(generator) },
+				{ distributionColor(generator), distributionColor(generator), distributionColor(generator) });
+		}
+		//The first update sizes the buffers, the second one is timed.
+		m_LightManager.Update(m_ObjectBounds);
+		m_LightManager.Update(m_ObjectBounds);
+
+		LightListBenchmarkResult result;
+		result.NrOfLights = s_NrOfLights[size];
+		result.NrOfObjects = s_NrOfObjects;
+		result.UpdateTime = m_LightManager.GetUpdateTime();
+		result.AverageNrOfLights = m_LightManager.GetAverageNrOfLights();
+
+		const std::vector<PointLight>& lights = m_LightManager.GetLights();
+		const std::vector<uint32_t>& lightIndices = m_LightManager.GetLightIndices();
+		for (uint32_t objectIndex{ 0u }; objectIndex < s_NrOfObjects; objectIndex += s_CheckStride)
+		{
+			//The lists are sorted on the light index, so walking the lights in order has to find them in the same order.
+			const LightRange& lightRange = m_LightManager.GetLightRange(objectIndex);
+			uint32_t nrOfFound = 0u;
+			bool matches = true;
+			for (uint32_t lightIndex{ 0u }; lightIndex < lights.size() && matches; ++lightIndex)
+			{
+				if (!LightManager::Overlaps(lights[lightIndex], m_ObjectBounds[objectIndex]))
+					continue;
+				matches = nrOfFound < lightRange.Count && lightIndices[lightRange.Offset + nrOfFound] == lightIndex;
+				nrOfFound++;
+			}
+			if (!matches || nrOfFound != lightRange.Count)
+			{
+				result.NrOfMismatches++;
+			}
+			result.NrOfChecked++;
+		}
+		DBG_ASSERT(result.NrOfMismatches == 0u, "Error! The light lists disagree with testing every light.");
+		m_Results.push_back(result);
+	}
+}
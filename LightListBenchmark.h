@@ -0,0 +1,40 @@
+#pragma once
+#include "LightManager.h"
+
+struct LightListBenchmarkResult
+{
+	uint32_t NrOfLights = 0u;
+	uint32_t NrOfObjects = 0u;
+	//In milliseconds.
+	double UpdateTime = 0.0;
+	//Lights shaded per object with the lists, every object shaded every light before.
+	double AverageNrOfLights = 0.0;
+	//Objects whose list differs from testing every light, out of the checked ones.
+	uint32_t NrOfMismatches = 0u;
+	uint32_t NrOfChecked = 0u;
+};
+
+//Times the light list update on a generated scene of small boxes and random lights, against the number of lights.
+//The scene is the same on every run so that the times can be compared between cutoffs.
+class LightListBenchmark
+{
+public:
+	static constexpr uint32_t s_NrOfObjects = 100'000u;
+	static constexpr uint32_t s_NrOfSizes = 3u;
+	static constexpr uint32_t s_NrOfLights[s_NrOfSizes] = { 16u, 128u, 1024u };
+	//Every s_CheckStride:th object is checked against testing every light.
+	static constexpr uint32_t s_CheckStride = 97u;
+	//Side of the cube the objects and lights are spread over.
+	static constexpr float s_WorldSize = 2000.0f;
+public:
+	LightListBenchmark() noexcept = default;
+	~LightListBenchmark() noexcept = default;
+
+	void Run(float intensityCutoff) noexcept;
+
+	[[nodiscard]] const std::vector<LightListBenchmarkResult>& GetResults() const noexcept { return m_Results; }
+private:
+	std::vector<LightListBenchmarkResult> m_Results = {};
+	LightManager m_LightManager;
+	std::vector<DirectX::BoundingBox> m_ObjectBounds = {};
+};
@@ -0,0 +1,186 @@
+#include "pch.h"
+#include "LightManager.h"
+
+namespace
+{
+	//For every mask of eight lanes, the lanes that are set moved to the front.
+	struct CompactTable
+	{
+		uint32_t Lanes[256][8];
+	};
+
+	constexpr CompactTable MakeCompactTable() noexcept
+	{
+		CompactTable table = {};
+		for (uint32_t mask{ 0u }; mask < 256u; ++mask)
+		{
+			uint32_t nrOfSet = 0u;
+			for (uint32_t lane{ 0u }; lane < 8u; ++lane)
+			{
+				if (mask & (1u << lane))
+				{
+					table.Lanes[mask][nrOfSet++] = lane;
+				}
+			}
+		}
+		return table;
+	}
+
+	constexpr CompactTable s_CompactTable = MakeCompactTable();
+
+	float DistanceSquared(const DirectX::XMFLOAT3& point, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) noexcept
+	{
+		float dx = std::max(std::max(min.x - point.x, 0.0f), point.x - max.x);
+		float dy = std::max(std::max(min.y - point.y, 0.0f), point.y - max.y);
+		float dz = std::max(std::max(min.z - point.z, 0.0f), point.z - max.z);
+		return dx * dx + dy * dy + dz * dz;
+	}
+}
+
+uint32_t LightManager::AddLight(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& color) noexcept
+{
+	//The renderer's light buffer holds s_MaxNrOfLights, a light past it would be referenced by the light lists without being uploaded.
+	DBG_ASSERT(m_Lights.size() < s_MaxNrOfLights, "Error! Too many lights.");
+	if (m_Lights.size() >= s_MaxNrOfLights)
+		return UINT32_MAX;
+
+	PointLight light = {};
+	light.Position = position;
+	light.Color = color;
+	light.Radius = ComputeRadius(color, m_IntensityCutoff);
+	m_Lights.push_back(light);
+	return static_cast<uint32_t>(m_Lights.size() - 1u);
+}
+
+void LightManager::Clear() noexcept
+{
+	m_Lights.clear();
+	m_Ranges.clear();
+	m_LightIndices.clear();
+}
+
+void LightManager::SetIntensityCutoff(float intensityCutoff) noexcept
+{
+	DBG_ASSERT(intensityCutoff > 0.0f, "Error! The intensity cutoff has to be positive.");
+
+	m_IntensityCutoff = std::max(intensityCutoff, 1.0e-6f);
+	for (PointLight& light : m_Lights)
+	{
+		light.Radius = ComputeRadius(light.Color, m_IntensityCutoff);
+	}
+}
+
+float LightManager::ComputeRadius(const DirectX::XMFLOAT3& color, float intensityCutoff) noexcept
+{
+	//Solves maxIntensity / (1 + l * d + q * d^2) = cutoff for d.
+	const float maxIntensity = std::max(std::max(color.x, color.y), color.z) * s_MaxResponse;
+	const float c = 1.0f - maxIntensity / intensityCutoff;
+	if (c >= 0.0f)
+		return 0.0f;
+
+	if constexpr (s_QuadraticAttenuation == 0.0f)
+	{
+		return s_LinearAttenuation > 0.0f ? -c / s_LinearAttenuation : FLT_MAX;
+	}
+	else
+	{
+		const float discriminant = s_LinearAttenuation * s_LinearAttenuation - 4.0f * s_QuadraticAttenuation * c;
+		return (-s_LinearAttenuation + std::sqrt(discriminant)) / (2.0f * s_QuadraticAttenuation);
+	}
+}
+
+bool LightManager::Overlaps(const PointLight& light, const DirectX::BoundingBox& bounds) noexcept
+{
+	const DirectX::XMFLOAT3 min = { bounds.Center.x - bounds.Extents.x, bounds.Center.y - bounds.Extents.y, bounds.Center.z - bounds.Extents.z };
+	const DirectX::XMFLOAT3 max = { bounds.Center.x + bounds.Extents.x, bounds.Center.y + bounds.Extents.y, bounds.Center.z + bounds.Extents.z };
+	return DistanceSquared(light.Position, min, max) <= light.Radius * light.Radius;
+}
+
+void LightManager::Update(const std::vector<DirectX::BoundingBox>& objectBounds) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint32_t nrOfLights = static_cast<uint32_t>(m_Lights.size());
+	const uint32_t nrOfPaddedLights = (nrOfLights + 7u) & ~7u;
+	m_LightX.assign(nrOfPaddedLights, 0.0f);
+	m_LightY.assign(nrOfPaddedLights, 0.0f);
+	m_LightZ.assign(nrOfPaddedLights, 0.0f);
+	m_LightRadiusSquared.assign(nrOfPaddedLights, -1.0f);
+	for (uint32_t i{ 0u }; i < nrOfLights; ++i)
+	{
+		const PointLight& light = m_Lights[i];
+		m_LightX[i] = light.Position.x;
+		m_LightY[i] = light.Position.y;
+		m_LightZ[i] = light.Position.z;
+		m_LightRadiusSquared[i] = light.Radius * light.Radius;
+	}
+
+	const uint32_t nrOfObjects = static_cast<uint32_t>(objectBounds.size());
+	const uint32_t nrOfRanges = (nrOfObjects + s_GrainSize - 1u) / s_GrainSize;
+	m_Ranges.resize(nrOfObjects);
+	if (m_RangeIndices.size() < nrOfRanges)
+	{
+		m_RangeIndices.resize(nrOfRanges);
+	}
+
+	//Every range of objects collects its lists on its own, the counts go straight into the ranges.
+	ThreadPool::Get().ParallelFor(nrOfObjects, s_GrainSize, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<uint32_t>& indices = m_RangeIndices[begin / s_GrainSize];
+			uint32_t nrOfIndices = 0u;
+			for (uint32_t objectIndex{ begin }; objectIndex < end; ++objectIndex)
+			{
+				//Every block of lights writes all eight lanes, so there has to be room for every light of the object.
+				if (indices.size() < nrOfIndices + nrOfPaddedLights)
+				{
+					indices.resize(2u * (nrOfIndices + nrOfPaddedLights));
+				}
+
+				const DirectX::BoundingBox& bounds = objectBounds[objectIndex];
+				const __m256 minX = _mm256_set1_ps(bounds.Center.x - bounds.Extents.x);
+				const __m256 minY = _mm256_set1_ps(bounds.Center.y - bounds.Extents.y);
+				const __m256 minZ = _mm256_set1_ps(bounds.Center.z - bounds.Extents.z);
+				const __m256 maxX = _mm256_set1_ps(bounds.Center.x + bounds.Extents.x);
+				const __m256 maxY = _mm256_set1_ps(bounds.Center.y + bounds.Extents.y);
+				const __m256 maxZ = _mm256_set1_ps(bounds.Center.z + bounds.Extents.z);
+				const uint32_t first = nrOfIndices;
+				for (uint32_t block{ 0u }; block < nrOfPaddedLights; block += 8u)
+				{
+					//Distance from the light to the closest point of the box.
+					const __m256 x = _mm256_loadu_ps(&m_LightX[block]);
+					const __m256 y = _mm256_loadu_ps(&m_LightY[block]);
+					const __m256 z = _mm256_loadu_ps(&m_LightZ[block]);
+					const __m256 dx = _mm256_sub_ps(x, _mm256_min_ps(_mm256_max_ps(x, minX), maxX));
+					const __m256 dy = _mm256_sub_ps(y, _mm256_min_ps(_mm256_max_ps(y, minY), maxY));
+					const __m256 dz = _mm256_sub_ps(z, _mm256_min_ps(_mm256_max_ps(z, minZ), maxZ));
+					const __m256 distanceSquared = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+					const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, _mm256_loadu_ps(&m_LightRadiusSquared[block]), _CMP_LE_OQ)));
+
+					//The lights that reach the object are moved to the front and the rest of the lanes are overwritten by the next block.
+					const __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s_CompactTable.Lanes[mask]));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(&indices[nrOfIndices]), _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(block))));
+					nrOfIndices += static_cast<uint32_t>(_mm_popcnt_u32(mask));
+				}
+				m_Ranges[objectIndex].Count = nrOfIndices - first;
+			}
+		});
+
+	//Put the lists of the ranges after each other in object order.
+	uint32_t nrOfIndices = 0u;
+	for (uint32_t objectIndex{ 0u }; objectIndex < nrOfObjects; ++objectIndex)
+	{
+		m_Ranges[objectIndex].Offset = nrOfIndices;
+		nrOfIndices += m_Ranges[objectIndex].Count;
+	}
+	m_LightIndices.resize(nrOfIndices);
+	ThreadPool::Get().ParallelFor(nrOfObjects, s_GrainSize, [&](uint32_t begin, uint32_t end)
+		{
+			const std::vector<uint32_t>& indices = m_RangeIndices[begin / s_GrainSize];
+			const uint32_t offset = m_Ranges[begin].Offset;
+			const uint32_t count = m_Ranges[end - 1u].Offset + m_Ranges[end - 1u].Count - offset;
+			std::copy(indices.begin(), indices.begin() + count, m_LightIndices.begin() + offset);
+		});
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_UpdateTime = static_cast<double>(dif.count()) * 0.001;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "ThreadPool.h"
+
+//Matches PointLight in the pixel shader.
+struct PointLight
+{
+	DirectX::XMFLOAT3 Position;
+	//Distance at which the light's contribution falls below the manager's intensity cutoff.
+	float Radius;
+	DirectX::XMFLOAT3 Color;
+	float Padding;
+};
+static_assert(sizeof(PointLight) == 32u, "The lights are copied to the GPU as they are.");
+
+//The lights that reach an object, as a range of the manager's light indices.
+struct LightRange
+{
+	uint32_t Offset = 0u;
+	uint32_t Count = 0u;
+};
+
+//Owns the scene's point lights and finds the lights that reach every object.
+//Every light gets a radius beyond which its contribution is below the intensity cutoff. Every frame every object's bounds are tested against
+//the light spheres to build a compact list of the lights that reach the object, so that shading skips the rest.
+//The lights are tested eight at a time with AVX2 and the hits are written without branches, which beats a BVH over the lights for the large,
+//overlapping spheres that a low cutoff gives. The objects are split over the thread pool and the lists come out in object order,
+//every list sorted on the light index.
+class LightManager
+{
+public:
+	//The attenuation of the shaders, 1 / (1 + s_LinearAttenuation * d + s_QuadraticAttenuation * d^2).
+	static constexpr float s_LinearAttenuation = 0.0f;
+	static constexpr float s_QuadraticAttenuation = 0.0001f;
+	//The largest sum of the ambient, diffuse and specular factors of the pixel shader, the most a light can add before attenuation.
+	static constexpr float s_MaxResponse = 0.2f + 0.7f + 0.8f;
+	static constexpr uint32_t s_MaxNrOfLights = 4096u;
+	static constexpr uint32_t s_GrainSize = 256u;
+public:
+	LightManager() noexcept = default;
+	~LightManager() noexcept = default;
+
+	//Returns the index of the light, or UINT32_MAX if there already are s_MaxNrOfLights lights.
+	uint32_t AddLight(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& color) noexcept;
+	void SetLightPosition(uint32_t lightIndex, const DirectX::XMFLOAT3& position) noexcept { m_Lights[lightIndex].Position = position; }
+	void Clear() noexcept;
+	//Recomputes the radius of every light.
+	void SetIntensityCutoff(float intensityCutoff) noexcept;
+	//Builds the light lists of the objects, indexed the same way as the bounds.
+	void Update(const std::vector<DirectX::BoundingBox>& objectBounds) noexcept;
+
+	//Distance at which a light of the color contributes less than the cutoff.
+	[[nodiscard]] static float ComputeRadius(const DirectX::XMFLOAT3& color, float intensityCutoff) noexcept;
+	//Exact test of a light's sphere against a box.
+	[[nodiscard]] static bool Overlaps(const PointLight& light, const DirectX::BoundingBox& bounds) noexcept;
+
+	[[nodiscard]] const std::vector<PointLight>& GetLights() const noexcept { return m_Lights; }
+	[[nodiscard]] uint32_t GetNrOfLights() const noexcept { return static_cast<uint32_t>(m_Lights.size()); }
+	[[nodiscard]] const LightRange& GetLightRange(uint32_t objectIndex) const noexcept { return m_Ranges[objectIndex]; }
+	[[nodiscard]] const std::vector<LightRange>& GetLightRanges() const noexcept { return m_Ranges; }
+	[[nodiscard]] const std::vector<uint32_t>& GetLightIndices() const noexcept { return m_LightIndices; }
+	[[nodiscard]] constexpr float GetIntensityCutoff() const noexcept { return m_IntensityCutoff; }
+	//Time the last update took in milliseconds.
+	[[nodiscard]] constexpr double GetUpdateTime() const noexcept { return m_UpdateTime; }
+	//Average number of lights per object after the last update, against the number of lights every object was shaded with before.
+	[[nodiscard]] double GetAverageNrOfLights() const noexcept { return m_Ranges.empty() ? 0.0 : static_cast<double>(m_LightIndices.size()) / m_Ranges.size(); }
+private:
+	std::vector<PointLight> m_Lights = {};
+	float m_IntensityCutoff = 0.05f;
+
+	//The lights as structure of arrays, padded to a multiple of eight with lights that reach nothing.
+	std::vector<float> m_LightX = {};
+	std::vector<float> m_LightY = {};
+	std::vector<float> m_LightZ = {};
+	std::vector<float> m_LightRadiusSquared = {};
+
+	std::vector<LightRange> m_Ranges = {};
+	std::vector<uint32_t> m_LightIndices = {};
+	//The indices found by every range of objects, before they are put together. The vectors are larger than the number of indices found.
+	std::vector<std::vector<uint32_t>> m_RangeIndices = {};
+	double m_UpdateTime = 0.0;
+};
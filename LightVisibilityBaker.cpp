@@ -0,0 +1,377 @@
+#include "pch.h"
+#include "LightVisibilityBaker.h"
+
+namespace
+{
+	float RadicalInverse(uint32_t value) noexcept
+	{
+		value = (value << 16u) | (value >> 16u);
+		value = ((value & 0x55555555u) << 1u) | ((value & 0xAAAAAAAAu) >> 1u);
+		value = ((value & 0x33333333u) << 2u) | ((value & 0xCCCCCCCCu) >> 2u);
+		value = ((value & 0x0F0F0F0Fu) << 4u) | ((value & 0xF0F0F0F0u) >> 4u);
+		value = ((value & 0x00FF00FFu) << 8u) | ((value & 0xFF00FF00u) >> 8u);
+		return static_cast<float>(value) * 2.3283064365386963e-10f;
+	}
+
+	//Narrows [sMin, sMax] down to the s where a <= s * b.
+	bool Clip(float a, float b, float& sMin, float& sMax) noexcept
+	{
+		if (b > 0.0f)
+			sMin = std::max(sMin, a / b);
+		else if (b < 0.0f)
+			sMax = std::min(sMax, a / b);
+		else if (a > 0.0f)
+			return false;
+		return sMin <= sMax;
+	}
+}
+
+LightVisibilityBaker::LightVisibilityBaker(const LightVisibilitySettings& settings) noexcept
+	: m_Settings{ settings }
+{
+	DBG_ASSERT(m_Settings.NrOfSamples > 0u && m_Settings.NrOfSamples <= s_MaxNrOfSamples, "Error! The number of light visibility samples is out of range.");
+	m_Settings.NrOfSamples = std::clamp(m_Settings.NrOfSamples, 1u, s_MaxNrOfSamples);
+}
+
+void LightVisibilityBaker::Bake(uint32_t nrOfObjects, std::vector<ModelBVH::Triangle>&& triangles, const std::vector<PointLight>& lights) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//The BVH reorders the triangles, so the receivers keep their own copy sorted on the object.
+	m_ReceiverTriangles = triangles;
+	std::stable_sort(m_ReceiverTriangles.begin(), m_ReceiverTriangles.end(), [](const ModelBVH::Triangle& a, const ModelBVH::Triangle& b) noexcept { return a.MeshIndex < b.MeshIndex; });
+	m_Receivers.clear();
+	m_ObjectReceivers.assign(nrOfObjects, UINT32_MAX);
+	m_TriangleAreas.resize(m_ReceiverTriangles.size());
+	std::vector<DirectX::XMFLOAT3> minimums = {};
+	std::vector<DirectX::XMFLOAT3> maximums = {};
+	for (uint32_t triangleIndex{ 0u }; triangleIndex < m_ReceiverTriangles.size(); ++triangleIndex)
+	{
+		const ModelBVH::Triangle& triangle = m_ReceiverTriangles[triangleIndex];
+		DBG_ASSERT(triangle.MeshIndex < nrOfObjects, "Error! The triangle belongs to an object outside the object list.");
+		if (m_Receivers.empty() || m_Receivers.back().ObjectIndex != triangle.MeshIndex)
+		{
+			m_ObjectReceivers[triangle.MeshIndex] = static_cast<uint32_t>(m_Receivers.size());
+			m_Receivers.push_back({ triangle.MeshIndex, triangleIndex, 0u, 0.0f, {} });
+			minimums.push_back({ FLT_MAX, FLT_MAX, FLT_MAX });
+			maximums.push_back({ -FLT_MAX, -FLT_MAX, -FLT_MAX });
+		}
+		Receiver& receiver = m_Receivers.back();
+		const DirectX::XMVECTOR vertex0 = DirectX::XMLoadFloat3(&triangle.Vertex0);
+		const DirectX::XMVECTOR edge1 = DirectX::XMLoadFloat3(&triangle.Edge1);
+		const DirectX::XMVECTOR edge2 = DirectX::XMLoadFloat3(&triangle.Edge2);
+		receiver.Area += 0.5f * DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3Cross(edge1, edge2)));
+		m_TriangleAreas[triangleIndex] = receiver.Area;
+		receiver.NrOfTriangles++;
+
+		DirectX::XMVECTOR minimum = DirectX::XMLoadFloat3(&minimums.back());
+		DirectX::XMVECTOR maximum = DirectX::XMLoadFloat3(&maximums.back());
+		for (const DirectX::XMVECTOR& vertex : { vertex0, DirectX::XMVectorAdd(vertex0, edge1), DirectX::XMVectorAdd(vertex0, edge2) })
+		{
+			minimum = DirectX::XMVectorMin(minimum, vertex);
+			maximum = DirectX::XMVectorMax(maximum, vertex);
+		}
+		DirectX::XMStoreFloat3(&minimums.back(), minimum);
+		DirectX::XMStoreFloat3(&maximums.back(), maximum);
+	}
+	for (uint32_t receiverIndex{ 0u }; receiverIndex < m_Receivers.size(); ++receiverIndex)
+	{
+		DirectX::BoundingBox::CreateFromPoints(m_Receivers[receiverIndex].Bounds, DirectX::XMLoadFloat3(&minimums[receiverIndex]), DirectX::XMLoadFloat3(&maximums[receiverIndex]));
+	}
+	m_OccluderBVH.Build(std::move(triangles));
+
+	const uint32_t nrOfReceivers = static_cast<uint32_t>(m_Receivers.size());
+	m_NrOfLights = static_cast<uint32_t>(lights.size());
+	m_NrOfWordsPerRow = (m_NrOfLights + s_StatesPerWord - 1u) / s_StatesPerWord;
+	m_BakedLightPositions.resize(m_NrOfLights);
+	for (uint32_t lightIndex{ 0u }; lightIndex < m_NrOfLights; ++lightIndex)
+	{
+		m_BakedLightPositions[lightIndex] = lights[lightIndex].Position;
+	}
+	m_BakedStates.assign(static_cast<size_t>(nrOfReceivers) * m_NrOfLights, static_cast<uint8_t>(LightVisibility::Partial));
+
+	std::atomic<uint64_t> nrOfRays = 0u;
+	ThreadPool::Get().ParallelFor(nrOfReceivers, s_GrainSize, [&](uint32_t begin, uint32_t end)
+		{
+			uint64_t rangeRays = 0u;
+			for (uint32_t receiverIndex{ begin }; receiverIndex < end; ++receiverIndex)
+			{
+				const float* pTriangleAreas = &m_TriangleAreas[m_Receivers[receiverIndex].FirstTriangle];
+				for (uint32_t lightIndex{ 0u }; lightIndex < m_NrOfLights; ++lightIndex)
+				{
+					m_BakedStates[receiverIndex * m_NrOfLights + lightIndex] = static_cast<uint8_t>(BakePair(receiverIndex, lights[lightIndex].Position, pTriangleAreas, rangeRays));
+				}
+			}
+			nrOfRays += rangeRays;
+		});
+
+	m_NrOfBakedVisible = static_cast<uint32_t>(std::count(m_BakedStates.begin(), m_BakedStates.end(), static_cast<uint8_t>(LightVisibility::Visible)));
+	m_NrOfBakedOccluded = static_cast<uint32_t>(std::count(m_BakedStates.begin(), m_BakedStates.end(), static_cast<uint8_t>(LightVisibility::Occluded)));
+	m_NrOfBakedPartial = static_cast<uint32_t>(m_BakedStates.size()) - m_NrOfBakedVisible - m_NrOfBakedOccluded;
+	m_Masks.assign(static_cast<size_t>(nrOfReceivers) * m_NrOfWordsPerRow, 0u);
+	m_ReachedArea.assign(nrOfReceivers, 0.0);
+	m_EliminatedArea.assign(nrOfReceivers, 0.0);
+	m_DemotedCounts.assign(nrOfReceivers, 0u);
+	m_NrOfDemoted = 0u;
+	m_EliminatedFraction = 0.0;
+
+	m_NrOfRays = nrOfRays;
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BakeTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+LightVisibility LightVisibilityBaker::BakePair(uint32_t receiverIndex, const DirectX::XMFLOAT3& lightPosition, const float* pTriangleAreas, uint64_t& nrOfRays) const noexcept
+{
+	const Receiver& receiver = m_Receivers[receiverIndex];
+	const ModelBVH::Triangle* pTriangles = &m_ReceiverTriangles[receiver.FirstTriangle];
+	//The area samples are followed by one sample in the middle of every triangle, so that faces too small to get an area sample are seen too.
+	const uint32_t nrOfAreaSamples = m_Settings.NrOfSamples;
+	const uint32_t nrOfSamples = nrOfAreaSamples + receiver.NrOfTriangles;
+	uint32_t nrOfHits = 0u;
+	uint32_t triangleIndex = 0u;
+	RayPacket firstPacket;
+	for (uint32_t first{ 0u }; first < nrOfSamples; first += RayPacket::s_Size)
+	{
+		RayPacket packet;
+		packet.ActiveMask = 0u;
+		for (uint32_t lane{ 0u }; lane < RayPacket::s_Size; ++lane)
+		{
+			//Lanes past the last sample repeat it and stay inactive.
+			const uint32_t sampleIndex = std::min(first + lane, nrOfSamples - 1u);
+			float weight1 = 1.0f / 3.0f;
+			float weight2 = 1.0f / 3.0f;
+			if (sampleIndex < nrOfAreaSamples)
+			{
+				//Evenly spaced along the running sum of the areas picks the triangle, so every triangle gets samples in proportion to its area.
+				//What is left of the spacing and the radical inverse pick the point in the triangle.
+				const float area = (static_cast<float>(sampleIndex) + 0.5f) / nrOfAreaSamples * receiver.Area;
+				while (triangleIndex + 1u < receiver.NrOfTriangles && pTriangleAreas[triangleIndex] < area)
+				{
+					triangleIndex++;
+				}
+				const float lowerArea = triangleIndex == 0u ? 0.0f : pTriangleAreas[triangleIndex - 1u];
+				const float triangleArea = pTriangleAreas[triangleIndex] - lowerArea;
+				const float u = triangleArea > 0.0f ? std::clamp((area - lowerArea) / triangleArea, 0.0f, 1.0f) : 0.5f;
+				const float v = RadicalInverse(sampleIndex);
+				const float root = std::sqrt(u);
+				weight1 = root * (1.0f - v);
+				weight2 = root * v;
+			}
+			else
+			{
+				triangleIndex = sampleIndex - nrOfAreaSamples;
+			}
+
+			const ModelBVH::Triangle& triangle = pTriangles[triangleIndex];
+			const DirectX::XMFLOAT3 origin = {
+				triangle.Vertex0.x + weight1 * triangle.Edge1.x + weight2 * triangle.Edge2.x,
+				triangle.Vertex0.y + weight1 * triangle.Edge1.y + weight2 * triangle.Edge2.y,
+				triangle.Vertex0.z + weight1 * triangle.Edge1.z + weight2 * triangle.Edge2.z };
+			//The ray ends at the light, so the distances are fractions of the way there.
+			const DirectX::XMFLOAT3 direction = { lightPosition.x - origin.x, lightPosition.y - origin.y, lightPosition.z - origin.z };
+			const float length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+			packet.Set(lane, origin, direction, length > 0.0f ? m_Settings.MinDistance / length : 1.0f, 1.0f);
+			//A light closer than the minimum distance can not be blocked, the lane stays inactive and counts as unblocked.
+			if (first + lane < nrOfSamples && length > m_Settings.MinDistance)
+			{
+				packet.ActiveMask |= 1u << lane;
+			}
+		}
+		nrOfRays += static_cast<uint32_t>(_mm_popcnt_u32(packet.ActiveMask));
+		nrOfHits += static_cast<uint32_t>(_mm_popcnt_u32(m_OccluderBVH.IntersectAny(packet)));
+		if (first == 0u)
+		{
+			firstPacket = packet;
+		}
+
+		//Once the samples disagree the pair is partial whatever the rest of them say.
+		const uint32_t nrOfTaken = std::min(first + RayPacket::s_Size, nrOfSamples);
+		if (nrOfHits != 0u && nrOfHits != nrOfTaken)
+			return LightVisibility::Partial;
+	}
+	if (nrOfHits == nrOfSamples)
+	{
+		//Every sample was blocked, which only holds for the whole receiver when a single triangle shadows all of it.
+		//The candidates are the closest triangles the first samples hit. Several triangles of an object can share an index, one per mesh.
+		RayHit hits[RayPacket::s_Size];
+		const uint32_t hitMask = m_OccluderBVH.Intersect(firstPacket, hits);
+		for (uint32_t lane{ 0u }; lane < RayPacket::s_Size; ++lane)
+		{
+			if ((hitMask & (1u << lane)) == 0u || hits[lane].MeshIndex >= m_ObjectReceivers.size() || m_ObjectReceivers[hits[lane].MeshIndex] == UINT32_MAX)
+				continue;
+
+			const Receiver& occluder = m_Receivers[m_ObjectReceivers[hits[lane].MeshIndex]];
+			const ModelBVH::Triangle* pOccluderTriangles = &m_ReceiverTriangles[occluder.FirstTriangle];
+			for (uint32_t i{ 0u }; i < occluder.NrOfTriangles; ++i)
+			{
+				if (pOccluderTriangles[i].TriangleIndex == hits[lane].TriangleIndex && ShadowsBox(pOccluderTriangles[i], lightPosition, receiver.Bounds, m_Settings.MinDistance))
+					return LightVisibility::Occluded;
+			}
+		}
+		return LightVisibility::Partial;
+	}
+
+	//No sample was blocked, which only holds for the whole receiver when nothing else can cast a shadow on it.
+	//The other bounds are shrunk by the minimum distance, the slack the shadow rays have, so that objects that only touch the receiver
+	//like a wall standing on the floor do not count.
+	for (uint32_t otherIndex{ 0u }; otherIndex < m_Receivers.size(); ++otherIndex)
+	{
+		if (otherIndex == receiverIndex)
+			continue;
+		DirectX::BoundingBox bounds = m_Receivers[otherIndex].Bounds;
+		bounds.Extents = { std::max(bounds.Extents.x - m_Settings.MinDistance, 0.0f), std::max(bounds.Extents.y - m_Settings.MinDistance, 0.0f), std::max(bounds.Extents.z - m_Settings.MinDistance, 0.0f) };
+		if (OverlapsShadowVolume(receiver.Bounds, lightPosition, bounds))
+			return LightVisibility::Partial;
+	}
+	return LightVisibility::Visible;
+}
+
+void LightVisibilityBaker::Update(const std::vector<PointLight>& lights, const std::vector<DirectX::BoundingBox>& dynamicBounds) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint32_t nrOfReceivers = static_cast<uint32_t>(m_Receivers.size());
+	ThreadPool::Get().ParallelFor(nrOfReceivers, s_GrainSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t receiverIndex{ begin }; receiverIndex < end; ++receiverIndex)
+			{
+				const Receiver& receiver = m_Receivers[receiverIndex];
+				uint32_t* pRow = &m_Masks[receiverIndex * m_NrOfWordsPerRow];
+				std::fill(pRow, pRow + m_NrOfWordsPerRow, 0u);
+				double reachedArea = 0.0;
+				double eliminatedArea = 0.0;
+				uint32_t nrOfDemoted = 0u;
+				for (uint32_t lightIndex{ 0u }; lightIndex < m_NrOfLights && lightIndex < lights.size(); ++lightIndex)
+				{
+					const PointLight& light = lights[lightIndex];
+					const DirectX::XMFLOAT3& bakedPosition = m_BakedLightPositions[lightIndex];
+					LightVisibility visibility = GetBakedVisibility(receiverIndex, lightIndex);
+					if (light.Position.x != bakedPosition.x || light.Position.y != bakedPosition.y || light.Position.z != bakedPosition.z)
+					{
+						visibility = LightVisibility::Partial;
+					}
+					else if (visibility == LightVisibility::Visible)
+					{
+						for (const DirectX::BoundingBox& bounds : dynamicBounds)
+						{
+							if (OverlapsShadowVolume(receiver.Bounds, light.Position, bounds))
+							{
+								visibility = LightVisibility::Partial;
+								nrOfDemoted++;
+								break;
+							}
+						}
+					}
+					pRow[lightIndex / s_StatesPerWord] |= static_cast<uint32_t>(visibility) << ((lightIndex % s_StatesPerWord) * 2u);
+
+					//Lights out of reach are skipped by the shader anyway.
+					if (LightManager::Overlaps(light, receiver.Bounds))
+					{
+						reachedArea += receiver.Area;
+						eliminatedArea += visibility == LightVisibility::Partial ? 0.0 : receiver.Area;
+					}
+				}
+				m_ReachedArea[receiverIndex] = reachedArea;
+				m_EliminatedArea[receiverIndex] = eliminatedArea;
+				m_DemotedCounts[receiverIndex] = nrOfDemoted;
+			}
+		});
+
+	double reachedArea = 0.0;
+	double eliminatedArea = 0.0;
+	m_NrOfDemoted = 0u;
+	for (uint32_t receiverIndex{ 0u }; receiverIndex < nrOfReceivers; ++receiverIndex)
+	{
+		reachedArea += m_ReachedArea[receiverIndex];
+		eliminatedArea += m_EliminatedArea[receiverIndex];
+		m_NrOfDemoted += m_DemotedCounts[receiverIndex];
+	}
+	m_EliminatedFraction = reachedArea > 0.0 ? eliminatedArea / reachedArea : 0.0;
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_UpdateTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+bool LightVisibilityBaker::OverlapsShadowVolume(const DirectX::BoundingBox& receiver, const DirectX::XMFLOAT3& lightPosition, const DirectX::BoundingBox& bounds) noexcept
+{
+	//The hull is the union of the receiver's box shrunk towards the light, the box with center L + s * (C - L) and extents s * E for s in [0, 1].
+	//Along every axis the boxes overlap when |c - L - s * (C - L)| <= s * E + e, two linear bounds on s, so the test is exact.
+	const float lightCoordinates[3] = { lightPosition.x, lightPosition.y, lightPosition.z };
+	const float receiverCenter[3] = { receiver.Center.x, receiver.Center.y, receiver.Center.z };
+	const float receiverExtents[3] = { receiver.Extents.x, receiver.Extents.y, receiver.Extents.z };
+	const float boundsCenter[3] = { bounds.Center.x, bounds.Center.y, bounds.Center.z };
+	const float boundsExtents[3] = { bounds.Extents.x, bounds.Extents.y, bounds.Extents.z };
+	float sMin = 0.0f;
+	float sMax = 1.0f;
+	for (uint32_t axis{ 0u }; axis < 3u; ++axis)
+	{
+		const float offset = boundsCenter[axis] - lightCoordinates[axis];
+		const float toReceiver = receiverCenter[axis] - lightCoordinates[axis];
+		if (!Clip(offset - boundsExtents[axis], toReceiver + receiverExtents[axis], sMin, sMax) ||
+			!Clip(-offset - boundsExtents[axis], receiverExtents[axis] - toReceiver, sMin, sMax))
+			return false;
+	}
+	return true;
+}
+
+bool LightVisibilityBaker::ShadowsBox(const ModelBVH::Triangle& triangle, const DirectX::XMFLOAT3& lightPosition, const DirectX::BoundingBox& box, float minDistance) noexcept
+{
+	using namespace DirectX;
+	const XMVECTOR light = XMLoadFloat3(&lightPosition);
+	const XMVECTOR vertices[3] = {
+		XMLoadFloat3(&triangle.Vertex0),
+		XMVectorAdd(XMLoadFloat3(&triangle.Vertex0), XMLoadFloat3(&triangle.Edge1)),
+		XMVectorAdd(XMLoadFloat3(&triangle.Vertex0), XMLoadFloat3(&triangle.Edge2)) };
+	const XMVECTOR normal = XMVector3Cross(XMLoadFloat3(&triangle.Edge1), XMLoadFloat3(&triangle.Edge2));
+	const float normalLength = XMVectorGetX(XMVector3Length(normal));
+	const float lightSide = XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(light, vertices[0])));
+	if (normalLength <= 0.0f || std::abs(lightSide) <= 0.0f)
+		return false;
+
+	//The side planes of the pyramid go through the light and an edge, facing the third vertex.
+	XMVECTOR sideNormals[3] = {};
+	for (uint32_t edge{ 0u }; edge < 3u; ++edge)
+	{
+		const XMVECTOR& from = vertices[edge];
+		const XMVECTOR& to = vertices[(edge + 1u) % 3u];
+		const XMVECTOR& opposite = vertices[(edge + 2u) % 3u];
+		sideNormals[edge] = XMVector3Cross(XMVectorSubtract(from, light), XMVectorSubtract(to, light));
+		const float facing = XMVectorGetX(XMVector3Dot(sideNormals[edge], XMVectorSubtract(opposite, light)));
+		if (facing == 0.0f)
+			return false;
+		if (facing < 0.0f)
+			sideNormals[edge] = XMVectorNegate(sideNormals[edge]);
+	}
+
+	//The pyramid and the half space are convex, so the box is inside both when its corners are.
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+	for (const XMFLOAT3& cornerCoordinates : corners)
+	{
+		const XMVECTOR corner = XMLoadFloat3(&cornerCoordinates);
+		//On the other side of the plane than the light, far enough away that the hit is past the minimum distance of the ray.
+		const float side = XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(corner, vertices[0])));
+		if (side * lightSide >= 0.0f || std::abs(side) < minDistance * normalLength)
+			return false;
+		for (const XMVECTOR& sideNormal : sideNormals)
+		{
+			if (XMVectorGetX(XMVector3Dot(sideNormal, XMVectorSubtract(corner, light))) < 0.0f)
+				return false;
+		}
+	}
+	return true;
+}
+
+LightRange LightVisibilityBaker::GetVisibilityRange(uint32_t objectIndex) const noexcept
+{
+	const uint32_t receiverIndex = objectIndex < m_ObjectReceivers.size() ? m_ObjectReceivers[objectIndex] : UINT32_MAX;
+	if (receiverIndex == UINT32_MAX)
+		return {};
+	return { receiverIndex * m_NrOfWordsPerRow, m_NrOfLights };
+}
+
+LightVisibility LightVisibilityBaker::GetVisibility(uint32_t receiverIndex, uint32_t lightIndex) const noexcept
+{
+	const uint32_t word = m_Masks[receiverIndex * m_NrOfWordsPerRow + lightIndex / s_StatesPerWord];
+	return static_cast<LightVisibility>((word >> ((lightIndex % s_StatesPerWord) * 2u)) & 3u);
+}
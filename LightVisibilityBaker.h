@@ -0,0 +1,123 @@
+#pragma once
+#include "ModelBVH.h"
+#include "LightManager.h"
+
+//How the shadow ray of a pair of a static receiver and a light is resolved. Matches the two bit states of the pixel shader.
+enum class LightVisibility : uint8_t
+{
+	//The light is visible from part of the receiver, or the pair is unknown, so the shader traces the ray.
+	Partial = 0u,
+	Visible = 1u,
+	Occluded = 2u
+};
+
+struct LightVisibilitySettings
+{
+	//Rays per pair spread over the receiver's surface by area, on top of one ray from the middle of every triangle.
+	uint32_t NrOfSamples = 256u;
+	//Closest distance a hit can have, the same as the TMin of the shadow rays in the pixel shader.
+	float MinDistance = 0.1f;
+};
+
+//Bakes the visibility between the static objects and the lights, so that the pixel shader only traces shadow rays where the answer varies.
+//Every pair of a static receiver and a light is sampled with rays from points on the receiver's surface towards the light, through a BVH
+//over the world space triangles of all static objects. A pair where some rays are blocked and some are not is partial.
+//The samples are only as fine as their spacing, so neither answer is trusted from the samples alone. A pair where no ray is blocked is visible
+//only when no other static object's bounds reach into its shadow volume, the convex hull of the receiver's bounds and the light.
+//A pair where every ray is blocked is occluded only when one of the triangles the rays hit covers the whole receiver's bounds as seen from the light,
+//see ShadowsBox. Both are then exact, everything else is partial and traced.
+//The dynamic objects move through the shadow volumes, so every Update turns the visible pairs that have a dynamic object's bounds in their shadow
+//volume into partial ones. Occluded pairs stay occluded, the static occluder is still there. Lights that moved since the bake are partial.
+//The result is a row of two bit states per receiver, sixteen lights per word, read by the pixel shader with the object's visibility range.
+class LightVisibilityBaker
+{
+public:
+	static constexpr uint32_t s_StatesPerWord = 16u;
+	static constexpr uint32_t s_MaxNrOfSamples = 4096u;
+	static constexpr uint32_t s_GrainSize = 4u;
+public:
+	LightVisibilityBaker(const LightVisibilitySettings& settings = {}) noexcept;
+	~LightVisibilityBaker() noexcept = default;
+
+	//The triangles are the world space triangles of the static objects, with the object's index as mesh index, see Scene::GatherWorldTriangles.
+	//Every object with triangles becomes a receiver and every triangle an occluder.
+	void Bake(uint32_t nrOfObjects, std::vector<ModelBVH::Triangle>&& triangles, const std::vector<PointLight>& lights) noexcept;
+	//Rebuilds the states of the frame from the baked ones and the current bounds of the dynamic objects.
+	void Update(const std::vector<PointLight>& lights, const std::vector<DirectX::BoundingBox>& dynamicBounds) noexcept;
+
+	//Exact test of a box against the convex hull of a receiver's bounds and a light.
+	[[nodiscard]] static bool OverlapsShadowVolume(const DirectX::BoundingBox& receiver, const DirectX::XMFLOAT3& lightPosition, const DirectX::BoundingBox& bounds) noexcept;
+	//True when every segment from a point of the box to the light crosses the triangle at least minDistance from the point.
+	//That holds when every corner of the box lies in the triangle's shadow, the pyramid from the light through the triangle,
+	//on the far side of the triangle's plane and at least minDistance from it.
+	[[nodiscard]] static bool ShadowsBox(const ModelBVH::Triangle& triangle, const DirectX::XMFLOAT3& lightPosition, const DirectX::BoundingBox& box, float minDistance) noexcept;
+
+	//The object's row of states as the word offset in the masks and the number of lights in the row. Objects that are not receivers get an empty row.
+	[[nodiscard]] LightRange GetVisibilityRange(uint32_t objectIndex) const noexcept;
+	[[nodiscard]] LightVisibility GetBakedVisibility(uint32_t receiverIndex, uint32_t lightIndex) const noexcept { return static_cast<LightVisibility>(m_BakedStates[receiverIndex * m_NrOfLights + lightIndex]); }
+	[[nodiscard]] LightVisibility GetVisibility(uint32_t receiverIndex, uint32_t lightIndex) const noexcept;
+	[[nodiscard]] const std::vector<uint32_t>& GetMasks() const noexcept { return m_Masks; }
+	[[nodiscard]] uint32_t GetNrOfReceivers() const noexcept { return static_cast<uint32_t>(m_Receivers.size()); }
+	[[nodiscard]] uint32_t GetReceiverObjectIndex(uint32_t receiverIndex) const noexcept { return m_Receivers[receiverIndex].ObjectIndex; }
+	[[nodiscard]] const DirectX::BoundingBox& GetReceiverBounds(uint32_t receiverIndex) const noexcept { return m_Receivers[receiverIndex].Bounds; }
+	//The receiver's triangles, in world space.
+	[[nodiscard]] const ModelBVH::Triangle* GetReceiverTriangles(uint32_t receiverIndex) const noexcept { return &m_ReceiverTriangles[m_Receivers[receiverIndex].FirstTriangle]; }
+	[[nodiscard]] uint32_t GetNrOfReceiverTriangles(uint32_t receiverIndex) const noexcept { return m_Receivers[receiverIndex].NrOfTriangles; }
+	//The BVH over the static triangles that the samples are traced against.
+	[[nodiscard]] const ModelBVH& GetOccluderBVH() const noexcept { return m_OccluderBVH; }
+	[[nodiscard]] constexpr const LightVisibilitySettings& GetSettings() const noexcept { return m_Settings; }
+
+	//Number of pairs in every state after the bake.
+	[[nodiscard]] constexpr uint32_t GetNrOfBakedVisible() const noexcept { return m_NrOfBakedVisible; }
+	[[nodiscard]] constexpr uint32_t GetNrOfBakedOccluded() const noexcept { return m_NrOfBakedOccluded; }
+	[[nodiscard]] constexpr uint32_t GetNrOfBakedPartial() const noexcept { return m_NrOfBakedPartial; }
+	//Time the last bake took in milliseconds, including building the BVH.
+	[[nodiscard]] constexpr double GetBakeTime() const noexcept { return m_BakeTime; }
+	[[nodiscard]] constexpr uint64_t GetNrOfRays() const noexcept { return m_NrOfRays; }
+	//Visible pairs that a dynamic object turned partial during the last update.
+	[[nodiscard]] constexpr uint32_t GetNrOfDemoted() const noexcept { return m_NrOfDemoted; }
+	//Share of the static receivers' shadow rays that the shader skips after the last update. Every pair where the light reaches the receiver
+	//is weighed by the receiver's surface area, as an estimate of the pixels it covers.
+	[[nodiscard]] constexpr double GetEliminatedFraction() const noexcept { return m_EliminatedFraction; }
+	//Time the last update took in milliseconds.
+	[[nodiscard]] constexpr double GetUpdateTime() const noexcept { return m_UpdateTime; }
+private:
+	struct Receiver
+	{
+		uint32_t ObjectIndex = 0u;
+		uint32_t FirstTriangle = 0u;
+		uint32_t NrOfTriangles = 0u;
+		float Area = 0.0f;
+		DirectX::BoundingBox Bounds = {};
+	};
+
+	LightVisibility BakePair(uint32_t receiverIndex, const DirectX::XMFLOAT3& lightPosition, const float* pTriangleAreas, uint64_t& nrOfRays) const noexcept;
+private:
+	LightVisibilitySettings m_Settings = {};
+	ModelBVH m_OccluderBVH;
+	std::vector<Receiver> m_Receivers = {};
+	//The triangles of the receivers sorted on the receiver, and the running sum of their areas within every receiver.
+	std::vector<ModelBVH::Triangle> m_ReceiverTriangles = {};
+	std::vector<float> m_TriangleAreas = {};
+	//Receiver of every object, UINT32_MAX for objects that are not static.
+	std::vector<uint32_t> m_ObjectReceivers = {};
+
+	uint32_t m_NrOfLights = 0u;
+	uint32_t m_NrOfWordsPerRow = 0u;
+	std::vector<DirectX::XMFLOAT3> m_BakedLightPositions = {};
+	std::vector<uint8_t> m_BakedStates = {};
+	std::vector<uint32_t> m_Masks = {};
+	//Weighted pairs in reach and weighted pairs skipped, per receiver, summed after every update.
+	std::vector<double> m_ReachedArea = {};
+	std::vector<double> m_EliminatedArea = {};
+	std::vector<uint32_t> m_DemotedCounts = {};
+
+	uint32_t m_NrOfBakedVisible = 0u;
+	uint32_t m_NrOfBakedOccluded = 0u;
+	uint32_t m_NrOfBakedPartial = 0u;
+	uint32_t m_NrOfDemoted = 0u;
+	double m_EliminatedFraction = 0.0;
+	double m_BakeTime = 0.0;
+	double m_UpdateTime = 0.0;
+	uint64_t m_NrOfRays = 0u;
+};
@@ -0,0 +1,183 @@
+#include "pch.h"
+#include "LightVisibilityBenchmark.h"
+
+namespace
+{
+	//The two triangles of a rectangle as the next object, with the object's index as mesh index.
+	void AddQuad(std::vector<ModelBVH::Triangle>& triangles, std::vector<DirectX::BoundingBox>& objectBounds, const DirectX::XMFLOAT3& corner, const DirectX::XMFLOAT3& edge1, const DirectX::XMFLOAT3& edge2) noexcept
+	{
+		const uint32_t objectIndex = static_cast<uint32_t>(objectBounds.size());
+		const DirectX::XMFLOAT3 opposite = { corner.x + edge1.x + edge2.x, corner.y + edge1.y + edge2.y, corner.z + edge1.z + edge2.z };
+		DirectX::BoundingBox bounds;
+		DirectX::BoundingBox::CreateFromPoints(bounds, DirectX::XMVectorMin(DirectX::XMLoadFloat3(&corner), DirectX::XMLoadFloat3(&opposite)), DirectX::XMVectorMax(DirectX::XMLoadFloat3(&corner), DirectX::XMLoadFloat3(&opposite)));
+		objectBounds.push_back(bounds);
+		triangles.push_back({ corner, edge1, edge2, objectIndex, 0u });
+		triangles.push_back({ opposite, { -edge1.x, -edge1.y, -edge1.z }, { -edge2.x, -edge2.y, -edge2.z }, objectIndex, 1u });
+	}
+
+	//The twelve triangles of a box as the next object, with the object's index as mesh index.
+	void AddBox(std::vector<ModelBVH::Triangle>& triangles, std::vector<DirectX::BoundingBox>& objectBounds, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents) noexcept
+	{
+		const uint32_t objectIndex = static_cast<uint32_t>(objectBounds.size());
+		objectBounds.push_back(DirectX::BoundingBox(center, extents));
+		const float extentValues[3] = { extents.x, extents.y, extents.z };
+		const float centerValues[3] = { center.x, center.y, center.z };
+		for (uint32_t axis{ 0u }; axis < 3u; ++axis)
+		{
+			const uint32_t axisU = (axis + 1u) % 3u;
+			const uint32_t axisV = (axis + 2u) % 3u;
+			for (float side : { -1.0f, 1.0f })
+			{
+				float corner[3] = { centerValues[0], centerValues[1], centerValues[2] };
+				corner[axis] += side * extentValues[axis];
+				corner[axisU] -= extentValues[axisU];
+				corner[axisV] -= extentValues[axisV];
+				float edgeU[3] = { 0.0f, 0.0f, 0.0f };
+				float edgeV[3] = { 0.0f, 0.0f, 0.0f };
+				edgeU[axisU] = 2.0f * extentValues[axisU];
+				edgeV[axisV] = 2.0f * extentValues[axisV];
+				const DirectX::XMFLOAT3 vertex0 = { corner[0], corner[1], corner[2] };
+				const DirectX::XMFLOAT3 opposite = { corner[0] + edgeU[0] + edgeV[0], corner[1] + edgeU[1] + edgeV[1], corner[2] + edgeU[2] + edgeV[2] };
+				const uint32_t first = static_cast<uint32_t>(triangles.size());
+				triangles.push_back({ vertex0, { edgeU[0], edgeU[1], edgeU[2] }, { edgeV[0], edgeV[1], edgeV[2] }, objectIndex, first });
+				triangles.push_back({ opposite, { -edgeU[0], -edgeU[1], -edgeU[2] }, { -edgeV[0], -edgeV[1], -edgeV[2] }, objectIndex, first + 1u });
+			}
+		}
+	}
+}
+
+void LightVisibilityBenchmark::Run() noexcept
+{
+	m_Results.clear();
+
+	//A floor and four walls made of rectangles like the room of the scene, and a grid of pillars, all static.
+	const float half = 0.5f * s_RoomSize;
+	m_Triangles.clear();
+	m_StaticBounds.clear();
+	AddQuad(m_Triangles, m_StaticBounds, { -half, 0.0f, -half }, { s_RoomSize, 0.0f, 0.0f }, { 0.0f, 0.0f, s_RoomSize });
+	AddQuad(m_Triangles, m_StaticBounds, { -half, 0.0f, -half }, { 0.0f, s_RoomSize, 0.0f }, { 0.0f, 0.0f, s_RoomSize });
+	AddQuad(m_Triangles, m_StaticBounds, { half, 0.0f, -half }, { 0.0f, s_RoomSize, 0.0f }, { 0.0f, 0.0f, s_RoomSize });
+	AddQuad(m_Triangles, m_StaticBounds, { -half, 0.0f, -half }, { s_RoomSize, 0.0f, 0.0f }, { 0.0f, s_RoomSize, 0.0f });
+	AddQuad(m_Triangles, m_StaticBounds, { -half, 0.0f, half }, { s_RoomSize, 0.0f, 0.0f }, { 0.0f, s_RoomSize, 0.0f });
+	const float spacing = s_RoomSize / s_NrOfPillarsPerSide;
+	for (uint32_t z{ 0u }; z < s_NrOfPillarsPerSide; ++z)
+	{
+		for (uint32_t x{ 0u }; x < s_NrOfPillarsPerSide; ++x)
+		{
+			const float height = 0.25f * s_RoomSize * (1.0f + static_cast<float>((x + 2u * z) % 3u));
+			AddBox(m_Triangles, m_StaticBounds, { -half + (x + 0.5f) * spacing, 0.5f * height, -half + (z + 0.5f) * spacing }, { 2.0f, 0.5f * height, 2.0f });
+		}
+	}
+
+	//Lights anywhere in the room and some outside of it, but not inside a pillar, and small boxes moving through the room.
+	std::default_random_engine generator(1u);
+	std::uniform_real_distribution<float> distributionPos(-0.6f * s_RoomSize, 0.6f * s_RoomSize);
+	std::uniform_real_distribution<float> distributionHeight(0.0f, 1.2f * s_RoomSize);
+	std::uniform_real_distribution<float> distributionColor(0.05f, 1.0f);
+	m_Lights.resize(s_NrOfLights);
+	for (PointLight& light : m_Lights)
+	{
+		light = {};
+		do
+		{
+			light.Position = { distributionPos(generator), distributionHeight(generator), distributionPos(generator) };
+		} while (std::any_of(m_StaticBounds.begin(), m_StaticBounds.end(), [&](const DirectX::BoundingBox& bounds) noexcept { return bounds.Contains(DirectX::XMLoadFloat3(&light.Position)) != DirectX::DISJOINT; }));
+		light.Color = { distributionColor(generator), distributionColor(generator), distributionColor(generator) };
+		light.Radius = LightManager::ComputeRadius(light.Color, 0.05f);
+	}
+	m_DynamicBounds.resize(s_NrOfDynamicObjects);
+	for (DirectX::BoundingBox& bounds : m_DynamicBounds)
+	{
+		bounds.Center = { 0.8f * distributionPos(generator), 0.8f * distributionHeight(generator), 0.8f * distributionPos(generator) };
+		bounds.Extents = { 3.0f, 3.0f, 3.0f };
+	}
+
+	for (uint32_t size{ 0u }; size < s_NrOfSizes; ++size)
+	{
+		LightVisibilitySettings settings = {};
+		settings.NrOfSamples = s_NrOfSamples[size];
+		LightVisibilityBaker baker(settings);
+		std::vector<ModelBVH::Triangle> triangles = m_Triangles;
+		baker.Bake(static_cast<uint32_t>(m_StaticBounds.size()), std::move(triangles), m_Lights);
+
+		LightVisibilityBenchmarkResult result;
+		result.NrOfSamples = s_NrOfSamples[size];
+		result.BakeTime = baker.GetBakeTime();
+		result.NrOfRays = baker.GetNrOfRays();
+		result.NrOfVisible = baker.GetNrOfBakedVisible();
+		result.NrOfOccluded = baker.GetNrOfBakedOccluded();
+		result.NrOfPartial = baker.GetNrOfBakedPartial();
+		baker.Update(m_Lights, {});
+		result.EliminatedFraction = baker.GetEliminatedFraction();
+		baker.Update(m_Lights, m_DynamicBounds);
+		result.EliminatedFractionDynamic = baker.GetEliminatedFraction();
+		result.NrOfWrongPairs = CountWrongPairs(baker);
+		m_Results.push_back(result);
+	}
+}
+
+uint32_t LightVisibilityBenchmark::CountWrongPairs(const LightVisibilityBaker& baker) const noexcept
+{
+	const float minDistance = baker.GetSettings().MinDistance;
+	std::default_random_engine generator(2u);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	uint32_t nrOfWrongPairs = 0u;
+	for (uint32_t receiverIndex{ 0u }; receiverIndex < baker.GetNrOfReceivers(); ++receiverIndex)
+	{
+		const ModelBVH::Triangle* pTriangles = baker.GetReceiverTriangles(receiverIndex);
+		const uint32_t nrOfTriangles = baker.GetNrOfReceiverTriangles(receiverIndex);
+		//Twice the area of every triangle, and the height over the edge across from every vertex, which a barycentric weight scales.
+		std::vector<float> areas(nrOfTriangles);
+		std::vector<float> heights(3u * nrOfTriangles);
+		for (uint32_t i{ 0u }; i < nrOfTriangles; ++i)
+		{
+			const DirectX::XMVECTOR edge1 = DirectX::XMLoadFloat3(&pTriangles[i].Edge1);
+			const DirectX::XMVECTOR edge2 = DirectX::XMLoadFloat3(&pTriangles[i].Edge2);
+			areas[i] = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3Cross(edge1, edge2)));
+			heights[3u * i] = areas[i] / std::max(DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(edge2, edge1))), FLT_MIN);
+			heights[3u * i + 1u] = areas[i] / std::max(DirectX::XMVectorGetX(DirectX::XMVector3Length(edge2)), FLT_MIN);
+			heights[3u * i + 2u] = areas[i] / std::max(DirectX::XMVectorGetX(DirectX::XMVector3Length(edge1)), FLT_MIN);
+		}
+		std::discrete_distribution<uint32_t> distributionTriangle(areas.begin(), areas.end());
+
+		for (uint32_t lightIndex{ 0u }; lightIndex < m_Lights.size(); ++lightIndex)
+		{
+			const LightVisibility visibility = baker.GetBakedVisibility(receiverIndex, lightIndex);
+			if (visibility == LightVisibility::Partial)
+				continue;
+
+			//Independent random points, with the same ray setup as the bake. The rim of every triangle as wide as the minimum distance is left out,
+			//the rays from there skip whatever touches the triangle, so the answer there depends on the slack rather than the bake.
+			const DirectX::XMFLOAT3& lightPosition = m_Lights[lightIndex].Position;
+			bool wrong = false;
+			for (uint32_t sample{ 0u }; sample < s_NrOfReferenceSamples && !wrong; ++sample)
+			{
+				const uint32_t triangleIndex = distributionTriangle(generator);
+				const ModelBVH::Triangle& triangle = pTriangles[triangleIndex];
+				float weight1 = 0.0f;
+				float weight2 = 0.0f;
+				bool onRim = true;
+				for (uint32_t attempt{ 0u }; attempt < 16u && onRim; ++attempt)
+				{
+					const float root = std::sqrt(distribution(generator));
+					const float v = distribution(generator);
+					weight1 = root * (1.0f - v);
+					weight2 = root * v;
+					onRim = std::min(std::min((1.0f - weight1 - weight2) * heights[3u * triangleIndex], weight1 * heights[3u * triangleIndex + 1u]), weight2 * heights[3u * triangleIndex + 2u]) < minDistance;
+				}
+				if (onRim)
+					continue;
+				const DirectX::XMFLOAT3 origin = {
+					triangle.Vertex0.x + weight1 * triangle.Edge1.x + weight2 * triangle.Edge2.x,
+					triangle.Vertex0.y + weight1 * triangle.Edge1.y + weight2 * triangle.Edge2.y,
+					triangle.Vertex0.z + weight1 * triangle.Edge1.z + weight2 * triangle.Edge2.z };
+				const DirectX::XMFLOAT3 direction = { lightPosition.x - origin.x, lightPosition.y - origin.y, lightPosition.z - origin.z };
+				const float length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+				const bool blocked = length > minDistance && baker.GetOccluderBVH().IntersectAny(origin, direction, minDistance / length, 1.0f);
+				wrong = blocked != (visibility == LightVisibility::Occluded);
+			}
+			nrOfWrongPairs += wrong ? 1u : 0u;
+		}
+	}
+	return nrOfWrongPairs;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "LightVisibilityBaker.h"
+
+struct LightVisibilityBenchmarkResult
+{
+	uint32_t NrOfSamples = 0u;
+	//In milliseconds.
+	double BakeTime = 0.0;
+	uint64_t NrOfRays = 0u;
+	uint32_t NrOfVisible = 0u;
+	uint32_t NrOfOccluded = 0u;
+	uint32_t NrOfPartial = 0u;
+	//Share of the shadow rays of the receivers that are skipped, without and with the dynamic boxes moving through the room.
+	double EliminatedFraction = 0.0;
+	double EliminatedFractionDynamic = 0.0;
+	//Visible or occluded pairs where one of the reference samples disagrees.
+	uint32_t NrOfWrongPairs = 0u;
+};
+
+//Bakes the light visibility of a generated room with pillars and random lights, against the number of samples per pair.
+//Every pair that comes out visible or occluded is checked with many more random samples, which is what the baked state has to hold for.
+//The room is the same on every run so that the results can be compared.
+class LightVisibilityBenchmark
+{
+public:
+	static constexpr uint32_t s_NrOfSizes = 3u;
+	static constexpr uint32_t s_NrOfSamples[s_NrOfSizes] = { 16u, 64u, 256u };
+	static constexpr uint32_t s_NrOfReferenceSamples = 4096u;
+	static constexpr uint32_t s_NrOfLights = 32u;
+	//Pillars along every side of the floor.
+	static constexpr uint32_t s_NrOfPillarsPerSide = 3u;
+	static constexpr uint32_t s_NrOfDynamicObjects = 16u;
+	//Side and height of the room.
+	static constexpr float s_RoomSize = 200.0f;
+public:
+	LightVisibilityBenchmark() noexcept = default;
+	~LightVisibilityBenchmark() noexcept = default;
+
+	void Run() noexcept;
+
+	[[nodiscard]] const std::vector<LightVisibilityBenchmarkResult>& GetResults() const noexcept { return m_Results; }
+private:
+	uint32_t CountWrongPairs(const LightVisibilityBaker& baker) const noexcept;
+private:
+	std::vector<LightVisibilityBenchmarkResult> m_Results = {};
+	std::vector<ModelBVH::Triangle> m_Triangles = {};
+	std::vector<DirectX::BoundingBox> m_StaticBounds = {};
+	std::vector<PointLight> m_Lights = {};
+	std::vector<DirectX::BoundingBox> m_DynamicBounds = {};
+};
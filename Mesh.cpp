@@ -5,6 +5,7 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices) noexcept
 {
 	m_VertexCount = static_cast<uint32_t>(vertices.size());
 	m_IndexCount = static_cast<uint32_t>(indices.size());
+	CalculateBounds(vertices);
 
 	D3D12_HEAP_PROPERTIES heapProperties = {};
 	heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
@@ -79,4 +80,192 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices) noexcept
 
 	HR(pCommandAllocator->Reset());
 	HR(pCommandList->Reset(pCommandAllocator.Get(), nullptr));
+
+	//Keep the data on the CPU for the ray queries that run there.
+	m_Vertices = std::move(vertices);
+	m_Indices = std::move(indices);
+}
+
+void Mesh::SetAmbientOcclusion(const std::vector<std::unique_ptr<Mesh>>& meshes, std::vector<std::vector<uint8_t>> occlusion) noexcept
+{
+	DBG_ASSERT(occlusion.size() == meshes.size(), "Error! The ambient occlusion has to have one bake per mesh.");
+
+	auto pUploadBuffer = DXCore::GetUploadBuffer();
+	auto pCommandAllocator = DXCore::GetCommandAllocators()[0];
+	auto pCommandList = DXCore::GetCommandList();
+	const uint64_t uploadSize = pUploadBuffer->GetDesc().Width;
+
+	//Executes the copies recorded so far and waits for them, after which the upload buffer can be written again.
+	auto submit = [&]()
+	{
+		HR(pCommandList->Close());
+		ID3D12CommandList* commandLists[] = { pCommandList.Get() };
+		STDCALL(DXCore::GetCommandQueue()->ExecuteCommandLists(ARRAYSIZE(commandLists), commandLists));
+		RenderCommand::Flush();
+
+		HR(pCommandAllocator->Reset());
+		HR(pCommandList->Reset(pCommandAllocator.Get(), nullptr));
+	};
+
+	D3D12_RANGE nullRange = { 0,0 };
+	unsigned char* mappedPtr = nullptr;
+	HR(pUploadBuffer->Map(0u, &nullRange, reinterpret_cast<void**>(&mappedPtr)));
+	uint64_t uploadOffset = 0u;
+	for (uint32_t i{ 0u }; i < meshes.size(); ++i)
+	{
+		//Only when the meshes do not fit in the upload buffer together is it waited for more than once.
+		const uint64_t size = (occlusion[i].size() + 3u) & ~static_cast<uint64_t>(3u);
+		if (uploadOffset + size > uploadSize && uploadOffset > 0u)
+		{
+			submit();
+			uploadOffset = 0u;
+		}
+		uploadOffset += meshes[i]->RecordAmbientOcclusionUpload(std::move(occlusion[i]), mappedPtr, uploadOffset);
+	}
+	STDCALL(pUploadBuffer->Unmap(0u, nullptr));
+	mappedPtr = nullptr;
+
+	submit();
+}
+
+uint64_t Mesh::RecordAmbientOcclusionUpload(std::vector<uint8_t> occlusion, unsigned char* pMappedUpload, uint64_t uploadOffset) noexcept
+{
+	DBG_ASSERT(occlusion.size() == m_VertexCount, "Error! The ambient occlusion has to have one value per vertex.");
+	m_AmbientOcclusion = std::move(occlusion);
+
+	D3D12_HEAP_PROPERTIES heapProperties = {};
+	heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+	heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProperties.CreationNodeMask = 0u;
+	heapProperties.VisibleNodeMask = 0u;
+
+	//The shader reads it as a ByteAddressBuffer, four values at a time, so the size is rounded up to whole 32 bit words.
+	D3D12_RESOURCE_DESC resourceDescriptor = {};
+	resourceDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	resourceDescriptor.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	resourceDescriptor.Width = (m_AmbientOcclusion.size() + 3u) & ~static_cast<size_t>(3u);
+	resourceDescriptor.Height = 1u;
+	resourceDescriptor.DepthOrArraySize = 1u;
+	resourceDescriptor.MipLevels = 1u;
+	resourceDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+	resourceDescriptor.SampleDesc = { 1u, 0u };
+	resourceDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	resourceDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	HR(DXCore::GetDevice()->CreateCommittedResource(
+		&heapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDescriptor,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&m_pAmbientOcclusionBuffer)
+	));
+
+	std::memcpy(pMappedUpload + uploadOffset, m_AmbientOcclusion.data(), m_AmbientOcclusion.size());
+	std::memset(pMappedUpload + uploadOffset + m_AmbientOcclusion.size(), 255, resourceDescriptor.Width - m_AmbientOcclusion.size());
+	STDCALL(DXCore::GetCommandList()->CopyBufferRegion(m_pAmbientOcclusionBuffer.Get(), 0u, DXCore::GetUploadBuffer().Get(), uploadOffset, resourceDescriptor.Width));
+
+	m_pAmbientOcclusionBuffer->SetName(L"Ambient Occlusion Buffer");
+	RenderCommand::TransitionResource(m_pAmbientOcclusionBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	return resourceDescriptor.Width;
 }
+
+void Mesh::CalculateBounds(const std::vector<Vertex>& vertices) noexcept
+{
+	//A mesh without vertices gets empty bounds at the origin, which the model leaves out of its own.
+	if (vertices.empty())
+	{
+		m_BoundingBox = DirectX::BoundingBox({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f });
+		m_BoundingSphere = DirectX::BoundingSphere({ 0.0f, 0.0f, 0.0f }, 0.0f);
+		return;
+	}
+	//The position is loaded as a float4, the w component reads into the normal which is ignored.
+	static_assert(offsetof(Vertex, normal) == sizeof(DirectX::XMFLOAT3), "The vertex position has to be followed by more data.");
+	auto LoadPosition = [&vertices](size_t index) {
+		return DirectX::XMLoadFloat4(reinterpret_cast<const DirectX::XMFLOAT4*>(&vertices[index].pos));
+	};
+
+	//Min/max reduction with four independent accumulators to hide the latency of the min & max instructions.
+	DirectX::XMVECTOR minimum[4];
+	DirectX::XMVECTOR maximum[4];
+	for (uint32_t i{ 0u }; i < 4u; ++i)
+	{
+		minimum[i] = LoadPosition(0u);
+		maximum[i] = minimum[i];
+	}
+	const size_t vertexCount = vertices.size();
+	size_t index = 0u;
+	for (; index + 4u <= vertexCount; index += 4u)
+	{
+		for (uint32_t i{ 0u }; i < 4u; ++i)
+		{
+			DirectX::XMVECTOR position = LoadPosition(index + i);
+			minimum[i] = DirectX::XMVectorMin(minimum[i], position);
+			maximum[i] = DirectX::XMVectorMax(maximum[i], position);
+		}
+	}
+	for (; index < vertexCount; ++index)
+	{
+		DirectX::XMVECTOR position = LoadPosition(index);
+		minimum[0] = DirectX::XMVectorMin(minimum[0], position);
+		maximum[0] = DirectX::XMVectorMax(maximum[0], position);
+	}
+	DirectX::XMVECTOR boxMin = DirectX::XMVectorMin(DirectX::XMVectorMin(minimum[0], minimum[1]), DirectX::XMVectorMin(minimum[2], minimum[3]));
+	DirectX::XMVECTOR boxMax = DirectX::XMVectorMax(DirectX::XMVectorMax(maximum[0], maximum[1]), DirectX::XMVectorMax(maximum[2], maximum[3]));
+	DirectX::BoundingBox::CreateFromPoints(m_BoundingBox, boxMin, boxMax);
+
+	//Sphere centered on the box, its radius is the distance to the vertex furthest away.
+	DirectX::XMVECTOR boxCenter = DirectX::XMLoadFloat3(&m_BoundingBox.Center);
+	DirectX::XMVECTOR maxDistanceSq = DirectX::XMVectorZero();
+	for (size_t i{ 0u }; i < vertexCount; ++i)
+	{
+		DirectX::XMVECTOR toVertex = DirectX::XMVectorSubtract(LoadPosition(i), boxCenter);
+		maxDistanceSq = DirectX::XMVectorMax(maxDistanceSq, DirectX::XMVector3LengthSq(toVertex));
+	}
+	float boxSphereRadius = std::sqrt(DirectX::XMVectorGetX(maxDistanceSq));
+
+	//Ritter's sphere: start from two points far apart and grow the sphere to include every vertex outside it.
+	auto FindFurthest = [&](DirectX::XMVECTOR from) {
+		size_t furthest = 0u;
+		float furthestDistanceSq = -1.0f;
+		for (size_t i{ 0u }; i < vertexCount; ++i)
+		{
+			float distanceSq = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(LoadPosition(i), from)));
+			if (distanceSq > furthestDistanceSq)
+			{
+				furthestDistanceSq = distanceSq;
+				furthest = i;
+			}
+		}
+		return LoadPosition(furthest);
+	};
+	DirectX::XMVECTOR pointA = FindFurthest(LoadPosition(0u));
+	DirectX::XMVECTOR pointB = FindFurthest(pointA);
+	DirectX::XMVECTOR ritterCenter = DirectX::XMVectorScale(DirectX::XMVectorAdd(pointA, pointB), 0.5f);
+	float ritterRadius = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(pointB, pointA))) * 0.5f;
+	for (size_t i{ 0u }; i < vertexCount; ++i)
+	{
+		DirectX::XMVECTOR toVertex = DirectX::XMVectorSubtract(LoadPosition(i), ritterCenter);
+		float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(toVertex));
+		if (distance > ritterRadius)
+		{
+			//Move the center towards the vertex so that the new sphere touches both the vertex and the old sphere's far side.
+			float newRadius = (ritterRadius + distance) * 0.5f;
+			ritterCenter = DirectX::XMVectorAdd(ritterCenter, DirectX::XMVectorScale(toVertex, (newRadius - ritterRadius) / distance));
+			ritterRadius = newRadius;
+		}
+	}
+
+	//Keep whichever of the two spheres is the tightest.
+	if (ritterRadius < boxSphereRadius)
+	{
+		DirectX::XMStoreFloat3(&m_BoundingSphere.Center, ritterCenter);
+		m_BoundingSphere.Radius = ritterRadius;
+	}
+	else
+	{
+		m_BoundingSphere.Center = m_BoundingBox.Center;
+		m_BoundingSphere.Radius = boxSphereRadius;
+	}
+}
\ No newline at end of file
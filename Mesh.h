@@ -19,13 +19,40 @@ public:
 		DBG_ASSERT(m_pVertexBuffer, "Error! Trying to get an index buffer's GPU address while it has not been set.");
 		return m_pIndexBuffer->GetGPUVirtualAddress();
 	}
+	const D3D12_GPU_VIRTUAL_ADDRESS GetAmbientOcclusionBufferGPUAddress() const noexcept {
+		DBG_ASSERT(m_pAmbientOcclusionBuffer, "Error! Trying to get an ambient occlusion buffer's GPU address while it has not been baked.");
+		return m_pAmbientOcclusionBuffer->GetGPUVirtualAddress();
+	}
 	const uint32_t GetVertexCount() const noexcept { return m_VertexCount; }
 	const uint32_t GetIndexCount() const noexcept { return m_IndexCount; }
+	const DirectX::BoundingBox& GetBoundingBox() const noexcept { return m_BoundingBox; }
+	const DirectX::BoundingSphere& GetBoundingSphere() const noexcept { return m_BoundingSphere; }
+	//CPU copies of the data in the vertex & index buffers.
+	[[nodiscard]] const std::vector<Vertex>& GetVertices() const noexcept { return m_Vertices; }
+	[[nodiscard]] const std::vector<uint32_t>& GetIndices() const noexcept { return m_Indices; }
+	//One byte per vertex, 255 is fully open. Read by the vertex shader as a stream next to the vertices.
+	[[nodiscard]] const std::vector<uint8_t>& GetAmbientOcclusion() const noexcept { return m_AmbientOcclusion; }
+
+	//Uploads the baked ambient occlusion of the vertices of every mesh, see AOBaker. One bake per mesh, in the same order.
+	//The copies of all meshes are recorded on one command list and waited for once.
+	static void SetAmbientOcclusion(const std::vector<std::unique_ptr<Mesh>>& meshes, std::vector<std::vector<uint8_t>> occlusion) noexcept;
 
+private:
+	void CalculateBounds(const std::vector<Vertex>& vertices) noexcept;
+	//Creates the buffer and records its copy from the mapped upload buffer at the offset. Returns the number of bytes it used there.
+	uint64_t RecordAmbientOcclusionUpload(std::vector<uint8_t> occlusion, unsigned char* pMappedUpload, uint64_t uploadOffset) noexcept;
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_pVertexBuffer = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_pIndexBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pAmbientOcclusionBuffer = nullptr;
 
 	uint32_t m_VertexCount = 0u;
 	uint32_t m_IndexCount = 0u;
+	std::vector<Vertex> m_Vertices = {};
+	std::vector<uint32_t> m_Indices = {};
+	std::vector<uint8_t> m_AmbientOcclusion = {};
+
+	//Local space bounds of the vertices.
+	DirectX::BoundingBox m_BoundingBox = {};
+	DirectX::BoundingSphere m_BoundingSphere = {};
 };
\ No newline at end of file
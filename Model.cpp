@@ -16,6 +16,9 @@ void Model::Initialize(const std::string path) noexcept
 	{
 		LoadModel();
 	}
+	CalculateBounds();
+	m_BVH.Build(m_Meshes);
+	BakeAmbientOcclusion();
 }
 
 void Model::LoadTri() noexcept
@@ -87,6 +90,13 @@ void Model::LoadRec() noexcept
 	indices.push_back(2u);
 	indices.push_back(3u);
 
+	//The rec is already as simple as it gets, so it is its own occluder.
+	for (const Vertex& vertex : vertices)
+	{
+		m_OccluderPositions.push_back(vertex.pos);
+	}
+	m_OccluderIndices = indices;
+
 	m_Meshes.push_back(std::make_unique<Mesh>(vertices, indices));
 }
 
@@ -160,4 +170,54 @@ void Model::ProcessMesh(aiMesh* mesh)
 		}
 	}
 	m_Meshes.push_back(std::make_unique<Mesh>(vertices, indices));
+}
+
+void Model::CalculateBounds() noexcept
+{
+	DBG_ASSERT(!m_Meshes.empty(), "Error! Trying to calculate the bounds of a model without meshes.");
+	//Meshes without vertices have no bounds to merge, a model with only those gets the same empty bounds as they have.
+	bool hasBounds = false;
+	m_BoundingBox = DirectX::BoundingBox({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f });
+	m_BoundingSphere = DirectX::BoundingSphere({ 0.0f, 0.0f, 0.0f }, 0.0f);
+	for (const std::unique_ptr<Mesh>& pMesh : m_Meshes)
+	{
+		if (pMesh->GetVertices().empty())
+			continue;
+
+		if (!hasBounds)
+		{
+			m_BoundingBox = pMesh->GetBoundingBox();
+			m_BoundingSphere = pMesh->GetBoundingSphere();
+			hasBounds = true;
+			continue;
+		}
+		DirectX::BoundingBox::CreateMerged(m_BoundingBox, m_BoundingBox, pMesh->GetBoundingBox());
+		DirectX::BoundingSphere::CreateMerged(m_BoundingSphere, m_BoundingSphere, pMesh->GetBoundingSphere());
+	}
+}
+
+void Model::BakeAmbientOcclusion() noexcept
+{
+	//The bake only depends on the geometry and the settings, so models loaded from file cache it next to the file.
+	AOBaker baker;
+	const bool isFile = m_Name != "Tri" && m_Name != "Rec";
+	const std::string cachePath = m_Name + ".ao";
+	const uint64_t hash = baker.Hash(m_Meshes);
+	std::vector<std::vector<uint8_t>> occlusion;
+	if (!isFile || !AOBaker::ReadCache(cachePath, hash, m_Meshes, m_BoundingBox, occlusion))
+	{
+		occlusion.resize(m_Meshes.size());
+		m_AmbientOcclusionBakeTime = 0.0;
+		for (uint32_t i{ 0u }; i < m_Meshes.size(); ++i)
+		{
+			baker.Bake(m_BVH, m_BoundingSphere.Radius, m_Meshes[i]->GetVertices(), occlusion[i]);
+			m_AmbientOcclusionBakeTime += baker.GetBakeTime();
+		}
+		if (isFile)
+		{
+			AOBaker::WriteCache(cachePath, hash, m_BoundingBox, occlusion);
+		}
+	}
+
+	Mesh::SetAmbientOcclusion(m_Meshes, std::move(occlusion));
 }
\ No newline at end of file
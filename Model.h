@@ -1,5 +1,6 @@
 #pragma once
 #include "Mesh.h"
+#include "AOBaker.h"
 
 class Model
 {
@@ -15,15 +16,37 @@ public:
 	}
 
 	const std::vector<std::unique_ptr<Mesh>>& GetMeshes() noexcept { return m_Meshes; }
+	const DirectX::BoundingBox& GetBoundingBox() const noexcept { return m_BoundingBox; }
+	const DirectX::BoundingSphere& GetBoundingSphere() const noexcept { return m_BoundingSphere; }
+	//Simplified geometry that is rasterized by the occlusion culler. Empty for models that are not used as occluders.
+	[[nodiscard]] bool HasOccluder() const noexcept { return !m_OccluderIndices.empty(); }
+	const std::vector<DirectX::XMFLOAT3>& GetOccluderPositions() const noexcept { return m_OccluderPositions; }
+	const std::vector<uint32_t>& GetOccluderIndices() const noexcept { return m_OccluderIndices; }
+	//Hierarchy over the triangles of all meshes, used for ray queries on the CPU.
+	[[nodiscard]] const ModelBVH& GetBVH() const noexcept { return m_BVH; }
+	//Time the ambient occlusion bake took in milliseconds, 0 when it was read from the cache.
+	[[nodiscard]] constexpr double GetAmbientOcclusionBakeTime() const noexcept { return m_AmbientOcclusionBakeTime; }
 private:
 	void LoadTri() noexcept;
 	void LoadRec() noexcept;
 	void LoadModel() noexcept;
 	void ProcessNode(aiNode* node, const aiScene* scene) noexcept;
 	void ProcessMesh(aiMesh* mesh);
+	void CalculateBounds() noexcept;
+	void BakeAmbientOcclusion() noexcept;
 private:
 
 	std::string m_Name = "";
 
 	std::vector<std::unique_ptr<Mesh>> m_Meshes = {};
+
+	//Local space bounds of all the meshes in the model.
+	DirectX::BoundingBox m_BoundingBox = {};
+	DirectX::BoundingSphere m_BoundingSphere = {};
+
+	std::vector<DirectX::XMFLOAT3> m_OccluderPositions = {};
+	std::vector<uint32_t> m_OccluderIndices = {};
+
+	ModelBVH m_BVH;
+	double m_AmbientOcclusionBakeTime = 0.0;
 };
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "pch.h"
+#include "ModelBVH.h"
+
+namespace
+{
+	void GrowBounds(DirectX::XMFLOAT3& min, DirectX::XMFLOAT3& max, const DirectX::XMFLOAT3& otherMin, const DirectX::XMFLOAT3& otherMax) noexcept
+	{
+		min = { std::min(min.x, otherMin.x), std::min(min.y, otherMin.y), std::min(min.z, otherMin.z) };
+		max = { std::max(max.x, otherMax.x), std::max(max.y, otherMax.y), std::max(max.z, otherMax.z) };
+	}
+
+	DirectX::XMFLOAT3 Subtract(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) noexcept
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	DirectX::XMFLOAT3 Cross(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) noexcept
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	float Dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) noexcept
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	//Slab test, same as the one of the scene BVH.
+	bool IntersectBox(const BVHNode& node, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float minDistance, float maxDistance, float& entryDistance) noexcept
+	{
+		float tx1 = (node.Min.x - origin.x) * inverseDirection.x;
+		float tx2 = (node.Max.x - origin.x) * inverseDirection.x;
+		float tEnter = std::fmin(tx1, tx2);
+		float tExit = std::fmax(tx1, tx2);
+
+		float ty1 = (node.Min.y - origin.y) * inverseDirection.y;
+		float ty2 = (node.Max.y - origin.y) * inverseDirection.y;
+		tEnter = std::fmax(tEnter, std::fmin(ty1, ty2));
+		tExit = std::fmin(tExit, std::fmax(ty1, ty2));
+
+		float tz1 = (node.Min.z - origin.z) * inverseDirection.z;
+		float tz2 = (node.Max.z - origin.z) * inverseDirection.z;
+		tEnter = std::fmax(tEnter, std::fmin(tz1, tz2));
+		tExit = std::fmin(tExit, std::fmax(tz1, tz2));
+
+		entryDistance = std::max(tEnter, minDistance);
+		return tExit >= entryDistance && entryDistance <= maxDistance;
+	}
+}
+
+void ModelBVH::Build(const std::vector<std::unique_ptr<Mesh>>& meshes, const BVHBuildSettings& settings) noexcept
+{
+	//Gather the triangles of every mesh.
+	std::vector<Triangle> triangles;
+	for (uint32_t meshIndex{ 0u }; meshIndex < meshes.size(); ++meshIndex)
+	{
+		const std::vector<Vertex>& vertices = meshes[meshIndex]->GetVertices();
+		const std::vector<uint32_t>& indices = meshes[meshIndex]->GetIndices();
+		const uint32_t nrOfTriangles = static_cast<uint32_t>(indices.size() / 3u);
+		for (uint32_t i{ 0u }; i < nrOfTriangles; ++i)
+		{
+			const DirectX::XMFLOAT3& v0 = vertices[indices[i * 3u]].pos;
+			const DirectX::XMFLOAT3& v1 = vertices[indices[i * 3u + 1u]].pos;
+			const DirectX::XMFLOAT3& v2 = vertices[indices[i * 3u + 2u]].pos;
+			triangles.push_back({ v0, Subtract(v1, v0), Subtract(v2, v0), meshIndex, i });
+		}
+	}
+	Build(std::move(triangles), settings);
+}
+
+void ModelBVH::Build(std::vector<Triangle>&& triangles, const BVHBuildSettings& settings) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint32_t nrOfTriangles = static_cast<uint32_t>(triangles.size());
+	std::vector<DirectX::XMFLOAT3> triangleMin(nrOfTriangles);
+	std::vector<DirectX::XMFLOAT3> triangleMax(nrOfTriangles);
+	for (uint32_t i{ 0u }; i < nrOfTriangles; ++i)
+	{
+		const Triangle& triangle = triangles[i];
+		const DirectX::XMFLOAT3 v1 = { triangle.Vertex0.x + triangle.Edge1.x, triangle.Vertex0.y + triangle.Edge1.y, triangle.Vertex0.z + triangle.Edge1.z };
+		const DirectX::XMFLOAT3 v2 = { triangle.Vertex0.x + triangle.Edge2.x, triangle.Vertex0.y + triangle.Edge2.y, triangle.Vertex0.z + triangle.Edge2.z };
+		triangleMin[i] = triangle.Vertex0;
+		triangleMax[i] = triangle.Vertex0;
+		GrowBounds(triangleMin[i], triangleMax[i], v1, v1);
+		GrowBounds(triangleMin[i], triangleMax[i], v2, v2);
+	}
+
+	BVHBuilder builder(settings);
+	std::vector<uint32_t> buildOrder;
+	builder.Build(triangleMin.data(), triangleMax.data(), nrOfTriangles, m_Nodes, buildOrder);
+
+	//Store the triangles in leaf order.
+	m_Triangles.resize(nrOfTriangles);
+	for (uint32_t i{ 0u }; i < nrOfTriangles; ++i)
+	{
+		m_Triangles[i] = triangles[buildOrder[i]];
+	}
+	m_WideBVH.Build(*this);
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BuildTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+bool ModelBVH::Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept
+{
+	return m_WideBVH.Intersect(origin, direction, minDistance, maxDistance, hit);
+}
+
+bool ModelBVH::IntersectAny(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance) const noexcept
+{
+	return m_WideBVH.IntersectAny(origin, direction, minDistance, maxDistance);
+}
+
+uint32_t ModelBVH::Intersect(const RayPacket& packet, RayHit hits[RayPacket::s_Size]) const noexcept
+{
+	return m_WideBVH.Intersect(packet, hits);
+}
+
+uint32_t ModelBVH::IntersectAny(const RayPacket& packet) const noexcept
+{
+	return m_WideBVH.IntersectAny(packet);
+}
+
+bool ModelBVH::IntersectBinary(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept
+{
+	return Traverse<false>(origin, direction, minDistance, maxDistance, hit);
+}
+
+bool ModelBVH::IntersectAnyBinary(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance) const noexcept
+{
+	RayHit hit = {};
+	return Traverse<true>(origin, direction, minDistance, maxDistance, hit);
+}
+
+template<bool AnyHit>
+bool ModelBVH::Traverse(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept
+{
+	if (m_Nodes.empty())
+		return false;
+
+	DirectX::XMFLOAT3 inverseDirection = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+	float entryDistance = 0.0f;
+	if (!IntersectBox(m_Nodes[0], origin, inverseDirection, minDistance, maxDistance, entryDistance))
+		return false;
+
+	uint32_t stack[BVHBuilder::s_MaxDepth];
+	uint32_t stackSize = 0u;
+	stack[stackSize++] = 0u;
+	bool found = false;
+	while (stackSize > 0u)
+	{
+		const BVHNode& node = m_Nodes[stack[--stackSize]];
+		if (node.Count > 0u)
+		{
+			for (uint32_t i{ node.LeftFirst }; i < node.LeftFirst + node.Count; ++i)
+			{
+				float distance = 0.0f;
+				float u = 0.0f;
+				float v = 0.0f;
+				if (!IntersectTriangle(m_Triangles[i], origin, direction, minDistance, maxDistance, distance, u, v))
+					continue;
+
+				if constexpr (AnyHit)
+				{
+					return true;
+				}
+				//Later tests only have to find something closer.
+				maxDistance = distance;
+				hit.Distance = distance;
+				hit.U = u;
+				hit.V = v;
+				hit.MeshIndex = m_Triangles[i].MeshIndex;
+				hit.TriangleIndex = m_Triangles[i].TriangleIndex;
+				found = true;
+			}
+			continue;
+		}
+
+		float leftDistance = 0.0f;
+		float rightDistance = 0.0f;
+		bool hitLeft = IntersectBox(m_Nodes[node.LeftFirst], origin, inverseDirection, minDistance, maxDistance, leftDistance);
+		bool hitRight = IntersectBox(m_Nodes[node.LeftFirst + 1u], origin, inverseDirection, minDistance, maxDistance, rightDistance);
+		//The builder caps the depth so that this never happens, should it anyway the ray misses rather than overflowing the stack.
+		if (stackSize + 2u > BVHBuilder::s_MaxDepth)
+		{
+			DBG_ASSERT(false, "The BVH is too deep for the traversal stack.");
+			return false;
+		}
+		//Push the furthest child first so that the closest one is visited first.
+		if (hitLeft && hitRight)
+		{
+			if (leftDistance < rightDistance)
+			{
+				stack[stackSize++] = node.LeftFirst + 1u;
+				stack[stackSize++] = node.LeftFirst;
+			}
+			else
+			{
+				stack[stackSize++] = node.LeftFirst;
+				stack[stackSize++] = node.LeftFirst + 1u;
+			}
+		}
+		else if (hitLeft)
+		{
+			stack[stackSize++] = node.LeftFirst;
+		}
+		else if (hitRight)
+		{
+			stack[stackSize++] = node.LeftFirst + 1u;
+		}
+	}
+	return found;
+}
+
+bool ModelBVH::IntersectTriangle(const Triangle& triangle, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, float& distance, float& u, float& v) noexcept
+{
+	//Moller-Trumbore.
+	const DirectX::XMFLOAT3 p = Cross(direction, triangle.Edge2);
+	const float determinant = Dot(triangle.Edge1, p);
+	if (std::fabs(determinant) < 1.0e-12f)
+		return false;
+
+	const float inverseDeterminant = 1.0f / determinant;
+	const DirectX::XMFLOAT3 s = Subtract(origin, triangle.Vertex0);
+	u = Dot(s, p) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	const DirectX::XMFLOAT3 q = Cross(s, triangle.Edge1);
+	v = Dot(direction, q) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	distance = Dot(triangle.Edge2, q) * inverseDeterminant;
+	return distance >= minDistance && distance <= maxDistance;
+}
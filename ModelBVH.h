@@ -0,0 +1,60 @@
+#pragma once
+#include "Mesh.h"
+#include "WideBVH.h"
+#include "BVHBuilder.h"
+
+//Bounding volume hierarchy over the triangles of all meshes of a model, in model space.
+//It is the CPU side counterpart of the bottom level acceleration structure: one per model with every mesh as a separate geometry.
+//Rays are tested without culling back faces, like the RayQuery in the pixel shader.
+//The binary tree is collapsed into an eight wide one after building, which is what the queries traverse.
+class ModelBVH
+{
+public:
+	//A triangle stored the way the intersection test wants it.
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 Vertex0;
+		DirectX::XMFLOAT3 Edge1;
+		DirectX::XMFLOAT3 Edge2;
+		uint32_t MeshIndex;
+		uint32_t TriangleIndex;
+	};
+public:
+	ModelBVH() noexcept = default;
+	~ModelBVH() noexcept = default;
+
+	void Build(const std::vector<std::unique_ptr<Mesh>>& meshes, const BVHBuildSettings& settings = {}) noexcept;
+	//Builds over triangles that were gathered elsewhere, for example the world space triangles of several objects.
+	void Build(std::vector<Triangle>&& triangles, const BVHBuildSettings& settings = {}) noexcept;
+
+	//Finds the closest hit with a distance in [minDistance, maxDistance]. The distance is in units of the direction's length.
+	bool Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept;
+	//Returns as soon as any hit in [minDistance, maxDistance] is found.
+	[[nodiscard]] bool IntersectAny(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance) const noexcept;
+	//Eight coherent rays at once, see WideBVH.
+	uint32_t Intersect(const RayPacket& packet, RayHit hits[RayPacket::s_Size]) const noexcept;
+	[[nodiscard]] uint32_t IntersectAny(const RayPacket& packet) const noexcept;
+	//The same queries on the binary tree, kept as the reference for the wide one.
+	bool IntersectBinary(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept;
+	[[nodiscard]] bool IntersectAnyBinary(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance) const noexcept;
+
+	[[nodiscard]] constexpr bool IsBuilt() const noexcept { return !m_Nodes.empty(); }
+	[[nodiscard]] uint32_t GetNrOfNodes() const noexcept { return static_cast<uint32_t>(m_Nodes.size()); }
+	[[nodiscard]] uint32_t GetNrOfTriangles() const noexcept { return static_cast<uint32_t>(m_Triangles.size()); }
+	[[nodiscard]] const std::vector<BVHNode>& GetNodes() const noexcept { return m_Nodes; }
+	//The triangles in leaf order.
+	[[nodiscard]] const std::vector<Triangle>& GetTriangles() const noexcept { return m_Triangles; }
+	[[nodiscard]] const WideBVH& GetWideBVH() const noexcept { return m_WideBVH; }
+	//Time the last build took in milliseconds, including collapsing it into the wide BVH.
+	[[nodiscard]] constexpr double GetBuildTime() const noexcept { return m_BuildTime; }
+private:
+	template<bool AnyHit>
+	bool Traverse(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept;
+	static bool IntersectTriangle(const Triangle& triangle, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, float& distance, float& u, float& v) noexcept;
+private:
+	std::vector<BVHNode> m_Nodes = {};
+	//The triangles are reordered while building so that every leaf holds one range of them.
+	std::vector<Triangle> m_Triangles = {};
+	WideBVH m_WideBVH = {};
+	double m_BuildTime = 0.0;
+};
@@ -0,0 +1,360 @@
+#include "pch.h"
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	using t_clock = std::chrono::high_resolution_clock;
+
+	double ElapsedMilliseconds(const t_clock::time_point& start) noexcept
+	{
+		return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(t_clock::now() - start).count()) * 0.001;
+	}
+
+	//Triangles are clipped against the near plane and a guard band around the screen.
+	//Without the guard band the vertices that end up right in front of the camera are projected so far off screen that the edge functions lose all precision, which opens cracks between neighbouring triangles.
+	constexpr float s_GuardBand = 2.0f;
+	const DirectX::XMFLOAT4 s_ClipPlanes[5] =
+	{
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ -1.0f, 0.0f, 0.0f, s_GuardBand },
+		{ 1.0f, 0.0f, 0.0f, s_GuardBand },
+		{ 0.0f, -1.0f, 0.0f, s_GuardBand },
+		{ 0.0f, 1.0f, 0.0f, s_GuardBand }
+	};
+
+	float PlaneDistance(const DirectX::XMFLOAT4& plane, const DirectX::XMFLOAT4& v) noexcept
+	{
+		return plane.x * v.x + plane.y * v.y + plane.z * v.z + plane.w * v.w;
+	}
+
+	//Clips the polygon against one plane with Sutherland-Hodgman. Returns the new number of vertices.
+	uint32_t ClipPolygon(const DirectX::XMFLOAT4& plane, const DirectX::XMFLOAT4* pInput, uint32_t nrOfVertices, DirectX::XMFLOAT4* pOutput) noexcept
+	{
+		uint32_t nrOfOutputVertices = 0u;
+		for (uint32_t i{ 0u }; i < nrOfVertices; ++i)
+		{
+			const DirectX::XMFLOAT4& current = pInput[i];
+			const DirectX::XMFLOAT4& next = pInput[(i + 1u) % nrOfVertices];
+			float currentDistance = PlaneDistance(plane, current);
+			float nextDistance = PlaneDistance(plane, next);
+			if (currentDistance >= 0.0f)
+			{
+				pOutput[nrOfOutputVertices++] = current;
+			}
+			if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+			{
+				float t = currentDistance / (currentDistance - nextDistance);
+				pOutput[nrOfOutputVertices++] =
+				{
+					current.x + (next.x - current.x) * t,
+					current.y + (next.y - current.y) * t,
+					current.z + (next.z - current.z) * t,
+					current.w + (next.w - current.w) * t
+				};
+			}
+		}
+		return nrOfOutputVertices;
+	}
+}
+
+OcclusionCuller::OcclusionCuller() noexcept
+{
+	for (uint32_t level{ 0u }; level < s_NrOfHiZLevels; ++level)
+	{
+		m_HiZLevels[level].resize(static_cast<size_t>(s_Width >> level) * (s_Height >> level), 1.0f);
+	}
+}
+
+void OcclusionCuller::BeginFrame(const DirectX::XMFLOAT4X4& viewProjection) noexcept
+{
+	m_ViewProjection = viewProjection;
+	m_Triangles.clear();
+	for (std::vector<uint32_t>& bin : m_TileBins)
+	{
+		bin.clear();
+	}
+	m_Stats = {};
+}
+
+void OcclusionCuller::AddOccluder(const DirectX::XMFLOAT4X4& world, const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices) noexcept
+{
+	auto start = t_clock::now();
+
+	DirectX::XMMATRIX worldViewProjection = DirectX::XMLoadFloat4x4(&world) * DirectX::XMLoadFloat4x4(&m_ViewProjection);
+	std::vector<DirectX::XMFLOAT4> clipPositions(positions.size());
+	for (size_t i{ 0u }; i < positions.size(); ++i)
+	{
+		DirectX::XMStoreFloat4(&clipPositions[i], DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&positions[i]), worldViewProjection));
+	}
+
+	for (size_t i{ 0u }; i + 2u < indices.size(); i += 3u)
+	{
+		const DirectX::XMFLOAT4& v0 = clipPositions[indices[i]];
+		const DirectX::XMFLOAT4& v1 = clipPositions[indices[i + 1u]];
+		const DirectX::XMFLOAT4& v2 = clipPositions[indices[i + 2u]];
+
+		//Trivially reject triangles that are completely outside one of the side planes.
+		if ((v0.x > v0.w && v1.x > v1.w && v2.x > v2.w) || (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) ||
+			(v0.y > v0.w && v1.y > v1.w && v2.y > v2.w) || (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w))
+			continue;
+
+		//Every plane can add at most one vertex to the polygon.
+		DirectX::XMFLOAT4 polygons[2][8] = { { v0, v1, v2 } };
+		uint32_t nrOfPolygonVertices = 3u;
+		uint32_t current = 0u;
+		for (uint32_t p{ 0u }; p < 5u && nrOfPolygonVertices >= 3u; ++p)
+		{
+			nrOfPolygonVertices = ClipPolygon(s_ClipPlanes[p], polygons[current], nrOfPolygonVertices, polygons[1u - current]);
+			current = 1u - current;
+		}
+
+		for (uint32_t j{ 2u }; j < nrOfPolygonVertices; ++j)
+		{
+			AddClippedTriangle(polygons[current][0], polygons[current][j - 1u], polygons[current][j]);
+		}
+	}
+
+	m_Stats.NrOfOccluders++;
+	m_Stats.SetupTime += ElapsedMilliseconds(start);
+}
+
+void OcclusionCuller::RenderOccluders() noexcept
+{
+	auto start = t_clock::now();
+	ThreadPool::Get().ParallelFor(s_NrOfTilesX * s_NrOfTilesY, 1u, [this](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t tileIndex{ begin }; tileIndex < end; ++tileIndex)
+			{
+				RasterizeTile(tileIndex);
+			}
+		});
+	m_Stats.RasterTime = ElapsedMilliseconds(start);
+
+	start = t_clock::now();
+	BuildHiZ();
+	m_Stats.HiZTime = ElapsedMilliseconds(start);
+}
+
+bool OcclusionCuller::IsVisible(const DirectX::BoundingBox& worldBox) const noexcept
+{
+	DirectX::XMMATRIX viewProjection = DirectX::XMLoadFloat4x4(&m_ViewProjection);
+	DirectX::XMFLOAT3 corners[DirectX::BoundingBox::CORNER_COUNT];
+	worldBox.GetCorners(corners);
+
+	float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (uint32_t i{ 0u }; i < DirectX::BoundingBox::CORNER_COUNT; ++i)
+	{
+		DirectX::XMFLOAT4 clip;
+		DirectX::XMStoreFloat4(&clip, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&corners[i]), viewProjection));
+		//Boxes that reach through the near plane are always visible.
+		if (clip.z <= 0.0f)
+			return true;
+
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW * 0.5f + 0.5f) * s_Width;
+		float y = (0.5f - clip.y * inverseW * 0.5f) * s_Height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * inverseW);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= static_cast<float>(s_Width) || minY >= static_cast<float>(s_Height))
+		return false;
+
+	int32_t x0 = std::max(static_cast<int32_t>(minX), 0);
+	int32_t y0 = std::max(static_cast<int32_t>(minY), 0);
+	int32_t x1 = std::min(static_cast<int32_t>(maxX), static_cast<int32_t>(s_Width) - 1);
+	int32_t y1 = std::min(static_cast<int32_t>(maxY), static_cast<int32_t>(s_Height) - 1);
+
+	//Pick the finest level where the rectangle covers at most 4x4 texels.
+	uint32_t level = 0u;
+	while (level + 1u < s_NrOfHiZLevels && (((x1 >> level) - (x0 >> level)) > 3 || ((y1 >> level) - (y0 >> level)) > 3))
+	{
+		level++;
+	}
+
+	const std::vector<float>& hiZ = m_HiZLevels[level];
+	const uint32_t levelWidth = s_Width >> level;
+	for (int32_t y{ y0 >> level }; y <= (y1 >> level); ++y)
+	{
+		for (int32_t x{ x0 >> level }; x <= (x1 >> level); ++x)
+		{
+			if (minZ <= hiZ[static_cast<size_t>(y) * levelWidth + x])
+				return true;
+		}
+	}
+	return false;
+}
+
+void OcclusionCuller::TestBoxes(const std::vector<DirectX::BoundingBox>& boxes, const std::vector<uint32_t>& indices, std::vector<uint8_t>& visibility) noexcept
+{
+	auto start = t_clock::now();
+
+	const uint32_t nrOfBoxes = static_cast<uint32_t>(indices.size());
+	visibility.resize(nrOfBoxes);
+	ThreadPool::Get().ParallelFor(nrOfBoxes, 256u, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				visibility[i] = IsVisible(boxes[indices[i]]) ? 1u : 0u;
+			}
+		});
+
+	m_Stats.NrOfTested += nrOfBoxes;
+	m_Stats.NrOfOccluded += nrOfBoxes - static_cast<uint32_t>(std::count(visibility.begin(), visibility.end(), 1u));
+	m_Stats.TestTime += ElapsedMilliseconds(start);
+}
+
+void OcclusionCuller::AddClippedTriangle(const DirectX::XMFLOAT4& v0, const DirectX::XMFLOAT4& v1, const DirectX::XMFLOAT4& v2) noexcept
+{
+	ScreenTriangle triangle = {};
+	const DirectX::XMFLOAT4* clipVertices[3] = { &v0, &v1, &v2 };
+	for (uint32_t i{ 0u }; i < 3u; ++i)
+	{
+		const DirectX::XMFLOAT4& clip = *clipVertices[i];
+		float inverseW = 1.0f / clip.w;
+		triangle.Vertices[i] =
+		{
+			(clip.x * inverseW * 0.5f + 0.5f) * s_Width,
+			(0.5f - clip.y * inverseW * 0.5f) * s_Height,
+			clip.z * inverseW
+		};
+	}
+
+	const DirectX::XMFLOAT3& a = triangle.Vertices[0];
+	const DirectX::XMFLOAT3& b = triangle.Vertices[1];
+	const DirectX::XMFLOAT3& c = triangle.Vertices[2];
+	float minX = std::min({ a.x, b.x, c.x });
+	float maxX = std::max({ a.x, b.x, c.x });
+	float minY = std::min({ a.y, b.y, c.y });
+	float maxY = std::max({ a.y, b.y, c.y });
+	if (maxX < 0.0f || maxY < 0.0f || minX >= static_cast<float>(s_Width) || minY >= static_cast<float>(s_Height))
+		return;
+
+	//Bin the triangle into every tile its bounding rectangle overlaps.
+	const uint32_t triangleIndex = static_cast<uint32_t>(m_Triangles.size());
+	m_Triangles.push_back(triangle);
+	m_Stats.NrOfOccluderTriangles++;
+
+	uint32_t tileX0 = static_cast<uint32_t>(std::max(minX, 0.0f)) / s_TileWidth;
+	uint32_t tileY0 = static_cast<uint32_t>(std::max(minY, 0.0f)) / s_TileHeight;
+	uint32_t tileX1 = std::min(static_cast<uint32_t>(std::min(maxX, static_cast<float>(s_Width - 1u))) / s_TileWidth, s_NrOfTilesX - 1u);
+	uint32_t tileY1 = std::min(static_cast<uint32_t>(std::min(maxY, static_cast<float>(s_Height - 1u))) / s_TileHeight, s_NrOfTilesY - 1u);
+	for (uint32_t tileY{ tileY0 }; tileY <= tileY1; ++tileY)
+	{
+		for (uint32_t tileX{ tileX0 }; tileX <= tileX1; ++tileX)
+		{
+			m_TileBins[tileY * s_NrOfTilesX + tileX].push_back(triangleIndex);
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeTile(uint32_t tileIndex) noexcept
+{
+	const uint32_t tileX = (tileIndex % s_NrOfTilesX) * s_TileWidth;
+	const uint32_t tileY = (tileIndex / s_NrOfTilesX) * s_TileHeight;
+	float* pDepth = m_HiZLevels[0].data();
+
+	for (uint32_t y{ tileY }; y < tileY + s_TileHeight; ++y)
+	{
+		std::fill_n(pDepth + static_cast<size_t>(y) * s_Width + tileX, s_TileWidth, 1.0f);
+	}
+
+	const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256 zero = _mm256_setzero_ps();
+	for (uint32_t triangleIndex : m_TileBins[tileIndex])
+	{
+		const ScreenTriangle& triangle = m_Triangles[triangleIndex];
+		DirectX::XMFLOAT3 a = triangle.Vertices[0];
+		DirectX::XMFLOAT3 b = triangle.Vertices[1];
+		DirectX::XMFLOAT3 c = triangle.Vertices[2];
+
+		//Occluders are double sided, so flip the winding of back facing triangles.
+		float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (area < 0.0f)
+		{
+			std::swap(b, c);
+			area = -area;
+		}
+		if (area < 1.0e-6f)
+			continue;
+
+		//Each edge function is written as e(x, y) = A * x + B * y + C, positive on the inside.
+		auto edge = [](const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to, float& A, float& B, float& C) noexcept
+		{
+			A = from.y - to.y;
+			B = to.x - from.x;
+			C = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+		};
+		float A0, B0, C0, A1, B1, C1, A2, B2, C2;
+		edge(b, c, A0, B0, C0);
+		edge(c, a, A1, B1, C1);
+		edge(a, b, A2, B2, C2);
+
+		//Depth is interpolated with the barycentrics of b and c, which are the edge functions opposite them.
+		const float inverseArea = 1.0f / area;
+		const float depthA = (A1 * (b.z - a.z) + A2 * (c.z - a.z)) * inverseArea;
+		const float depthB = (B1 * (b.z - a.z) + B2 * (c.z - a.z)) * inverseArea;
+		const float depthC = a.z + (C1 * (b.z - a.z) + C2 * (c.z - a.z)) * inverseArea;
+
+		//Rasterize the part of the bounding rectangle that is inside the tile, 8 pixels at a time.
+		int32_t x0 = std::max(static_cast<int32_t>(std::min({ a.x, b.x, c.x })), static_cast<int32_t>(tileX));
+		int32_t x1 = std::min(static_cast<int32_t>(std::max({ a.x, b.x, c.x })), static_cast<int32_t>(tileX + s_TileWidth - 1u));
+		int32_t y0 = std::max(static_cast<int32_t>(std::min({ a.y, b.y, c.y })), static_cast<int32_t>(tileY));
+		int32_t y1 = std::min(static_cast<int32_t>(std::max({ a.y, b.y, c.y })), static_cast<int32_t>(tileY + s_TileHeight - 1u));
+		if (x0 > x1 || y0 > y1)
+			continue;
+		x0 &= ~7;
+
+		const __m256 edgeA0 = _mm256_set1_ps(A0), edgeA1 = _mm256_set1_ps(A1), edgeA2 = _mm256_set1_ps(A2);
+		const __m256 planeA = _mm256_set1_ps(depthA);
+		for (int32_t y{ y0 }; y <= y1; ++y)
+		{
+			const float pixelY = static_cast<float>(y) + 0.5f;
+			const __m256 rowEdge0 = _mm256_set1_ps(B0 * pixelY + C0);
+			const __m256 rowEdge1 = _mm256_set1_ps(B1 * pixelY + C1);
+			const __m256 rowEdge2 = _mm256_set1_ps(B2 * pixelY + C2);
+			const __m256 rowDepth = _mm256_set1_ps(depthB * pixelY + depthC);
+			float* pRow = pDepth + static_cast<size_t>(y) * s_Width;
+			for (int32_t x{ x0 }; x <= x1; x += 8)
+			{
+				__m256 pixelX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+				__m256 e0 = _mm256_add_ps(_mm256_mul_ps(edgeA0, pixelX), rowEdge0);
+				__m256 e1 = _mm256_add_ps(_mm256_mul_ps(edgeA1, pixelX), rowEdge1);
+				__m256 e2 = _mm256_add_ps(_mm256_mul_ps(edgeA2, pixelX), rowEdge2);
+				__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+				if (_mm256_testz_ps(inside, inside))
+					continue;
+
+				__m256 depth = _mm256_add_ps(_mm256_mul_ps(planeA, pixelX), rowDepth);
+				__m256 current = _mm256_loadu_ps(pRow + x);
+				_mm256_storeu_ps(pRow + x, _mm256_blendv_ps(current, _mm256_min_ps(current, depth), inside));
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildHiZ() noexcept
+{
+	for (uint32_t level{ 1u }; level < s_NrOfHiZLevels; ++level)
+	{
+		const std::vector<float>& source = m_HiZLevels[level - 1u];
+		std::vector<float>& destination = m_HiZLevels[level];
+		const uint32_t sourceWidth = s_Width >> (level - 1u);
+		const uint32_t width = s_Width >> level;
+		const uint32_t height = s_Height >> level;
+		for (uint32_t y{ 0u }; y < height; ++y)
+		{
+			const float* pRow0 = &source[static_cast<size_t>(2u * y) * sourceWidth];
+			const float* pRow1 = pRow0 + sourceWidth;
+			for (uint32_t x{ 0u }; x < width; ++x)
+			{
+				destination[static_cast<size_t>(y) * width + x] = std::max(std::max(pRow0[2u * x], pRow0[2u * x + 1u]), std::max(pRow1[2u * x], pRow1[2u * x + 1u]));
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+struct OcclusionCullerStats
+{
+	uint32_t NrOfOccluders = 0u;
+	uint32_t NrOfOccluderTriangles = 0u;
+	uint32_t NrOfTested = 0u;
+	uint32_t NrOfOccluded = 0u;
+	//Timings in milliseconds.
+	double SetupTime = 0.0;
+	double RasterTime = 0.0;
+	double HiZTime = 0.0;
+	double TestTime = 0.0;
+};
+
+//Software occlusion culling.
+//Large occluders are rasterized into a low resolution depth buffer on the CPU, split into tiles that are rasterized in parallel using AVX2.
+//A hierarchical depth buffer holding the furthest depth of each block is built from it, and object bounds are tested against that.
+//Nothing here touches the GPU so it can run without a device.
+class OcclusionCuller
+{
+public:
+	static constexpr uint32_t s_Width = 256u;
+	static constexpr uint32_t s_Height = 128u;
+	static constexpr uint32_t s_TileWidth = 64u;
+	static constexpr uint32_t s_TileHeight = 32u;
+	static constexpr uint32_t s_NrOfTilesX = s_Width / s_TileWidth;
+	static constexpr uint32_t s_NrOfTilesY = s_Height / s_TileHeight;
+	static constexpr uint32_t s_NrOfHiZLevels = 6u;
+public:
+	OcclusionCuller() noexcept;
+	~OcclusionCuller() noexcept = default;
+
+	//Clears the occluders and the depth buffer.
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection) noexcept;
+	//Transforms, clips and bins the triangles of an occluder. Positions are in model space.
+	void AddOccluder(const DirectX::XMFLOAT4X4& world, const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices) noexcept;
+	//Rasterizes all added occluders and builds the hierarchical depth buffer.
+	void RenderOccluders() noexcept;
+
+	//Returns false if the box is completely hidden behind the occluders.
+	[[nodiscard]] bool IsVisible(const DirectX::BoundingBox& worldBox) const noexcept;
+	//Tests the boxes at the given indices in parallel. visibility[i] is set to 1 if the box at indices[i] is visible.
+	void TestBoxes(const std::vector<DirectX::BoundingBox>& boxes, const std::vector<uint32_t>& indices, std::vector<uint8_t>& visibility) noexcept;
+
+	[[nodiscard]] const OcclusionCullerStats& GetStats() const noexcept { return m_Stats; }
+	[[nodiscard]] const std::vector<float>& GetDepthBuffer() const noexcept { return m_HiZLevels[0]; }
+private:
+	//Screen space triangle. x and y are in pixels, z is the depth after the perspective divide.
+	struct ScreenTriangle
+	{
+		DirectX::XMFLOAT3 Vertices[3];
+	};
+
+	void AddClippedTriangle(const DirectX::XMFLOAT4& v0, const DirectX::XMFLOAT4& v1, const DirectX::XMFLOAT4& v2) noexcept;
+	void RasterizeTile(uint32_t tileIndex) noexcept;
+	void BuildHiZ() noexcept;
+private:
+	DirectX::XMFLOAT4X4 m_ViewProjection = {};
+	std::vector<ScreenTriangle> m_Triangles = {};
+	//The indices of the triangles that overlap each tile.
+	std::vector<uint32_t> m_TileBins[s_NrOfTilesX * s_NrOfTilesY];
+	//Level 0 is the depth buffer itself, every following level holds the furthest depth of 2x2 texels of the previous one.
+	std::vector<float> m_HiZLevels[s_NrOfHiZLevels];
+
+	OcclusionCullerStats m_Stats = {};
+};
\ No newline at end of file
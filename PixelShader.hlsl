@@ -1,19 +1,35 @@
+//Permutation keys, every variant is compiled with its own values by the renderer. The defaults are for compiling the file on its own.
+//How the shadows of the lights are found. Matches ShadowMode of the renderer.
+#define SHADOW_MODE_NONE 0
+#define SHADOW_MODE_TRACED 1
+#define SHADOW_MODE_BAKED 2
+#ifndef SHADOW_MODE
+#define SHADOW_MODE SHADOW_MODE_BAKED
+#endif
+//Shades with the lights of the pixel's cluster instead of the lights of the object.
+#ifndef CLUSTERED_LIGHTING
+#define CLUSTERED_LIGHTING 0
+#endif
+
 struct VS_OUT
 {
     float4 outPositionSS    : SV_Position;
     float4 outPosWorld      : POSWORLD;
     float3 outNormal        : NORMAL;
+    nointerpolation float4 outColor : COLOR;
+    float outAmbientOcclusion : AMBIENTOCCLUSION;
+    nointerpolation uint2 outLights : LIGHTS;
+    nointerpolation uint2 outVisibility : VISIBILITY;
+    float outViewDepth : VIEWDEPTH;
 };
 
+//Matches PointLight of the LightManager.
 struct PointLight
 {
     float3 pos;
+    float radius;
     float3 col;
-};
-
-struct ObjectColor
-{
-    float4 color;
+    float padding;
 };
 
 struct VPInverseBuffer
@@ -24,64 +40,97 @@ struct VPInverseBuffer
 struct CameraBuffer
 {
     float3 pos;
-    float rayTraceBool;
+    float padding;
+};
+
+//Matches LightClusterConstants of the renderer.
+struct LightClusterBuffer
+{
+    float2 tileScale;
+    float depthScale;
+    float depthBias;
+    uint3 dims;
+    uint padding;
 };
 
 RaytracingAccelerationStructure scene : register(t0, space1);
 
 ConstantBuffer<VPInverseBuffer> vpInverseBuffer : register(b0, space1);
-ConstantBuffer<ObjectColor> objectColor : register(b1, space1);
 ConstantBuffer<CameraBuffer> camera : register(b2, space1);
-
-static const PointLight light1 = { -40.0f, 60.0f, 80.0f, 1.0f, 0.0f, 0.0f };
-static const PointLight light2 = { 50.0f, 50.0f, 10.0f, 0.7f, 0.7f, 0.3f };
-static const PointLight light3 = { 0.0f, 50.0f, -5.0f, 0.0f, 0.7f, 0.7f };
-static const PointLight light4 = { 5.0f, 100.0f, -5.0f, 0.0f, 1.0f, 0.0f };
-static const PointLight light5 = { 0.0f, 150.0f, 160.0f, 0.2f, 0.65f, 0.90f };
-static const PointLight light6 = { 30.0f, 20.0f, -60.0f, 0.0f, 1.0f, 0.36f };
-static const PointLight light7 = { 0.0f, -40.0f, 170.0f, 1.0f, 0.15f, 0.22f };
-static const PointLight light8 = { 50.0f, 50.0f, 140.0f, 0.66f, 0.34f, 0.78f };
-static const PointLight light9 = { -34.0f, 87.0f, 170.0f, 1.0f, 0.0f, 1.0f };
-static const PointLight light10 = { 36.0f, 36.0f, -15.0f, 0.2f, 0.2f, 0.2f };
+//The scene's lights and the lists of the lights that reach every object.
+//The light indices are followed by the baked light visibility of the static objects.
+StructuredBuffer<PointLight> lights : register(t1, space1);
+StructuredBuffer<uint> lightIndices : register(t2, space1);
+//The froxel grid of the clustered lighting, every cluster has a range of clusterLightIndices.
+ConstantBuffer<LightClusterBuffer> lightClusters : register(b3, space1);
+StructuredBuffer<uint2> clusterRanges : register(t3, space1);
+StructuredBuffer<uint> clusterLightIndices : register(t4, space1);
+
+//Matches LightVisibility of the LightVisibilityBaker.
+static const uint SHADOW_PARTIAL = 0;
+static const uint SHADOW_VISIBLE = 1;
+static const uint SHADOW_OCCLUDED = 2;
 
 //Modifiers
 static const float ambient = 0.2f;
 static const float specular = 0.8f;
 static const float diffuse = 0.7f;
 
-float3 CalculateLight(PointLight light, float4 outPosWorld, float3 normal, float3 viewDir, float4 color, float rayTraceBool)
+//The baked shadow state of the light for the object, two bits per light in the object's row. Lights past the row, and every light of an object
+//that moves, have to be traced.
+uint GetShadowState(uint2 visibility, uint lightIndex)
+{
+    if (lightIndex >= visibility.y)
+    {
+        return SHADOW_PARTIAL;
+    }
+    return (lightIndices[visibility.x + lightIndex / 16] >> ((lightIndex % 16) * 2)) & 3;
+}
+
+//Traces a shadow ray from the position towards the light.
+bool IsShadowed(float3 position, float3 lightPosition, float dist)
+{
+    RayQuery<RAY_FLAG_CULL_NON_OPAQUE | RAY_FLAG_SKIP_PROCEDURAL_PRIMITIVES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH> query;
+    
+    RayDesc ray;
+    ray.Origin = position;
+    ray.Direction = normalize(lightPosition - position);
+    ray.TMin = 0.1f;
+    ray.TMax = 10000.0f;
+    
+    query.TraceRayInline(scene, 0, 0xFF, ray);
+    query.Proceed();
+    
+    return query.CommittedStatus() == COMMITTED_TRIANGLE_HIT && query.CommittedRayT() < dist;
+}
+
+float3 CalculateLight(PointLight light, float4 outPosWorld, float3 normal, float3 viewDir, float4 color, float ambientOcclusion, uint shadowState)
 {
     float dist = length(light.pos - outPosWorld.xyz);
+    //Past the radius the light adds less than the cutoff, so neither the shading nor the shadow ray is worth it.
+    if (dist > light.radius)
+    {
+        return float3(0.0f, 0.0f, 0.0f);
+    }
     float attenuation = 1.0f / (1.0f + 0.0f * dist + 0.0001f * (dist * dist));
     float3 lightDir = normalize(light.pos - outPosWorld.xyz);
 
     //Ambient
-    float3 ambientColor = ambient * light.col;
+    float3 ambientColor = ambient * ambientOcclusion * light.col;
     ambientColor = ambientColor * color.xyz * attenuation;
 
-    //Shadows with raytracing
-    if (rayTraceBool)
+    //Shadows with raytracing, with the baked states only for the pairs where the baked state can not tell.
+#if SHADOW_MODE == SHADOW_MODE_BAKED
+    if (shadowState == SHADOW_OCCLUDED || (shadowState == SHADOW_PARTIAL && IsShadowed(outPosWorld.xyz, light.pos, dist)))
     {
-        RayQuery<RAY_FLAG_CULL_NON_OPAQUE | RAY_FLAG_SKIP_PROCEDURAL_PRIMITIVES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH> query;
-    
-        RayDesc ray;
-        ray.Origin = outPosWorld.xyz;
-        ray.Direction = normalize(light.pos - outPosWorld.xyz);
-        ray.TMin = 0.1f;
-        ray.TMax = 10000.0f;
-    
-        query.TraceRayInline(scene, 0, 0xFF, ray);
-        query.Proceed();
-    
-    
-        if (query.CommittedStatus() == COMMITTED_TRIANGLE_HIT)
-        {
-            if (query.CommittedRayT() < dist)
-            {
-                return ambientColor;
-            }
-        }
+        return ambientColor;
+    }
+#elif SHADOW_MODE == SHADOW_MODE_TRACED
+    if (IsShadowed(outPosWorld.xyz, light.pos, dist))
+    {
+        return ambientColor;
     }
+#endif
     
     //Diffuse
     float diff = max(dot(lightDir, normal), 0.0f);
@@ -104,16 +153,29 @@ float4 main(in VS_OUT psIn) : SV_TARGET
     float3 viewDir = normalize(camera.pos - psIn.outPosWorld.xyz);
 
     float3 result = float3(0.0f, 0.0f, 0.0f);
-    result += CalculateLight(light3, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light1, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light2, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light4, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light5, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light6, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light7, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light8, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light9, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-    result += CalculateLight(light10, psIn.outPosWorld, normal, viewDir, objectColor.color, camera.rayTraceBool);
-
-    return float4(result, objectColor.color.w);
+#if CLUSTERED_LIGHTING
+    {
+        //Only the lights that reach the pixel's cluster.
+        uint3 cluster;
+        cluster.xy = min(uint2(psIn.outPositionSS.xy * lightClusters.tileScale), lightClusters.dims.xy - 1);
+        cluster.z = uint(clamp(floor(log(psIn.outViewDepth) * lightClusters.depthScale + lightClusters.depthBias), 0.0f, float(lightClusters.dims.z - 1)));
+        uint2 range = clusterRanges[(cluster.z * lightClusters.dims.y + cluster.y) * lightClusters.dims.x + cluster.x];
+        for (uint i = 0; i < range.y; i++)
+        {
+            uint lightIndex = clusterLightIndices[range.x + i];
+            result += CalculateLight(lights[lightIndex], psIn.outPosWorld, normal, viewDir, psIn.outColor, psIn.outAmbientOcclusion, GetShadowState(psIn.outVisibility, lightIndex));
+        }
+    }
+#else
+    {
+        //Only the lights that reach the object, in the order of the light indices.
+        for (uint i = 0; i < psIn.outLights.y; i++)
+        {
+            uint lightIndex = lightIndices[psIn.outLights.x + i];
+            result += CalculateLight(lights[lightIndex], psIn.outPosWorld, normal, viewDir, psIn.outColor, psIn.outAmbientOcclusion, GetShadowState(psIn.outVisibility, lightIndex));
+        }
+    }
+#endif
+
+    return float4(result, psIn.outColor.w);
 }
\ No newline at end of file
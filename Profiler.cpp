@@ -1,10 +1,221 @@
 #include "pch.h"
 #include "Profiler.h"
+#include "ThreadPool.h"
 
-std::vector<ProfilerData> ProfilerManager::ProfilerDatas;
-std::vector<ProfilerData> ProfilerManager::AllProfilerDatas;
-double ProfilerManager::m_CurrentAverageDuration{ 0.0f };
-double ProfilerManager::m_AverageDurationSinceStart{ 0.0f };
-double ProfilerManager::m_SummedDurationOverFrames{ 0.0f };
-uint32_t ProfilerManager::m_MaxMeasurements{ 1u };
-uint32_t ProfilerManager::m_CurrentMeasureNr{ 0u };
\ No newline at end of file
+Profiler Profiler::s_Instance;
+
+namespace
+{
+	thread_local uint32_t t_BufferIndex = UINT32_MAX;
+}
+
+Profiler& Profiler::Get() noexcept
+{
+	return s_Instance;
+}
+
+void Profiler::Initialize() noexcept
+{
+	DBG_ASSERT(!m_pBuffers, "The profiler is already initialized.");
+
+	m_NrOfPoolBuffers = ThreadPool::Get().GetNrOfThreads();
+	m_NrOfBuffers = m_NrOfPoolBuffers + s_NrOfExtraBuffers;
+	m_pBuffers = std::make_unique<ThreadBuffer[]>(m_NrOfBuffers);
+	m_StartTicks = __rdtsc();
+	m_StartTime = std::chrono::steady_clock::now();
+
+	m_Nodes.clear();
+	ProfileNode frameNode;
+	frameNode.pName = "Frame";
+	m_Nodes.push_back(frameNode);
+	m_Events.reserve(s_NrOfEventsPerThread);
+	m_OpenEvents.reserve(64u);
+	m_OpenNodes.reserve(64u);
+}
+
+void Profiler::Record(const char* pName, uint64_t begin, uint64_t end) noexcept
+{
+	if (!m_pBuffers)
+		return;
+
+	const uint32_t bufferIndex = GetBufferIndex();
+	if (bufferIndex >= m_NrOfBuffers)
+	{
+		m_NrOfUnbufferedDropped.fetch_add(1u, std::memory_order_relaxed);
+		return;
+	}
+
+	ThreadBuffer& buffer = m_pBuffers[bufferIndex];
+	const uint32_t writeIndex = buffer.WriteIndex.load(std::memory_order_relaxed);
+	if (writeIndex - buffer.CachedReadIndex == s_NrOfEventsPerThread)
+	{
+		buffer.CachedReadIndex = buffer.ReadIndex.load(std::memory_order_acquire);
+		if (writeIndex - buffer.CachedReadIndex == s_NrOfEventsPerThread)
+		{
+			buffer.NrOfDropped.fetch_add(1u, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	buffer.Events[writeIndex % s_NrOfEventsPerThread] = { pName, begin, end };
+	buffer.WriteIndex.store(writeIndex + 1u, std::memory_order_release);
+}
+
+void Profiler::EndFrame() noexcept
+{
+	if (!m_pBuffers)
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint64_t ticks = __rdtsc();
+	const std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(time - m_StartTime);
+	if (elapsed.count() > 0)
+	{
+		m_TicksPerMillisecond = static_cast<double>(ticks - m_StartTicks) / (static_cast<double>(elapsed.count()) * 0.001);
+	}
+
+	for (ProfileNode& node : m_Nodes)
+	{
+		node.NrOfCalls = 0u;
+		node.Time = 0.0;
+	}
+
+	m_NrOfDropped = m_NrOfUnbufferedDropped.exchange(0u, std::memory_order_relaxed);
+	m_NrOfEvents = 0u;
+	for (uint32_t threadIndex{ 0u }; threadIndex < m_NrOfBuffers; ++threadIndex)
+	{
+		ThreadBuffer& buffer = m_pBuffers[threadIndex];
+		const uint32_t readIndex = buffer.ReadIndex.load(std::memory_order_relaxed);
+		const uint32_t writeIndex = buffer.WriteIndex.load(std::memory_order_acquire);
+		m_Events.clear();
+		for (uint32_t i{ readIndex }; i != writeIndex; ++i)
+		{
+			m_Events.push_back(buffer.Events[i % s_NrOfEventsPerThread]);
+		}
+		buffer.ReadIndex.store(writeIndex, std::memory_order_release);
+		m_NrOfDropped += buffer.NrOfDropped.exchange(0u, std::memory_order_relaxed);
+		m_NrOfEvents += static_cast<uint32_t>(m_Events.size());
+
+		//The events were written as the scopes closed, children before their parents. Sorted on the start, with the longer one first
+		//on a tie, every parent comes before its children.
+		std::sort(m_Events.begin(), m_Events.end(), [](const ProfileEvent& first, const ProfileEvent& second)
+			{
+				return first.Begin != second.Begin ? first.Begin < second.Begin : first.End > second.End;
+			});
+
+		m_OpenEvents.clear();
+		m_OpenNodes.clear();
+		for (uint32_t i{ 0u }; i < m_Events.size(); ++i)
+		{
+			const ProfileEvent& event = m_Events[i];
+			while (!m_OpenEvents.empty() && m_Events[m_OpenEvents.back()].End <= event.Begin)
+			{
+				m_OpenEvents.pop_back();
+				m_OpenNodes.pop_back();
+			}
+
+			//A task run while waiting opens a fresh root, whatever the waiting thread had open.
+			if (event.pName == s_pTaskName)
+			{
+				m_OpenEvents.push_back(i);
+				m_OpenNodes.push_back(s_RootNode);
+				continue;
+			}
+
+			const uint32_t parent = m_OpenNodes.empty() ? s_RootNode : m_OpenNodes.back();
+			const uint32_t nodeIndex = GetChild(parent, event.pName);
+			ProfileNode& node = m_Nodes[nodeIndex];
+			node.NrOfCalls++;
+			node.Time += TicksToMilliseconds(event.End - event.Begin);
+			m_OpenEvents.push_back(i);
+			m_OpenNodes.push_back(nodeIndex);
+		}
+	}
+
+	for (uint32_t i{ 1u }; i < m_Nodes.size(); ++i)
+	{
+		ProfileNode& node = m_Nodes[i];
+		if (node.NrOfCalls > 0u)
+		{
+			node.TotalTime += node.Time;
+			node.NrOfFrames++;
+			m_Nodes[s_RootNode].Time += node.Parent == s_RootNode ? node.Time : 0.0;
+		}
+	}
+	m_Nodes[s_RootNode].TotalTime += m_Nodes[s_RootNode].Time;
+	m_Nodes[s_RootNode].NrOfFrames++;
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_AggregationTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+uint32_t Profiler::DiscardEvents() noexcept
+{
+	uint32_t nrOfDropped = m_NrOfUnbufferedDropped.exchange(0u, std::memory_order_relaxed);
+	for (uint32_t threadIndex{ 0u }; threadIndex < m_NrOfBuffers; ++threadIndex)
+	{
+		ThreadBuffer& buffer = m_pBuffers[threadIndex];
+		buffer.ReadIndex.store(buffer.WriteIndex.load(std::memory_order_acquire), std::memory_order_release);
+		nrOfDropped += buffer.NrOfDropped.exchange(0u, std::memory_order_relaxed);
+	}
+	return nrOfDropped;
+}
+
+void Profiler::ResetTotals() noexcept
+{
+	for (ProfileNode& node : m_Nodes)
+	{
+		node.TotalTime = 0.0;
+		node.NrOfFrames = 0u;
+	}
+}
+
+const ProfileNode* Profiler::FindNode(const char* pName) const noexcept
+{
+	for (const ProfileNode& node : m_Nodes)
+	{
+		if (std::strcmp(node.pName, pName) == 0)
+			return &node;
+	}
+	return nullptr;
+}
+
+uint32_t Profiler::GetChild(uint32_t parent, const char* pName) noexcept
+{
+	//The names are compared by address, every PROFILE_SCOPE has its own literal.
+	uint32_t lastChild = UINT32_MAX;
+	for (uint32_t child{ m_Nodes[parent].FirstChild }; child != UINT32_MAX; child = m_Nodes[child].NextSibling)
+	{
+		if (m_Nodes[child].pName == pName)
+			return child;
+		lastChild = child;
+	}
+
+	ProfileNode node;
+	node.pName = pName;
+	node.Parent = parent;
+	node.Depth = m_Nodes[parent].Depth + 1u;
+	const uint32_t nodeIndex = static_cast<uint32_t>(m_Nodes.size());
+	m_Nodes.push_back(node);
+	if (lastChild == UINT32_MAX)
+	{
+		m_Nodes[parent].FirstChild = nodeIndex;
+	}
+	else
+	{
+		m_Nodes[lastChild].NextSibling = nodeIndex;
+	}
+	return nodeIndex;
+}
+
+uint32_t Profiler::GetBufferIndex() noexcept
+{
+	//The threads of the pool use their own index, any other thread takes the next extra buffer.
+	if (t_BufferIndex == UINT32_MAX)
+	{
+		t_BufferIndex = ThreadPool::Get().IsPoolThread() ? ThreadPool::GetThreadIndex() : m_NrOfPoolBuffers + m_NrOfExtraBuffersTaken.fetch_add(1u, std::memory_order_relaxed);
+	}
+	return t_BufferIndex;
+}
@@ -1,74 +1,133 @@
 #pragma once
 
-struct ProfilerData
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+//Times the rest of the enclosing scope. The name has to be a string literal, its address is the id of the scope.
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__){ name }
+
+//A timed scope as it was recorded, in time stamp counter ticks.
+struct ProfileEvent
 {
-	std::string ContextName = "";
-	double Duration = 0.0f;
+	const char* pName;
+	uint64_t Begin;
+	uint64_t End;
 };
 
-template<typename LambdaFunction>
+//A scope in the tree of scopes, one node per name under every parent. Scopes with the same name under the same parent are summed,
+//also when they ran on different threads.
+struct ProfileNode
+{
+	const char* pName = nullptr;
+	uint32_t Parent = UINT32_MAX;
+	uint32_t FirstChild = UINT32_MAX;
+	uint32_t NextSibling = UINT32_MAX;
+	uint32_t Depth = 0u;
+	//Calls and time in milliseconds during the last frame.
+	uint32_t NrOfCalls = 0u;
+	double Time = 0.0;
+	//Summed over the frames since the last ResetTotals, and the number of those frames the scope ran in.
+	double TotalTime = 0.0;
+	uint32_t NrOfFrames = 0u;
+};
+
+//Low overhead CPU profiler of nested scopes. A scope reads the time stamp counter when it opens and when it closes, and writes one event
+//into the ring buffer of its thread. Every thread of the thread pool owns one buffer with a single writer and a single reader, so recording
+//takes no lock and allocates nothing. Threads outside the pool take one of a few extra buffers on their first scope, once those are gone
+//their scopes are dropped. When a buffer is full the event is dropped and counted as well.
+//Once per frame EndFrame drains the buffers on the main thread and merges the events into the tree: the events of a thread are sorted on
+//their start, and every event is the child of the closest earlier event that is still open. The scopes of the workers are roots of their own,
+//and so are those of the tasks a thread runs while it waits for the pool, the pool marks them with a scope named s_pTaskName.
+//A scope counts for the frame it closes in, so EndFrame is called outside of every scope.
 class Profiler
 {
 public:
-	Profiler(const std::string& contextName, const LambdaFunction&& func) noexcept
-		: m_ContextName{ contextName },
-		  m_FunctionToCall{ func },
-		  m_StartTime{ std::chrono::high_resolution_clock::now() }
-	{
-	}
-	~Profiler()
-	{
-		auto end = std::chrono::high_resolution_clock::now();
-		auto dif = std::chrono::duration_cast<std::chrono::microseconds>(end - m_StartTime);
-		auto ms = static_cast<double>(dif.count());
-		ms *= 0.001;
+	static constexpr uint32_t s_NrOfEventsPerThread = 8192u;
+	//Buffers for threads that are not part of the thread pool.
+	static constexpr uint32_t s_NrOfExtraBuffers = 4u;
+	//Scopes with this name are not shown, the scopes inside them start at the root.
+	static constexpr const char* s_pTaskName = "Pool task";
+	//The node of the frame, every top level scope is a child of it.
+	static constexpr uint32_t s_RootNode = 0u;
+public:
+	[[nodiscard]] static Profiler& Get() noexcept;
+	//Creates one buffer per thread of the thread pool, which has to be initialized first, and the extra buffers. Scopes before this are not recorded.
+	void Initialize() noexcept;
 
-		ProfilerData profilerData;
-		profilerData.ContextName = m_ContextName;
-		profilerData.Duration = ms;
+	//Called by ProfileScope on the thread that ran the scope.
+	void Record(const char* pName, uint64_t begin, uint64_t end) noexcept;
+	//Aggregates the events of every thread into the tree, only from the main thread.
+	void EndFrame() noexcept;
+	//Empties the buffers without aggregating, only from the main thread. Returns the number of events that were dropped since the last frame.
+	uint32_t DiscardEvents() noexcept;
+	void ResetTotals() noexcept;
 
-		m_FunctionToCall(profilerData);
-	}
+	//The first node with the name, compared as a string. nullptr if the scope never ran.
+	[[nodiscard]] const ProfileNode* FindNode(const char* pName) const noexcept;
+	[[nodiscard]] const std::vector<ProfileNode>& GetNodes() const noexcept { return m_Nodes; }
+	[[nodiscard]] double TicksToMilliseconds(uint64_t ticks) const noexcept { return static_cast<double>(ticks) / m_TicksPerMillisecond; }
+	//Events that did not fit in their buffer, during the last frame.
+	[[nodiscard]] constexpr uint32_t GetNrOfDropped() const noexcept { return m_NrOfDropped; }
+	[[nodiscard]] constexpr uint32_t GetNrOfEvents() const noexcept { return m_NrOfEvents; }
+	//Time the last EndFrame took in milliseconds.
+	[[nodiscard]] constexpr double GetAggregationTime() const noexcept { return m_AggregationTime; }
 private:
-	std::string m_ContextName;
-	LambdaFunction m_FunctionToCall;
-	std::chrono::time_point<std::chrono::high_resolution_clock> m_StartTime;
+	Profiler() noexcept = default;
+	~Profiler() noexcept = default;
+	[[nodiscard]] uint32_t GetChild(uint32_t parent, const char* pName) noexcept;
+	//The buffer of the calling thread, picked on its first scope. m_NrOfBuffers or more when there is none left for it.
+	[[nodiscard]] uint32_t GetBufferIndex() noexcept;
+private:
+	//The write index is only stored by the owning thread and the read index only by the main thread.
+	//They are on their own cache lines so that the two sides do not share one. The owner keeps the last read index it saw,
+	//and only loads the main thread's when the buffer looks full.
+	struct alignas(64) ThreadBuffer
+	{
+		std::atomic<uint32_t> WriteIndex = 0u;
+		std::atomic<uint32_t> NrOfDropped = 0u;
+		uint32_t CachedReadIndex = 0u;
+		alignas(64) std::atomic<uint32_t> ReadIndex = 0u;
+		alignas(64) ProfileEvent Events[s_NrOfEventsPerThread];
+	};
+
+	static Profiler s_Instance;
+	std::unique_ptr<ThreadBuffer[]> m_pBuffers = nullptr;
+	uint32_t m_NrOfBuffers = 0u;
+	uint32_t m_NrOfPoolBuffers = 0u;
+	std::atomic<uint32_t> m_NrOfExtraBuffersTaken = 0u;
+	//Events of threads that did not get a buffer.
+	std::atomic<uint32_t> m_NrOfUnbufferedDropped = 0u;
+
+	//The counter is calibrated against the steady clock over the whole run.
+	uint64_t m_StartTicks = 0u;
+	std::chrono::steady_clock::time_point m_StartTime = {};
+	double m_TicksPerMillisecond = 1.0;
+
+	std::vector<ProfileNode> m_Nodes = {};
+	//Kept between frames so that aggregating does not allocate once it has warmed up.
+	std::vector<ProfileEvent> m_Events = {};
+	std::vector<uint32_t> m_OpenEvents = {};
+	std::vector<uint32_t> m_OpenNodes = {};
+	uint32_t m_NrOfDropped = 0u;
+	uint32_t m_NrOfEvents = 0u;
+	double m_AggregationTime = 0.0;
 };
 
-struct ProfilerManager
+//Records the time from its construction to its destruction under the name, see PROFILE_SCOPE.
+class ProfileScope
 {
-	static std::vector<ProfilerData> ProfilerDatas;
-	static std::vector<ProfilerData> AllProfilerDatas;
-	static double m_SummedDurationOverFrames;
-	static double m_CurrentAverageDuration;
-	static double m_AverageDurationSinceStart;
-	static uint32_t m_MaxMeasurements;
-	static uint32_t m_CurrentMeasureNr;
-	static void Clear() noexcept
+public:
+	explicit ProfileScope(const char* pName) noexcept
+		: m_pName{ pName },
+		  m_Begin{ __rdtsc() }
 	{
-		ProfilerDatas.clear();
-		AllProfilerDatas.clear();
 	}
-	static std::pair<double, double> Report() noexcept
+	~ProfileScope() noexcept
 	{
-		m_CurrentAverageDuration = 0.0f;
-		m_AverageDurationSinceStart = 0.0f;
-		m_SummedDurationOverFrames = 0u;
-		for (uint32_t i{ 0u }; i < ProfilerDatas.size(); ++i)
-		{
-			m_CurrentAverageDuration += ProfilerDatas[i].Duration;
-			AllProfilerDatas.emplace_back(ProfilerDatas[i]);
-		}
-		for (uint32_t i{ 0u }; i < AllProfilerDatas.size(); ++i)
-		{
-			m_AverageDurationSinceStart += AllProfilerDatas[i].Duration;
-		}
-		m_SummedDurationOverFrames = m_CurrentAverageDuration;
-		m_CurrentAverageDuration /= ProfilerDatas.size();
-		m_AverageDurationSinceStart /= AllProfilerDatas.size();
-		m_CurrentMeasureNr++;
-		ProfilerDatas.clear();
-		return std::make_pair(m_CurrentAverageDuration, m_AverageDurationSinceStart);
+		Profiler::Get().Record(m_pName, m_Begin, __rdtsc());
 	}
-	[[nodiscard]] static constexpr bool IsValid() noexcept { return !ProfilerDatas.empty() && (m_CurrentMeasureNr != m_MaxMeasurements); }
-};
\ No newline at end of file
+	ProfileScope(const ProfileScope& other) = delete;
+	ProfileScope& operator=(const ProfileScope& other) = delete;
+private:
+	const char* m_pName;
+	uint64_t m_Begin;
+};
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "ProfilerBenchmark.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	void RecordFlat(uint32_t nrOfScopes) noexcept
+	{
+		for (uint32_t i{ 0u }; i < nrOfScopes; ++i)
+		{
+			PROFILE_SCOPE("Benchmark scope");
+		}
+	}
+
+	//Four levels deep, every iteration is four scopes.
+	void RecordNested(uint32_t nrOfScopes) noexcept
+	{
+		for (uint32_t i{ 0u }; i < nrOfScopes / 4u; ++i)
+		{
+			PROFILE_SCOPE("Benchmark level 0");
+			{
+				PROFILE_SCOPE("Benchmark level 1");
+				{
+					PROFILE_SCOPE("Benchmark level 2");
+					{
+						PROFILE_SCOPE("Benchmark level 3");
+					}
+				}
+			}
+		}
+	}
+}
+
+void ProfilerBenchmark::Run() noexcept
+{
+	m_Results.clear();
+	Profiler& profiler = Profiler::Get();
+	//Whatever the frame has recorded so far is lost, the benchmark runs between two frames.
+	static_cast<void>(profiler.DiscardEvents());
+
+	{
+		ProfilerBenchmarkResult result;
+		result.Name = "Flat";
+		result.NrOfThreads = 1u;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t batch{ 0u }; batch < s_NrOfBatches; ++batch)
+		{
+			RecordFlat(s_NrOfScopesPerBatch);
+			result.NrOfDropped += profiler.DiscardEvents();
+		}
+		auto dif = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start);
+		result.ScopeCost = static_cast<double>(dif.count()) / (s_NrOfBatches * s_NrOfScopesPerBatch);
+		m_Results.push_back(result);
+	}
+
+	{
+		ProfilerBenchmarkResult result;
+		result.Name = "Nested";
+		result.NrOfThreads = 1u;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t batch{ 0u }; batch < s_NrOfBatches; ++batch)
+		{
+			RecordNested(s_NrOfScopesPerBatch);
+			result.NrOfDropped += profiler.DiscardEvents();
+		}
+		auto dif = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start);
+		result.ScopeCost = static_cast<double>(dif.count()) / (s_NrOfBatches * s_NrOfScopesPerBatch);
+		m_Results.push_back(result);
+	}
+
+	{
+		//One batch per thread, the time is per scope on one thread. A thread that gets more than two batches drops the rest.
+		ProfilerBenchmarkResult result;
+		result.Name = "All threads";
+		result.NrOfThreads = ThreadPool::Get().GetNrOfThreads();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t batch{ 0u }; batch < s_NrOfBatches; ++batch)
+		{
+			ThreadPool::Get().ParallelFor(result.NrOfThreads, 1u, [&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t i{ begin }; i < end; ++i)
+					{
+						RecordNested(s_NrOfScopesPerBatch);
+					}
+				});
+			result.NrOfDropped += profiler.DiscardEvents();
+		}
+		auto dif = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start);
+		result.ScopeCost = static_cast<double>(dif.count()) / (s_NrOfBatches * s_NrOfScopesPerBatch);
+		m_Results.push_back(result);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Profiler.h"
+
+struct ProfilerBenchmarkResult
+{
+	std::string Name;
+	uint32_t NrOfThreads = 0u;
+	//Cost of one scope in nanoseconds, opening, closing and recording it.
+	double ScopeCost = 0.0;
+	//Scopes that did not fit in their thread's buffer.
+	uint32_t NrOfDropped = 0u;
+};
+
+//Measures the overhead of a profiled scope on the calling thread, nested inside other scopes and on every thread of the pool at once.
+//Every batch fits in half of a thread's buffer, and the buffers are emptied between batches so that the frame's profile does not see them.
+class ProfilerBenchmark
+{
+public:
+	static constexpr uint32_t s_NrOfBatches = 64u;
+	static constexpr uint32_t s_NrOfScopesPerBatch = Profiler::s_NrOfEventsPerThread / 2u;
+	//The cost a scope is allowed to have, in nanoseconds.
+	static constexpr double s_MaxScopeCost = 50.0;
+public:
+	ProfilerBenchmark() noexcept = default;
+	~ProfilerBenchmark() noexcept = default;
+
+	void Run() noexcept;
+
+	[[nodiscard]] const std::vector<ProfilerBenchmarkResult>& GetResults() const noexcept { return m_Results; }
+private:
+	std::vector<ProfilerBenchmarkResult> m_Results = {};
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+//The closest hit along a ray.
+struct RayHit
+{
+	float Distance = FLT_MAX;
+	//Barycentric weights of the second and third vertex of the triangle.
+	float U = 0.0f;
+	float V = 0.0f;
+	uint32_t MeshIndex = UINT32_MAX;
+	//Index of the triangle in the mesh's index buffer, the first index is 3 * TriangleIndex.
+	uint32_t TriangleIndex = UINT32_MAX;
+};
+
+//Eight rays in structure of arrays layout, traced together through the BVH.
+//Works best for coherent rays, for example the primary rays of a block of pixels or the shadow rays from them towards the same light.
+struct alignas(32) RayPacket
+{
+	static constexpr uint32_t s_Size = 8u;
+
+	float OriginX[s_Size];
+	float OriginY[s_Size];
+	float OriginZ[s_Size];
+	float DirectionX[s_Size];
+	float DirectionY[s_Size];
+	float DirectionZ[s_Size];
+	float MinDistance[s_Size];
+	float MaxDistance[s_Size];
+	//Bit i is set when ray i takes part in the query.
+	uint32_t ActiveMask = 0xFFu;
+
+	void Set(uint32_t index, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance) noexcept
+	{
+		OriginX[index] = origin.x;
+		OriginY[index] = origin.y;
+		OriginZ[index] = origin.z;
+		DirectionX[index] = direction.x;
+		DirectionY[index] = direction.y;
+		DirectionZ[index] = direction.z;
+		MinDistance[index] = minDistance;
+		MaxDistance[index] = maxDistance;
+	}
+};
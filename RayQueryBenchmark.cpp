@@ -0,0 +1,216 @@
+#include "pch.h"
+#include "RayQueryBenchmark.h"
+
+namespace
+{
+	constexpr uint32_t s_BlockWidth = 4u;
+	constexpr uint32_t s_BlockHeight = 2u;
+	constexpr float s_MaxDistance = 10000.0f;
+	const std::string s_SharkModel = "Models/Shark.obj";
+
+	//Runs the function once per packet and returns the rays per second.
+	template<typename Function>
+	double MeasureRaysPerSecond(const std::vector<RayPacket>& packets, uint32_t nrOfRays, Function function) noexcept
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		uint32_t nrOfHits = 0u;
+		for (const RayPacket& packet : packets)
+		{
+			nrOfHits += function(packet);
+		}
+		auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+		const double seconds = static_cast<double>(dif.count()) * 0.000001;
+		//The hit count keeps the queries from being optimized away.
+		return seconds > 0.0 && nrOfHits != UINT32_MAX ? nrOfRays / seconds : 0.0;
+	}
+
+	bool SameHit(const RayHit& a, bool hitA, const RayHit& b, bool hitB) noexcept
+	{
+		if (hitA != hitB)
+			return false;
+		return !hitA || std::fabs(a.Distance - b.Distance) <= 1.0e-3f * std::max(1.0f, a.Distance);
+	}
+}
+
+void RayQueryBenchmark::Run(const Scene& scene, const DirectX::XMFLOAT4X4& viewProjection, uint32_t width, uint32_t height) noexcept
+{
+	m_Results.clear();
+	const std::vector<VertexObject*>& objects = scene.GetObjectList();
+
+	//The Shark model in model space, seen from the front so that the whole model fills the grid.
+	auto sharkIt = std::find_if(objects.begin(), objects.end(), [](const VertexObject* pObject) noexcept { return pObject->GetModel()->GetName() == s_SharkModel; });
+	if (sharkIt != objects.end())
+	{
+		const std::shared_ptr<Model>& pShark = (*sharkIt)->GetModel();
+		const DirectX::BoundingSphere& sphere = pShark->GetBoundingSphere();
+		const DirectX::XMVECTOR center = DirectX::XMLoadFloat3(&sphere.Center);
+		const DirectX::XMVECTOR eye = DirectX::XMVectorAdd(center, DirectX::XMVectorSet(0.0f, 0.0f, -3.0f * sphere.Radius, 0.0f));
+		DirectX::XMFLOAT4X4 sharkViewProjection;
+		DirectX::XMStoreFloat4x4(&sharkViewProjection, DirectX::XMMatrixMultiply(
+			DirectX::XMMatrixLookAtLH(eye, center, DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)),
+			DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4, 1.0f, 0.1f, s_MaxDistance)));
+		GenerateRays(sharkViewProjection, s_SharkResolution, s_SharkResolution);
+		m_Results.push_back(Measure(s_SharkModel, pShark->GetBVH()));
+	}
+
+	//The whole room scene flattened into world space.
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<ModelBVH::Triangle> triangles;
+	scene.GatherWorldTriangles(triangles);
+	m_RoomBVH.Build(std::move(triangles));
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_RoomBuildTime = static_cast<double>(dif.count()) * 0.001;
+
+	GenerateRays(viewProjection, width, height);
+	m_Results.push_back(Measure("Room scene", m_RoomBVH));
+	m_NrOfSceneMismatches = CountSceneMismatches(scene);
+}
+
+void RayQueryBenchmark::GenerateRays(const DirectX::XMFLOAT4X4& viewProjection, uint32_t width, uint32_t height) noexcept
+{
+	const DirectX::XMMATRIX inverseViewProjection = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&viewProjection));
+	m_Packets.clear();
+	for (uint32_t blockY{ 0u }; blockY < height; blockY += s_BlockHeight)
+	{
+		for (uint32_t blockX{ 0u }; blockX < width; blockX += s_BlockWidth)
+		{
+			RayPacket packet;
+			packet.ActiveMask = 0u;
+			for (uint32_t i{ 0u }; i < RayPacket::s_Size; ++i)
+			{
+				const uint32_t x = blockX + i % s_BlockWidth;
+				const uint32_t y = blockY + i / s_BlockWidth;
+				//Rays outside the image stay in the packet as inactive lanes.
+				const float ndcX = (static_cast<float>(std::min(x, width - 1u)) + 0.5f) / width * 2.0f - 1.0f;
+				const float ndcY = 1.0f - (static_cast<float>(std::min(y, height - 1u)) + 0.5f) / height * 2.0f;
+				DirectX::XMVECTOR nearPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), inverseViewProjection);
+				DirectX::XMVECTOR farPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), inverseViewProjection);
+				DirectX::XMFLOAT3 origin = {};
+				DirectX::XMFLOAT3 direction = {};
+				DirectX::XMStoreFloat3(&origin, nearPoint);
+				DirectX::XMStoreFloat3(&direction, DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(farPoint, nearPoint)));
+				packet.Set(i, origin, direction, 0.0f, s_MaxDistance);
+				if (x < width && y < height)
+				{
+					packet.ActiveMask |= 1u << i;
+				}
+			}
+			m_Packets.push_back(packet);
+		}
+	}
+}
+
+RayQueryBenchmarkResult RayQueryBenchmark::Measure(const std::string& name, const ModelBVH& bvh) const noexcept
+{
+	RayQueryBenchmarkResult result;
+	result.Name = name;
+	result.NrOfTriangles = bvh.GetNrOfTriangles();
+
+	//Check the wide BVH against the binary one before timing anything.
+	for (const RayPacket& packet : m_Packets)
+	{
+		RayHit packetHits[RayPacket::s_Size];
+		const uint32_t packetHitMask = bvh.Intersect(packet, packetHits);
+		const uint32_t packetAnyHitMask = bvh.IntersectAny(packet);
+		for (uint32_t i{ 0u }; i < RayPacket::s_Size; ++i)
+		{
+			if ((packet.ActiveMask & (1u << i)) == 0u)
+				continue;
+
+			const DirectX::XMFLOAT3 origin = { packet.OriginX[i], packet.OriginY[i], packet.OriginZ[i] };
+			const DirectX::XMFLOAT3 direction = { packet.DirectionX[i], packet.DirectionY[i], packet.DirectionZ[i] };
+			RayHit binaryHit, singleHit;
+			const bool hitBinary = bvh.IntersectBinary(origin, direction, packet.MinDistance[i], packet.MaxDistance[i], binaryHit);
+			const bool hitSingle = bvh.Intersect(origin, direction, packet.MinDistance[i], packet.MaxDistance[i], singleHit);
+			const bool hitPacket = (packetHitMask & (1u << i)) != 0u;
+			const bool hitPacketAny = (packetAnyHitMask & (1u << i)) != 0u;
+			result.NrOfRays++;
+			result.NrOfHits += hitBinary ? 1u : 0u;
+			if (!SameHit(binaryHit, hitBinary, singleHit, hitSingle) || !SameHit(binaryHit, hitBinary, packetHits[i], hitPacket) || hitPacketAny != hitPacket)
+			{
+				result.NrOfMismatches++;
+			}
+		}
+	}
+	DBG_ASSERT(result.NrOfMismatches <= result.NrOfRays / 1000u, "Error! The wide BVH disagrees with the binary one.");
+
+	result.BinaryRaysPerSecond = MeasureRaysPerSecond(m_Packets, result.NrOfRays, [&](const RayPacket& packet) noexcept
+		{
+			uint32_t nrOfHits = 0u;
+			for (uint32_t i{ 0u }; i < RayPacket::s_Size; ++i)
+			{
+				if ((packet.ActiveMask & (1u << i)) == 0u)
+					continue;
+				RayHit hit;
+				nrOfHits += bvh.IntersectBinary({ packet.OriginX[i], packet.OriginY[i], packet.OriginZ[i] }, { packet.DirectionX[i], packet.DirectionY[i], packet.DirectionZ[i] }, packet.MinDistance[i], packet.MaxDistance[i], hit) ? 1u : 0u;
+			}
+			return nrOfHits;
+		});
+	result.SingleRaysPerSecond = MeasureRaysPerSecond(m_Packets, result.NrOfRays, [&](const RayPacket& packet) noexcept
+		{
+			uint32_t nrOfHits = 0u;
+			for (uint32_t i{ 0u }; i < RayPacket::s_Size; ++i)
+			{
+				if ((packet.ActiveMask & (1u << i)) == 0u)
+					continue;
+				RayHit hit;
+				nrOfHits += bvh.Intersect({ packet.OriginX[i], packet.OriginY[i], packet.OriginZ[i] }, { packet.DirectionX[i], packet.DirectionY[i], packet.DirectionZ[i] }, packet.MinDistance[i], packet.MaxDistance[i], hit) ? 1u : 0u;
+			}
+			return nrOfHits;
+		});
+	result.PacketRaysPerSecond = MeasureRaysPerSecond(m_Packets, result.NrOfRays, [&](const RayPacket& packet) noexcept
+		{
+			RayHit hits[RayPacket::s_Size];
+			return static_cast<uint32_t>(_mm_popcnt_u32(bvh.Intersect(packet, hits)));
+		});
+	result.SingleAnyHitRaysPerSecond = MeasureRaysPerSecond(m_Packets, result.NrOfRays, [&](const RayPacket& packet) noexcept
+		{
+			uint32_t nrOfHits = 0u;
+			for (uint32_t i{ 0u }; i < RayPacket::s_Size; ++i)
+			{
+				if ((packet.ActiveMask & (1u << i)) == 0u)
+					continue;
+				nrOfHits += bvh.IntersectAny({ packet.OriginX[i], packet.OriginY[i], packet.OriginZ[i] }, { packet.DirectionX[i], packet.DirectionY[i], packet.DirectionZ[i] }, packet.MinDistance[i], packet.MaxDistance[i]) ? 1u : 0u;
+			}
+			return nrOfHits;
+		});
+	result.PacketAnyHitRaysPerSecond = MeasureRaysPerSecond(m_Packets, result.NrOfRays, [&](const RayPacket& packet) noexcept
+		{
+			return static_cast<uint32_t>(_mm_popcnt_u32(bvh.IntersectAny(packet)));
+		});
+	return result;
+}
+
+uint32_t RayQueryBenchmark::CountSceneMismatches(const Scene& scene) const noexcept
+{
+	//The two level queries of the scene have to find the same closest hits as the flattened room.
+	uint32_t nrOfMismatches = 0u;
+	uint32_t nrOfRays = 0u;
+	for (const RayPacket& packet : m_Packets)
+	{
+		for (uint32_t i{ 0u }; i < RayPacket::s_Size; ++i)
+		{
+			if ((packet.ActiveMask & (1u << i)) == 0u)
+				continue;
+
+			SceneRay ray = {};
+			ray.Origin = { packet.OriginX[i], packet.OriginY[i], packet.OriginZ[i] };
+			ray.Direction = { packet.DirectionX[i], packet.DirectionY[i], packet.DirectionZ[i] };
+			ray.MinDistance = packet.MinDistance[i];
+			ray.MaxDistance = packet.MaxDistance[i];
+			RayHit roomHit;
+			SceneRayHit sceneHit;
+			const bool hitRoom = m_RoomBVH.Intersect(ray.Origin, ray.Direction, ray.MinDistance, ray.MaxDistance, roomHit);
+			const bool hitScene = scene.RayCast(ray, sceneHit);
+			RayHit sceneRayHit;
+			sceneRayHit.Distance = sceneHit.Distance;
+			if (!SameHit(roomHit, hitRoom, sceneRayHit, hitScene))
+			{
+				nrOfMismatches++;
+			}
+			nrOfRays++;
+		}
+	}
+	DBG_ASSERT(nrOfMismatches <= nrOfRays / 1000u, "Error! The scene ray casts disagree with the flattened scene.");
+	return nrOfMismatches;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Scene.h"
+
+struct RayQueryBenchmarkResult
+{
+	std::string Name = "";
+	uint32_t NrOfTriangles = 0u;
+	uint32_t NrOfRays = 0u;
+	uint32_t NrOfHits = 0u;
+	//Rays whose closest hit on the wide BVH, single or packet, differs from the binary reference.
+	uint32_t NrOfMismatches = 0u;
+	//Rays per second on one thread.
+	double BinaryRaysPerSecond = 0.0;
+	double SingleRaysPerSecond = 0.0;
+	double PacketRaysPerSecond = 0.0;
+	double SingleAnyHitRaysPerSecond = 0.0;
+	double PacketAnyHitRaysPerSecond = 0.0;
+};
+
+//Measures the CPU ray queries: the binary BVH, single rays on the wide BVH and packets of eight on the wide BVH, for closest and any hit.
+//One run shoots a grid of camera rays at the Shark model, and the current view's rays at the whole room scene flattened into world space.
+//The rays are ordered in 4x2 pixel blocks so that every packet is coherent.
+class RayQueryBenchmark
+{
+public:
+	static constexpr uint32_t s_SharkResolution = 256u;
+public:
+	RayQueryBenchmark() noexcept = default;
+	~RayQueryBenchmark() noexcept = default;
+
+	void Run(const Scene& scene, const DirectX::XMFLOAT4X4& viewProjection, uint32_t width, uint32_t height) noexcept;
+
+	[[nodiscard]] const std::vector<RayQueryBenchmarkResult>& GetResults() const noexcept { return m_Results; }
+	//Time to flatten the room scene and build its BVH in milliseconds.
+	[[nodiscard]] constexpr double GetRoomBuildTime() const noexcept { return m_RoomBuildTime; }
+	//Room scene rays whose closest hit through the scene's ray casts differs from the flattened BVH.
+	[[nodiscard]] constexpr uint32_t GetNrOfSceneMismatches() const noexcept { return m_NrOfSceneMismatches; }
+private:
+	void GenerateRays(const DirectX::XMFLOAT4X4& viewProjection, uint32_t width, uint32_t height) noexcept;
+	RayQueryBenchmarkResult Measure(const std::string& name, const ModelBVH& bvh) const noexcept;
+	uint32_t CountSceneMismatches(const Scene& scene) const noexcept;
+private:
+	std::vector<RayPacket> m_Packets = {};
+	std::vector<RayQueryBenchmarkResult> m_Results = {};
+	ModelBVH m_RoomBVH = {};
+	double m_RoomBuildTime = 0.0;
+	uint32_t m_NrOfSceneMismatches = 0u;
+};
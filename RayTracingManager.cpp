@@ -1,287 +1,331 @@
 #include "pch.h"
 #include "RayTracingManager.h"
+#include "Window.h"
 
 void RayTracingManager::Initialize(
 	const std::unordered_map<std::string, std::shared_ptr<Model>>& models,
 	const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& objects,
-	uint32_t totalNrMeshes
+	uint32_t totalNrObjects
 ) noexcept
 {
-	//Create the bottom level acceleration structure, send in the vertex data which consists of the local vertex data for all different models used.
+	//Create the bottom level acceleration structures, one for each unique model with one geometry per mesh.
 	//Only one instance of each model in this vertex buffer.
 	BuildBottomAcceleration(models);
 
-	//Make sure we are finished building the bottom level acceleration structure before using it.
-	std::unique_ptr<D3D12_RESOURCE_BARRIER[]> uavBarrier(DBG_NEW D3D12_RESOURCE_BARRIER[m_BottomBuffers]);
-	
-	uint32_t index = 0;
-	for (auto& resultBufferMapEntry : m_ResultBuffersBottom)
-	{
-		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>& resultBufferVector = resultBufferMapEntry.second;
-		for (auto& resultBuffer : resultBufferVector)
-		{
-			uavBarrier[index] = {};
-			uavBarrier[index].Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-			uavBarrier[index].UAV.pResource = resultBuffer.Get();
-
-			index++;
-		}
-	}
-	STDCALL(DXCore::GetCommandList()->ResourceBarrier((UINT)m_ResultBuffersBottom.size(), uavBarrier.get()));
+	//Make sure we are finished building the bottom level acceleration structures before using them.
+	//They all live in the same buffer, so one barrier covers every build.
+	D3D12_RESOURCE_BARRIER uavBarrier = {};
+	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	uavBarrier.UAV.pResource = m_pResultBufferBottom.Get();
+	STDCALL(DXCore::GetCommandList()->ResourceBarrier(1, &uavBarrier));
 
-	BuildTopAcceleration(models, objects, totalNrMeshes);
+	//Move the bottom level acceleration structures into a buffer of their compacted size before the top level structure points to them.
+	CompactBottomAcceleration();
 
-	D3D12_RESOURCE_BARRIER topBarrier = {};
-	topBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-	topBarrier.UAV.pResource = m_pResultBufferTop.Get();
-	STDCALL(DXCore::GetCommandList()->ResourceBarrier(1, &topBarrier));
+	BuildTopAcceleration(models, objects, totalNrObjects);
 }
 
-void RayTracingManager::UpdateInstances(
-	const std::unordered_map<std::string, std::shared_ptr<Model>>& models,
-	const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& objects,
-	uint32_t totalNrMeshes
-) noexcept
+
+void RayTracingManager::UpdateInstances() noexcept
 {
-	uint32_t index = 0u;
-	//For each unique model
-	for (auto& model : models)
+	//Only the instances whose object has moved since this frame's instance buffer was last written are packed again.
+	const uint32_t frameIndex = Window::Get().GetCurrentFrameInFlightIndex();
+	for (uint32_t i{ 0u }; i < m_NrOfInstancesTop; ++i)
 	{
-		//For each object using that unique model.
-		std::string currentModelName = model.first;
-		std::vector<std::shared_ptr<VertexObject>> currentVector = objects.at(currentModelName);
-		for (auto& object : currentVector)
-		{
-			//For each mesh that object uses.
-			const std::vector<std::unique_ptr<Mesh>>& objectMeshes = object->GetModel()->GetMeshes();
-			for (uint32_t i{ 0u }; i < objectMeshes.size(); i++)
-			{
-				DirectX::XMMATRIX objectMatrix = DirectX::XMLoadFloat4x4(&object->GetTransform());
-				objectMatrix = DirectX::XMMatrixTranspose(objectMatrix);
-				DirectX::XMFLOAT4X4 objectTransform = {};
-				DirectX::XMStoreFloat4x4(&objectTransform, objectMatrix);
-				//Change the transform to use the object's transform
-				//First row.
-				m_InstancingDescs[index].Transform[0][0] = objectTransform._11;
-				m_InstancingDescs[index].Transform[0][1] = objectTransform._12;
-				m_InstancingDescs[index].Transform[0][2] = objectTransform._13;
-				m_InstancingDescs[index].Transform[0][3] = objectTransform._14;
-				//Second row.
-				m_InstancingDescs[index].Transform[1][0] = objectTransform._21;
-				m_InstancingDescs[index].Transform[1][1] = objectTransform._22;
-				m_InstancingDescs[index].Transform[1][2] = objectTransform._23;
-				m_InstancingDescs[index].Transform[1][3] = objectTransform._24;
-				//Third row.
-				m_InstancingDescs[index].Transform[2][0] = objectTransform._31;
-				m_InstancingDescs[index].Transform[2][1] = objectTransform._32;
-				m_InstancingDescs[index].Transform[2][2] = objectTransform._33;
-				m_InstancingDescs[index].Transform[2][3] = objectTransform._34;
-
-				index++;
-			}
-		}
+		m_TopInstanceVersions[i] = m_TopInstanceObjects[i]->GetVersions().Transform;
 	}
+	m_NrOfPackedInstances = m_InstancePackers[frameIndex].Pack(m_TopInstanceTransforms.data(), m_TopInstanceVersions.data(), m_NrOfInstancesTop, m_pMappedInstanceDescsTop[frameIndex]);
+	m_InstancePackTime = m_InstancePackers[frameIndex].GetPackTime();
 
-	//Copy the desc to the created buffer resource.
-	D3D12_RANGE zero = { 0, 0 };
-	unsigned char* mappedPtr = nullptr;
-	HR(m_pInstanceBufferTop->Map(0, &zero, reinterpret_cast<void**>(&mappedPtr)));
-	std::memcpy(mappedPtr, m_InstancingDescs.get(), sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * totalNrMeshes);
-	STDCALL(m_pInstanceBufferTop->Unmap(0, nullptr));
-
-	//Create the top level acceleration structure description.
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS topInputs = {};
-	{
-		topInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
-		topInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE; //Maybe change this to faster build and make it a member variable.
-		topInputs.NumDescs = totalNrMeshes;
-		topInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-		topInputs.InstanceDescs = m_pInstanceBufferTop->GetGPUVirtualAddress();
-	}
+	//Refit the top level acceleration structure in place unless the policy asks for a full build.
+	const TLASBuildDecision& decision = m_TLASUpdatePolicy.Decide(m_NrOfInstancesTop);
+	BuildTop(decision, frameIndex);
+}
 
-	//Finally create the acceleration structure.
-	m_AccelerationDescTop = std::make_unique<D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC>();
-	{
-		m_AccelerationDescTop->DestAccelerationStructureData = m_pResultBufferTop->GetGPUVirtualAddress();
-		m_AccelerationDescTop->Inputs = topInputs;
-		m_AccelerationDescTop->SourceAccelerationStructureData = NULL; //Change this when dynamic scene?
-		m_AccelerationDescTop->ScratchAccelerationStructureData = m_pScratchBufferTop->GetGPUVirtualAddress();
-	}
+void RayTracingManager::BuildTop(const TLASBuildDecision& decision, uint32_t frameIndex) noexcept
+{
+	TLASUpdatePolicy::FillBuildDescription(
+		decision,
+		m_pInstanceBuffersTop[frameIndex]->GetGPUVirtualAddress(),
+		m_pResultBufferTop->GetGPUVirtualAddress(),
+		m_pScratchBufferTop->GetGPUVirtualAddress(),
+		m_AccelerationDescTop
+	);
+	STDCALL(DXCore::GetCommandList()->BuildRaytracingAccelerationStructure(&m_AccelerationDescTop, 0, nullptr));
 
-	STDCALL(DXCore::GetCommandList()->BuildRaytracingAccelerationStructure(m_AccelerationDescTop.get(), 0, nullptr));
+	//The next update reads the result, and the pixel shader traces against it, so the build has to finish first.
+	D3D12_RESOURCE_BARRIER topBarrier = {};
+	topBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	topBarrier.UAV.pResource = m_pResultBufferTop.Get();
+	STDCALL(DXCore::GetCommandList()->ResourceBarrier(1, &topBarrier));
 }
 
 void RayTracingManager::BuildBottomAcceleration(
 	const std::unordered_map<std::string, std::shared_ptr<Model>>& models
 ) noexcept
 {
-	//Create the descriptions of the different geometries.
-	D3D12_RAYTRACING_GEOMETRY_DESC geometryDescs[1] = {};
-	{
-		geometryDescs[0].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-		geometryDescs[0].Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-		geometryDescs[0].Triangles.Transform3x4 = NULL;
-		geometryDescs[0].Triangles.IndexFormat = DXGI_FORMAT_UNKNOWN; //Maybe change later?
-		geometryDescs[0].Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-		geometryDescs[0].Triangles.VertexBuffer.StrideInBytes = /*sizeof(Vertex)*/ sizeof(float) * 3;
-	}
-
 	//Create the bottom level acceleration structure input desc.
+	//The structures never change after this, so they are compacted once they have been built.
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS bottomInputs = {};
 	{
 		bottomInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
-		bottomInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE; //Maybe swap this for better performance in a dynamic scene.
-		bottomInputs.NumDescs = 1;
+		bottomInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE | D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
 		bottomInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 	}
-	
-	//Go through each unique model and create a result- & scratchbuffer for each mesh.
+
+	//Create the descriptions of the geometries of every unique model, one for each of its meshes, and get the sizes of the builds.
+	m_BottomStructureIndices.clear();
+	m_BLASCompactor.Clear();
+	m_BLASBuildPlanner.Clear();
+	std::vector<std::vector<D3D12_RAYTRACING_GEOMETRY_DESC>> geometryDescs(models.size());
 	for (auto& model : models)
 	{
-		std::string currentModelName = model.first;
+		const std::string& currentModelName = model.first;
 		const std::vector<std::unique_ptr<Mesh>>& modelMeshes = model.second->GetMeshes();
+		const uint32_t structureIndex = m_BLASBuildPlanner.GetNrOfBuilds();
 
-		m_ResultBuffersBottom.insert(std::pair(currentModelName, std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>()));
-		m_ScratchBuffersBottom.insert(std::pair(currentModelName, std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>()));
-		m_AccelerationDescsBottom.insert(std::pair(currentModelName, std::vector<std::shared_ptr<D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC>>()));
-
-		//For each mesh in the current model.
+		std::vector<D3D12_RAYTRACING_GEOMETRY_DESC>& modelGeometryDescs = geometryDescs[structureIndex];
+		modelGeometryDescs.resize(modelMeshes.size());
 		for (uint32_t i{ 0u }; i < modelMeshes.size(); i++)
 		{
-			geometryDescs[0].Triangles.IndexCount = modelMeshes[i]->GetIndexCount();
-			geometryDescs[0].Triangles.VertexCount = modelMeshes[i]->GetVertexCount();
-			geometryDescs[0].Triangles.IndexBuffer = modelMeshes[i]->GetIndexBufferGPUAddress();
-			geometryDescs[0].Triangles.VertexBuffer.StartAddress = modelMeshes[i]->GetVertexBufferGPUAddress();
-			geometryDescs[0].Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
-			geometryDescs[0].Triangles.VertexFormat = DXGI_FORMAT::DXGI_FORMAT_R32G32B32_FLOAT;
-			geometryDescs[0].Triangles.IndexFormat = DXGI_FORMAT::DXGI_FORMAT_R32_UINT;
-			bottomInputs.pGeometryDescs = geometryDescs;
-
-			//Get prebuild info that is used for creating the acceleration structure.
-			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
-			STDCALL(DXCore::GetDevice()->GetRaytracingAccelerationStructurePrebuildInfo(&bottomInputs, &prebuildInfo));
-
-			//Create temporary local Result & Scratchbuffer which we then put into the unordered maps which can be accessed with the model's name.
-			Microsoft::WRL::ComPtr<ID3D12Resource> tempResult = nullptr;
-			//Create the result buffer.
-			CreateCommitedBuffer(
-				"Bottom Level Acceleration Structure - Resultbuffer: " + currentModelName,
-				tempResult,
-				D3D12_HEAP_TYPE_DEFAULT,
-				prebuildInfo.ResultDataMaxSizeInBytes,
-				D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-				D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE
-			);
-
-			Microsoft::WRL::ComPtr<ID3D12Resource> tempScratch = nullptr;
-			//Create the scratch buffer.
-			CreateCommitedBuffer(
-				"Bottom Level Acceleration Structure - Scratchbuffer: " + currentModelName,
-				tempScratch,
-				D3D12_HEAP_TYPE_DEFAULT,
-				prebuildInfo.ScratchDataSizeInBytes,
-				D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-				D3D12_RESOURCE_STATE_UNORDERED_ACCESS
-			);
-
-			//Finally create the acceleration structure for this model mesh.
-			std::shared_ptr<D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC> accelerationDesc = std::make_unique<D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC>();
-			{
-				accelerationDesc->DestAccelerationStructureData = tempResult->GetGPUVirtualAddress();
-				accelerationDesc->Inputs = bottomInputs;
-				accelerationDesc->SourceAccelerationStructureData = NULL; //Change this when dynamic scene?
-				accelerationDesc->ScratchAccelerationStructureData = tempScratch->GetGPUVirtualAddress();
-			}
-			//Insert the created buffers into the unordered map vectors.
-			m_ResultBuffersBottom[currentModelName].push_back(std::move(tempResult));
-			m_ScratchBuffersBottom[currentModelName].push_back(std::move(tempScratch));
-			m_AccelerationDescsBottom[currentModelName].push_back(accelerationDesc);
-
-			STDCALL(DXCore::GetCommandList()->BuildRaytracingAccelerationStructure(accelerationDesc.get(), 0, nullptr)); //Maybe catch postbuild info here when rebuilding/refitting is needed?
-			m_BottomBuffers++;
+			D3D12_RAYTRACING_GEOMETRY_DESC& geometryDesc = modelGeometryDescs[i];
+			geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+			geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+			geometryDesc.Triangles.Transform3x4 = NULL;
+			geometryDesc.Triangles.IndexFormat = DXGI_FORMAT::DXGI_FORMAT_R32_UINT;
+			geometryDesc.Triangles.VertexFormat = DXGI_FORMAT::DXGI_FORMAT_R32G32B32_FLOAT;
+			geometryDesc.Triangles.IndexCount = modelMeshes[i]->GetIndexCount();
+			geometryDesc.Triangles.VertexCount = modelMeshes[i]->GetVertexCount();
+			geometryDesc.Triangles.IndexBuffer = modelMeshes[i]->GetIndexBufferGPUAddress();
+			geometryDesc.Triangles.VertexBuffer.StartAddress = modelMeshes[i]->GetVertexBufferGPUAddress();
+			geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
+		}
+		bottomInputs.NumDescs = static_cast<UINT>(modelGeometryDescs.size());
+		bottomInputs.pGeometryDescs = modelGeometryDescs.data();
+
+		//Get prebuild info that is used for placing the acceleration structure.
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
+		STDCALL(DXCore::GetDevice()->GetRaytracingAccelerationStructurePrebuildInfo(&bottomInputs, &prebuildInfo));
+
+		m_BLASBuildPlanner.Add(prebuildInfo.ResultDataMaxSizeInBytes, prebuildInfo.ScratchDataSizeInBytes);
+		m_BLASCompactor.Add(currentModelName, prebuildInfo.ResultDataMaxSizeInBytes, prebuildInfo.ScratchDataSizeInBytes);
+		m_BottomStructureIndices.insert(std::pair(currentModelName, structureIndex));
+	}
+	m_BLASBuildPlanner.Plan();
+
+	//Create one result buffer for all structures and one scratch buffer that is shared by the builds.
+	CreateCommitedBuffer(
+		"Bottom Level Acceleration Structure - Resultbuffer",
+		m_pResultBufferBottom,
+		D3D12_HEAP_TYPE_DEFAULT,
+		m_BLASBuildPlanner.GetResultBufferSize(),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE
+	);
+	CreateCommitedBuffer(
+		"Bottom Level Acceleration Structure - Scratchbuffer",
+		m_pScratchBufferBottom,
+		D3D12_HEAP_TYPE_DEFAULT,
+		m_BLASBuildPlanner.GetScratchBufferSize(),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+	);
+	//Every build writes its compacted size into this buffer.
+	CreateCommitedBuffer(
+		"Bottom Level Acceleration Structure - PostbuildInfoBuffer",
+		m_pPostbuildInfoBufferBottom,
+		D3D12_HEAP_TYPE_DEFAULT,
+		m_BLASCompactor.GetPostbuildInfoSize(),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+	);
+
+	//Finally build the acceleration structures, in the order they were planned in.
+	m_BottomStructureOffsets.resize(m_BLASBuildPlanner.GetNrOfBuilds());
+	for (uint32_t i{ 0u }; i < m_BLASBuildPlanner.GetNrOfBuilds(); ++i)
+	{
+		const BLASBuildPlacement& placement = m_BLASBuildPlanner.GetPlacement(i);
+		//The builds of the previous batch used the same scratch memory, so they have to finish first.
+		if (i != 0u && placement.Batch != m_BLASBuildPlanner.GetPlacement(i - 1u).Batch)
+		{
+			D3D12_RESOURCE_BARRIER scratchBarrier = {};
+			scratchBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+			scratchBarrier.UAV.pResource = m_pScratchBufferBottom.Get();
+			STDCALL(DXCore::GetCommandList()->ResourceBarrier(1, &scratchBarrier));
+		}
+
+		bottomInputs.NumDescs = static_cast<UINT>(geometryDescs[i].size());
+		bottomInputs.pGeometryDescs = geometryDescs[i].data();
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC accelerationDesc = {};
+		{
+			accelerationDesc.DestAccelerationStructureData = m_pResultBufferBottom->GetGPUVirtualAddress() + placement.ResultOffset;
+			accelerationDesc.Inputs = bottomInputs;
+			accelerationDesc.SourceAccelerationStructureData = NULL;
+			accelerationDesc.ScratchAccelerationStructureData = m_pScratchBufferBottom->GetGPUVirtualAddress() + placement.ScratchOffset;
+		}
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuildInfoDesc = {};
+		{
+			postbuildInfoDesc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+			postbuildInfoDesc.DestBuffer = m_pPostbuildInfoBufferBottom->GetGPUVirtualAddress() + BLASCompactor::GetPostbuildInfoOffset(i);
 		}
+		STDCALL(DXCore::GetCommandList()->BuildRaytracingAccelerationStructure(&accelerationDesc, 1, &postbuildInfoDesc));
+		m_BottomStructureOffsets[i] = placement.ResultOffset;
 	}
 }
 
+void RayTracingManager::CompactBottomAcceleration() noexcept
+{
+	//Read the compacted sizes back to the CPU.
+	Microsoft::WRL::ComPtr<ID3D12Resource> pReadbackBuffer = nullptr;
+	CreateCommitedBuffer(
+		"Bottom Level Acceleration Structure - PostbuildInfoReadbackBuffer",
+		pReadbackBuffer,
+		D3D12_HEAP_TYPE_READBACK,
+		m_BLASCompactor.GetPostbuildInfoSize(),
+		D3D12_RESOURCE_FLAG_NONE,
+		D3D12_RESOURCE_STATE_COPY_DEST
+	);
+	RenderCommand::TransitionResource(m_pPostbuildInfoBufferBottom, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	STDCALL(DXCore::GetCommandList()->CopyResource(pReadbackBuffer.Get(), m_pPostbuildInfoBufferBottom.Get()));
+	SubmitAndWait();
+
+	const uint32_t nrOfStructures = m_BLASCompactor.GetNrOfStructures();
+	std::vector<uint64_t> compactedSizes(nrOfStructures);
+	uint64_t* pMappedSizes = nullptr;
+	D3D12_RANGE readRange = { 0, static_cast<SIZE_T>(m_BLASCompactor.GetPostbuildInfoSize()) };
+	D3D12_RANGE writeRange = { 0, 0 };
+	HR(pReadbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pMappedSizes)));
+	std::memcpy(compactedSizes.data(), pMappedSizes, sizeof(uint64_t) * nrOfStructures);
+	STDCALL(pReadbackBuffer->Unmap(0, &writeRange));
+	m_BLASCompactor.SetCompactedSizes(compactedSizes.data(), nrOfStructures);
+
+	//Every structure is moved, the shared result buffer can only be released once none of them live in it.
+	//They are placed one after the other in a buffer of their combined compacted size.
+	std::vector<uint64_t> compactedOffsets(nrOfStructures);
+	const uint64_t compactedBufferSize = BLASBuildPlanner::PlaceBuffers(compactedSizes.data(), nrOfStructures, compactedOffsets.data());
+	Microsoft::WRL::ComPtr<ID3D12Resource> pCompactedBuffer = nullptr;
+	CreateCommitedBuffer(
+		"Bottom Level Acceleration Structure - Compacted Resultbuffer",
+		pCompactedBuffer,
+		D3D12_HEAP_TYPE_DEFAULT,
+		compactedBufferSize,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE
+	);
+	for (uint32_t i{ 0u }; i < nrOfStructures; ++i)
+	{
+		STDCALL(DXCore::GetCommandList()->CopyRaytracingAccelerationStructure(
+			pCompactedBuffer->GetGPUVirtualAddress() + compactedOffsets[i],
+			m_pResultBufferBottom->GetGPUVirtualAddress() + m_BottomStructureOffsets[i],
+			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT
+		));
+	}
+	D3D12_RESOURCE_BARRIER uavBarrier = {};
+	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	uavBarrier.UAV.pResource = pCompactedBuffer.Get();
+	STDCALL(DXCore::GetCommandList()->ResourceBarrier(1, &uavBarrier));
+	//The copies read the original buffer, so it can only be released once the GPU is done.
+	SubmitAndWait();
+
+	//Swap in the compacted buffer and release the original, the scratch pool and the post build info.
+	m_pResultBufferBottom = std::move(pCompactedBuffer);
+	m_BottomStructureOffsets = std::move(compactedOffsets);
+	m_pScratchBufferBottom.Reset();
+	m_pPostbuildInfoBufferBottom.Reset();
+	m_BLASCompactor.FinishCompaction();
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS RayTracingManager::GetBottomLevelAccelerationStructure(const std::string& modelName) const noexcept
+{
+	const uint32_t structureIndex = m_BottomStructureIndices.at(modelName);
+	return m_pResultBufferBottom->GetGPUVirtualAddress() + m_BottomStructureOffsets[structureIndex];
+}
+
+void RayTracingManager::SubmitAndWait() noexcept
+{
+	auto pCommandAllocator = DXCore::GetCommandAllocators()[0];
+	auto pCommandList = DXCore::GetCommandList();
+
+	HR(pCommandList->Close());
+	ID3D12CommandList* commandLists[] = { pCommandList.Get() };
+	STDCALL(DXCore::GetCommandQueue()->ExecuteCommandLists(ARRAYSIZE(commandLists), commandLists));
+	RenderCommand::Flush();
+
+	HR(pCommandAllocator->Reset());
+	HR(pCommandList->Reset(pCommandAllocator.Get(), nullptr));
+}
+
 void RayTracingManager::BuildTopAcceleration(
 	const std::unordered_map<std::string, std::shared_ptr<Model>>& models,
 	const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& objects,
-	uint32_t totalNrMeshes
+	uint32_t totalNrObjects
 ) noexcept
 {
-	//Create the top level instance buffer resource.
-	CreateCommitedBuffer(
-		"Top Level Acceleration Structure - InstanceBuffer",
-		m_pInstanceBufferTop,
-		D3D12_HEAP_TYPE_UPLOAD,
-		sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * totalNrMeshes,
-		D3D12_RESOURCE_FLAG_NONE,
-		D3D12_RESOURCE_STATE_GENERIC_READ
-	);
+	//Create one top level instance buffer per frame in flight, so that a buffer is not written while the GPU builds from it.
+	//They stay mapped and the transforms are packed straight into them.
+	D3D12_RANGE zero = { 0, 0 };
+	for (uint32_t i{ 0u }; i < NR_OF_FRAMES; ++i)
+	{
+		CreateCommitedBuffer(
+			"Top Level Acceleration Structure - InstanceBuffer #" + std::to_string(i),
+			m_pInstanceBuffersTop[i],
+			D3D12_HEAP_TYPE_UPLOAD,
+			sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * totalNrObjects,
+			D3D12_RESOURCE_FLAG_NONE,
+			D3D12_RESOURCE_STATE_GENERIC_READ
+		);
+		HR(m_pInstanceBuffersTop[i]->Map(0, &zero, reinterpret_cast<void**>(&m_pMappedInstanceDescsTop[i])));
+	}
 
-	//Define the desc for the top level instance buffer resource.
+	//Define the desc for the top level instances. Everything but the transforms stays the same, so it is written once here.
+	m_TopInstanceObjects.clear();
+	m_TopInstanceTransforms.clear();
+	std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instancingDescs(totalNrObjects);
 	uint32_t index = 0u;
-	m_InstancingDescs = std::unique_ptr<D3D12_RAYTRACING_INSTANCE_DESC[]>(DBG_NEW D3D12_RAYTRACING_INSTANCE_DESC[totalNrMeshes]);
 	//For each unique model
 	for (auto& model : models)
 	{
 		//For each object using that unique model.
-		std::string currentModelName = model.first;
-		std::vector<std::shared_ptr<VertexObject>> currentVector = objects.at(currentModelName);
+		const std::string& currentModelName = model.first;
+		const std::vector<std::shared_ptr<VertexObject>>& currentVector = objects.at(currentModelName);
+		//All meshes of the model are geometries in the same bottom level structure, so every object is a single instance.
+		const D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAddress = GetBottomLevelAccelerationStructure(currentModelName);
 		for (auto& object : currentVector)
 		{
-			//For each mesh that object uses.
-			const std::vector<std::unique_ptr<Mesh>>& objectMeshes = object->GetModel()->GetMeshes();
-			for (uint32_t i{ 0u }; i < objectMeshes.size(); i++)
-			{
-				DirectX::XMMATRIX objectMatrix = DirectX::XMLoadFloat4x4(&object->GetTransform());
-				objectMatrix = DirectX::XMMatrixTranspose(objectMatrix);
-				DirectX::XMFLOAT4X4 objectTransform = {};
-				DirectX::XMStoreFloat4x4(&objectTransform, objectMatrix);
-				//Change the transform to use the object's transform
-				//First row.
-				m_InstancingDescs[index].Transform[0][0] = objectTransform._11;
-				m_InstancingDescs[index].Transform[0][1] = objectTransform._12;
-				m_InstancingDescs[index].Transform[0][2] = objectTransform._13;
-				m_InstancingDescs[index].Transform[0][3] = objectTransform._14;
-				//Second row.
-				m_InstancingDescs[index].Transform[1][0] = objectTransform._21;
-				m_InstancingDescs[index].Transform[1][1] = objectTransform._22;
-				m_InstancingDescs[index].Transform[1][2] = objectTransform._23;
-				m_InstancingDescs[index].Transform[1][3] = objectTransform._24;
-				//Third row.
-				m_InstancingDescs[index].Transform[2][0] = objectTransform._31;
-				m_InstancingDescs[index].Transform[2][1] = objectTransform._32;
-				m_InstancingDescs[index].Transform[2][2] = objectTransform._33;
-				m_InstancingDescs[index].Transform[2][3] = objectTransform._34;
-
-				m_InstancingDescs[index].InstanceID = index;
-				m_InstancingDescs[index].InstanceMask = 0xFF;
-				m_InstancingDescs[index].InstanceContributionToHitGroupIndex = 0;
-				m_InstancingDescs[index].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-				m_InstancingDescs[index].AccelerationStructure = ((m_ResultBuffersBottom[currentModelName])[i])->GetGPUVirtualAddress();
-				index++;
-			}
-			//Only increment the index for each object, we do not want different meshes in the same object to have different indices.
-			//This is to be swapped to a material number in the future.
+			m_TopInstanceObjects.push_back(object.get());
+			m_TopInstanceTransforms.push_back(&object->GetTransform());
+
+			instancingDescs[index].InstanceID = index;
+			instancingDescs[index].InstanceMask = 0xFF;
+			instancingDescs[index].InstanceContributionToHitGroupIndex = 0;
+			instancingDescs[index].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+			instancingDescs[index].AccelerationStructure = bottomLevelAddress;
+			index++;
 		}
 	}
-	
-	//Copy the desc to the created buffer resource.
-	D3D12_RANGE zero = { 0, 0 };
-	unsigned char* mappedPtr = nullptr;
-	HR(m_pInstanceBufferTop->Map(0, &zero, reinterpret_cast<void**>(&mappedPtr)));
-	std::memcpy(mappedPtr, m_InstancingDescs.get(), sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * totalNrMeshes);
-	STDCALL(m_pInstanceBufferTop->Unmap(0, nullptr));
+	m_NrOfInstancesTop = totalNrObjects;
+	m_TopInstanceVersions.resize(totalNrObjects);
+	for (uint32_t i{ 0u }; i < totalNrObjects; ++i)
+	{
+		m_TopInstanceVersions[i] = m_TopInstanceObjects[i]->GetVersions().Transform;
+	}
 
-	//Create the top level acceleration structure description.
+	//Fill every instance buffer completely.
+	for (uint32_t i{ 0u }; i < NR_OF_FRAMES; ++i)
+	{
+		std::memcpy(m_pMappedInstanceDescsTop[i], instancingDescs.data(), sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * totalNrObjects);
+		m_InstancePackers[i].Reset(totalNrObjects);
+		m_InstancePackers[i].Pack(m_TopInstanceTransforms.data(), m_TopInstanceVersions.data(), totalNrObjects, m_pMappedInstanceDescsTop[i]);
+	}
+
+	//Create the top level acceleration structure description. It allows updates so that the following frames can refit it in place.
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS topInputs = {};
 	{
 		topInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
-		topInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE; //Maybe change this to faster build and make it a member variable.
-		topInputs.NumDescs = totalNrMeshes;
+		topInputs.Flags = TLASUpdatePolicy::GetBuildFlags(TLASBuildType::BUILD);
+		topInputs.NumDescs = totalNrObjects;
 		topInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-		topInputs.InstanceDescs = m_pInstanceBufferTop->GetGPUVirtualAddress();
+		topInputs.InstanceDescs = m_pInstanceBuffersTop[0]->GetGPUVirtualAddress();
 	}
 
 	//Get prebuild info that is used for creating the acceleration structure.
@@ -299,26 +343,19 @@ void RayTracingManager::BuildTopAcceleration(
 		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE
 	);
 
-	//Create the scratch buffer.
+	//Create the scratch buffer. It is used for both builds and updates.
 	CreateCommitedBuffer(
 		"Top Level Acceleration Structure - ScratchBuffer",
 		m_pScratchBufferTop,
 		D3D12_HEAP_TYPE_DEFAULT,
-		prebuildInfo.ScratchDataSizeInBytes,
+		std::max(prebuildInfo.ScratchDataSizeInBytes, prebuildInfo.UpdateScratchDataSizeInBytes),
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
 		D3D12_RESOURCE_STATE_UNORDERED_ACCESS
 	);
 
-	//Finally create the acceleration structure.
-	m_AccelerationDescTop = std::make_unique<D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC>();
-	{
-		m_AccelerationDescTop->DestAccelerationStructureData = m_pResultBufferTop->GetGPUVirtualAddress();
-		m_AccelerationDescTop->Inputs = topInputs;
-		m_AccelerationDescTop->SourceAccelerationStructureData = NULL; //Change this when dynamic scene?
-		m_AccelerationDescTop->ScratchAccelerationStructureData = m_pScratchBufferTop->GetGPUVirtualAddress();
-	}
-
-	STDCALL(DXCore::GetCommandList()->BuildRaytracingAccelerationStructure(m_AccelerationDescTop.get(), 0, nullptr)); //Maybe catch postbuild info here when rebuilding/refitting is needed?
+	//Finally create the acceleration structure. The buffers are new, so it is always a full build.
+	m_TLASUpdatePolicy.Invalidate();
+	BuildTop(m_TLASUpdatePolicy.Decide(totalNrObjects), Window::Get().GetCurrentFrameInFlightIndex());
 }
 
 void RayTracingManager::CreateCommitedBuffer(
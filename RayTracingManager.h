@@ -2,6 +2,10 @@
 #include "DXHelper.h"
 #include "DXCore.h"
 #include "VertexObject.h"
+#include "TLASUpdatePolicy.h"
+#include "TLASInstancePacker.h"
+#include "BLASCompactor.h"
+#include "BLASBuildPlanner.h"
 
 class RayTracingManager
 {
@@ -12,25 +16,38 @@ public:
 	void Initialize(
 		const std::unordered_map<std::string, std::shared_ptr<Model>>& models,
 		const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& objects,
-		uint32_t totalNrMeshes
+		uint32_t totalNrObjects
 	) noexcept;
 
-	void UpdateInstances(
-		const std::unordered_map<std::string, std::shared_ptr<Model>>& models,
-		const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& objects,
-		uint32_t totalNrMeshes
-	) noexcept;
+	//Packs the moved instances into this frame's instance buffer and refits or rebuilds the top level acceleration structure.
+	void UpdateInstances() noexcept;
 
 	D3D12_GPU_VIRTUAL_ADDRESS GetTopLevelAccelerationStructure() const { return m_pResultBufferTop->GetGPUVirtualAddress(); }
+	[[nodiscard]] const TLASUpdatePolicy& GetTLASUpdatePolicy() const noexcept { return m_TLASUpdatePolicy; }
+	//Number of instances written to the instance buffer by the last update, the rest were unchanged.
+	[[nodiscard]] constexpr uint32_t GetNrOfPackedInstances() const noexcept { return m_NrOfPackedInstances; }
+	[[nodiscard]] constexpr uint32_t GetNrOfInstances() const noexcept { return m_NrOfInstancesTop; }
+	//Time spent packing the instances during the last update in milliseconds.
+	[[nodiscard]] constexpr double GetInstancePackTime() const noexcept { return m_InstancePackTime; }
+	[[nodiscard]] const BLASCompactor& GetBLASCompactor() const noexcept { return m_BLASCompactor; }
+	[[nodiscard]] const BLASBuildPlanner& GetBLASBuildPlanner() const noexcept { return m_BLASBuildPlanner; }
 private:
 	void BuildBottomAcceleration(
 		const std::unordered_map<std::string, std::shared_ptr<Model>>& models
 	) noexcept;
+	//Reads back the compacted sizes, copies the bottom level acceleration structures into right sized buffers and releases the originals and the scratch memory.
+	//Waits for the GPU twice, so it is only done while loading.
+	void CompactBottomAcceleration() noexcept;
+	//Executes the main command list, waits for it and resets it for more recording.
+	void SubmitAndWait() noexcept;
+	[[nodiscard]] D3D12_GPU_VIRTUAL_ADDRESS GetBottomLevelAccelerationStructure(const std::string& modelName) const noexcept;
 	void BuildTopAcceleration(
 		const std::unordered_map<std::string, std::shared_ptr<Model>>& models,
 		const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& objects,
-		uint32_t totalNrMeshes
+		uint32_t totalNrObjects
 	) noexcept;
+	//Builds or refits the top level acceleration structure as decided, followed by a UAV barrier on the result.
+	void BuildTop(const TLASBuildDecision& decision, uint32_t frameIndex) noexcept;
 
 	void CreateCommitedBuffer(
 		std::string bufferName,
@@ -42,14 +59,30 @@ private:
 	) noexcept;
 
 private:
-	std::unordered_map<std::string, std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>> m_ResultBuffersBottom = {};
-	std::unordered_map<std::string, std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>> m_ScratchBuffersBottom = {};
-	std::unordered_map<std::string, std::vector<std::shared_ptr<D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC>>> m_AccelerationDescsBottom = {};
-	uint32_t m_BottomBuffers = 0u;
+	//All bottom level acceleration structures live in one buffer, first at the planned offsets and then at their compacted offsets.
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pResultBufferBottom = nullptr;
+	std::vector<uint64_t> m_BottomStructureOffsets = {};
+	std::unordered_map<std::string, uint32_t> m_BottomStructureIndices = {};
+	//Only alive until the bottom level acceleration structures have been compacted.
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pScratchBufferBottom = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pPostbuildInfoBufferBottom = nullptr;
+	BLASBuildPlanner m_BLASBuildPlanner;
+	//The shared result buffer can only be released once every structure has been moved out of it, so all of them are compacted.
+	BLASCompactor m_BLASCompactor{ 0u };
 
-	std::unique_ptr<D3D12_RAYTRACING_INSTANCE_DESC[]> m_InstancingDescs = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_pInstanceBufferTop = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pInstanceBuffersTop[NR_OF_FRAMES] = {};
+	D3D12_RAYTRACING_INSTANCE_DESC* m_pMappedInstanceDescsTop[NR_OF_FRAMES] = {};
+	TLASInstancePacker m_InstancePackers[NR_OF_FRAMES];
+	//The object, transform and transform version behind every top level instance, in instance order.
+	std::vector<const VertexObject*> m_TopInstanceObjects = {};
+	std::vector<const DirectX::XMFLOAT4X4*> m_TopInstanceTransforms = {};
+	std::vector<uint32_t> m_TopInstanceVersions = {};
+	uint32_t m_NrOfPackedInstances = 0u;
+	double m_InstancePackTime = 0.0;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_pResultBufferTop = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_pScratchBufferTop = nullptr;
-	std::unique_ptr<D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC> m_AccelerationDescTop = nullptr;
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC m_AccelerationDescTop = {};
+	//Number of instances the top level buffers were created for.
+	uint32_t m_NrOfInstancesTop = 0u;
+	TLASUpdatePolicy m_TLASUpdatePolicy;
 };
\ No newline at end of file
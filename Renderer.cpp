@@ -5,15 +5,41 @@
 #include "RenderCommand.h"
 #include "Camera.h"
 #include "MemoryManager.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
 #define USE_PIX
 #include "pix3.h"
 
+namespace
+{
+	//The shaders the renderer creates its pipelines with, also what the shader cache is built from ahead of time.
+	const ShaderDesc s_VertexShader = { L"VertexShader.hlsl", L"main", L"vs_6_5" };
+	const ShaderDesc s_PixelShader = { L"PixelShader.hlsl", L"main", L"ps_6_5" };
+	//The order of the keys is the order of the values in the masks.
+	const std::vector<ShaderPermutationKey> s_PixelShaderKeys =
+	{
+		{ L"SHADOW_MODE", 3u },
+		{ L"CLUSTERED_LIGHTING", 2u }
+	};
+
+	//Shortens the range to the part that lies below the limit.
+	LightRange ClampRange(LightRange range, uint32_t limit) noexcept
+	{
+		range.Count = range.Offset >= limit ? 0u : std::min(range.Count, limit - range.Offset);
+		return range;
+	}
+}
+
 void Renderer::Initialize() noexcept
 {
 	CreateDepthBuffer();
 	CreateRootSignature();
 	CreatePipelineStateObject();
 	CreateViewportAndScissorRect();
+	CreateInstanceBuffers();
+	CreateLightBuffers();
+	CreateCommandSignature();
+	CreateIndirectArgumentBuffers();
 
 	auto pCommandList = DXCore::GetCommandList();
 
@@ -42,72 +68,333 @@ void Renderer::Begin(Camera* const pCamera, D3D12_GPU_VIRTUAL_ADDRESS accelerati
 	RenderCommand::ClearRenderTarget(backBufferDescriptorHandle, DirectX::Colors::Black);
 	RenderCommand::ClearDepth(depthBufferDSVHandle, 1.0f);
 
-	//Set back buffer RTV and depth buffer DSV:
-	STDCALL(pCommandList->OMSetRenderTargets(1u, &backBufferDescriptorHandle, false, &depthBufferDSVHandle));
-
-	//PSO and Root sig:
-	STDCALL(pCommandList->SetPipelineState(m_pPSO.Get()));
-	STDCALL(pCommandList->SetGraphicsRootSignature(m_pRootSignature.Get()));
-	STDCALL(pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
-
-	STDCALL(pCommandList->RSSetViewports(1u, &m_ViewPort));
-	STDCALL(pCommandList->RSSetScissorRects(1u, &m_ScissorRect));
+	//The state is kept so that every command list of the frame can be set up the same way.
+	m_BackBufferRTV = backBufferDescriptorHandle;
+	m_DepthBufferDSV = depthBufferDSVHandle;
+	m_ViewProjection = pCamera->GetVPMatrix();
 
-	auto pDescriptorHeap = MemoryManager::Get().GetActiveSRVCBVUAVDescriptorHeap();
-	STDCALL(pCommandList->SetDescriptorHeaps(1u, pDescriptorHeap->GetInterface().GetAddressOf()));
-
-	static VP vpMatrixCBuffer;
 	auto vpMatrix = DirectX::XMLoadFloat4x4(&(pCamera->GetVPMatrix()));
 	vpMatrix = DirectX::XMMatrixTranspose(vpMatrix);
-	DirectX::XMStoreFloat4x4(&vpMatrixCBuffer.VPMatrix, vpMatrix);
-	STDCALL(pCommandList->SetGraphicsRoot32BitConstants(3u, 4*4, &vpMatrixCBuffer, 0u));
+	DirectX::XMStoreFloat4x4(&m_VPCBuffer.VPMatrix, vpMatrix);
 
-	static InverseVP vpInverseCBuffer;
 	auto vpInverse = DirectX::XMLoadFloat4x4(&(pCamera->GetVPMatrix()));
 	DirectX::XMVECTOR det = DirectX::XMMatrixDeterminant(vpInverse);
 	vpInverse = DirectX::XMMatrixInverse(&det, vpInverse);
 	vpInverse = DirectX::XMMatrixTranspose(vpInverse);
-	DirectX::XMStoreFloat4x4(&vpInverseCBuffer.InverseVPMatrix, vpInverse);
-	STDCALL(pCommandList->SetGraphicsRoot32BitConstants(5u, 4 * 4, &vpInverseCBuffer, 0u));
+	DirectX::XMStoreFloat4x4(&m_InverseVPCBuffer.InverseVPMatrix, vpInverse);
 
 	DirectX::XMFLOAT3 cameraFloat3 = pCamera->GetPosition();
-	DirectX::XMFLOAT4 cameraFloat4 = DirectX::XMFLOAT4(cameraFloat3.x, cameraFloat3.y, cameraFloat3.z, (float)pCamera->GetRayTraceBool());
-	auto cameraPos = DirectX::XMLoadFloat4(&(cameraFloat4));
-	STDCALL(pCommandList->SetGraphicsRoot32BitConstants(7u, 4, &cameraPos, 0u));
-
-	//Raytracing accelerationstructure.
-	STDCALL(pCommandList->SetGraphicsRootShaderResourceView(4u, accelerationStructure));
+	m_CameraConstants = DirectX::XMFLOAT4(cameraFloat3.x, cameraFloat3.y, cameraFloat3.z, 0.0f);
+
+	//The branches of the pixel shader are picked with its variant.
+	m_ShadowMode = !pCamera->GetRayTraceBool() ? ShadowMode::None : m_BakedLightVisibilityEnabled ? ShadowMode::Baked : ShadowMode::Traced;
+	m_PipelineMask = m_PixelShaders.GetMask({ static_cast<uint32_t>(m_ShadowMode), m_ClusteredLightingEnabled ? 1u : 0u });
+
+	//The clusters only change shape with the projection, the lights are assigned to them in Submit.
+	m_View = pCamera->GetViewMatrix();
+	m_LightClusterBuilder.SetProjection(pCamera->GetElement1PMatrix(), pCamera->GetElement2PMatrix(), Camera::s_NearPlane, Camera::s_FarPlane);
+	m_LightClusterConstants.TileScaleX = LightClusterBuilder::s_DimX / m_ViewPort.Width;
+	m_LightClusterConstants.TileScaleY = LightClusterBuilder::s_DimY / m_ViewPort.Height;
+	m_LightClusterConstants.DepthScale = m_LightClusterBuilder.GetDepthScale();
+	m_LightClusterConstants.DepthBias = m_LightClusterBuilder.GetDepthBias();
+	m_LightClusterConstants.DimX = LightClusterBuilder::s_DimX;
+	m_LightClusterConstants.DimY = LightClusterBuilder::s_DimY;
+	m_LightClusterConstants.DimZ = LightClusterBuilder::s_DimZ;
+	m_AccelerationStructure = accelerationStructure;
+
+	//The bindings of the frame go through the recorder, which drops the ones that are already set.
+	m_CommandRecorder.Begin(pCommandList.Get());
+	m_CommandRecorder.ResetCounters();
+	BindFrameState(m_CommandRecorder);
 	PIXEndEvent(DXCore::GetCommandList().Get());
 }
 
-void Renderer::Submit(const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& vertexObjects) noexcept
+void Renderer::Submit(const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& vertexObjects, const LightManager& lightManager, const LightVisibilityBaker& lightVisibility) noexcept
 {
 	PIXBeginEvent(DXCore::GetCommandList().Get(), 300, "Renderer::Submit");
-	static float speed = 1.0f;
-	auto pCommandList = DXCore::GetCommandList();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Nothing is written past the end of the upload buffers, what does not fit is dropped and counted in every build.
+	m_SubmitOverflow = {};
+	const std::vector<PointLight>& lights = lightManager.GetLights();
+	const std::vector<uint32_t>& lightIndices = lightManager.GetLightIndices();
+	const std::vector<uint32_t>& visibilityMasks = lightVisibility.GetMasks();
+	const uint32_t nrOfLights = std::min(static_cast<uint32_t>(lights.size()), LightManager::s_MaxNrOfLights);
+	const uint32_t nrOfLightIndices = std::min(static_cast<uint32_t>(lightIndices.size()), s_MaxNrOfLightIndices);
+	const uint32_t visibilityOffset = nrOfLightIndices;
+	const uint32_t nrOfVisibilityMasks = std::min(static_cast<uint32_t>(visibilityMasks.size()), s_MaxNrOfLightIndices - visibilityOffset);
+	m_SubmitOverflow.NrOfLights = static_cast<uint32_t>(lights.size()) - nrOfLights;
+	m_SubmitOverflow.NrOfLightIndices = static_cast<uint32_t>(lightIndices.size()) - nrOfLightIndices;
+	m_SubmitOverflow.NrOfVisibilityMasks = static_cast<uint32_t>(visibilityMasks.size()) - nrOfVisibilityMasks;
+	std::memcpy(m_pMappedLights[m_FrameIndex], lights.data(), sizeof(PointLight) * nrOfLights);
+	std::memcpy(m_pMappedLightIndices[m_FrameIndex], lightIndices.data(), sizeof(uint32_t) * nrOfLightIndices);
+	std::memcpy(m_pMappedLightIndices[m_FrameIndex] + visibilityOffset, visibilityMasks.data(), sizeof(uint32_t) * nrOfVisibilityMasks);
+	if (m_ClusteredLightingEnabled)
+	{
+		m_LightClusterBuilder.Build(m_View, lights);
+#if defined(_DEBUG)
+		DBG_ASSERT(m_LightClusterBuilder.CountMismatches(m_View, lights) == 0u, "Error! The light clusters disagree with testing every light against every cluster.");
+#endif
+		const std::vector<LightRange>& clusterRanges = m_LightClusterBuilder.GetClusterRanges();
+		const std::vector<uint32_t>& clusterLightIndices = m_LightClusterBuilder.GetLightIndices();
+		const uint32_t nrOfClusterLightIndices = std::min(static_cast<uint32_t>(clusterLightIndices.size()), s_MaxNrOfLightIndices);
+		m_SubmitOverflow.NrOfClusterLightIndices = static_cast<uint32_t>(clusterLightIndices.size()) - nrOfClusterLightIndices;
+		if (m_SubmitOverflow.NrOfClusterLightIndices == 0u)
+		{
+			std::memcpy(m_pMappedClusterRanges[m_FrameIndex], clusterRanges.data(), sizeof(LightRange) * clusterRanges.size());
+		}
+		else
+		{
+			for (uint32_t i{ 0u }; i < clusterRanges.size(); ++i)
+			{
+				m_pMappedClusterRanges[m_FrameIndex][i] = ClampRange(clusterRanges[i], nrOfClusterLightIndices);
+			}
+		}
+		std::memcpy(m_pMappedClusterLightIndices[m_FrameIndex], clusterLightIndices.data(), sizeof(uint32_t) * nrOfClusterLightIndices);
+	}
+
+	//One packet per mesh of every object. Only objects that changed since the last frame have their cached data rebuilt and their packets sorted,
+	//the sorted packets of the rest are kept from the frame they were added in and merged with them. The depth is the view space depth
+	//of the object's center, which is w after the projection.
+	m_DrawPacketCache.BeginFrame();
+	const DirectX::XMFLOAT4X4& vp = m_ViewProjection;
+	m_NrOfStateChangesUnsorted = 0u;
+	uint64_t previousStateKey = UINT64_MAX;
 	for (auto& modelInstances : vertexObjects)
 	{
 		for (auto& object : modelInstances.second)
 		{
-			auto objectColor = DirectX::XMLoadFloat4(&(object->GetColor()));
-			STDCALL(pCommandList->SetGraphicsRoot32BitConstants(6u, 4, &objectColor, 0u));
-
-			const std::vector<std::unique_ptr<Mesh>>& objectMeshes = object->GetModel()->GetMeshes();
-			for (uint32_t i{ 0u }; i < objectMeshes.size(); i++)
+			const uint32_t entryIndex = m_DrawPacketCache.Update(*object);
+			m_DrawPacketCache.SetLightRange(entryIndex, ClampRange(lightManager.GetLightRange(object->GetSceneIndex()), nrOfLightIndices));
+			//A visibility row counts lights, sixteen to a mask. Lights past a cut off row are traced like those of a moving object.
+			LightRange visibilityRange = lightVisibility.GetVisibilityRange(object->GetSceneIndex());
+			const uint32_t nrOfMasks = visibilityRange.Offset >= nrOfVisibilityMasks ? 0u : nrOfVisibilityMasks - visibilityRange.Offset;
+			visibilityRange.Count = std::min(visibilityRange.Count, nrOfMasks * 16u);
+			visibilityRange.Offset += visibilityOffset;
+			m_DrawPacketCache.SetLightVisibility(entryIndex, visibilityRange);
+
+			const DirectX::XMFLOAT3& center = object->GetWorldBoundingBox().Center;
+			const uint64_t depthKey = DrawList::QuantizeDepth(center.x * vp._14 + center.y * vp._24 + center.z * vp._34 + vp._44, s_MaxSortDepth);
+			m_DrawPacketCache.AddPackets(entryIndex, depthKey);
+
+			//The state changes the objects would cost in the order they come in, to compare against the sorted list.
+			const uint64_t* pStateKeys = m_DrawPacketCache.GetStateKeys(entryIndex);
+			const uint32_t nrOfStateKeys = m_DrawPacketCache.GetNrOfStateKeys(entryIndex);
+			for (uint32_t i{ 0u }; i < nrOfStateKeys; ++i)
 			{
-				auto& cbv = object->GetTransformConstantBufferView();
-				auto gpuHandle = cbv.GpuHandles[m_FrameIndex];
-
-				STDCALL(pCommandList->SetGraphicsRootDescriptorTable(0, gpuHandle));
-				STDCALL(pCommandList->SetGraphicsRootShaderResourceView(1u, objectMeshes[i]->GetVertexBufferGPUAddress()));
-				STDCALL(pCommandList->SetGraphicsRootShaderResourceView(2u, objectMeshes[i]->GetIndexBufferGPUAddress()));
-				STDCALL(pCommandList->DrawInstanced(objectMeshes[i]->GetIndexCount(), 1u, 0u, 0u));
+				m_NrOfStateChangesUnsorted += previousStateKey != UINT64_MAX && pStateKeys[i] != previousStateKey;
+				previousStateKey = pStateKeys[i];
 			}
 		}
 	}
+	m_DrawPacketCache.BuildDrawList(m_DrawList);
+	m_NrOfStateChangesSorted = m_DrawList.CountStateChanges();
+
+	//Gather the cached transforms and colors in the sorted order and copy them to this frame's instance buffer.
+	m_InstanceBatcher.Build(m_DrawPacketCache.GetInstanceData(), m_DrawList, m_DrawPacketCache.GetMeshes());
+	const std::vector<InstanceData>& instanceData = m_InstanceBatcher.GetInstanceData();
+	const uint32_t nrOfInstances = std::min(static_cast<uint32_t>(instanceData.size()), s_MaxNrOfInstances);
+	m_SubmitOverflow.NrOfInstances = static_cast<uint32_t>(instanceData.size()) - nrOfInstances;
+	std::memcpy(m_pMappedInstanceData[m_FrameIndex], instanceData.data(), sizeof(InstanceData) * nrOfInstances);
+
+	//One draw per run of packets that share the same mesh. The batches are in instance order, so the ones that fit are a prefix
+	//and only the last of them can have to be cut short. There is one indirect argument record per instance at most.
+	const std::vector<InstanceBatch>* pBatches = &m_InstanceBatcher.GetBatches();
+	if (m_SubmitOverflow.NrOfInstances > 0u || pBatches->size() > s_MaxNrOfInstances)
+	{
+		m_ClampedBatches.clear();
+		for (const InstanceBatch& batch : *pBatches)
+		{
+			if (batch.InstanceOffset >= nrOfInstances || m_ClampedBatches.size() == s_MaxNrOfInstances)
+				break;
+
+			m_ClampedBatches.push_back({ batch.pMesh, batch.InstanceOffset, std::min(batch.InstanceCount, nrOfInstances - batch.InstanceOffset) });
+		}
+		m_SubmitOverflow.NrOfDraws = static_cast<uint32_t>(pBatches->size() - m_ClampedBatches.size());
+		pBatches = &m_ClampedBatches;
+	}
+	const std::vector<InstanceBatch>& batches = *pBatches;
+	if (m_IndirectDrawsEnabled)
+	{
+		//The draws are written as argument records and submitted with a single call on the main list.
+		uint32_t nrOfDraws = m_IndirectDrawBuilder.Build(batches, m_pMappedIndirectArguments[m_FrameIndex]);
+		m_NrOfChunks = 0u;
+		if (nrOfDraws > 0u)
+		{
+			STDCALL(m_CommandRecorder.ExecuteIndirect(m_pCommandSignature.Get(), nrOfDraws, m_pIndirectArgumentBuffers[m_FrameIndex].Get(), 0u, nullptr, 0u));
+		}
+	}
+	else
+	{
+		RecordDrawsInParallel(batches);
+	}
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_SubmitTime = static_cast<double>(dif.count()) * 0.001;
 	PIXEndEvent(DXCore::GetCommandList().Get());
 }
 
+void Renderer::RecordDrawsInParallel(const std::vector<InstanceBatch>& batches) noexcept
+{
+	auto pCommandList = DXCore::GetCommandList();
+
+	//The batches are split into chunks that are recorded in parallel, each into its own command list that starts out from the frame state.
+	//STDCALL is not used on the recording threads since it reads the info queue that all threads share.
+	m_ChunkRecorders.resize(ThreadPool::Get().GetNrOfThreads());
+	m_CommandListPool.RecordParallel(static_cast<uint32_t>(batches.size()), s_MinNrOfBatchesPerChunk, DXCore::GetFence()->GetCompletedValue(),
+		[&](uint32_t chunkIndex, D3D12CommandListBackend::CommandList& commandList, uint32_t begin, uint32_t end)
+		{
+			PROFILE_SCOPE("Record chunk");
+			CommandRecorder& recorder = m_ChunkRecorders[chunkIndex];
+			recorder.Begin(commandList.pCommandList.Get());
+			recorder.ResetCounters();
+			BindFrameState(recorder);
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				const InstanceBatch& batch = batches[i];
+				recorder.SetGraphicsRoot32BitConstant(6u, batch.InstanceOffset, 0u);
+				recorder.SetGraphicsRootShaderResourceView(1u, batch.pMesh->GetVertexBufferGPUAddress());
+				recorder.SetGraphicsRootShaderResourceView(2u, batch.pMesh->GetIndexBufferGPUAddress());
+				recorder.SetGraphicsRootShaderResourceView(8u, batch.pMesh->GetAmbientOcclusionBufferGPUAddress());
+				recorder.DrawInstanced(batch.pMesh->GetIndexCount(), batch.InstanceCount, 0u, 0u);
+			}
+		});
+	m_NrOfChunks = static_cast<uint32_t>(m_CommandListPool.GetRecorded().size());
+
+	//The main list holds the clears, so it is executed first and the chunks follow in order.
+	//It is then reopened on the same allocator for the work that comes after the scene.
+	HR(pCommandList->Close());
+	std::vector<ID3D12CommandList*> commandLists = { pCommandList.Get() };
+	for (D3D12CommandListBackend::CommandList* pChunkCommandList : m_CommandListPool.GetRecorded())
+	{
+		commandLists.push_back(pChunkCommandList->pCommandList.Get());
+	}
+	STDCALL(DXCore::GetCommandQueue()->ExecuteCommandLists(static_cast<UINT>(commandLists.size()), commandLists.data()));
+	m_CommandListPool.ReleaseRecorded(m_FrameFenceValues[m_FrameIndex]);
+
+	HR(pCommandList->Reset(DXCore::GetCommandAllocators()[Window::Get().GetCurrentFrameInFlightIndex()].Get(), nullptr));
+	m_CommandRecorder.Begin(pCommandList.Get());
+	BindFrameState(m_CommandRecorder);
+
+}
+
+void Renderer::CreateCommandSignature() noexcept
+{
+	//Matches IndirectDrawArguments: the vertex, index and ambient occlusion buffer SRVs and the instance offset, followed by the draw.
+	D3D12_INDIRECT_ARGUMENT_DESC argumentDescriptors[5] = {};
+	argumentDescriptors[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+	argumentDescriptors[0].ShaderResourceView.RootParameterIndex = 1u;
+	argumentDescriptors[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+	argumentDescriptors[1].ShaderResourceView.RootParameterIndex = 2u;
+	argumentDescriptors[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+	argumentDescriptors[2].ShaderResourceView.RootParameterIndex = 8u;
+	argumentDescriptors[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	argumentDescriptors[3].Constant.RootParameterIndex = 6u;
+	argumentDescriptors[3].Constant.DestOffsetIn32BitValues = 0u;
+	argumentDescriptors[3].Constant.Num32BitValuesToSet = 1u;
+	argumentDescriptors[4].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+
+	D3D12_COMMAND_SIGNATURE_DESC commandSignatureDescriptor = {};
+	commandSignatureDescriptor.ByteStride = sizeof(IndirectDrawArguments);
+	commandSignatureDescriptor.NumArgumentDescs = ARRAYSIZE(argumentDescriptors);
+	commandSignatureDescriptor.pArgumentDescs = argumentDescriptors;
+	commandSignatureDescriptor.NodeMask = 0u;
+
+	//The signature changes root arguments, so it has to be created against the root signature.
+	HR(DXCore::GetDevice()->CreateCommandSignature(&commandSignatureDescriptor, m_pRootSignature.Get(), IID_PPV_ARGS(&m_pCommandSignature)));
+	HR(m_pCommandSignature->SetName(L"Indirect Draw Command Signature"));
+}
+
+void Renderer::CreateIndirectArgumentBuffers() noexcept
+{
+	D3D12_HEAP_PROPERTIES heapProperties = {};
+	heapProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
+	heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProperties.CreationNodeMask = 0u;
+	heapProperties.VisibleNodeMask = 0u;
+
+	//There is never more than one draw per instance.
+	D3D12_RESOURCE_DESC resourceDescriptor = {};
+	resourceDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	resourceDescriptor.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	resourceDescriptor.Width = sizeof(IndirectDrawArguments) * s_MaxNrOfInstances;
+	resourceDescriptor.Height = 1u;
+	resourceDescriptor.DepthOrArraySize = 1u;
+	resourceDescriptor.MipLevels = 1u;
+	resourceDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+	resourceDescriptor.SampleDesc = { 1u, 0u };
+	resourceDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	resourceDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	D3D12_RANGE nullRange = { 0,0 };
+	for (uint32_t i{ 0u }; i < NR_OF_FRAMES; ++i)
+	{
+		HR(DXCore::GetDevice()->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDescriptor,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pIndirectArgumentBuffers[i])
+		));
+		HR(m_pIndirectArgumentBuffers[i]->SetName(L"Indirect Argument Buffer"));
+		HR(m_pIndirectArgumentBuffers[i]->Map(0u, &nullRange, reinterpret_cast<void**>(&m_pMappedIndirectArguments[i])));
+	}
+}
+
+void Renderer::BindFrameState(CommandRecorder& recorder) noexcept
+{
+	ID3D12GraphicsCommandList4* pCommandList = recorder.GetCommandList();
+
+	//Set back buffer RTV and depth buffer DSV:
+	pCommandList->OMSetRenderTargets(1u, &m_BackBufferRTV, false, &m_DepthBufferDSV);
+
+	//PSO and Root sig:
+	recorder.SetPipelineState(m_PSOs[m_PipelineMask].Get());
+	recorder.SetGraphicsRootSignature(m_pRootSignature.Get());
+	pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	pCommandList->RSSetViewports(1u, &m_ViewPort);
+	pCommandList->RSSetScissorRects(1u, &m_ScissorRect);
+
+	auto pDescriptorHeap = MemoryManager::Get().GetActiveSRVCBVUAVDescriptorHeap();
+	pCommandList->SetDescriptorHeaps(1u, pDescriptorHeap->GetInterface().GetAddressOf());
+
+	recorder.SetGraphicsRoot32BitConstants(3u, 4 * 4, &m_VPCBuffer, 0u);
+	recorder.SetGraphicsRoot32BitConstants(5u, 4 * 4, &m_InverseVPCBuffer, 0u);
+	recorder.SetGraphicsRoot32BitConstants(7u, 4, &m_CameraConstants, 0u);
+
+	//Raytracing accelerationstructure.
+	recorder.SetGraphicsRootShaderResourceView(4u, m_AccelerationStructure);
+	recorder.SetGraphicsRootShaderResourceView(0u, m_pInstanceBuffers[m_FrameIndex]->GetGPUVirtualAddress());
+	recorder.SetGraphicsRootShaderResourceView(9u, m_pLightBuffers[m_FrameIndex]->GetGPUVirtualAddress());
+	recorder.SetGraphicsRootShaderResourceView(10u, m_pLightIndexBuffers[m_FrameIndex]->GetGPUVirtualAddress());
+	recorder.SetGraphicsRoot32BitConstants(11u, sizeof(LightClusterConstants) / 4u, &m_LightClusterConstants, 0u);
+	recorder.SetGraphicsRootShaderResourceView(12u, m_pClusterRangeBuffers[m_FrameIndex]->GetGPUVirtualAddress());
+	recorder.SetGraphicsRootShaderResourceView(13u, m_pClusterLightIndexBuffers[m_FrameIndex]->GetGPUVirtualAddress());
+}
+
+uint32_t Renderer::GetNrOfBindingCallsIssued() const noexcept
+{
+	uint32_t nrOfIssued = m_CommandRecorder.GetNrOfIssued();
+	for (uint32_t i{ 0u }; i < m_NrOfChunks; ++i)
+	{
+		nrOfIssued += m_ChunkRecorders[i].GetNrOfIssued();
+	}
+	return nrOfIssued;
+}
+
+uint32_t Renderer::GetNrOfBindingCallsElided() const noexcept
+{
+	uint32_t nrOfElided = m_CommandRecorder.GetNrOfElided();
+	for (uint32_t i{ 0u }; i < m_NrOfChunks; ++i)
+	{
+		nrOfElided += m_ChunkRecorders[i].GetNrOfElided();
+	}
+	return nrOfElided;
+}
+
 void Renderer::End() noexcept
 {
 	auto pCommandList = DXCore::GetCommandList();
@@ -221,19 +508,12 @@ void Renderer::CreateRootSignature() noexcept
 {
 	std::vector<D3D12_ROOT_PARAMETER> rootParameters;
 
-	D3D12_DESCRIPTOR_RANGE descriptorRange = {};
-	descriptorRange.BaseShaderRegister = 1u;
-	descriptorRange.RegisterSpace = 0u;
-	descriptorRange.NumDescriptors = 1u;
-	descriptorRange.OffsetInDescriptorsFromTableStart = 0u;
-	descriptorRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-
-	D3D12_ROOT_PARAMETER transformsRootParameterVS = {};
-	transformsRootParameterVS.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-	transformsRootParameterVS.DescriptorTable.NumDescriptorRanges = 1u;
-	transformsRootParameterVS.DescriptorTable.pDescriptorRanges = &descriptorRange;
-	transformsRootParameterVS.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
-	rootParameters.push_back(transformsRootParameterVS);
+	D3D12_ROOT_PARAMETER instanceBufferSRVParameter = {};
+	instanceBufferSRVParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	instanceBufferSRVParameter.Descriptor.ShaderRegister = 2u;
+	instanceBufferSRVParameter.Descriptor.RegisterSpace = 0u;
+	instanceBufferSRVParameter.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+	rootParameters.push_back(instanceBufferSRVParameter);
 
 	D3D12_ROOT_PARAMETER vertexBufferSRVParameter = {};
 	vertexBufferSRVParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;		
@@ -273,13 +553,14 @@ void Renderer::CreateRootSignature() noexcept
 	vpInversePS.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 	rootParameters.push_back(vpInversePS);
 
-	D3D12_ROOT_PARAMETER objectColorPS = {};
-	objectColorPS.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
-	objectColorPS.Constants.Num32BitValues = 4;
-	objectColorPS.Constants.ShaderRegister = 1u;
-	objectColorPS.Constants.RegisterSpace = 1u;
-	objectColorPS.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-	rootParameters.push_back(objectColorPS);
+	//Offset of the first instance of a draw in the instance buffer, SV_InstanceID does not include it.
+	D3D12_ROOT_PARAMETER instanceOffsetVS = {};
+	instanceOffsetVS.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	instanceOffsetVS.Constants.Num32BitValues = 1;
+	instanceOffsetVS.Constants.ShaderRegister = 1u;
+	instanceOffsetVS.Constants.RegisterSpace = 0u;
+	instanceOffsetVS.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+	rootParameters.push_back(instanceOffsetVS);
 	
 	D3D12_ROOT_PARAMETER cameraPS = {};
 	cameraPS.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
@@ -288,6 +569,52 @@ void Renderer::CreateRootSignature() noexcept
 	cameraPS.Constants.RegisterSpace = 1u;
 	cameraPS.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 	rootParameters.push_back(cameraPS);
+
+	//Baked ambient occlusion of the mesh, read next to the vertex buffer.
+	D3D12_ROOT_PARAMETER ambientOcclusionSRVParameter = {};
+	ambientOcclusionSRVParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	ambientOcclusionSRVParameter.Descriptor.ShaderRegister = 3u;
+	ambientOcclusionSRVParameter.Descriptor.RegisterSpace = 0u;
+	ambientOcclusionSRVParameter.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+	rootParameters.push_back(ambientOcclusionSRVParameter);
+
+	//The scene's lights and the light lists of the objects.
+	D3D12_ROOT_PARAMETER lightBufferSRVParameter = {};
+	lightBufferSRVParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	lightBufferSRVParameter.Descriptor.ShaderRegister = 1u;
+	lightBufferSRVParameter.Descriptor.RegisterSpace = 1u;
+	lightBufferSRVParameter.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	rootParameters.push_back(lightBufferSRVParameter);
+
+	D3D12_ROOT_PARAMETER lightIndexBufferSRVParameter = {};
+	lightIndexBufferSRVParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	lightIndexBufferSRVParameter.Descriptor.ShaderRegister = 2u;
+	lightIndexBufferSRVParameter.Descriptor.RegisterSpace = 1u;
+	lightIndexBufferSRVParameter.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	rootParameters.push_back(lightIndexBufferSRVParameter);
+
+	//The froxel grid of the clustered lighting and the light lists of its clusters.
+	D3D12_ROOT_PARAMETER lightClusterPS = {};
+	lightClusterPS.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	lightClusterPS.Constants.Num32BitValues = sizeof(LightClusterConstants) / 4u;
+	lightClusterPS.Constants.ShaderRegister = 3u;
+	lightClusterPS.Constants.RegisterSpace = 1u;
+	lightClusterPS.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	rootParameters.push_back(lightClusterPS);
+
+	D3D12_ROOT_PARAMETER clusterRangeSRVParameter = {};
+	clusterRangeSRVParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	clusterRangeSRVParameter.Descriptor.ShaderRegister = 3u;
+	clusterRangeSRVParameter.Descriptor.RegisterSpace = 1u;
+	clusterRangeSRVParameter.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	rootParameters.push_back(clusterRangeSRVParameter);
+
+	D3D12_ROOT_PARAMETER clusterLightIndexSRVParameter = {};
+	clusterLightIndexSRVParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	clusterLightIndexSRVParameter.Descriptor.ShaderRegister = 4u;
+	clusterLightIndexSRVParameter.Descriptor.RegisterSpace = 1u;
+	clusterLightIndexSRVParameter.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	rootParameters.push_back(clusterLightIndexSRVParameter);
 	
 	D3D12_ROOT_SIGNATURE_DESC rootSignatureDescriptor = {};
 	rootSignatureDescriptor.NumParameters = static_cast<UINT>(rootParameters.size());
@@ -362,18 +689,21 @@ void Renderer::CreatePipelineStateObject() noexcept
 	streamOutputDescriptor.RasterizedStream = 0u;
 
 	//We need the shaders:
-	//First we compile them using the dxc compiler.
-	Microsoft::WRL::ComPtr<IDxcBlob> vertexShaderBlob = CompileShader(L"VertexShader.hlsl", L"main", L"vs_6_5");
-	Microsoft::WRL::ComPtr<IDxcBlob> pixelShaderBlob = CompileShader(L"PixelShader.hlsl", L"main", L"ps_6_5");
+	//They come from the shader cache, which only runs the dxc compiler when a shader or its arguments changed.
+	//Every variant of the pixel shader is fetched at once, the ones that have to be compiled are compiled in parallel.
+	m_ShaderCache.Initialize();
+	m_VertexShaders = ShaderPermutations(s_VertexShader, {});
+	m_PixelShaders = ShaderPermutations(s_PixelShader, s_PixelShaderKeys);
+	ShaderPermutations::Compile(m_ShaderCache, { &m_VertexShaders, &m_PixelShaders });
+	IDxcBlob* pVertexShaderBlob = m_VertexShaders.GetVariant(0u);
+	DBG_ASSERT(pVertexShaderBlob, "Error! The vertex shader did not compile.");
 
 	//We now create the Graphics Pipe line state, the PSO:
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDescriptor = { 0 };
 	std::vector<DXGI_FORMAT> rtvFormats = { DXGI_FORMAT_R8G8B8A8_UNORM };
 	psoDescriptor.pRootSignature = m_pRootSignature.Get();
-	psoDescriptor.VS.pShaderBytecode = vertexShaderBlob->GetBufferPointer();
-	psoDescriptor.VS.BytecodeLength = vertexShaderBlob->GetBufferSize();
-	psoDescriptor.PS.pShaderBytecode = pixelShaderBlob->GetBufferPointer();
-	psoDescriptor.PS.BytecodeLength = pixelShaderBlob->GetBufferSize();
+	psoDescriptor.VS.pShaderBytecode = pVertexShaderBlob->GetBufferPointer();
+	psoDescriptor.VS.BytecodeLength = pVertexShaderBlob->GetBufferSize();
 
 	psoDescriptor.SampleMask = UINT_MAX;
 	psoDescriptor.RasterizerState = rasterizerDescriptor;
@@ -392,131 +722,41 @@ void Renderer::CreatePipelineStateObject() noexcept
 	psoDescriptor.StreamOutput = streamOutputDescriptor;
 	psoDescriptor.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
 
-	HR(DXCore::GetDevice()->CreateGraphicsPipelineState(&psoDescriptor, IID_PPV_ARGS(&m_pPSO)));
-}
-
-Microsoft::WRL::ComPtr<IDxcBlob> Renderer::CompileShader(const std::wstring& filepath, const std::wstring& entryPoint, const std::wstring& target) noexcept
-{
-	//Find the file name.
-	uint32_t dotPos = static_cast<uint32_t>(filepath.find(L".", 0));
-	std::wstring name = filepath.substr(0, dotPos);
-
-	//Compiler and utils should be kept in some sort of shader handler ideally.
-	Microsoft::WRL::ComPtr<IDxcCompiler3> pCompiler = nullptr;
-	HR(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(pCompiler.GetAddressOf())));
-	Microsoft::WRL::ComPtr<IDxcUtils> pUtils = nullptr;
-	HR(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(pUtils.GetAddressOf())));
-
-	Microsoft::WRL::ComPtr<IDxcBlobEncoding> pSource = nullptr;
-	uint32_t codePage = CP_UTF8;
-	HR(pUtils->LoadFile(filepath.c_str(), &codePage, pSource.GetAddressOf()));
-	
-	//Add the arguments that get sent to the compiler.
-	//https://simoncoenen.com/blog/programming/graphics/DxcCompiling
-	//Shows all arguments
-	std::vector<LPCWSTR> arguments = {};
-
-	//E for entrypoint.
-	arguments.push_back(L"-E");
-	arguments.push_back(entryPoint.c_str());
-
-	//T for target profile (shader version)
-	arguments.push_back(L"-T");
-	arguments.push_back(target.c_str());
-
-	arguments.push_back(DXC_ARG_PACK_MATRIX_COLUMN_MAJOR);
-
-#if defined(_DEBUG)
-	arguments.push_back(L"-Od"); //Disable optimizations.
-	//arguments.push_back(DXC_ARG_WARNINGS_ARE_ERRORS);
-	arguments.push_back(DXC_ARG_DEBUG);
-
-	//Write debug information to the given file
-	arguments.push_back(L"-Fd");
-	std::wstring nameDebug = name + L"_debug";
-	arguments.push_back(nameDebug.c_str());
-
-	//Write errors and warnings to the given file
-	arguments.push_back(L"-Fe");
-	std::wstring nameError = name + L"_error";
-	arguments.push_back(nameError.c_str());
-#else
-	arguments.push_back(L"-O3"); //Optimization level.
-#endif
-
-	//To be able to strip reflection data and pdb's. They are separated from the shader object, therefore reducing the shader object's size.
-	arguments.push_back(L"-Qstrip_debug");
-	arguments.push_back(L"-Qstrip_reflect");
-
-	//Macros can be defined in strings and sent to the shader if we want.
-	/*
-	for (const std::wstring& define : defines)
+	//The pipelines only differ in the pixel shader.
+	m_PSOs.resize(m_PixelShaders.GetNrOfMasks());
+	for (uint32_t mask{ 0u }; mask < m_PixelShaders.GetNrOfMasks(); ++mask)
 	{
-		arguments.push_back(L"-D");
-		arguments.push_back(define.c_str());
+		if (!m_PixelShaders.IsValid(mask))
+			continue;
+
+		IDxcBlob* pPixelShaderBlob = m_PixelShaders.GetVariant(mask);
+		DBG_ASSERT(pPixelShaderBlob, "Error! A variant of the pixel shader did not compile.");
+		psoDescriptor.PS.pShaderBytecode = pPixelShaderBlob->GetBufferPointer();
+		psoDescriptor.PS.BytecodeLength = pPixelShaderBlob->GetBufferSize();
+		HR(DXCore::GetDevice()->CreateGraphicsPipelineState(&psoDescriptor, IID_PPV_ARGS(&m_PSOs[mask])));
 	}
-	*/
-
-	DxcBuffer sourceBuffer = {};
-	sourceBuffer.Ptr = pSource->GetBufferPointer();
-	sourceBuffer.Size = pSource->GetBufferSize();
-	sourceBuffer.Encoding = 0;
-
-	
-	Microsoft::WRL::ComPtr<IDxcResult> pCompileResult = nullptr;
-	HR(pCompiler->Compile(&sourceBuffer, arguments.data(), (uint32_t)arguments.size(), nullptr, IID_PPV_ARGS(pCompileResult.GetAddressOf())));
-	
-#if defined(_DEBUG)
-	//Handle errors.
-	Microsoft::WRL::ComPtr<IDxcBlobUtf8> pErrors = nullptr;
-	HR(pCompileResult->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(pErrors.GetAddressOf()), nullptr));
-	//DBG_ASSERT(pErrors && pErrors->GetStringLength() > 0, (char*)pErrors->GetBufferPointer()); //? Dont know how to print this.
-
-	//Get the Debug data.
-	Microsoft::WRL::ComPtr<IDxcBlob> pDebugData = nullptr;
-	//This contains the path that is baked into the shader object to refer to the part in question.
-	//So if you want to save the PDBs to a separate file, use this name so that Pix will know where to find it.
-	Microsoft::WRL::ComPtr<IDxcBlobUtf16> pDebugDataPath = nullptr;
-	HR(pCompileResult->GetOutput(DXC_OUT_PDB, IID_PPV_ARGS(pDebugData.GetAddressOf()), pDebugDataPath.GetAddressOf()));
-	//How do we print the debug data?
-	
-	//Get the reflection data.
-	Microsoft::WRL::ComPtr<IDxcBlob> pReflectionData = nullptr;
-	HR(pCompileResult->GetOutput(DXC_OUT_REFLECTION, IID_PPV_ARGS(pReflectionData.GetAddressOf()), nullptr));
-
-	DxcBuffer reflectionBuffer = {};
-	reflectionBuffer.Ptr = pReflectionData->GetBufferPointer();
-	reflectionBuffer.Size = pReflectionData->GetBufferSize();
-	reflectionBuffer.Encoding = 0;
-
-	Microsoft::WRL::ComPtr<ID3D12ShaderReflection> pShaderReflection = nullptr;
-	HR(pUtils->CreateReflection(&reflectionBuffer, IID_PPV_ARGS(pShaderReflection.GetAddressOf())));
-	//How do we use the reflectiondata?
-#endif
-
-	Microsoft::WRL::ComPtr<IDxcBlob> pResultBlob = nullptr;
-	pCompileResult->GetResult(pResultBlob.GetAddressOf());
-
-	return pResultBlob;
 }
 
-//The CSO path get sent in here and then returns the blob.
-Microsoft::WRL::ComPtr<ID3DBlob> Renderer::LoadCSO(const std::wstring& filepath) noexcept
+bool Renderer::BuildShaderCache() noexcept
 {
-	std::ifstream file(filepath, std::ios::binary);
-	DBG_ASSERT(file.is_open(), "Error! Could not open CSO file!");
-
-	file.seekg(0, std::ios_base::end);
-	size_t size = static_cast<size_t>(file.tellg());
-	file.seekg(0, std::ios_base::beg);
-
-	Microsoft::WRL::ComPtr<ID3DBlob> toReturn = nullptr;
-	HR(D3DCreateBlob(size, &toReturn));
-
-	file.read(static_cast<char*>(toReturn->GetBufferPointer()), size);
-	file.close();
-
-	return toReturn;
+	ThreadPool::Get().Initialize();
+	bool succeeded = true;
+	{
+		ShaderCache shaderCache;
+		shaderCache.Initialize();
+		ShaderPermutations vertexShaders(s_VertexShader, {});
+		ShaderPermutations pixelShaders(s_PixelShader, s_PixelShaderKeys);
+		ShaderPermutations::Compile(shaderCache, { &vertexShaders, &pixelShaders });
+		for (const ShaderPermutations* pPermutations : { &vertexShaders, &pixelShaders })
+		{
+			for (uint32_t mask{ 0u }; mask < pPermutations->GetNrOfMasks(); ++mask)
+			{
+				succeeded &= !pPermutations->IsValid(mask) || pPermutations->GetVariant(mask) != nullptr;
+			}
+		}
+	}
+	ThreadPool::Get().OnShutDown();
+	return succeeded;
 }
 
 void Renderer::CreateViewportAndScissorRect() noexcept
@@ -535,3 +775,113 @@ void Renderer::CreateViewportAndScissorRect() noexcept
 	m_ScissorRect.right = static_cast<LONG>(m_ViewPort.Width);
 	m_ScissorRect.bottom = static_cast<LONG>(m_ViewPort.Height);
 }
+
+void Renderer::CreateInstanceBuffers() noexcept
+{
+	D3D12_HEAP_PROPERTIES heapProperties = {};
+	heapProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
+	heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProperties.CreationNodeMask = 0u;
+	heapProperties.VisibleNodeMask = 0u;
+
+	D3D12_RESOURCE_DESC resourceDescriptor = {};
+	resourceDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	resourceDescriptor.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	resourceDescriptor.Width = sizeof(InstanceData) * s_MaxNrOfInstances;
+	resourceDescriptor.Height = 1u;
+	resourceDescriptor.DepthOrArraySize = 1u;
+	resourceDescriptor.MipLevels = 1u;
+	resourceDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+	resourceDescriptor.SampleDesc = { 1u, 0u };
+	resourceDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	resourceDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	D3D12_RANGE nullRange = { 0,0 };
+	for (uint32_t i{ 0u }; i < NR_OF_FRAMES; ++i)
+	{
+		HR(DXCore::GetDevice()->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDescriptor,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pInstanceBuffers[i])
+		));
+		HR(m_pInstanceBuffers[i]->SetName(L"Instance Buffer"));
+		HR(m_pInstanceBuffers[i]->Map(0u, &nullRange, reinterpret_cast<void**>(&m_pMappedInstanceData[i])));
+	}
+}
+
+void Renderer::CreateLightBuffers() noexcept
+{
+	D3D12_HEAP_PROPERTIES heapProperties = {};
+	heapProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
+	heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProperties.CreationNodeMask = 0u;
+	heapProperties.VisibleNodeMask = 0u;
+
+	D3D12_RESOURCE_DESC resourceDescriptor = {};
+	resourceDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	resourceDescriptor.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	resourceDescriptor.Height = 1u;
+	resourceDescriptor.DepthOrArraySize = 1u;
+	resourceDescriptor.MipLevels = 1u;
+	resourceDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+	resourceDescriptor.SampleDesc = { 1u, 0u };
+	resourceDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	resourceDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	D3D12_RANGE nullRange = { 0,0 };
+	for (uint32_t i{ 0u }; i < NR_OF_FRAMES; ++i)
+	{
+		resourceDescriptor.Width = sizeof(PointLight) * LightManager::s_MaxNrOfLights;
+		HR(DXCore::GetDevice()->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDescriptor,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pLightBuffers[i])
+		));
+		HR(m_pLightBuffers[i]->SetName(L"Light Buffer"));
+		HR(m_pLightBuffers[i]->Map(0u, &nullRange, reinterpret_cast<void**>(&m_pMappedLights[i])));
+
+		resourceDescriptor.Width = sizeof(uint32_t) * s_MaxNrOfLightIndices;
+		HR(DXCore::GetDevice()->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDescriptor,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pLightIndexBuffers[i])
+		));
+		HR(m_pLightIndexBuffers[i]->SetName(L"Light Index Buffer"));
+		HR(m_pLightIndexBuffers[i]->Map(0u, &nullRange, reinterpret_cast<void**>(&m_pMappedLightIndices[i])));
+
+		resourceDescriptor.Width = sizeof(LightRange) * LightClusterBuilder::s_NrOfClusters;
+		HR(DXCore::GetDevice()->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDescriptor,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pClusterRangeBuffers[i])
+		));
+		HR(m_pClusterRangeBuffers[i]->SetName(L"Cluster Range Buffer"));
+		HR(m_pClusterRangeBuffers[i]->Map(0u, &nullRange, reinterpret_cast<void**>(&m_pMappedClusterRanges[i])));
+
+		resourceDescriptor.Width = sizeof(uint32_t) * s_MaxNrOfLightIndices;
+		HR(DXCore::GetDevice()->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDescriptor,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_pClusterLightIndexBuffers[i])
+		));
+		HR(m_pClusterLightIndexBuffers[i]->SetName(L"Cluster Light Index Buffer"));
+		HR(m_pClusterLightIndexBuffers[i]->Map(0u, &nullRange, reinterpret_cast<void**>(&m_pMappedClusterLightIndices[i])));
+	}
+}
@@ -2,9 +2,27 @@
 #include "DescriptorHeap.h"
 #include "Triangle.h"
 #include "Scene.h"
+#include "DrawPacketCache.h"
+#include "CommandRecorder.h"
+#include "CommandListPool.h"
+#include "IndirectDrawBuilder.h"
+#include "LightClusterBuilder.h"
+#include "ShaderPermutations.h"
 
 class Camera;
 
+//What Submit left out of the frame because it did not fit into the upload buffers. The objects past the end lose their light lists
+//and visibility rows, the excess draws are not drawn.
+struct SubmitOverflow
+{
+	uint32_t NrOfLights = 0u;
+	uint32_t NrOfLightIndices = 0u;
+	uint32_t NrOfVisibilityMasks = 0u;
+	uint32_t NrOfClusterLightIndices = 0u;
+	uint32_t NrOfInstances = 0u;
+	uint32_t NrOfDraws = 0u;
+};
+
 struct VP
 {
 	DirectX::XMFLOAT4X4 VPMatrix;
@@ -20,6 +38,29 @@ struct World
 	DirectX::XMFLOAT4X4 WorldMatrix;
 };
 
+//How the pixel shader finds its cluster, see LightClusterBuilder.
+struct LightClusterConstants
+{
+	float TileScaleX;
+	float TileScaleY;
+	float DepthScale;
+	float DepthBias;
+	uint32_t DimX;
+	uint32_t DimY;
+	uint32_t DimZ;
+	uint32_t Padding;
+};
+
+//How the pixel shader finds the shadows of the lights, the SHADOW_MODE key of its variants.
+enum class ShadowMode : uint32_t
+{
+	None = 0u,
+	//A shadow ray for every light.
+	Traced = 1u,
+	//Shadow rays only for the pairs of objects and lights whose baked light visibility is partial.
+	Baked = 2u
+};
+
 class Renderer
 {
 public:
@@ -27,28 +68,129 @@ public:
 	~Renderer() noexcept { RenderCommand::s_Renderer = nullptr; };
 	void Initialize() noexcept;
 	void Begin(Camera* const pCamera, D3D12_GPU_VIRTUAL_ADDRESS accelerationStructure) noexcept;
-	void Submit(const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& vertexObjects) noexcept;
+	//The light manager holds the light lists of the objects and the light visibility their baked shadow states, both found through their scene index.
+	void Submit(const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& vertexObjects, const LightManager& lightManager, const LightVisibilityBaker& lightVisibility) noexcept;
 	void End() noexcept;
 	void OnShutDown() noexcept;
 	void WaitAndSync();
 	void WaitForGpu();
+	//Compiles every variant of the pipeline shaders that is missing from the shader cache without creating a device, run as a build step.
+	//Returns false if any of them did not compile.
+	static bool BuildShaderCache() noexcept;
+
+	[[nodiscard]] const InstanceBatcher& GetInstanceBatcher() const noexcept { return m_InstanceBatcher; }
+	[[nodiscard]] const DrawPacketCache& GetDrawPacketCache() const noexcept { return m_DrawPacketCache; }
+	[[nodiscard]] const CommandListPool& GetCommandListPool() const noexcept { return m_CommandListPool; }
+	[[nodiscard]] const IndirectDrawBuilder& GetIndirectDrawBuilder() const noexcept { return m_IndirectDrawBuilder; }
+	[[nodiscard]] constexpr bool IsIndirectDrawsEnabled() const noexcept { return m_IndirectDrawsEnabled; }
+	//Submits the draws with one ExecuteIndirect instead of recording them on the thread pool.
+	void SetIndirectDraws(bool enabled) noexcept { m_IndirectDrawsEnabled = enabled; }
+	//Number of chunks the draws were split into for recording during the last Submit.
+	[[nodiscard]] constexpr uint32_t GetNrOfChunks() const noexcept { return m_NrOfChunks; }
+	//Binding calls that reached the command lists and that were dropped as redundant, summed over all lists of the frame.
+	[[nodiscard]] uint32_t GetNrOfBindingCallsIssued() const noexcept;
+	[[nodiscard]] uint32_t GetNrOfBindingCallsElided() const noexcept;
+	//CPU time of the last Submit in milliseconds, from gathering the packets to the last draw call.
+	[[nodiscard]] constexpr double GetSubmitTime() const noexcept { return m_SubmitTime; }
+	//Counts of what the last Submit had to drop, all zero when everything fit.
+	[[nodiscard]] constexpr const SubmitOverflow& GetSubmitOverflow() const noexcept { return m_SubmitOverflow; }
+	[[nodiscard]] const DrawList& GetDrawList() const noexcept { return m_DrawList; }
+	[[nodiscard]] constexpr uint32_t GetNrOfStateChangesUnsorted() const noexcept { return m_NrOfStateChangesUnsorted; }
+	[[nodiscard]] constexpr uint32_t GetNrOfStateChangesSorted() const noexcept { return m_NrOfStateChangesSorted; }
+	[[nodiscard]] const LightClusterBuilder& GetLightClusterBuilder() const noexcept { return m_LightClusterBuilder; }
+	[[nodiscard]] constexpr bool IsClusteredLightingEnabled() const noexcept { return m_ClusteredLightingEnabled; }
+	//Shades with the lights of the pixel's cluster instead of the lights of the object, takes effect from the next Begin.
+	void SetClusteredLighting(bool enabled) noexcept { m_ClusteredLightingEnabled = enabled; }
+	[[nodiscard]] constexpr bool IsBakedLightVisibilityEnabled() const noexcept { return m_BakedLightVisibilityEnabled; }
+	//Skips the shadow rays of the pairs whose baked light visibility is known while ray tracing, takes effect from the next Begin.
+	void SetBakedLightVisibility(bool enabled) noexcept { m_BakedLightVisibilityEnabled = enabled; }
+	[[nodiscard]] constexpr ShadowMode GetShadowMode() const noexcept { return m_ShadowMode; }
+	[[nodiscard]] const ShaderCache& GetShaderCache() const noexcept { return m_ShaderCache; }
+	[[nodiscard]] const ShaderPermutations& GetVertexShaders() const noexcept { return m_VertexShaders; }
+	[[nodiscard]] const ShaderPermutations& GetPixelShaders() const noexcept { return m_PixelShaders; }
 private:
 	void CreateDepthBuffer() noexcept;
 	void CreateRootSignature() noexcept;
 	void CreatePipelineStateObject() noexcept;
 	void CreateViewportAndScissorRect() noexcept;
+	void CreateInstanceBuffers() noexcept;
+	void CreateLightBuffers() noexcept;
+	void CreateCommandSignature() noexcept;
+	void CreateIndirectArgumentBuffers() noexcept;
+	void RecordDrawsInParallel(const std::vector<InstanceBatch>& batches) noexcept;
+	//Sets the render targets, pipeline and per frame root parameters on the recorder's command list.
+	void BindFrameState(CommandRecorder& recorder) noexcept;
 
-	Microsoft::WRL::ComPtr<IDxcBlob> CompileShader(const std::wstring& filepath, const std::wstring& entryPoint, const std::wstring& target) noexcept;
-	Microsoft::WRL::ComPtr<ID3DBlob> LoadCSO(const std::wstring& filepath) noexcept;
 private:
 	uint32_t m_CurrentBackBufferIndex{0u};
 	uint64_t m_FrameFenceValues[NR_OF_FRAMES] = {};
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_pRootSignature;
-	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pPSO;
+	//One pipeline per variant of the pixel shader, indexed with its mask. The frame's pipeline is picked in Begin.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_PSOs = {};
+	uint32_t m_PipelineMask = 0u;
+	ShaderCache m_ShaderCache;
+	ShaderPermutations m_VertexShaders;
+	ShaderPermutations m_PixelShaders;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_pDepthBuffer;
 	std::unique_ptr<DescriptorHeap> m_pDSVDescriptorHeap;
 
 	D3D12_VIEWPORT m_ViewPort;
 	RECT m_ScissorRect;
 	uint64_t m_FrameIndex = 0u;
+
+	static constexpr uint32_t s_MaxNrOfInstances = 100'000u;
+	static constexpr uint32_t s_MaxNrOfLightIndices = 1'000'000u;
+	//Same as the far plane of the camera.
+	static constexpr float s_MaxSortDepth = 10'000.0f;
+
+	static constexpr uint32_t s_MinNrOfBatchesPerChunk = 64u;
+
+	DirectX::XMFLOAT4X4 m_ViewProjection = {};
+	DirectX::XMFLOAT4X4 m_View = {};
+	D3D12_CPU_DESCRIPTOR_HANDLE m_BackBufferRTV = {};
+	D3D12_CPU_DESCRIPTOR_HANDLE m_DepthBufferDSV = {};
+	VP m_VPCBuffer = {};
+	InverseVP m_InverseVPCBuffer = {};
+	DirectX::XMFLOAT4 m_CameraConstants = {};
+	D3D12_GPU_VIRTUAL_ADDRESS m_AccelerationStructure = 0u;
+	CommandRecorder m_CommandRecorder;
+	//One recorder per chunk, the chunks are recorded on the thread pool.
+	std::vector<CommandRecorder> m_ChunkRecorders = {};
+	CommandListPool m_CommandListPool;
+	uint32_t m_NrOfChunks = 0u;
+	DrawPacketCache m_DrawPacketCache;
+	DrawList m_DrawList;
+	uint32_t m_NrOfStateChangesUnsorted = 0u;
+	uint32_t m_NrOfStateChangesSorted = 0u;
+	double m_SubmitTime = 0.0;
+	SubmitOverflow m_SubmitOverflow = {};
+
+	InstanceBatcher m_InstanceBatcher;
+	//The batches that fit into the instance and indirect argument buffers, only filled when some did not.
+	std::vector<InstanceBatch> m_ClampedBatches = {};
+	//One upload buffer per frame in flight. They stay mapped for the lifetime of the renderer.
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pInstanceBuffers[NR_OF_FRAMES];
+	InstanceData* m_pMappedInstanceData[NR_OF_FRAMES] = {};
+	//The lights and the light lists of the objects, copied every frame like the instances.
+	//The rows of the light visibility follow the light lists in the light index buffer, the root signature has no room for another buffer.
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pLightBuffers[NR_OF_FRAMES];
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pLightIndexBuffers[NR_OF_FRAMES];
+	PointLight* m_pMappedLights[NR_OF_FRAMES] = {};
+	uint32_t* m_pMappedLightIndices[NR_OF_FRAMES] = {};
+
+	bool m_ClusteredLightingEnabled = false;
+	bool m_BakedLightVisibilityEnabled = true;
+	ShadowMode m_ShadowMode = ShadowMode::None;
+	LightClusterBuilder m_LightClusterBuilder;
+	LightClusterConstants m_LightClusterConstants = {};
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pClusterRangeBuffers[NR_OF_FRAMES];
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pClusterLightIndexBuffers[NR_OF_FRAMES];
+	LightRange* m_pMappedClusterRanges[NR_OF_FRAMES] = {};
+	uint32_t* m_pMappedClusterLightIndices[NR_OF_FRAMES] = {};
+
+	bool m_IndirectDrawsEnabled = true;
+	IndirectDrawBuilder m_IndirectDrawBuilder;
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> m_pCommandSignature;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pIndirectArgumentBuffers[NR_OF_FRAMES];
+	IndirectDrawArguments* m_pMappedIndirectArguments[NR_OF_FRAMES] = {};
 };
\ No newline at end of file
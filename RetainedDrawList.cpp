@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "RetainedDrawList.h"
+
+void RetainedDrawList::BeginFrame() noexcept
+{
+	m_FrameNumber++;
+	m_AddedPackets.Clear();
+}
+
+bool RetainedDrawList::Submit(uint32_t objectIndex, bool hasChanged) noexcept
+{
+	if (objectIndex >= m_Objects.size())
+	{
+		m_Objects.resize(objectIndex + 1u);
+	}
+
+	ObjectState& state = m_Objects[objectIndex];
+	state.SubmitFrame = m_FrameNumber;
+	if (hasChanged)
+	{
+		//Its retained packets are dropped by the next build.
+		state.ChangeFrame = m_FrameNumber;
+		state.IsRetained = false;
+	}
+	return !state.IsRetained;
+}
+
+void RetainedDrawList::Remove(uint32_t objectIndex) noexcept
+{
+	if (objectIndex < m_Objects.size())
+	{
+		m_Objects[objectIndex] = {};
+	}
+}
+
+void RetainedDrawList::Build(DrawList& drawList) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_AddedPackets.Sort();
+	const std::vector<DrawPacket>& addedPackets = m_AddedPackets.GetPackets();
+
+	//One pass drops the packets of the objects that changed or were removed, and picks out the ones submitted this frame.
+	//Both keep the sorted order.
+	m_SubmittedPackets.clear();
+	uint32_t nrOfKept = 0u;
+	for (const DrawPacket& packet : m_RetainedPackets)
+	{
+		const ObjectState& state = m_Objects[packet.ObjectIndex];
+		if (!state.IsRetained)
+			continue;
+
+		m_RetainedPackets[nrOfKept++] = packet;
+		if (state.SubmitFrame == m_FrameNumber)
+		{
+			m_SubmittedPackets.push_back(packet);
+		}
+	}
+	m_RetainedPackets.resize(nrOfKept);
+	drawList.Merge(m_SubmittedPackets, addedPackets);
+
+	//The added packets of the objects that did not change this frame are retained from now on.
+	m_PromotedPackets.clear();
+	for (const DrawPacket& packet : addedPackets)
+	{
+		ObjectState& state = m_Objects[packet.ObjectIndex];
+		if (state.ChangeFrame != m_FrameNumber)
+		{
+			state.IsRetained = true;
+			m_PromotedPackets.push_back(packet);
+		}
+	}
+	if (!m_PromotedPackets.empty())
+	{
+		m_MergeBuffer.resize(m_RetainedPackets.size() + m_PromotedPackets.size());
+		std::merge(m_RetainedPackets.begin(), m_RetainedPackets.end(), m_PromotedPackets.begin(), m_PromotedPackets.end(), m_MergeBuffer.begin(), [](const DrawPacket& a, const DrawPacket& b) { return a.SortKey < b.SortKey; });
+		m_RetainedPackets.swap(m_MergeBuffer);
+	}
+
+	m_NrOfReusedPackets = static_cast<uint32_t>(m_SubmittedPackets.size());
+	m_NrOfSortedPackets = static_cast<uint32_t>(addedPackets.size());
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BuildTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+void RetainedDrawList::Clear() noexcept
+{
+	m_Objects.clear();
+	m_RetainedPackets.clear();
+	m_AddedPackets.Clear();
+	m_SubmittedPackets.clear();
+	m_PromotedPackets.clear();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "DrawList.h"
+
+//Keeps the sorted packets of the objects that did not change across frames, so that a frame only sorts the packets of the objects
+//that changed or are new to the list, and merges them with the retained ones. Objects are identified by the ObjectIndex of their packets.
+//An object that stays unchanged for a frame has its packets moved into the retained list, one that changes has them dropped from it.
+//The depth of a retained packet is the one it was added with, so the front to back order of a group goes stale while the camera moves.
+//It only steers early depth rejection, the state order that the batches depend on is always exact.
+class RetainedDrawList
+{
+public:
+	RetainedDrawList() noexcept = default;
+	~RetainedDrawList() noexcept = default;
+
+	void BeginFrame() noexcept;
+	//The object is drawn this frame. Returns true if its packets have to be added, because it changed or is not retained yet.
+	[[nodiscard]] bool Submit(uint32_t objectIndex, bool hasChanged) noexcept;
+	//A packet of an object that Submit returned true for.
+	void Add(const DrawPacket& packet) noexcept { m_AddedPackets.Add(packet); }
+	//Drops the retained packets of the object, for example when its index is given to another object.
+	void Remove(uint32_t objectIndex) noexcept;
+	//Writes the packets of every object submitted this frame to the draw list, sorted on their key.
+	void Build(DrawList& drawList) noexcept;
+	//Drops everything, for example when the scene is reloaded.
+	void Clear() noexcept;
+
+	[[nodiscard]] bool IsRetained(uint32_t objectIndex) const noexcept { return objectIndex < m_Objects.size() && m_Objects[objectIndex].IsRetained; }
+	[[nodiscard]] uint32_t GetNrOfRetainedPackets() const noexcept { return static_cast<uint32_t>(m_RetainedPackets.size()); }
+	//Number of packets that were taken from the retained list and that had to be sorted during the last build.
+	[[nodiscard]] constexpr uint32_t GetNrOfReusedPackets() const noexcept { return m_NrOfReusedPackets; }
+	[[nodiscard]] constexpr uint32_t GetNrOfSortedPackets() const noexcept { return m_NrOfSortedPackets; }
+	//Time the last build took in milliseconds.
+	[[nodiscard]] constexpr double GetBuildTime() const noexcept { return m_BuildTime; }
+private:
+	struct ObjectState
+	{
+		//Last frame the object was submitted in and last frame it changed in.
+		uint32_t SubmitFrame = UINT32_MAX;
+		uint32_t ChangeFrame = UINT32_MAX;
+		bool IsRetained = false;
+	};
+private:
+	std::vector<ObjectState> m_Objects = {};
+	//Sorted on their key, also holds the packets of retained objects that were not submitted this frame.
+	std::vector<DrawPacket> m_RetainedPackets = {};
+	DrawList m_AddedPackets;
+	std::vector<DrawPacket> m_SubmittedPackets = {};
+	std::vector<DrawPacket> m_PromotedPackets = {};
+	std::vector<DrawPacket> m_MergeBuffer = {};
+	uint32_t m_FrameNumber = 0u;
+
+	uint32_t m_NrOfReusedPackets = 0u;
+	uint32_t m_NrOfSortedPackets = 0u;
+	double m_BuildTime = 0.0;
+};
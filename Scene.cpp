@@ -2,12 +2,11 @@
 #include "Scene.h"
 #include "Window.h"
 
-void Scene::Initialize() noexcept
+void Scene::Initialize(uint32_t seed) noexcept
 {
 	m_pRayTracingManager = std::make_unique<RayTracingManager>();
 	//Use this to randomize colors.
-	using t_clock = std::chrono::high_resolution_clock;
-	std::default_random_engine generator(static_cast<UINT>(t_clock::now().time_since_epoch().count()));
+	std::default_random_engine generator(seed);
 	std::uniform_real_distribution<float> distributionColor(0.0f, 1.0f);
 	std::uniform_real_distribution<float> distributionSize(0.5f, 2.0f);
 	std::uniform_int_distribution<int> distributionBehaviour(0, 3);
@@ -64,6 +63,18 @@ void Scene::Initialize() noexcept
 	////Wall to the right
 	AddVertexObject("Rec", DirectX::XMVectorSet(100.0f, 90.0f, 50.0f, 1.0f), DirectX::XMVectorSet(0.0f, (float)M_PI / 2.0f, 0.0f, 0.0f), 200.0f, NONE, DirectX::XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f));
 
+	//Lights, in the order the pixel shader used to add them up.
+	m_LightManager.AddLight(DirectX::XMFLOAT3(0.0f, 50.0f, -5.0f), DirectX::XMFLOAT3(0.0f, 0.7f, 0.7f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(-40.0f, 60.0f, 80.0f), DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(50.0f, 50.0f, 10.0f), DirectX::XMFLOAT3(0.7f, 0.7f, 0.3f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(5.0f, 100.0f, -5.0f), DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(0.0f, 150.0f, 160.0f), DirectX::XMFLOAT3(0.2f, 0.65f, 0.90f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(30.0f, 20.0f, -60.0f), DirectX::XMFLOAT3(0.0f, 1.0f, 0.36f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(0.0f, -40.0f, 170.0f), DirectX::XMFLOAT3(1.0f, 0.15f, 0.22f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(50.0f, 50.0f, 140.0f), DirectX::XMFLOAT3(0.66f, 0.34f, 0.78f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(-34.0f, 87.0f, 170.0f), DirectX::XMFLOAT3(1.0f, 0.0f, 1.0f));
+	m_LightManager.AddLight(DirectX::XMFLOAT3(36.0f, 36.0f, -15.0f), DirectX::XMFLOAT3(0.2f, 0.2f, 0.2f));
+
 	auto pCommandAllocator = DXCore::GetCommandAllocators()[0];
 	auto pCommandList = DXCore::GetCommandList();
 	auto pDevice = DXCore::GetDevice();
@@ -76,7 +87,17 @@ void Scene::Initialize() noexcept
 	HR(pCommandAllocator->Reset());
 	HR(pCommandList->Reset(pCommandAllocator.Get(), nullptr));
 
-	m_pRayTracingManager->Initialize(m_UniqueModels, m_Objects, m_TotalMeshes);
+	m_pRayTracingManager->Initialize(m_UniqueModels, m_Objects, m_TotalObjects);
+
+	GatherObjects();
+	m_SceneBVH.Build(m_ObjectBounds);
+	m_RayCaster.Update(m_ObjectList, m_SceneBVH);
+	m_LightManager.Update(m_ObjectBounds);
+	//The lights and the static objects do not move, so their visibility is baked once.
+	std::vector<ModelBVH::Triangle> staticTriangles;
+	GatherWorldTriangles(staticTriangles, true);
+	m_LightVisibility.Bake(m_TotalObjects, std::move(staticTriangles), m_LightManager.GetLights());
+	m_LightVisibility.Update(m_LightManager.GetLights(), m_DynamicBounds);
 
 	HR(pCommandList->Close());
 	STDCALL(DXCore::GetCommandQueue()->ExecuteCommandLists(ARRAYSIZE(commandLists), commandLists));
@@ -110,8 +131,162 @@ void Scene::Update(bool rayTraceBool, float deltaTime) noexcept
 	if (rayTraceBool)
 	{
 		//Update the top level acceleration structure.
-		m_pRayTracingManager->UpdateInstances(m_UniqueModels, m_Objects, m_TotalMeshes);
+		m_pRayTracingManager->UpdateInstances();
+	}
+}
+
+void Scene::CullObjects(const DirectX::XMFLOAT4X4& viewProjection) noexcept
+{
+	GatherObjects();
+	m_SceneBVH.Refit(m_ObjectBounds);
+	m_RayCaster.Update(m_ObjectList, m_SceneBVH);
+	//Every object gets its light list, also the culled ones, so that the CPU ray tracer can shade anything it hits.
+	m_LightManager.Update(m_ObjectBounds);
+	m_LightVisibility.Update(m_LightManager.GetLights(), m_DynamicBounds);
+
+	FrustumPlanes frustum = FrustumCuller::ExtractPlanes(viewProjection);
+	m_VisibleIndices.clear();
+	if (m_TotalObjects >= s_HierarchicalCullingThreshold)
+	{
+		//Large scenes walk the hierarchy so that whole groups of objects are accepted or rejected at once.
+		m_SceneBVH.QueryFrustum(frustum, m_VisibleIndices);
+		std::sort(m_VisibleIndices.begin(), m_VisibleIndices.end());
+	}
+	else
+	{
+		m_FrustumCuller.Clear();
+		m_FrustumCuller.Reserve(m_TotalObjects);
+		for (const DirectX::BoundingBox& bounds : m_ObjectBounds)
+		{
+			m_FrustumCuller.AddBox(bounds);
+		}
+		uint32_t nrOfVisible = m_FrustumCuller.Cull(frustum);
+		m_VisibleIndices.assign(m_FrustumCuller.GetVisibleIndices(), m_FrustumCuller.GetVisibleIndices() + nrOfVisible);
+	}
+	m_NrOfVisibleObjects = static_cast<uint32_t>(m_VisibleIndices.size());
+
+#if defined(_DEBUG)
+	//Validate both the SIMD kernel and the hierarchy against the scalar reference.
+	FrustumCuller referenceCuller;
+	referenceCuller.Reserve(m_TotalObjects);
+	for (const DirectX::BoundingBox& bounds : m_ObjectBounds)
+	{
+		referenceCuller.AddBox(bounds);
+	}
+	std::vector<uint32_t> referenceIndices = {};
+	referenceCuller.CullScalar(frustum, referenceIndices);
+	DBG_ASSERT(referenceIndices == m_VisibleIndices, "Error! The frustum culling result does not match the scalar reference.");
+
+	std::vector<uint32_t> hierarchyIndices = {};
+	m_SceneBVH.QueryFrustum(frustum, hierarchyIndices);
+	std::sort(hierarchyIndices.begin(), hierarchyIndices.end());
+	DBG_ASSERT(referenceIndices == hierarchyIndices, "Error! The hierarchical frustum culling does not match the scalar reference.");
+#endif
+
+	if (m_OcclusionCullingEnabled)
+	{
+		OcclusionCull(viewProjection);
+	}
+
+	//The visible indices are sorted, so we can walk them alongside the objects.
+	uint32_t objectIndex = 0u;
+	uint32_t visibleIndex = 0u;
+	for (auto& modelInstances : m_Objects)
+	{
+		std::vector<std::shared_ptr<VertexObject>>& culledObjects = m_CulledObjects[modelInstances.first];
+		culledObjects.clear();
+		for (auto& object : modelInstances.second)
+		{
+			if (visibleIndex < m_NrOfVisibleObjects && m_VisibleIndices[visibleIndex] == objectIndex)
+			{
+				culledObjects.push_back(object);
+				visibleIndex++;
+			}
+			objectIndex++;
+		}
+	}
+}
+
+void Scene::GatherObjects() noexcept
+{
+	m_ObjectList.clear();
+	m_ObjectList.reserve(m_TotalObjects);
+	m_ObjectBounds.clear();
+	m_ObjectBounds.reserve(m_TotalObjects);
+	m_DynamicBounds.clear();
+	for (auto& modelInstances : m_Objects)
+	{
+		for (auto& object : modelInstances.second)
+		{
+			object->SetSceneIndex(static_cast<uint32_t>(m_ObjectList.size()));
+			m_ObjectList.push_back(object.get());
+			m_ObjectBounds.push_back(object->GetWorldBoundingBox());
+			if (!object->IsStatic())
+			{
+				m_DynamicBounds.push_back(object->GetWorldBoundingBox());
+			}
+		}
+	}
+}
+
+void Scene::GatherWorldTriangles(std::vector<ModelBVH::Triangle>& triangles, bool onlyStatic) const noexcept
+{
+	triangles.clear();
+	for (uint32_t objectIndex{ 0u }; objectIndex < m_ObjectList.size(); ++objectIndex)
+	{
+		if (onlyStatic && !m_ObjectList[objectIndex]->IsStatic())
+			continue;
+
+		const DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&m_ObjectList[objectIndex]->GetTransform());
+		for (const ModelBVH::Triangle& triangle : m_ObjectList[objectIndex]->GetModel()->GetBVH().GetTriangles())
+		{
+			DirectX::XMFLOAT3 vertex0, edge1, edge2;
+			DirectX::XMStoreFloat3(&vertex0, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&triangle.Vertex0), world));
+			DirectX::XMStoreFloat3(&edge1, DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&triangle.Edge1), world));
+			DirectX::XMStoreFloat3(&edge2, DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&triangle.Edge2), world));
+			triangles.push_back({ vertex0, edge1, edge2, objectIndex, triangle.TriangleIndex });
+		}
+	}
+}
+
+void Scene::OcclusionCull(const DirectX::XMFLOAT4X4& viewProjection) noexcept
+{
+	//The large objects that survived frustum culling become occluders, everything else is tested against them.
+	m_OcclusionCuller.BeginFrame(viewProjection);
+	m_OccludeeIndices.clear();
+	for (uint32_t i{ 0u }; i < m_NrOfVisibleObjects; ++i)
+	{
+		const VertexObject* pObject = m_ObjectList[m_VisibleIndices[i]];
+		const std::shared_ptr<Model>& pModel = pObject->GetModel();
+		if (pModel->HasOccluder() && pObject->GetWorldBoundingSphere().Radius >= s_MinOccluderRadius)
+		{
+			m_OcclusionCuller.AddOccluder(pObject->GetTransform(), pModel->GetOccluderPositions(), pModel->GetOccluderIndices());
+		}
+		else
+		{
+			m_OccludeeIndices.push_back(m_VisibleIndices[i]);
+		}
+	}
+	m_OcclusionCuller.RenderOccluders();
+	m_OcclusionCuller.TestBoxes(m_ObjectBounds, m_OccludeeIndices, m_OccludeeVisibility);
+
+	//Both lists are sorted, so the hidden objects can be removed in a single pass that keeps the order.
+	uint32_t occludeeIndex = 0u;
+	uint32_t nrOfVisible = 0u;
+	for (uint32_t i{ 0u }; i < m_NrOfVisibleObjects; ++i)
+	{
+		bool visible = true;
+		if (occludeeIndex < m_OccludeeIndices.size() && m_OccludeeIndices[occludeeIndex] == m_VisibleIndices[i])
+		{
+			visible = m_OccludeeVisibility[occludeeIndex++] != 0u;
+		}
+		if (visible)
+		{
+			m_VisibleIndices[nrOfVisible++] = m_VisibleIndices[i];
+		}
 	}
+	m_VisibleIndices.resize(nrOfVisible);
+	m_NrOfVisibleObjects = nrOfVisible;
 }
 
 void Scene::AddVertexObject(const std::string path, DirectX::XMVECTOR pos, DirectX::XMVECTOR rot, float scale, UpdateType updateType, DirectX::XMFLOAT4 color)
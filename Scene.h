@@ -2,6 +2,11 @@
 #include "RayTracingManager.h"
 #include "DXCore.h"
 #include "RenderCommand.h"
+#include "SceneBVH.h"
+#include "SceneRayCaster.h"
+#include "OcclusionCuller.h"
+#include "LightManager.h"
+#include "LightVisibilityBaker.h"
 
 class Scene
 {
@@ -9,15 +14,41 @@ public:
 	Scene() noexcept = default;
 	~Scene() noexcept = default;
 
-	//Initializes all objects in the scene.
-	void Initialize() noexcept;
+	//Initializes all objects in the scene. The seed places the randomized objects, the same seed gives the same scene.
+	void Initialize(uint32_t seed) noexcept;
 	void Update(bool rayTraceBool, float deltaTime) noexcept;
+	//Frustum and occlusion culls all objects against the view projection matrix. The result is fetched with GetCulledVertexObjects.
+	void CullObjects(const DirectX::XMFLOAT4X4& viewProjection) noexcept;
+	void SetOcclusionCulling(bool enabled) noexcept { m_OcclusionCullingEnabled = enabled; }
 
-	const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& GetCulledVertexObjects() const { return m_Objects; }
+	const std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>>& GetCulledVertexObjects() const { return m_CulledObjects; }
 	D3D12_GPU_VIRTUAL_ADDRESS GetAccelerationStructureGPUAddress() const { return m_pRayTracingManager->GetTopLevelAccelerationStructure(); }
+	[[nodiscard]] const TLASUpdatePolicy& GetTLASUpdatePolicy() const noexcept { return m_pRayTracingManager->GetTLASUpdatePolicy(); }
+	[[nodiscard]] const RayTracingManager& GetRayTracingManager() const noexcept { return *m_pRayTracingManager; }
 	[[nodiscard]] constexpr uint32_t GetTotalNrOfMeshes() noexcept { return m_TotalMeshes; }
 	[[nodiscard]] constexpr uint32_t GetTotalNrOfVertices() noexcept { return m_TotalNrOfVertices; }
 	[[nodiscard]] constexpr uint32_t GetTotalNrOfIndices() noexcept { return m_TotalNrOfIndices; }
+	[[nodiscard]] constexpr uint32_t GetTotalNrOfObjects() noexcept { return m_TotalObjects; }
+	[[nodiscard]] constexpr uint32_t GetNrOfCulledObjects() noexcept { return m_TotalObjects - m_NrOfVisibleObjects; }
+	[[nodiscard]] const SceneBVH& GetBVH() const noexcept { return m_SceneBVH; }
+	//All objects, indexed the same way as the items of the BVH.
+	[[nodiscard]] const std::vector<VertexObject*>& GetObjectList() const noexcept { return m_ObjectList; }
+	//CPU ray queries for picking, line of sight and placement. They see the objects as they were at the last CullObjects.
+	//The single queries can be called from several threads at once, the batched ones spread the rays over the thread pool.
+	bool RayCast(const SceneRay& ray, SceneRayHit& hit) const noexcept { return m_RayCaster.RayCast(ray, hit); }
+	[[nodiscard]] bool RayCastAny(const SceneRay& ray) const noexcept { return m_RayCaster.RayCastAny(ray); }
+	uint32_t RayCast(const SceneRay* pRays, uint32_t count, SceneRayHit* pHits) noexcept { return m_RayCaster.RayCast(pRays, count, pHits); }
+	uint32_t RayCastAny(const SceneRay* pRays, uint32_t count, uint8_t* pResults) noexcept { return m_RayCaster.RayCastAny(pRays, count, pResults); }
+	[[nodiscard]] const SceneRayCaster& GetRayCaster() const noexcept { return m_RayCaster; }
+	//Every object's triangles moved into world space, with the object's index in the object list as mesh index. Optionally only the static objects.
+	void GatherWorldTriangles(std::vector<ModelBVH::Triangle>& triangles, bool onlyStatic = false) const noexcept;
+	//The lights and the light list of every object, indexed like the object list and rebuilt by CullObjects.
+	[[nodiscard]] LightManager& GetLightManager() noexcept { return m_LightManager; }
+	[[nodiscard]] const LightManager& GetLightManager() const noexcept { return m_LightManager; }
+	//Baked visibility between the static objects and the lights, indexed like the object list and updated for the dynamic objects by CullObjects.
+	[[nodiscard]] const LightVisibilityBaker& GetLightVisibility() const noexcept { return m_LightVisibility; }
+	[[nodiscard]] constexpr bool IsOcclusionCullingEnabled() const noexcept { return m_OcclusionCullingEnabled; }
+	[[nodiscard]] const OcclusionCullerStats& GetOcclusionStats() const noexcept { return m_OcclusionCuller.GetStats(); }
 
 private:
 	void AddVertexObject(
@@ -28,7 +59,16 @@ private:
 		UpdateType updateType,
 		DirectX::XMFLOAT4 color
 	);
+	//Gathers every object and its world space bounds, in the order m_Objects is iterated.
+	void GatherObjects() noexcept;
+	//Removes the objects hidden behind the large occluders from the visible indices.
+	void OcclusionCull(const DirectX::XMFLOAT4X4& viewProjection) noexcept;
 private:
+	//Below this many objects the flat SIMD kernel is faster than walking the hierarchy.
+	static constexpr uint32_t s_HierarchicalCullingThreshold = 1024u;
+	//Objects with an occluder proxy and a bounding sphere at least this large are rasterized as occluders.
+	static constexpr float s_MinOccluderRadius = 10.0f;
+
 	std::unique_ptr<RayTracingManager> m_pRayTracingManager = nullptr;
 
 	uint32_t m_TotalObjects = 0u;
@@ -41,6 +81,25 @@ private:
 	//Second unordered map has the same key, but holds a vector with all the objects that use that model.
 	std::unordered_map<std::string, std::shared_ptr<Model>> m_UniqueModels = {};
 	std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>> m_Objects = {};
+	//Same layout as m_Objects but only holds the objects that survived culling this frame.
+	std::unordered_map<std::string, std::vector<std::shared_ptr<VertexObject>>> m_CulledObjects = {};
+
+	FrustumCuller m_FrustumCuller;
+	SceneBVH m_SceneBVH;
+	SceneRayCaster m_RayCaster;
+	LightManager m_LightManager;
+	LightVisibilityBaker m_LightVisibility;
+	OcclusionCuller m_OcclusionCuller;
+	//All objects and their world space bounds, indexed the same way as the culling results.
+	std::vector<VertexObject*> m_ObjectList = {};
+	std::vector<DirectX::BoundingBox> m_ObjectBounds = {};
+	//Bounds of the objects that move, which can cast shadows the light visibility bake does not know about.
+	std::vector<DirectX::BoundingBox> m_DynamicBounds = {};
+	std::vector<uint32_t> m_VisibleIndices = {};
+	std::vector<uint32_t> m_OccludeeIndices = {};
+	std::vector<uint8_t> m_OccludeeVisibility = {};
+	uint32_t m_NrOfVisibleObjects = 0u;
+	bool m_OcclusionCullingEnabled = true;
 
 	//Add corresponding unordered maps for arbitrary geometry.
 };
\ No newline at end of file
@@ -0,0 +1,483 @@
+#include "pch.h"
+#include "SceneBVH.h"
+
+namespace
+{
+	//Nodes are only rejected by the frustum when they are outside by more than this.
+	//The node bounds are stored as min & max while the items use center & extents, so rounding could otherwise reject an item that touches a plane.
+	constexpr float s_PlaneTolerance = 1.0e-3f;
+
+	struct SAHBin
+	{
+		DirectX::XMFLOAT3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		DirectX::XMFLOAT3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t Count = 0u;
+	};
+
+	void GrowBounds(DirectX::XMFLOAT3& min, DirectX::XMFLOAT3& max, const DirectX::XMFLOAT3& otherMin, const DirectX::XMFLOAT3& otherMax) noexcept
+	{
+		min = { std::min(min.x, otherMin.x), std::min(min.y, otherMin.y), std::min(min.z, otherMin.z) };
+		max = { std::max(max.x, otherMax.x), std::max(max.y, otherMax.y), std::max(max.z, otherMax.z) };
+	}
+
+	float GetComponent(const DirectX::XMFLOAT3& vector, uint32_t axis) noexcept
+	{
+		return axis == 0u ? vector.x : (axis == 1u ? vector.y : vector.z);
+	}
+}
+
+void SceneBVH::Build(const std::vector<DirectX::BoundingBox>& itemBounds) noexcept
+{
+	const size_t nrOfItems = itemBounds.size();
+	m_ItemCenters.resize(nrOfItems);
+	m_ItemExtents.resize(nrOfItems);
+	for (size_t i{ 0u }; i < nrOfItems; ++i)
+	{
+		m_ItemCenters[i] = itemBounds[i].Center;
+		m_ItemExtents[i] = itemBounds[i].Extents;
+	}
+
+	BuildFromItems();
+}
+
+void SceneBVH::Refit(const std::vector<DirectX::BoundingBox>& itemBounds) noexcept
+{
+	DBG_ASSERT(itemBounds.size() == m_ItemCenters.size(), "The BVH has to be rebuilt when the number of items changes.");
+
+	for (size_t i{ 0u }; i < itemBounds.size(); ++i)
+	{
+		m_ItemCenters[i] = itemBounds[i].Center;
+		m_ItemExtents[i] = itemBounds[i].Extents;
+	}
+	if (m_Nodes.empty())
+		return;
+
+	//Children are always stored after their parent, so walking backwards updates the children before the parent.
+	//Nodes left behind by partial rebuilds are updated as well, it is cheaper than keeping track of them.
+	for (size_t i{ m_Nodes.size() }; i-- > 0u;)
+	{
+		SceneBVHNode& node = m_Nodes[i];
+		if (node.Count > 0u)
+		{
+			node.Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+			node.Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (uint32_t j{ 0u }; j < node.Count; ++j)
+			{
+				uint32_t itemIndex = m_ItemIndices[node.LeftFirst + j];
+				const DirectX::XMFLOAT3& center = m_ItemCenters[itemIndex];
+				const DirectX::XMFLOAT3& extents = m_ItemExtents[itemIndex];
+				GrowBounds(node.Min, node.Max,
+					{ center.x - extents.x, center.y - extents.y, center.z - extents.z },
+					{ center.x + extents.x, center.y + extents.y, center.z + extents.z });
+			}
+		}
+		else
+		{
+			const SceneBVHNode& left = m_Nodes[node.LeftFirst];
+			const SceneBVHNode& right = m_Nodes[node.LeftFirst + 1u];
+			node.Min = left.Min;
+			node.Max = left.Max;
+			GrowBounds(node.Min, node.Max, right.Min, right.Max);
+		}
+	}
+
+	RebuildDegradedSubtrees(0u, 1u);
+
+	//When the partial rebuilds have left more dead nodes than live ones the whole tree is rebuilt to compact it.
+	if (m_NrOfDeadNodes > static_cast<uint32_t>(m_Nodes.size()) / 2u)
+	{
+		BuildFromItems();
+	}
+}
+
+void SceneBVH::QueryFrustum(const FrustumPlanes& frustum, std::vector<uint32_t>& result) const noexcept
+{
+	if (m_Nodes.empty())
+		return;
+
+	uint32_t stack[s_MaxDepth];
+	uint32_t stackSize = 0u;
+	stack[stackSize++] = 0u;
+	while (stackSize > 0u)
+	{
+		uint32_t nodeIndex = stack[--stackSize];
+		const SceneBVHNode& node = m_Nodes[nodeIndex];
+		DirectX::XMFLOAT3 center = { (node.Min.x + node.Max.x) * 0.5f, (node.Min.y + node.Max.y) * 0.5f, (node.Min.z + node.Max.z) * 0.5f };
+		DirectX::XMFLOAT3 extents = { (node.Max.x - node.Min.x) * 0.5f, (node.Max.y - node.Min.y) * 0.5f, (node.Max.z - node.Min.z) * 0.5f };
+
+		bool outside = false;
+		bool fullyInside = true;
+		for (uint32_t p{ 0u }; p < 6u && !outside; ++p)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.Planes[p];
+			float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float radius = std::fabs(plane.x) * extents.x + std::fabs(plane.y) * extents.y + std::fabs(plane.z) * extents.z;
+			outside = distance + radius < -s_PlaneTolerance;
+			fullyInside = fullyInside && distance - radius > s_PlaneTolerance;
+		}
+		if (outside)
+			continue;
+
+		//Nothing below a node that is completely inside the frustum has to be tested.
+		if (fullyInside)
+		{
+			AppendSubtree(nodeIndex, result);
+		}
+		else if (node.Count > 0u)
+		{
+			//Same test as the flat culling kernel so that both give identical results.
+			for (uint32_t i{ 0u }; i < node.Count; ++i)
+			{
+				uint32_t itemIndex = m_ItemIndices[node.LeftFirst + i];
+				const DirectX::XMFLOAT3& itemCenter = m_ItemCenters[itemIndex];
+				const DirectX::XMFLOAT3& itemExtents = m_ItemExtents[itemIndex];
+				bool inside = true;
+				for (uint32_t p{ 0u }; p < 6u && inside; ++p)
+				{
+					const DirectX::XMFLOAT4& plane = frustum.Planes[p];
+					float distance = plane.x * itemCenter.x + plane.y * itemCenter.y + plane.z * itemCenter.z + plane.w;
+					float radius = std::fabs(plane.x) * itemExtents.x + std::fabs(plane.y) * itemExtents.y + std::fabs(plane.z) * itemExtents.z;
+					inside = distance + radius >= 0.0f;
+				}
+				if (inside)
+				{
+					result.push_back(itemIndex);
+				}
+			}
+		}
+		else
+		{
+			if (stackSize + 2u > s_MaxDepth)
+			{
+				DBG_ASSERT(false, "The BVH is too deep for the traversal stack.");
+				return;
+			}
+			stack[stackSize++] = node.LeftFirst + 1u;
+			stack[stackSize++] = node.LeftFirst;
+		}
+	}
+}
+
+void SceneBVH::QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<uint32_t>& result) const noexcept
+{
+	if (m_Nodes.empty())
+		return;
+
+	const DirectX::XMFLOAT3& c = sphere.Center;
+	const float radiusSquared = sphere.Radius * sphere.Radius;
+	auto distanceSquared = [&c](const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) noexcept
+	{
+		float dx = std::max(std::max(min.x - c.x, 0.0f), c.x - max.x);
+		float dy = std::max(std::max(min.y - c.y, 0.0f), c.y - max.y);
+		float dz = std::max(std::max(min.z - c.z, 0.0f), c.z - max.z);
+		return dx * dx + dy * dy + dz * dz;
+	};
+
+	uint32_t stack[s_MaxDepth];
+	uint32_t stackSize = 0u;
+	stack[stackSize++] = 0u;
+	while (stackSize > 0u)
+	{
+		const SceneBVHNode& node = m_Nodes[stack[--stackSize]];
+		if (distanceSquared(node.Min, node.Max) > radiusSquared)
+			continue;
+
+		if (node.Count > 0u)
+		{
+			for (uint32_t i{ 0u }; i < node.Count; ++i)
+			{
+				uint32_t itemIndex = m_ItemIndices[node.LeftFirst + i];
+				const DirectX::XMFLOAT3& center = m_ItemCenters[itemIndex];
+				const DirectX::XMFLOAT3& extents = m_ItemExtents[itemIndex];
+				DirectX::XMFLOAT3 min = { center.x - extents.x, center.y - extents.y, center.z - extents.z };
+				DirectX::XMFLOAT3 max = { center.x + extents.x, center.y + extents.y, center.z + extents.z };
+				if (distanceSquared(min, max) <= radiusSquared)
+				{
+					result.push_back(itemIndex);
+				}
+			}
+		}
+		else
+		{
+			if (stackSize + 2u > s_MaxDepth)
+			{
+				DBG_ASSERT(false, "The BVH is too deep for the traversal stack.");
+				return;
+			}
+			stack[stackSize++] = node.LeftFirst + 1u;
+			stack[stackSize++] = node.LeftFirst;
+		}
+	}
+}
+
+void SceneBVH::QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, std::vector<uint32_t>& result) const noexcept
+{
+	TraverseRay(origin, direction, maxDistance, [&result](uint32_t itemIndex, float&) noexcept
+		{
+			result.push_back(itemIndex);
+			return false;
+		});
+}
+
+void SceneBVH::BuildFromItems() noexcept
+{
+	const uint32_t nrOfItems = static_cast<uint32_t>(m_ItemCenters.size());
+	m_Nodes.clear();
+	m_BuildAreas.clear();
+	m_NrOfDeadNodes = 0u;
+	if (nrOfItems == 0u)
+		return;
+
+	m_ItemIndices.resize(nrOfItems);
+	for (uint32_t i{ 0u }; i < nrOfItems; ++i)
+	{
+		m_ItemIndices[i] = i;
+	}
+
+	//A binary tree with at least one item per leaf never has more than 2n - 1 nodes.
+	m_Nodes.reserve(2u * static_cast<size_t>(nrOfItems));
+	m_BuildAreas.reserve(2u * static_cast<size_t>(nrOfItems));
+	m_Nodes.push_back({});
+	m_BuildAreas.push_back(0.0f);
+	BuildRecursive(0u, 1u, 0u, nrOfItems);
+}
+
+void SceneBVH::BuildRecursive(uint32_t nodeIndex, uint32_t depth, uint32_t first, uint32_t count) noexcept
+{
+	//Bounds of the items and of their centers.
+	DirectX::XMFLOAT3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	DirectX::XMFLOAT3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	DirectX::XMFLOAT3 centroidMin = min;
+	DirectX::XMFLOAT3 centroidMax = max;
+	for (uint32_t i{ first }; i < first + count; ++i)
+	{
+		const DirectX::XMFLOAT3& center = m_ItemCenters[m_ItemIndices[i]];
+		const DirectX::XMFLOAT3& extents = m_ItemExtents[m_ItemIndices[i]];
+		GrowBounds(min, max,
+			{ center.x - extents.x, center.y - extents.y, center.z - extents.z },
+			{ center.x + extents.x, center.y + extents.y, center.z + extents.z });
+		GrowBounds(centroidMin, centroidMax, center, center);
+	}
+
+	const float area = SurfaceArea(min, max);
+	m_Nodes[nodeIndex].Min = min;
+	m_Nodes[nodeIndex].Max = max;
+	m_Nodes[nodeIndex].LeftFirst = first;
+	m_Nodes[nodeIndex].Count = count;
+	m_BuildAreas[nodeIndex] = area;
+	if (count <= s_MaxLeafSize)
+		return;
+
+	//Find the cheapest split plane between the bins of every axis.
+	//Deep nodes skip this and are halved at the median of their longest axis instead, which keeps the tree within the depth cap.
+	const bool medianSplit = depth >= s_MedianSplitDepth;
+	float bestCost = FLT_MAX;
+	uint32_t bestAxis = 0u;
+	uint32_t bestSplit = 0u;
+	for (uint32_t axis{ 0u }; axis < 3u && !medianSplit; ++axis)
+	{
+		const float axisMin = GetComponent(centroidMin, axis);
+		const float axisExtent = GetComponent(centroidMax, axis) - axisMin;
+		if (axisExtent <= 0.0f)
+			continue;
+
+		SAHBin bins[s_NrOfBins];
+		const float scale = static_cast<float>(s_NrOfBins) / axisExtent;
+		for (uint32_t i{ first }; i < first + count; ++i)
+		{
+			const DirectX::XMFLOAT3& center = m_ItemCenters[m_ItemIndices[i]];
+			const DirectX::XMFLOAT3& extents = m_ItemExtents[m_ItemIndices[i]];
+			uint32_t bin = std::min(s_NrOfBins - 1u, static_cast<uint32_t>((GetComponent(center, axis) - axisMin) * scale));
+			GrowBounds(bins[bin].Min, bins[bin].Max,
+				{ center.x - extents.x, center.y - extents.y, center.z - extents.z },
+				{ center.x + extents.x, center.y + extents.y, center.z + extents.z });
+			bins[bin].Count++;
+		}
+
+		//Sweep from both sides to get the area and item count on each side of every split plane.
+		float leftArea[s_NrOfBins - 1u], rightArea[s_NrOfBins - 1u];
+		uint32_t leftCount[s_NrOfBins - 1u], rightCount[s_NrOfBins - 1u];
+		SAHBin left, right;
+		for (uint32_t i{ 0u }; i < s_NrOfBins - 1u; ++i)
+		{
+			GrowBounds(left.Min, left.Max, bins[i].Min, bins[i].Max);
+			left.Count += bins[i].Count;
+			leftArea[i] = left.Count > 0u ? SurfaceArea(left.Min, left.Max) : 0.0f;
+			leftCount[i] = left.Count;
+
+			const uint32_t j = s_NrOfBins - 1u - i;
+			GrowBounds(right.Min, right.Max, bins[j].Min, bins[j].Max);
+			right.Count += bins[j].Count;
+			rightArea[j - 1u] = right.Count > 0u ? SurfaceArea(right.Min, right.Max) : 0.0f;
+			rightCount[j - 1u] = right.Count;
+		}
+
+		for (uint32_t i{ 0u }; i < s_NrOfBins - 1u; ++i)
+		{
+			if (leftCount[i] == 0u || rightCount[i] == 0u)
+				continue;
+
+			float cost = leftArea[i] * leftCount[i] + rightArea[i] * rightCount[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	uint32_t leftCount = 0u;
+	if (medianSplit)
+	{
+		uint32_t axis = 0u;
+		for (uint32_t i{ 1u }; i < 3u; ++i)
+		{
+			if (GetComponent(centroidMax, i) - GetComponent(centroidMin, i) > GetComponent(centroidMax, axis) - GetComponent(centroidMin, axis))
+			{
+				axis = i;
+			}
+		}
+		leftCount = count / 2u;
+		std::nth_element(m_ItemIndices.begin() + first, m_ItemIndices.begin() + first + leftCount, m_ItemIndices.begin() + first + count, [&](uint32_t a, uint32_t b) noexcept
+			{
+				const float centerA = GetComponent(m_ItemCenters[a], axis);
+				const float centerB = GetComponent(m_ItemCenters[b], axis);
+				return centerA < centerB || (centerA == centerB && a < b);
+			});
+	}
+	else if (bestCost < FLT_MAX)
+	{
+		const float axisMin = GetComponent(centroidMin, bestAxis);
+		const float scale = static_cast<float>(s_NrOfBins) / (GetComponent(centroidMax, bestAxis) - axisMin);
+		auto middle = std::partition(m_ItemIndices.begin() + first, m_ItemIndices.begin() + first + count, [&](uint32_t itemIndex) noexcept
+			{
+				uint32_t bin = std::min(s_NrOfBins - 1u, static_cast<uint32_t>((GetComponent(m_ItemCenters[itemIndex], bestAxis) - axisMin) * scale));
+				return bin <= bestSplit;
+			});
+		leftCount = static_cast<uint32_t>(middle - (m_ItemIndices.begin() + first));
+	}
+
+	//All centers are in the same spot, so just split the items in half.
+	if (leftCount == 0u || leftCount == count)
+	{
+		leftCount = count / 2u;
+	}
+
+	const uint32_t leftChild = static_cast<uint32_t>(m_Nodes.size());
+	m_Nodes.push_back({});
+	m_Nodes.push_back({});
+	m_BuildAreas.push_back(0.0f);
+	m_BuildAreas.push_back(0.0f);
+	m_Nodes[nodeIndex].LeftFirst = leftChild;
+	m_Nodes[nodeIndex].Count = 0u;
+
+	BuildRecursive(leftChild, depth + 1u, first, leftCount);
+	BuildRecursive(leftChild + 1u, depth + 1u, first + leftCount, count - leftCount);
+}
+
+void SceneBVH::RebuildDegradedSubtrees(uint32_t nodeIndex, uint32_t depth) noexcept
+{
+	const SceneBVHNode& node = m_Nodes[nodeIndex];
+	if (node.Count > 0u)
+		return;
+
+	//Degenerate nodes (all items in one point when built) would otherwise be rebuilt every time.
+	float buildArea = std::max(m_BuildAreas[nodeIndex], 1.0f);
+	if (SurfaceArea(node.Min, node.Max) > buildArea * s_RebuildAreaThreshold)
+	{
+		//The items of a subtree are stored in one range, so the subtree can be rebuilt in place.
+		//The node itself is reused and its old descendants are left behind until the next full build.
+		uint32_t first = 0u;
+		uint32_t count = 0u;
+		GetSubtreeItemRange(nodeIndex, first, count);
+		m_NrOfDeadNodes += CountSubtreeNodes(nodeIndex) - 1u;
+		BuildRecursive(nodeIndex, depth, first, count);
+		m_NrOfSubtreeRebuilds++;
+		return;
+	}
+
+	const uint32_t leftChild = node.LeftFirst;
+	RebuildDegradedSubtrees(leftChild, depth + 1u);
+	RebuildDegradedSubtrees(leftChild + 1u, depth + 1u);
+}
+
+void SceneBVH::GetSubtreeItemRange(uint32_t nodeIndex, uint32_t& first, uint32_t& count) const noexcept
+{
+	uint32_t leftmost = nodeIndex;
+	while (m_Nodes[leftmost].Count == 0u)
+	{
+		leftmost = m_Nodes[leftmost].LeftFirst;
+	}
+	uint32_t rightmost = nodeIndex;
+	while (m_Nodes[rightmost].Count == 0u)
+	{
+		rightmost = m_Nodes[rightmost].LeftFirst + 1u;
+	}
+
+	first = m_Nodes[leftmost].LeftFirst;
+	count = m_Nodes[rightmost].LeftFirst + m_Nodes[rightmost].Count - first;
+}
+
+uint32_t SceneBVH::CountSubtreeNodes(uint32_t nodeIndex) const noexcept
+{
+	const SceneBVHNode& node = m_Nodes[nodeIndex];
+	if (node.Count > 0u)
+		return 1u;
+
+	return 1u + CountSubtreeNodes(node.LeftFirst) + CountSubtreeNodes(node.LeftFirst + 1u);
+}
+
+void SceneBVH::AppendSubtree(uint32_t nodeIndex, std::vector<uint32_t>& result) const noexcept
+{
+	uint32_t first = 0u;
+	uint32_t count = 0u;
+	GetSubtreeItemRange(nodeIndex, first, count);
+	result.insert(result.end(), m_ItemIndices.begin() + first, m_ItemIndices.begin() + first + count);
+}
+
+bool SceneBVH::IntersectRayItem(uint32_t itemIndex, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float maxDistance) const noexcept
+{
+	const DirectX::XMFLOAT3& center = m_ItemCenters[itemIndex];
+	const DirectX::XMFLOAT3& extents = m_ItemExtents[itemIndex];
+	float entryDistance = 0.0f;
+	return IntersectRay(
+		{ center.x - extents.x, center.y - extents.y, center.z - extents.z },
+		{ center.x + extents.x, center.y + extents.y, center.z + extents.z },
+		origin, inverseDirection, maxDistance, entryDistance);
+}
+
+float SceneBVH::SurfaceArea(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) noexcept
+{
+	float x = max.x - min.x;
+	float y = max.y - min.y;
+	float z = max.z - min.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+bool SceneBVH::IntersectRay(const SceneBVHNode& node, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float maxDistance, float& entryDistance) noexcept
+{
+	return IntersectRay(node.Min, node.Max, origin, inverseDirection, maxDistance, entryDistance);
+}
+
+bool SceneBVH::IntersectRay(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float maxDistance, float& entryDistance) noexcept
+{
+	//Slab test. fmin/fmax ignore the NaNs that show up when the ray is parallel to and exactly on a slab plane.
+	float tx1 = (min.x - origin.x) * inverseDirection.x;
+	float tx2 = (max.x - origin.x) * inverseDirection.x;
+	float tEnter = std::fmin(tx1, tx2);
+	float tExit = std::fmax(tx1, tx2);
+
+	float ty1 = (min.y - origin.y) * inverseDirection.y;
+	float ty2 = (max.y - origin.y) * inverseDirection.y;
+	tEnter = std::fmax(tEnter, std::fmin(ty1, ty2));
+	tExit = std::fmin(tExit, std::fmax(ty1, ty2));
+
+	float tz1 = (min.z - origin.z) * inverseDirection.z;
+	float tz2 = (max.z - origin.z) * inverseDirection.z;
+	tEnter = std::fmax(tEnter, std::fmin(tz1, tz2));
+	tExit = std::fmin(tExit, std::fmax(tz1, tz2));
+
+	entryDistance = std::max(tEnter, 0.0f);
+	return tExit >= entryDistance && entryDistance <= maxDistance;
+}
\ No newline at end of file
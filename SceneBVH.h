@@ -0,0 +1,135 @@
+#pragma once
+#include "FrustumCuller.h"
+
+struct SceneBVHNode
+{
+	DirectX::XMFLOAT3 Min;
+	uint32_t LeftFirst;		//Inner node: index of the left child, the right child follows it. Leaf: first index into the item indices.
+	DirectX::XMFLOAT3 Max;
+	uint32_t Count;			//Number of items in a leaf, 0 for inner nodes.
+};
+
+//Bounding volume hierarchy over the world space bounds of the scene objects.
+//Built top-down with binned SAH, refitted when objects move and partially rebuilt when a subtree has degraded too much.
+class SceneBVH
+{
+public:
+	SceneBVH() noexcept = default;
+	~SceneBVH() noexcept = default;
+
+	void Build(const std::vector<DirectX::BoundingBox>& itemBounds) noexcept;
+	//Updates the node bounds after the items have moved. The item count has to be the same as when it was built.
+	void Refit(const std::vector<DirectX::BoundingBox>& itemBounds) noexcept;
+
+	//The queries append the indices of the items whose bounds intersect the volume.
+	void QueryFrustum(const FrustumPlanes& frustum, std::vector<uint32_t>& result) const noexcept;
+	void QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<uint32_t>& result) const noexcept;
+	void QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, std::vector<uint32_t>& result) const noexcept;
+
+	//Visits the items whose bounds are hit by the ray, closest node first.
+	//The visitor is called as bool(uint32_t itemIndex, float& maxDistance). It may shorten maxDistance and returns true to stop the traversal.
+	template<typename Visitor>
+	void TraverseRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, Visitor&& visitor) const noexcept;
+
+	[[nodiscard]] constexpr bool IsBuilt() const noexcept { return !m_Nodes.empty(); }
+	[[nodiscard]] uint32_t GetNrOfNodes() const noexcept { return static_cast<uint32_t>(m_Nodes.size()); }
+	[[nodiscard]] constexpr uint32_t GetNrOfSubtreeRebuilds() const noexcept { return m_NrOfSubtreeRebuilds; }
+	[[nodiscard]] const std::vector<SceneBVHNode>& GetNodes() const noexcept { return m_Nodes; }
+	[[nodiscard]] const std::vector<uint32_t>& GetItemIndices() const noexcept { return m_ItemIndices; }
+private:
+	void BuildFromItems() noexcept;
+	void BuildRecursive(uint32_t nodeIndex, uint32_t depth, uint32_t first, uint32_t count) noexcept;
+	void RebuildDegradedSubtrees(uint32_t nodeIndex, uint32_t depth) noexcept;
+	void GetSubtreeItemRange(uint32_t nodeIndex, uint32_t& first, uint32_t& count) const noexcept;
+	uint32_t CountSubtreeNodes(uint32_t nodeIndex) const noexcept;
+	void AppendSubtree(uint32_t nodeIndex, std::vector<uint32_t>& result) const noexcept;
+	bool IntersectRayItem(uint32_t itemIndex, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float maxDistance) const noexcept;
+
+	static float SurfaceArea(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) noexcept;
+	static bool IntersectRay(const SceneBVHNode& node, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float maxDistance, float& entryDistance) noexcept;
+	static bool IntersectRay(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float maxDistance, float& entryDistance) noexcept;
+private:
+	static constexpr uint32_t s_NrOfBins = 16u;
+	static constexpr uint32_t s_MaxLeafSize = 4u;
+	//A subtree is rebuilt when its surface area has grown by more than this factor since it was built.
+	static constexpr float s_RebuildAreaThreshold = 2.0f;
+	//No node is more than this many levels deep, the root being the first, which is also the size of the traversal stacks.
+	//Nodes from s_MedianSplitDepth on are split at the median instead of with SAH, which reaches a leaf within 32 more levels.
+	static constexpr uint32_t s_MaxDepth = 64u;
+	static constexpr uint32_t s_MedianSplitDepth = s_MaxDepth - 32u;
+
+	std::vector<SceneBVHNode> m_Nodes = {};
+	//Surface area of every node when it was built, used to measure how much a subtree has degraded.
+	std::vector<float> m_BuildAreas = {};
+	std::vector<uint32_t> m_ItemIndices = {};
+	//The item bounds are kept as center & extents so that the item tests match the flat frustum culling kernel exactly.
+	std::vector<DirectX::XMFLOAT3> m_ItemCenters = {};
+	std::vector<DirectX::XMFLOAT3> m_ItemExtents = {};
+
+	uint32_t m_NrOfDeadNodes = 0u;
+	uint32_t m_NrOfSubtreeRebuilds = 0u;
+};
+
+template<typename Visitor>
+void SceneBVH::TraverseRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, Visitor&& visitor) const noexcept
+{
+	if (m_Nodes.empty())
+		return;
+
+	DirectX::XMFLOAT3 inverseDirection = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+
+	uint32_t stack[s_MaxDepth];
+	uint32_t stackSize = 0u;
+	float entryDistance = 0.0f;
+	if (!IntersectRay(m_Nodes[0], origin, inverseDirection, maxDistance, entryDistance))
+		return;
+	stack[stackSize++] = 0u;
+
+	while (stackSize > 0u)
+	{
+		const SceneBVHNode& node = m_Nodes[stack[--stackSize]];
+		if (node.Count > 0u)
+		{
+			for (uint32_t i{ 0u }; i < node.Count; ++i)
+			{
+				uint32_t itemIndex = m_ItemIndices[node.LeftFirst + i];
+				if (IntersectRayItem(itemIndex, origin, inverseDirection, maxDistance) && visitor(itemIndex, maxDistance))
+					return;
+			}
+			continue;
+		}
+
+		float leftDistance = 0.0f;
+		float rightDistance = 0.0f;
+		bool hitLeft = IntersectRay(m_Nodes[node.LeftFirst], origin, inverseDirection, maxDistance, leftDistance);
+		bool hitRight = IntersectRay(m_Nodes[node.LeftFirst + 1u], origin, inverseDirection, maxDistance, rightDistance);
+		//The build keeps the tree within the stack, should it not the traversal stops rather than write past it.
+		if (stackSize + 2u > s_MaxDepth)
+		{
+			DBG_ASSERT(false, "The BVH is too deep for the traversal stack.");
+			return;
+		}
+		//Push the furthest child first so that the closest one is visited first.
+		if (hitLeft && hitRight)
+		{
+			if (leftDistance < rightDistance)
+			{
+				stack[stackSize++] = node.LeftFirst + 1u;
+				stack[stackSize++] = node.LeftFirst;
+			}
+			else
+			{
+				stack[stackSize++] = node.LeftFirst;
+				stack[stackSize++] = node.LeftFirst + 1u;
+			}
+		}
+		else if (hitLeft)
+		{
+			stack[stackSize++] = node.LeftFirst;
+		}
+		else if (hitRight)
+		{
+			stack[stackSize++] = node.LeftFirst + 1u;
+		}
+	}
+}
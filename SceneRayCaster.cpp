@@ -0,0 +1,133 @@
+#include "pch.h"
+#include "SceneRayCaster.h"
+#include "ThreadPool.h"
+
+void SceneRayCaster::Update(const std::vector<VertexObject*>& objects, const SceneBVH& bvh) noexcept
+{
+	m_pBVH = &bvh;
+	const uint32_t nrOfObjects = static_cast<uint32_t>(objects.size());
+	if (m_Objects.size() != nrOfObjects)
+	{
+		m_InverseTransforms.resize(nrOfObjects);
+		m_TransformVersions.assign(nrOfObjects, UINT32_MAX);
+	}
+	m_Objects = objects;
+
+	//Only objects that moved since the last update need a new inverse.
+	std::atomic<uint32_t> nrOfUpdated = 0u;
+	ThreadPool::Get().ParallelFor(nrOfObjects, 1024u, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t rangeUpdated = 0u;
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				const uint32_t version = m_Objects[i]->GetVersions().Transform;
+				if (version == m_TransformVersions[i])
+					continue;
+
+				DirectX::XMStoreFloat4x4(&m_InverseTransforms[i], DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&m_Objects[i]->GetTransform())));
+				m_TransformVersions[i] = version;
+				rangeUpdated++;
+			}
+			nrOfUpdated += rangeUpdated;
+		});
+	m_NrOfUpdatedTransforms = nrOfUpdated;
+}
+
+bool SceneRayCaster::RayCast(const SceneRay& ray, SceneRayHit& hit) const noexcept
+{
+	hit = {};
+	if (!m_pBVH)
+		return false;
+
+	RayHit modelHit = {};
+	m_pBVH->TraverseRay(ray.Origin, ray.Direction, ray.MaxDistance, [&](uint32_t objectIndex, float& closestDistance) noexcept
+		{
+			//The direction is not renormalized in model space, so the hit distances stay in world units.
+			DirectX::XMFLOAT3 modelOrigin = {};
+			DirectX::XMFLOAT3 modelDirection = {};
+			ToModelSpace(objectIndex, ray, modelOrigin, modelDirection);
+			if (m_Objects[objectIndex]->GetModel()->GetBVH().Intersect(modelOrigin, modelDirection, ray.MinDistance, closestDistance, modelHit))
+			{
+				closestDistance = modelHit.Distance;
+				hit.ObjectIndex = objectIndex;
+			}
+			return false;
+		});
+	if (hit.ObjectIndex == UINT32_MAX)
+		return false;
+
+	hit.pObject = m_Objects[hit.ObjectIndex];
+	hit.MeshIndex = modelHit.MeshIndex;
+	hit.TriangleIndex = modelHit.TriangleIndex;
+	hit.Distance = modelHit.Distance;
+	hit.U = modelHit.U;
+	hit.V = modelHit.V;
+	return true;
+}
+
+bool SceneRayCaster::RayCastAny(const SceneRay& ray) const noexcept
+{
+	if (!m_pBVH)
+		return false;
+
+	bool found = false;
+	m_pBVH->TraverseRay(ray.Origin, ray.Direction, ray.MaxDistance, [&](uint32_t objectIndex, float&) noexcept
+		{
+			DirectX::XMFLOAT3 modelOrigin = {};
+			DirectX::XMFLOAT3 modelDirection = {};
+			ToModelSpace(objectIndex, ray, modelOrigin, modelDirection);
+			found = m_Objects[objectIndex]->GetModel()->GetBVH().IntersectAny(modelOrigin, modelDirection, ray.MinDistance, ray.MaxDistance);
+			return found;
+		});
+	return found;
+}
+
+uint32_t SceneRayCaster::RayCast(const SceneRay* pRays, uint32_t count, SceneRayHit* pHits) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::atomic<uint32_t> nrOfHits = 0u;
+	ThreadPool::Get().ParallelFor(count, s_GrainSize, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t rangeHits = 0u;
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				rangeHits += RayCast(pRays[i], pHits[i]) ? 1u : 0u;
+			}
+			nrOfHits += rangeHits;
+		});
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_LastBatchTime = static_cast<double>(dif.count()) * 0.001;
+	m_LastBatchSize = count;
+	return nrOfHits;
+}
+
+uint32_t SceneRayCaster::RayCastAny(const SceneRay* pRays, uint32_t count, uint8_t* pResults) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::atomic<uint32_t> nrOfHits = 0u;
+	ThreadPool::Get().ParallelFor(count, s_GrainSize, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t rangeHits = 0u;
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				pResults[i] = RayCastAny(pRays[i]) ? 1u : 0u;
+				rangeHits += pResults[i];
+			}
+			nrOfHits += rangeHits;
+		});
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_LastBatchTime = static_cast<double>(dif.count()) * 0.001;
+	m_LastBatchSize = count;
+	return nrOfHits;
+}
+
+void SceneRayCaster::ToModelSpace(uint32_t objectIndex, const SceneRay& ray, DirectX::XMFLOAT3& modelOrigin, DirectX::XMFLOAT3& modelDirection) const noexcept
+{
+	const DirectX::XMMATRIX inverseTransform = DirectX::XMLoadFloat4x4(&m_InverseTransforms[objectIndex]);
+	DirectX::XMStoreFloat3(&modelOrigin, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&ray.Origin), inverseTransform));
+	DirectX::XMStoreFloat3(&modelDirection, DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&ray.Direction), inverseTransform));
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "SceneBVH.h"
+#include "VertexObject.h"
+
+//A world space ray. Distances are in units of the direction's length.
+struct SceneRay
+{
+	DirectX::XMFLOAT3 Origin = {};
+	float MinDistance = 0.0f;
+	DirectX::XMFLOAT3 Direction = {};
+	float MaxDistance = FLT_MAX;
+};
+
+struct SceneRayHit
+{
+	VertexObject* pObject = nullptr;
+	//Index of the object in the scene's object list.
+	uint32_t ObjectIndex = UINT32_MAX;
+	uint32_t MeshIndex = UINT32_MAX;
+	//Index of the triangle in the mesh's index buffer, the first index is 3 * TriangleIndex.
+	uint32_t TriangleIndex = UINT32_MAX;
+	float Distance = FLT_MAX;
+	//Barycentric weights of the second and third vertex of the triangle.
+	float U = 0.0f;
+	float V = 0.0f;
+};
+
+//CPU ray queries against the scene through two levels: the scene BVH over the object bounds finds the objects,
+//and every object's model BVH finds the triangles with the ray moved into model space.
+//The inverse transforms are refreshed in Update when an object's transform version changes, so queries see the objects as they were then.
+//The single queries only read, so any number of threads can cast at once. The batched queries split the rays over the thread pool.
+class SceneRayCaster
+{
+public:
+	static constexpr uint32_t s_GrainSize = 256u;
+public:
+	SceneRayCaster() noexcept = default;
+	~SceneRayCaster() noexcept = default;
+
+	//Has to be called after the scene BVH is built or refitted over the same object list.
+	void Update(const std::vector<VertexObject*>& objects, const SceneBVH& bvh) noexcept;
+
+	bool RayCast(const SceneRay& ray, SceneRayHit& hit) const noexcept;
+	[[nodiscard]] bool RayCastAny(const SceneRay& ray) const noexcept;
+	//Returns the number of rays that hit something. Rays that miss get a hit with a null object.
+	uint32_t RayCast(const SceneRay* pRays, uint32_t count, SceneRayHit* pHits) noexcept;
+	//Writes 1 for every ray that hits anything and 0 for the others. Returns the number of hits.
+	uint32_t RayCastAny(const SceneRay* pRays, uint32_t count, uint8_t* pResults) noexcept;
+
+	[[nodiscard]] constexpr uint32_t GetNrOfUpdatedTransforms() const noexcept { return m_NrOfUpdatedTransforms; }
+	//Size and time in milliseconds of the last batch.
+	[[nodiscard]] constexpr uint32_t GetLastBatchSize() const noexcept { return m_LastBatchSize; }
+	[[nodiscard]] constexpr double GetLastBatchTime() const noexcept { return m_LastBatchTime; }
+private:
+	void ToModelSpace(uint32_t objectIndex, const SceneRay& ray, DirectX::XMFLOAT3& modelOrigin, DirectX::XMFLOAT3& modelDirection) const noexcept;
+private:
+	const SceneBVH* m_pBVH = nullptr;
+	std::vector<VertexObject*> m_Objects = {};
+	std::vector<DirectX::XMFLOAT4X4> m_InverseTransforms = {};
+	std::vector<uint32_t> m_TransformVersions = {};
+	uint32_t m_NrOfUpdatedTransforms = 0u;
+
+	uint32_t m_LastBatchSize = 0u;
+	double m_LastBatchTime = 0.0;
+};
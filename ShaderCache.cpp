@@ -0,0 +1,377 @@
+#include "pch.h"
+#include "ShaderCache.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	constexpr uint64_t s_HashSeed = 0xcbf29ce484222325ull;
+	//Bumped when the layout of the keys changes.
+	constexpr uint32_t s_CacheVersion = 1u;
+
+	//FNV-1a over raw bytes.
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t size) noexcept
+	{
+		const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+		for (size_t i{ 0u }; i < size; ++i)
+		{
+			hash ^= pBytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	//Includes the terminator so that neighbouring strings can not run into each other.
+	uint64_t HashString(uint64_t hash, const std::wstring& string) noexcept
+	{
+		return HashBytes(hash, string.c_str(), (string.size() + 1u) * sizeof(wchar_t));
+	}
+
+	bool ReadFile(const std::filesystem::path& path, std::string& contents) noexcept
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+
+		file.seekg(0, std::ios_base::end);
+		contents.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios_base::beg);
+		file.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+		return static_cast<bool>(file);
+	}
+
+	std::wstring GetDirectory(const std::wstring& path) noexcept
+	{
+		const size_t slashPos = path.find_last_of(L"/\\");
+		return slashPos == std::wstring::npos ? std::wstring{} : path.substr(0u, slashPos + 1u);
+	}
+
+	//Hashes the file and every file it includes, depth first in the order of the include directives. Only the directives are looked at,
+	//not the preprocessor state around them, so a file behind a disabled #if is still part of the key. That can only cause extra misses.
+	//Includes that can not be opened, like system headers, add their name alone.
+	uint64_t HashSourceTree(uint64_t hash, const std::wstring& path, std::vector<std::wstring>& visited) noexcept
+	{
+		if (std::find(visited.begin(), visited.end(), path) != visited.end())
+			return hash;
+		visited.push_back(path);
+
+		hash = HashString(hash, path);
+		std::string source;
+		if (!ReadFile(path, source))
+			return hash;
+		hash = HashBytes(hash, source.data(), source.size());
+
+		const std::wstring directory = GetDirectory(path);
+		size_t lineStart = 0u;
+		while (lineStart < source.size())
+		{
+			size_t lineEnd = source.find('\n', lineStart);
+			if (lineEnd == std::string::npos)
+				lineEnd = source.size();
+
+			const size_t directivePos = source.find_first_not_of(" \t", lineStart);
+			if (directivePos < lineEnd && source.compare(directivePos, 8u, "#include") == 0)
+			{
+				const size_t nameStart = source.find_first_of("\"<", directivePos + 8u);
+				const size_t nameEnd = nameStart < lineEnd ? source.find_first_of("\">", nameStart + 1u) : std::string::npos;
+				if (nameEnd < lineEnd)
+				{
+					const std::string name = source.substr(nameStart + 1u, nameEnd - nameStart - 1u);
+					hash = HashSourceTree(hash, directory + std::wstring(name.begin(), name.end()), visited);
+				}
+			}
+			lineStart = lineEnd + 1u;
+		}
+		return hash;
+	}
+
+	//A DXIL container starts with its four character code and has its total size at byte 24.
+	bool IsValidContainer(const std::string& data) noexcept
+	{
+		if (data.size() < 32u || data.compare(0u, 4u, "DXBC") != 0)
+			return false;
+
+		uint32_t containerSize = 0u;
+		std::memcpy(&containerSize, data.data() + 24u, sizeof(containerSize));
+		return containerSize == data.size();
+	}
+}
+
+void ShaderCache::Initialize(const std::wstring& directory) noexcept
+{
+	m_Directory = directory;
+	std::error_code error;
+	std::filesystem::create_directories(m_Directory, error);
+	DBG_ASSERT(!error, "Error! Could not create the shader cache directory.");
+
+	//The compiler objects are not free threaded, so every thread of the pool gets its own.
+	m_Compilers.resize(ThreadPool::Get().GetNrOfThreads());
+	//Checked without HR, it goes through the info queue of the device and the cache does not need one.
+	for (Compiler& compiler : m_Compilers)
+	{
+		[[maybe_unused]] const bool isCreated = SUCCEEDED(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler.pCompiler)))
+			&& SUCCEEDED(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&compiler.pUtils)))
+			&& SUCCEEDED(compiler.pUtils->CreateDefaultIncludeHandler(&compiler.pIncludeHandler));
+		DBG_ASSERT(isCreated, "Error! Could not create the shader compiler.");
+	}
+
+	//A new compiler can produce different code from the same source.
+	const DxcPtr<IDxcCompiler3>& pCompiler = m_Compilers[0].pCompiler;
+	DxcPtr<IDxcVersionInfo> pVersionInfo = nullptr;
+	if (pCompiler && SUCCEEDED(pCompiler->QueryInterface(IID_PPV_ARGS(&pVersionInfo))))
+	{
+		pVersionInfo->GetVersion(&m_CompilerVersion[0], &m_CompilerVersion[1]);
+	}
+	DxcPtr<IDxcVersionInfo2> pVersionInfo2 = nullptr;
+	if (pCompiler && SUCCEEDED(pCompiler->QueryInterface(IID_PPV_ARGS(&pVersionInfo2))))
+	{
+		//The portable dxc implements CoTaskMemFree in WinAdapter.
+		char* pCommitHash = nullptr;
+		pVersionInfo2->GetCommitInfo(&m_CompilerVersion[2], &pCommitHash);
+		CoTaskMemFree(pCommitHash);
+	}
+}
+
+DxcPtr<IDxcBlob> ShaderCache::GetShader(const ShaderDesc& desc) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	const uint64_t key = GetKey(desc);
+	const std::filesystem::path path = GetCachePath(desc, key);
+	DxcPtr<IDxcBlob> pShader = ReadShader(path);
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_LoadTime += static_cast<uint64_t>(dif.count());
+	if (pShader)
+	{
+		++m_NrOfHits;
+		return pShader;
+	}
+
+	++m_NrOfMisses;
+	start = std::chrono::high_resolution_clock::now();
+	pShader = Compile(desc);
+	if (pShader)
+	{
+		//Written next to the final name and moved over it, so a crash during the write never leaves a broken shader under a valid key.
+		//The temporary name is unique per thread, two threads can compile the same shader.
+		std::filesystem::path temporaryPath = path;
+		temporaryPath += L".tmp" + std::to_wstring(ThreadPool::GetThreadIndex());
+		std::ofstream file(temporaryPath, std::ios::binary);
+		file.write(static_cast<const char*>(pShader->GetBufferPointer()), static_cast<std::streamsize>(pShader->GetBufferSize()));
+		file.close();
+		std::error_code error;
+		if (file)
+		{
+			std::filesystem::rename(temporaryPath, path, error);
+		}
+		if (!file || error)
+		{
+			//The shader is still returned, it is compiled again the next time.
+			++m_NrOfWriteFailures;
+			std::filesystem::remove(temporaryPath, error);
+		}
+	}
+	dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_CompileTime += static_cast<uint64_t>(dif.count());
+	return pShader;
+}
+
+void ShaderCache::GetShaders(const std::vector<ShaderDesc>& descs, std::vector<DxcPtr<IDxcBlob>>& shaders) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	shaders.resize(descs.size());
+	ThreadPool::Get().ParallelFor(static_cast<uint32_t>(descs.size()), 1u, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				shaders[i] = GetShader(descs[i]);
+			}
+		});
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_BatchTime = static_cast<double>(dif.count()) * 0.001;
+}
+
+uint64_t ShaderCache::GetKey(const ShaderDesc& desc) const noexcept
+{
+	uint64_t hash = s_HashSeed;
+	hash = HashBytes(hash, &s_CacheVersion, sizeof(s_CacheVersion));
+	hash = HashBytes(hash, m_CompilerVersion, sizeof(m_CompilerVersion));
+	hash = HashString(hash, desc.EntryPoint);
+	hash = HashString(hash, desc.Target);
+	for (const std::wstring& argument : GetArguments(desc))
+	{
+		hash = HashString(hash, argument);
+	}
+
+	std::vector<std::wstring> visited;
+	return HashSourceTree(hash, desc.FilePath, visited);
+}
+
+std::vector<std::wstring> ShaderCache::GetArguments(const ShaderDesc& desc) const noexcept
+{
+	//Find the file name.
+	uint32_t dotPos = static_cast<uint32_t>(desc.FilePath.find(L".", 0));
+	std::wstring name = desc.FilePath.substr(0, dotPos);
+
+	//Add the arguments that get sent to the compiler.
+	//https://simoncoenen.com/blog/programming/graphics/DxcCompiling
+	//Shows all arguments
+	std::vector<std::wstring> arguments = {};
+
+	//The name of the source, so that errors point at the file and includes are found next to it.
+	arguments.push_back(desc.FilePath);
+
+	//E for entrypoint.
+	arguments.push_back(L"-E");
+	arguments.push_back(desc.EntryPoint);
+
+	//T for target profile (shader version)
+	arguments.push_back(L"-T");
+	arguments.push_back(desc.Target);
+
+	arguments.push_back(DXC_ARG_PACK_MATRIX_COLUMN_MAJOR);
+
+#if defined(_DEBUG)
+	arguments.push_back(L"-Od"); //Disable optimizations.
+	//arguments.push_back(DXC_ARG_WARNINGS_ARE_ERRORS);
+	arguments.push_back(DXC_ARG_DEBUG);
+
+	//Write debug information to the given file
+	arguments.push_back(L"-Fd");
+	arguments.push_back(name + L"_debug");
+
+	//Write errors and warnings to the given file
+	arguments.push_back(L"-Fe");
+	arguments.push_back(name + L"_error");
+#else
+	arguments.push_back(L"-O3"); //Optimization level.
+#endif
+
+	//To be able to strip reflection data and pdb's. They are separated from the shader object, therefore reducing the shader object's size.
+	arguments.push_back(L"-Qstrip_debug");
+	arguments.push_back(L"-Qstrip_reflect");
+
+	//Macros can be defined in strings and sent to the shader if we want.
+	for (const std::wstring& define : desc.Defines)
+	{
+		arguments.push_back(L"-D");
+		arguments.push_back(define);
+	}
+	return arguments;
+}
+
+std::wstring ShaderCache::GetCachePath(const ShaderDesc& desc, uint64_t key) const noexcept
+{
+	const size_t nameStart = desc.FilePath.find_last_of(L"/\\") + 1u;
+	const size_t dotPos = desc.FilePath.find(L".", nameStart);
+	std::wstringstream path;
+	path << m_Directory << L"/" << desc.FilePath.substr(nameStart, dotPos - nameStart) << L"_" << desc.EntryPoint << L"_" << desc.Target << L"_";
+	path << std::hex << std::setw(16) << std::setfill(L'0') << key << L".dxil";
+	return path.str();
+}
+
+DxcPtr<IDxcBlob> ShaderCache::ReadShader(const std::filesystem::path& path) const noexcept
+{
+	std::string data;
+	if (!ReadFile(path, data) || !IsValidContainer(data))
+		return nullptr;
+
+	//A blob that can not be created is treated as a miss.
+	DxcPtr<IDxcBlobEncoding> pBlob = nullptr;
+	if (FAILED(GetCompiler().pUtils->CreateBlob(data.data(), static_cast<uint32_t>(data.size()), DXC_CP_ACP, &pBlob)))
+		return nullptr;
+
+	return DxcPtr<IDxcBlob>(GetPointer(pBlob));
+}
+
+const ShaderCache::Compiler& ShaderCache::GetCompiler() const noexcept
+{
+	DBG_ASSERT(ThreadPool::Get().IsPoolThread(), "Error! Shaders can only be fetched from the threads of the thread pool.");
+	return m_Compilers[ThreadPool::GetThreadIndex()];
+}
+
+//The results are checked without HR, this runs on the threads of the pool and HR goes through the info queue of the device.
+DxcPtr<IDxcBlob> ShaderCache::Compile(const ShaderDesc& desc) noexcept
+{
+	const Compiler& compiler = GetCompiler();
+	DxcPtr<IDxcBlobEncoding> pSource = nullptr;
+	uint32_t codePage = CP_UTF8;
+	if (FAILED(compiler.pUtils->LoadFile(desc.FilePath.c_str(), &codePage, &pSource)))
+	{
+		++m_NrOfFailed;
+		DBG_ASSERT(false, "Error! Could not load the shader source.");
+		return nullptr;
+	}
+
+	const std::vector<std::wstring> argumentStrings = GetArguments(desc);
+	std::vector<LPCWSTR> arguments = {};
+	for (const std::wstring& argument : argumentStrings)
+	{
+		arguments.push_back(argument.c_str());
+	}
+
+	DxcBuffer sourceBuffer = {};
+	sourceBuffer.Ptr = pSource->GetBufferPointer();
+	sourceBuffer.Size = pSource->GetBufferSize();
+	sourceBuffer.Encoding = 0;
+
+	//The include handler resolves the includes relative to the including file, the same way the source tree is hashed.
+	DxcPtr<IDxcResult> pCompileResult = nullptr;
+	HRESULT status = compiler.pCompiler->Compile(&sourceBuffer, arguments.data(), (uint32_t)arguments.size(), GetPointer(compiler.pIncludeHandler), IID_PPV_ARGS(&pCompileResult));
+	if (SUCCEEDED(status))
+	{
+		pCompileResult->GetStatus(&status);
+	}
+
+	//Handle errors. They are written to a file next to the cache entry and the file of an earlier failure is removed once the shader compiles.
+	std::filesystem::path errorPath = GetCachePath(desc, GetKey(desc));
+	errorPath.replace_extension(L".errors.txt");
+	DxcPtr<IDxcBlobUtf8> pErrors = nullptr;
+	if (pCompileResult)
+	{
+		pCompileResult->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&pErrors), nullptr);
+	}
+	if (FAILED(status))
+	{
+		std::ofstream errorFile(errorPath, std::ios::binary);
+		if (pErrors && pErrors->GetStringLength() > 0)
+		{
+			errorFile.write(pErrors->GetStringPointer(), static_cast<std::streamsize>(pErrors->GetStringLength()));
+		}
+		++m_NrOfFailed;
+		DBG_ASSERT(false, "Error! Could not compile shader, see the .errors.txt file in the shader cache.");
+		return nullptr;
+	}
+	std::error_code error;
+	std::filesystem::remove(errorPath, error);
+
+#if defined(_DEBUG)
+	//Get the Debug data.
+	DxcPtr<IDxcBlob> pDebugData = nullptr;
+	//This contains the path that is baked into the shader object to refer to the part in question.
+	//So if you want to save the PDBs to a separate file, use this name so that Pix will know where to find it.
+	DxcPtr<IDxcBlobUtf16> pDebugDataPath = nullptr;
+	pCompileResult->GetOutput(DXC_OUT_PDB, IID_PPV_ARGS(&pDebugData), &pDebugDataPath);
+	//How do we print the debug data?
+
+	//Get the reflection data.
+	DxcPtr<IDxcBlob> pReflectionData = nullptr;
+	if (SUCCEEDED(pCompileResult->GetOutput(DXC_OUT_REFLECTION, IID_PPV_ARGS(&pReflectionData), nullptr)) && pReflectionData)
+	{
+		DxcBuffer reflectionBuffer = {};
+		reflectionBuffer.Ptr = pReflectionData->GetBufferPointer();
+		reflectionBuffer.Size = pReflectionData->GetBufferSize();
+		reflectionBuffer.Encoding = 0;
+
+		DxcPtr<ID3D12ShaderReflection> pShaderReflection = nullptr;
+		compiler.pUtils->CreateReflection(&reflectionBuffer, IID_PPV_ARGS(&pShaderReflection));
+		//How do we use the reflectiondata?
+	}
+#endif
+
+	DxcPtr<IDxcBlob> pResultBlob = nullptr;
+	if (FAILED(pCompileResult->GetResult(&pResultBlob)))
+	{
+		++m_NrOfFailed;
+		return nullptr;
+	}
+	return pResultBlob;
+}
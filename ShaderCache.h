@@ -0,0 +1,90 @@
+#pragma once
+
+//The interfaces of dxc are held by WRL's ComPtr on Windows and by the CComPtr of dxc's WinAdapter.h elsewhere, so the shader code builds
+//against the portable dxc too. The two only share ->, the tests against nullptr and & for out parameters, the raw pointer is taken with GetPointer.
+#if defined(_WIN32)
+template<typename T>
+using DxcPtr = Microsoft::WRL::ComPtr<T>;
+
+template<typename T>
+[[nodiscard]] T* GetPointer(const DxcPtr<T>& pInterface) noexcept { return pInterface.Get(); }
+#else
+template<typename T>
+using DxcPtr = CComPtr<T>;
+
+template<typename T>
+[[nodiscard]] T* GetPointer(const DxcPtr<T>& pInterface) noexcept { return pInterface.p; }
+#endif
+
+struct ShaderDesc
+{
+	std::wstring FilePath;
+	std::wstring EntryPoint;
+	std::wstring Target;
+	//NAME=VALUE pairs, every one is passed to the compiler as a define.
+	std::vector<std::wstring> Defines = {};
+};
+
+//Compiles shaders with dxc and keeps the DXIL on disk, one file per compilation. The file name holds a hash of everything the result depends on:
+//the source, the files it includes (followed through their own includes), the entry point, the target, the compiler arguments and the compiler version.
+//Editing any of them gives a new key, so a stale shader is never loaded and nothing has to be invalidated by hand. A miss compiles and writes the file.
+//Every thread of the thread pool has its own compiler, utils and include handler, created once and reused for every shader it compiles,
+//so shaders can be fetched from any thread of the pool, but not from threads outside of it. Those would share the compiler of thread 0.
+//The file handling only goes through the standard library and dxc. Nothing is printed, the compile errors of a shader are written
+//next to where its cache file would be, with the extension .errors.txt, and the failures are counted.
+class ShaderCache
+{
+public:
+	ShaderCache() noexcept = default;
+	~ShaderCache() noexcept = default;
+
+	//Creates the compilers and the cache directory. The directory is relative to the working directory, like the models.
+	//The thread pool has to be initialized first.
+	void Initialize(const std::wstring& directory = L"ShaderCache") noexcept;
+	//Loads the shader from the cache or compiles it. Returns nullptr if the shader did not compile.
+	[[nodiscard]] DxcPtr<IDxcBlob> GetShader(const ShaderDesc& desc) noexcept;
+	//Fetches the shaders on the thread pool, one shader per task.
+	void GetShaders(const std::vector<ShaderDesc>& descs, std::vector<DxcPtr<IDxcBlob>>& shaders) noexcept;
+	//Compiles the shader without looking at or writing to the cache.
+	[[nodiscard]] DxcPtr<IDxcBlob> Compile(const ShaderDesc& desc) noexcept;
+	//Key of the shader. Reads the source and its includes but does not compile anything.
+	[[nodiscard]] uint64_t GetKey(const ShaderDesc& desc) const noexcept;
+
+	[[nodiscard]] uint32_t GetNrOfHits() const noexcept { return m_NrOfHits.load(); }
+	[[nodiscard]] uint32_t GetNrOfMisses() const noexcept { return m_NrOfMisses.load(); }
+	//Shaders that did not compile, and compiled shaders that could not be written to the cache.
+	[[nodiscard]] uint32_t GetNrOfFailed() const noexcept { return m_NrOfFailed.load(); }
+	[[nodiscard]] uint32_t GetNrOfWriteFailures() const noexcept { return m_NrOfWriteFailures.load(); }
+	//Milliseconds spent hashing the sources and reading cached shaders, and compiling the misses, summed over the threads.
+	[[nodiscard]] double GetLoadTime() const noexcept { return static_cast<double>(m_LoadTime.load()) * 0.001; }
+	[[nodiscard]] double GetCompileTime() const noexcept { return static_cast<double>(m_CompileTime.load()) * 0.001; }
+	//Wall time of the last GetShaders in milliseconds.
+	[[nodiscard]] constexpr double GetBatchTime() const noexcept { return m_BatchTime; }
+private:
+	struct Compiler
+	{
+		DxcPtr<IDxcCompiler3> pCompiler;
+		DxcPtr<IDxcUtils> pUtils;
+		DxcPtr<IDxcIncludeHandler> pIncludeHandler;
+	};
+
+	[[nodiscard]] std::vector<std::wstring> GetArguments(const ShaderDesc& desc) const noexcept;
+	[[nodiscard]] std::wstring GetCachePath(const ShaderDesc& desc, uint64_t key) const noexcept;
+	DxcPtr<IDxcBlob> ReadShader(const std::filesystem::path& path) const noexcept;
+	[[nodiscard]] const Compiler& GetCompiler() const noexcept;
+private:
+	std::wstring m_Directory;
+	//One per thread of the thread pool, indexed with the thread index.
+	std::vector<Compiler> m_Compilers = {};
+	//Major, minor and commit of the compiler, part of every key.
+	uint32_t m_CompilerVersion[3] = {};
+
+	std::atomic<uint32_t> m_NrOfHits = 0u;
+	std::atomic<uint32_t> m_NrOfMisses = 0u;
+	std::atomic<uint32_t> m_NrOfFailed = 0u;
+	std::atomic<uint32_t> m_NrOfWriteFailures = 0u;
+	//In microseconds.
+	std::atomic<uint64_t> m_LoadTime = 0u;
+	std::atomic<uint64_t> m_CompileTime = 0u;
+	double m_BatchTime = 0.0;
+};
@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "ShaderPermutationBenchmark.h"
+#include "ThreadPool.h"
+
+void ShaderPermutationBenchmark::Run(const std::vector<const ShaderPermutations*>& permutations) noexcept
+{
+	m_Results.clear();
+	if (!m_IsInitialized)
+	{
+		m_ShaderCache.Initialize();
+		m_IsInitialized = true;
+	}
+
+	for (const ShaderPermutations* pPermutations : permutations)
+	{
+		const std::vector<ShaderDesc> descs = pPermutations->GetVariantDescs();
+		const uint32_t nrOfVariants = static_cast<uint32_t>(descs.size());
+
+		ShaderPermutationBenchmarkResult result;
+		const std::wstring& filePath = pPermutations->GetDesc().FilePath;
+		result.Name = std::string(filePath.begin(), filePath.end());
+		result.NrOfVariants = nrOfVariants;
+		result.NrOfThreads = ThreadPool::Get().GetNrOfThreads();
+
+		std::vector<DxcPtr<IDxcBlob>> serialShaders(nrOfVariants);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i{ 0u }; i < nrOfVariants; ++i)
+		{
+			serialShaders[i] = m_ShaderCache.Compile(descs[i]);
+		}
+		auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+		result.SerialTime = static_cast<double>(dif.count()) * 0.001;
+
+		std::vector<DxcPtr<IDxcBlob>> parallelShaders(nrOfVariants);
+		start = std::chrono::high_resolution_clock::now();
+		ThreadPool::Get().ParallelFor(nrOfVariants, 1u, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i{ begin }; i < end; ++i)
+				{
+					parallelShaders[i] = m_ShaderCache.Compile(descs[i]);
+				}
+			});
+		dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+		result.ParallelTime = static_cast<double>(dif.count()) * 0.001;
+
+		//The first batch fills the cache if the renderer has not, the second one is timed.
+		std::vector<DxcPtr<IDxcBlob>> cachedShaders;
+		m_ShaderCache.GetShaders(descs, cachedShaders);
+		m_ShaderCache.GetShaders(descs, cachedShaders);
+		result.CachedTime = m_ShaderCache.GetBatchTime();
+
+		for (uint32_t i{ 0u }; i < nrOfVariants; ++i)
+		{
+			if (!serialShaders[i] || !parallelShaders[i])
+			{
+				++result.NrOfFailed;
+				continue;
+			}
+
+			result.NrOfBytes += serialShaders[i]->GetBufferSize();
+			const bool isSame = serialShaders[i]->GetBufferSize() == parallelShaders[i]->GetBufferSize()
+				&& std::memcmp(serialShaders[i]->GetBufferPointer(), parallelShaders[i]->GetBufferPointer(), serialShaders[i]->GetBufferSize()) == 0;
+			result.NrOfMismatches += isSame ? 0u : 1u;
+		}
+		m_Results.push_back(result);
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "ShaderPermutations.h"
+
+struct ShaderPermutationBenchmarkResult
+{
+	std::string Name;
+	uint32_t NrOfVariants = 0u;
+	uint32_t NrOfThreads = 0u;
+	//In milliseconds. Every variant compiled one after the other on the calling thread, then one per task on the thread pool.
+	double SerialTime = 0.0;
+	double ParallelTime = 0.0;
+	//Fetching every variant from a shader cache that already holds them, in milliseconds.
+	double CachedTime = 0.0;
+	//Size of all the variants' DXIL.
+	uint64_t NrOfBytes = 0u;
+	//Variants that did not compile, and variants that came out different on the thread pool than on the calling thread.
+	uint32_t NrOfFailed = 0u;
+	uint32_t NrOfMismatches = 0u;
+};
+
+//Times compiling every variant of the pipeline shaders with dxc, serially and in parallel, against loading them from the shader cache.
+//Nothing is read from or written to the cache while compiling, so every run compiles everything.
+class ShaderPermutationBenchmark
+{
+public:
+	ShaderPermutationBenchmark() noexcept = default;
+	~ShaderPermutationBenchmark() noexcept = default;
+
+	void Run(const std::vector<const ShaderPermutations*>& permutations) noexcept;
+
+	[[nodiscard]] const std::vector<ShaderPermutationBenchmarkResult>& GetResults() const noexcept { return m_Results; }
+private:
+	std::vector<ShaderPermutationBenchmarkResult> m_Results = {};
+	ShaderCache m_ShaderCache;
+	bool m_IsInitialized = false;
+};
@@ -0,0 +1,104 @@
+#include "pch.h"
+#include "ShaderPermutations.h"
+
+ShaderPermutations::ShaderPermutations(const ShaderDesc& desc, const std::vector<ShaderPermutationKey>& keys) noexcept
+	: m_Desc{ desc }, m_Keys{ keys }
+{
+	for (const ShaderPermutationKey& key : m_Keys)
+	{
+		DBG_ASSERT(key.NrOfValues >= 2u, "Error! A shader permutation key needs at least two values.");
+		m_Shifts.push_back(m_NrOfBits);
+		m_NrOfBits += 32u - _lzcnt_u32(key.NrOfValues - 1u);
+	}
+	DBG_ASSERT(m_NrOfBits <= s_MaxNrOfBits, "Error! Too many shader permutation keys.");
+	m_Variants.resize(GetNrOfMasks());
+}
+
+void ShaderPermutations::Compile(ShaderCache& shaderCache, const std::vector<ShaderPermutations*>& permutations) noexcept
+{
+	std::vector<ShaderDesc> descs;
+	std::vector<std::pair<ShaderPermutations*, uint32_t>> variants;
+	for (ShaderPermutations* pPermutations : permutations)
+	{
+		for (uint32_t mask{ 0u }; mask < pPermutations->GetNrOfMasks(); ++mask)
+		{
+			if (pPermutations->IsValid(mask))
+			{
+				descs.push_back(pPermutations->GetVariantDesc(mask));
+				variants.emplace_back(pPermutations, mask);
+			}
+		}
+	}
+
+	std::vector<DxcPtr<IDxcBlob>> shaders;
+	shaderCache.GetShaders(descs, shaders);
+	for (uint32_t i{ 0u }; i < variants.size(); ++i)
+	{
+		variants[i].first->m_Variants[variants[i].second] = std::move(shaders[i]);
+	}
+}
+
+uint32_t ShaderPermutations::GetMask(std::initializer_list<uint32_t> values) const noexcept
+{
+	DBG_ASSERT(values.size() == m_Keys.size(), "Error! A shader permutation mask needs one value per key.");
+	uint32_t mask = 0u;
+	uint32_t keyIndex = 0u;
+	for (uint32_t value : values)
+	{
+		DBG_ASSERT(value < m_Keys[keyIndex].NrOfValues, "Error! The value is out of range for the shader permutation key.");
+		mask |= value << m_Shifts[keyIndex++];
+	}
+	return mask;
+}
+
+bool ShaderPermutations::IsValid(uint32_t mask) const noexcept
+{
+	if (mask >= GetNrOfMasks())
+		return false;
+
+	for (uint32_t i{ 0u }; i < m_Keys.size(); ++i)
+	{
+		if (GetValue(mask, i) >= m_Keys[i].NrOfValues)
+			return false;
+	}
+	return true;
+}
+
+ShaderDesc ShaderPermutations::GetVariantDesc(uint32_t mask) const noexcept
+{
+	ShaderDesc desc = m_Desc;
+	for (uint32_t i{ 0u }; i < m_Keys.size(); ++i)
+	{
+		desc.Defines.push_back(m_Keys[i].Name + L"=" + std::to_wstring(GetValue(mask, i)));
+	}
+	return desc;
+}
+
+std::vector<ShaderDesc> ShaderPermutations::GetVariantDescs() const noexcept
+{
+	std::vector<ShaderDesc> descs;
+	for (uint32_t mask{ 0u }; mask < GetNrOfMasks(); ++mask)
+	{
+		if (IsValid(mask))
+		{
+			descs.push_back(GetVariantDesc(mask));
+		}
+	}
+	return descs;
+}
+
+uint32_t ShaderPermutations::GetValue(uint32_t mask, uint32_t keyIndex) const noexcept
+{
+	const uint32_t nextShift = keyIndex + 1u < m_Shifts.size() ? m_Shifts[keyIndex + 1u] : m_NrOfBits;
+	return (mask >> m_Shifts[keyIndex]) & ((1u << (nextShift - m_Shifts[keyIndex])) - 1u);
+}
+
+uint32_t ShaderPermutations::GetNrOfVariants() const noexcept
+{
+	uint32_t nrOfVariants = 1u;
+	for (const ShaderPermutationKey& key : m_Keys)
+	{
+		nrOfVariants *= key.NrOfValues;
+	}
+	return nrOfVariants;
+}
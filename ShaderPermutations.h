@@ -0,0 +1,49 @@
+#pragma once
+#include "ShaderCache.h"
+
+//One axis of the variants of a shader. Every value becomes the define NAME=value, so a bool key is 0 or 1 and an enum key 0 to NrOfValues - 1.
+struct ShaderPermutationKey
+{
+	std::wstring Name;
+	uint32_t NrOfValues = 2u;
+};
+
+//The variants of a shader over a set of keys, every combination compiled as a shader of its own, so that the branches on the keys are
+//resolved by the compiler instead of per pixel. A variant is found with a mask: every key gets as many bits as its largest value needs,
+//right after the bits of the keys before it. Masks where an enum key is past its last value have no variant.
+class ShaderPermutations
+{
+public:
+	static constexpr uint32_t s_MaxNrOfBits = 8u;
+public:
+	ShaderPermutations() noexcept = default;
+	ShaderPermutations(const ShaderDesc& desc, const std::vector<ShaderPermutationKey>& keys) noexcept;
+	~ShaderPermutations() noexcept = default;
+
+	//Fetches every variant of every set from the cache in one batch on the thread pool.
+	static void Compile(ShaderCache& shaderCache, const std::vector<ShaderPermutations*>& permutations) noexcept;
+
+	//The mask of one value per key, in the order of the keys.
+	[[nodiscard]] uint32_t GetMask(std::initializer_list<uint32_t> values) const noexcept;
+	[[nodiscard]] bool IsValid(uint32_t mask) const noexcept;
+	//The desc of the variant, the base desc with the defines of the mask's values added.
+	[[nodiscard]] ShaderDesc GetVariantDesc(uint32_t mask) const noexcept;
+	//Descs of the valid variants in the order of their masks.
+	[[nodiscard]] std::vector<ShaderDesc> GetVariantDescs() const noexcept;
+	[[nodiscard]] IDxcBlob* GetVariant(uint32_t mask) const noexcept { return GetPointer(m_Variants[mask]); }
+
+	[[nodiscard]] const ShaderDesc& GetDesc() const noexcept { return m_Desc; }
+	//Number of masks, including the ones that have no variant.
+	[[nodiscard]] uint32_t GetNrOfMasks() const noexcept { return 1u << m_NrOfBits; }
+	[[nodiscard]] uint32_t GetNrOfVariants() const noexcept;
+private:
+	[[nodiscard]] uint32_t GetValue(uint32_t mask, uint32_t keyIndex) const noexcept;
+private:
+	ShaderDesc m_Desc = {};
+	std::vector<ShaderPermutationKey> m_Keys = {};
+	//Lowest bit of every key in the mask.
+	std::vector<uint32_t> m_Shifts = {};
+	uint32_t m_NrOfBits = 0u;
+	//Indexed with the mask, nullptr for the masks that have no variant or did not compile.
+	std::vector<DxcPtr<IDxcBlob>> m_Variants = {};
+};
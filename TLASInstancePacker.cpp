@@ -0,0 +1,84 @@
+#include "pch.h"
+#include "TLASInstancePacker.h"
+#include "ThreadPool.h"
+
+static_assert(offsetof(D3D12_RAYTRACING_INSTANCE_DESC, Transform) == 0u && sizeof(float) * 12u == 48u, "The transform is written as the first three 16 byte rows of the description.");
+
+void TLASInstancePacker::Reset(uint32_t nrOfInstances) noexcept
+{
+	m_WrittenVersions.assign(nrOfInstances, s_NotWritten);
+	m_ChangedIndices.reserve(nrOfInstances);
+}
+
+uint32_t TLASInstancePacker::Pack(const DirectX::XMFLOAT4X4* const* ppTransforms, const uint32_t* pVersions, uint32_t nrOfInstances, D3D12_RAYTRACING_INSTANCE_DESC* pDestination) noexcept
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	DBG_ASSERT(nrOfInstances == m_WrittenVersions.size(), "Error! The packer was reset for a different number of instances.");
+
+	m_ChangedIndices.clear();
+	for (uint32_t i{ 0u }; i < nrOfInstances; ++i)
+	{
+		if (pVersions[i] != m_WrittenVersions[i])
+		{
+			m_WrittenVersions[i] = pVersions[i];
+			m_ChangedIndices.push_back(i);
+		}
+	}
+
+	const uint32_t nrOfChanged = static_cast<uint32_t>(m_ChangedIndices.size());
+	ThreadPool::Get().ParallelFor(nrOfChanged, 2048u, [&](uint32_t begin, uint32_t end)
+		{
+			PackTransforms(ppTransforms, m_ChangedIndices.data() + begin, end - begin, pDestination);
+		});
+
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	m_PackTime = static_cast<double>(dif.count()) * 0.001;
+	return nrOfChanged;
+}
+
+void TLASInstancePacker::PackTransforms(const DirectX::XMFLOAT4X4* const* ppTransforms, const uint32_t* pIndices, uint32_t count, D3D12_RAYTRACING_INSTANCE_DESC* pDestination) noexcept
+{
+	uint32_t i = 0u;
+	//Two matrices at a time, one in each 128 bit lane. The shuffles only work within a lane, so both are transposed side by side.
+	for (; i + 1u < count; i += 2u)
+	{
+		const float* a = &ppTransforms[pIndices[i]]->_11;
+		const float* b = &ppTransforms[pIndices[i + 1u]]->_11;
+		__m256 row0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), _mm_loadu_ps(b), 1);
+		__m256 row1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a + 4)), _mm_loadu_ps(b + 4), 1);
+		__m256 row2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a + 8)), _mm_loadu_ps(b + 8), 1);
+		__m256 row3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a + 12)), _mm_loadu_ps(b + 12), 1);
+
+		__m256 t0 = _mm256_unpacklo_ps(row0, row1);		//m11 m21 m12 m22
+		__m256 t1 = _mm256_unpacklo_ps(row2, row3);		//m31 m41 m32 m42
+		__m256 t2 = _mm256_unpackhi_ps(row0, row1);		//m13 m23 m14 m24
+		__m256 t3 = _mm256_unpackhi_ps(row2, row3);		//m33 m43 m34 m44
+		__m256 column0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 column1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 column2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+
+		float* destinationA = &pDestination[pIndices[i]].Transform[0][0];
+		float* destinationB = &pDestination[pIndices[i + 1u]].Transform[0][0];
+		_mm_storeu_ps(destinationA, _mm256_castps256_ps128(column0));
+		_mm_storeu_ps(destinationA + 4, _mm256_castps256_ps128(column1));
+		_mm_storeu_ps(destinationA + 8, _mm256_castps256_ps128(column2));
+		_mm_storeu_ps(destinationB, _mm256_extractf128_ps(column0, 1));
+		_mm_storeu_ps(destinationB + 4, _mm256_extractf128_ps(column1, 1));
+		_mm_storeu_ps(destinationB + 8, _mm256_extractf128_ps(column2, 1));
+	}
+
+	for (; i < count; ++i)
+	{
+		const float* a = &ppTransforms[pIndices[i]]->_11;
+		__m128 row0 = _mm_loadu_ps(a);
+		__m128 row1 = _mm_loadu_ps(a + 4);
+		__m128 row2 = _mm_loadu_ps(a + 8);
+		__m128 row3 = _mm_loadu_ps(a + 12);
+		_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+		float* destination = &pDestination[pIndices[i]].Transform[0][0];
+		_mm_storeu_ps(destination, row0);
+		_mm_storeu_ps(destination + 4, row1);
+		_mm_storeu_ps(destination + 8, row2);
+	}
+}
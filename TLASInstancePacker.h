@@ -0,0 +1,31 @@
+#pragma once
+
+//Writes the transforms of the top level instances straight into a mapped instance buffer.
+//The world matrices are row major with the translation in the last row, the instance descriptions want the transposed 3x4,
+//so the matrices are transposed two at a time with AVX and the three rows are written with full 16 byte stores.
+//Each instance remembers the transform version it was written with, so unchanged instances are skipped.
+class TLASInstancePacker
+{
+public:
+	//Marks an instance as never written.
+	static constexpr uint32_t s_NotWritten = UINT32_MAX;
+public:
+	TLASInstancePacker() noexcept = default;
+	~TLASInstancePacker() noexcept = default;
+
+	//Resets the written versions of a destination with the given number of instances.
+	void Reset(uint32_t nrOfInstances) noexcept;
+	//Writes the transforms whose version differs from the one last written to pDestination.
+	//ppTransforms and pVersions hold one entry per instance. Returns the number of instances written.
+	uint32_t Pack(const DirectX::XMFLOAT4X4* const* ppTransforms, const uint32_t* pVersions, uint32_t nrOfInstances, D3D12_RAYTRACING_INSTANCE_DESC* pDestination) noexcept;
+
+	//Transposes the matrices and writes the first three rows to the transforms of the destinations. No versions are checked.
+	static void PackTransforms(const DirectX::XMFLOAT4X4* const* ppTransforms, const uint32_t* pIndices, uint32_t count, D3D12_RAYTRACING_INSTANCE_DESC* pDestination) noexcept;
+
+	//Time spent in the last Pack in milliseconds.
+	[[nodiscard]] constexpr double GetPackTime() const noexcept { return m_PackTime; }
+private:
+	std::vector<uint32_t> m_WrittenVersions = {};
+	std::vector<uint32_t> m_ChangedIndices = {};
+	double m_PackTime = 0.0;
+};
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "TLASUpdatePolicy.h"
+
+TLASUpdatePolicy::TLASUpdatePolicy(uint32_t maxUpdatesBeforeRebuild) noexcept
+	: m_MaxUpdatesBeforeRebuild{ maxUpdatesBeforeRebuild }
+{
+}
+
+const TLASBuildDecision& TLASUpdatePolicy::Decide(uint32_t nrOfInstances) noexcept
+{
+	TLASBuildDecision decision = {};
+	decision.NrOfInstances = nrOfInstances;
+	decision.FrameNumber = m_FrameNumber++;
+
+	if (!m_Built)
+		decision.Reason = TLASBuildReason::FIRST_BUILD;
+	else if (m_Invalidated)
+		decision.Reason = TLASBuildReason::INVALIDATED;
+	else if (nrOfInstances != m_NrOfInstances)
+		decision.Reason = TLASBuildReason::INSTANCE_COUNT_CHANGED;
+	else if (m_NrOfUpdatesSinceBuild >= m_MaxUpdatesBeforeRebuild)
+		decision.Reason = TLASBuildReason::UPDATE_LIMIT_REACHED;
+	else
+		decision.Reason = TLASBuildReason::REFIT;
+
+	if (decision.Reason == TLASBuildReason::REFIT)
+	{
+		decision.Type = TLASBuildType::UPDATE;
+		m_NrOfUpdatesSinceBuild++;
+		m_NrOfUpdates++;
+	}
+	else
+	{
+		decision.Type = TLASBuildType::BUILD;
+		m_NrOfUpdatesSinceBuild = 0u;
+		m_NrOfBuilds++;
+		m_Built = true;
+		m_Invalidated = false;
+		m_NrOfInstances = nrOfInstances;
+	}
+	decision.NrOfUpdatesSinceBuild = m_NrOfUpdatesSinceBuild;
+
+	if (m_DecisionLog.size() == s_DecisionLogSize)
+		m_DecisionLog.pop_front();
+	m_DecisionLog.push_back(decision);
+	return m_DecisionLog.back();
+}
+
+D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS TLASUpdatePolicy::GetBuildFlags(TLASBuildType type) noexcept
+{
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE | D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+	if (type == TLASBuildType::UPDATE)
+		flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+	return flags;
+}
+
+void TLASUpdatePolicy::FillBuildDescription(
+	const TLASBuildDecision& decision,
+	D3D12_GPU_VIRTUAL_ADDRESS instanceDescs,
+	D3D12_GPU_VIRTUAL_ADDRESS resultBuffer,
+	D3D12_GPU_VIRTUAL_ADDRESS scratchBuffer,
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC& description
+) noexcept
+{
+	description.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+	description.Inputs.Flags = GetBuildFlags(decision.Type);
+	description.Inputs.NumDescs = decision.NrOfInstances;
+	description.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+	description.Inputs.InstanceDescs = instanceDescs;
+	description.DestAccelerationStructureData = resultBuffer;
+	description.SourceAccelerationStructureData = decision.Type == TLASBuildType::UPDATE ? resultBuffer : 0u;
+	description.ScratchAccelerationStructureData = scratchBuffer;
+}
+
+const char* TLASUpdatePolicy::GetReasonName(TLASBuildReason reason) noexcept
+{
+	switch (reason)
+	{
+	case TLASBuildReason::REFIT:
+		return "Refit";
+	case TLASBuildReason::FIRST_BUILD:
+		return "First build";
+	case TLASBuildReason::INSTANCE_COUNT_CHANGED:
+		return "Instance count changed";
+	case TLASBuildReason::UPDATE_LIMIT_REACHED:
+		return "Update limit reached";
+	case TLASBuildReason::INVALIDATED:
+		return "Invalidated";
+	default:
+		return "Unknown";
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+enum class TLASBuildType : uint32_t
+{
+	BUILD = 0,
+	UPDATE
+};
+
+enum class TLASBuildReason : uint32_t
+{
+	REFIT = 0,				//Nothing forced a rebuild, the structure is updated in place.
+	FIRST_BUILD,
+	INSTANCE_COUNT_CHANGED,
+	UPDATE_LIMIT_REACHED,
+	INVALIDATED
+};
+
+struct TLASBuildDecision
+{
+	TLASBuildType Type = TLASBuildType::BUILD;
+	TLASBuildReason Reason = TLASBuildReason::FIRST_BUILD;
+	uint32_t NrOfInstances = 0u;
+	//Updates done on top of the last full build, including this one.
+	uint32_t NrOfUpdatesSinceBuild = 0u;
+	uint64_t FrameNumber = 0u;
+};
+
+//Decides whether the top level acceleration structure is refitted in place or rebuilt, and fills in the build description for it.
+//The structure is always built with ALLOW_UPDATE so that the following frames can use PERFORM_UPDATE with itself as the source.
+//Refitting keeps the tree of the last build, so the trace quality drops as the instances move, which is why it is rebuilt every so often.
+class TLASUpdatePolicy
+{
+public:
+	static constexpr uint32_t s_DefaultMaxUpdatesBeforeRebuild = 64u;
+	static constexpr uint32_t s_DecisionLogSize = 128u;
+public:
+	TLASUpdatePolicy(uint32_t maxUpdatesBeforeRebuild = s_DefaultMaxUpdatesBeforeRebuild) noexcept;
+	~TLASUpdatePolicy() noexcept = default;
+
+	//Makes the decision for this frame and adds it to the log.
+	const TLASBuildDecision& Decide(uint32_t nrOfInstances) noexcept;
+	//Forces the next decision to be a full build, for example after the instance buffer has been recreated.
+	void Invalidate() noexcept { m_Invalidated = true; }
+
+	[[nodiscard]] static D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS GetBuildFlags(TLASBuildType type) noexcept;
+	//Fills in the description for the decision. Updates use the result buffer as both source and destination.
+	static void FillBuildDescription(
+		const TLASBuildDecision& decision,
+		D3D12_GPU_VIRTUAL_ADDRESS instanceDescs,
+		D3D12_GPU_VIRTUAL_ADDRESS resultBuffer,
+		D3D12_GPU_VIRTUAL_ADDRESS scratchBuffer,
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC& description
+	) noexcept;
+
+	void SetMaxUpdatesBeforeRebuild(uint32_t maxUpdatesBeforeRebuild) noexcept { m_MaxUpdatesBeforeRebuild = maxUpdatesBeforeRebuild; }
+	[[nodiscard]] constexpr uint32_t GetMaxUpdatesBeforeRebuild() const noexcept { return m_MaxUpdatesBeforeRebuild; }
+	[[nodiscard]] constexpr uint32_t GetNrOfBuilds() const noexcept { return m_NrOfBuilds; }
+	[[nodiscard]] constexpr uint32_t GetNrOfUpdates() const noexcept { return m_NrOfUpdates; }
+	[[nodiscard]] const TLASBuildDecision& GetLastDecision() const noexcept { return m_DecisionLog.back(); }
+	//The decisions of the last frames, oldest first.
+	[[nodiscard]] const std::deque<TLASBuildDecision>& GetDecisionLog() const noexcept { return m_DecisionLog; }
+	[[nodiscard]] static const char* GetReasonName(TLASBuildReason reason) noexcept;
+private:
+	uint32_t m_MaxUpdatesBeforeRebuild;
+	uint32_t m_NrOfInstances = 0u;
+	uint32_t m_NrOfUpdatesSinceBuild = 0u;
+	bool m_Built = false;
+	bool m_Invalidated = false;
+
+	uint64_t m_FrameNumber = 0u;
+	uint32_t m_NrOfBuilds = 0u;
+	uint32_t m_NrOfUpdates = 0u;
+	std::deque<TLASBuildDecision> m_DecisionLog = {};
+};
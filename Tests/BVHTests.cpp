@@ -0,0 +1,379 @@
+#include "pch.h"
+#include "Tests.h"
+#include "BVHBuilder.h"
+#include "ModelBVH.h"
+#include "SceneBVH.h"
+
+namespace
+{
+	[[nodiscard]] bool Contains(const DirectX::XMFLOAT3& outerMin, const DirectX::XMFLOAT3& outerMax, const DirectX::XMFLOAT3& innerMin, const DirectX::XMFLOAT3& innerMax) noexcept
+	{
+		return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z && outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+	}
+
+	//Walks the tree from the root. Every primitive is in exactly one leaf, the children come after their parent and lie within its bounds,
+	//and no leaf is deeper than the traversal stacks allow.
+	[[nodiscard]] bool IsValidTree(const std::vector<BVHNode>& nodes, const std::vector<uint32_t>& order, const DirectX::XMFLOAT3* pMin, const DirectX::XMFLOAT3* pMax, uint32_t count, uint32_t maxLeafSize) noexcept
+	{
+		if (nodes.empty() || order.size() != count)
+			return false;
+
+		std::vector<uint32_t> nrOfTimesSeen(count, 0u);
+		std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0u, 1u } };
+		while (!stack.empty())
+		{
+			const auto [nodeIndex, depth] = stack.back();
+			stack.pop_back();
+			const BVHNode& node = nodes[nodeIndex];
+			if (depth > BVHBuilder::s_MaxDepth)
+				return false;
+
+			if (node.Count > 0u)
+			{
+				if (node.Count > maxLeafSize || node.LeftFirst + node.Count > count)
+					return false;
+				for (uint32_t i{ node.LeftFirst }; i < node.LeftFirst + node.Count; ++i)
+				{
+					const uint32_t primitive = order[i];
+					if (primitive >= count || !Contains(node.Min, node.Max, pMin[primitive], pMax[primitive]))
+						return false;
+					nrOfTimesSeen[primitive]++;
+				}
+				continue;
+			}
+
+			if (node.LeftFirst <= nodeIndex || node.LeftFirst + 1u >= nodes.size())
+				return false;
+			for (uint32_t child{ node.LeftFirst }; child < node.LeftFirst + 2u; ++child)
+			{
+				if (!Contains(node.Min, node.Max, nodes[child].Min, nodes[child].Max))
+					return false;
+				stack.push_back({ child, depth + 1u });
+			}
+		}
+		return std::all_of(nrOfTimesSeen.begin(), nrOfTimesSeen.end(), [](uint32_t nrOfTimes) { return nrOfTimes == 1u; });
+	}
+
+	void TestBVHBuilder(TestContext& context) noexcept
+	{
+		std::mt19937 generator(6u);
+		std::uniform_real_distribution<float> distributionPos(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> distributionSize(0.0f, 2.0f);
+		//Sizes on both sides of the parallel thresholds.
+		const uint32_t counts[] = { 1u, 5u, 100u, 5000u, 40000u };
+		for (uint32_t count : counts)
+		{
+			std::vector<DirectX::XMFLOAT3> min(count);
+			std::vector<DirectX::XMFLOAT3> max(count);
+			for (uint32_t i{ 0u }; i < count; ++i)
+			{
+				min[i] = { distributionPos(generator), distributionPos(generator), distributionPos(generator) };
+				max[i] = { min[i].x + distributionSize(generator), min[i].y + distributionSize(generator), min[i].z + distributionSize(generator) };
+			}
+
+			BVHBuildSettings settings;
+			BVHBuilder builder(settings);
+			std::vector<BVHNode> nodes;
+			std::vector<uint32_t> order;
+			builder.Build(min.data(), max.data(), count, nodes, order);
+			TEST_CHECK(context, IsValidTree(nodes, order, min.data(), max.data(), count, 4u * settings.MaxLeafSize));
+
+			//The tree does not depend on the number of threads that built it.
+			settings.NrOfThreads = 1u;
+			BVHBuilder singleThreadedBuilder(settings);
+			std::vector<BVHNode> singleThreadedNodes;
+			std::vector<uint32_t> singleThreadedOrder;
+			singleThreadedBuilder.Build(min.data(), max.data(), count, singleThreadedNodes, singleThreadedOrder);
+			TEST_CHECK(context, singleThreadedNodes.size() == nodes.size() && std::memcmp(singleThreadedNodes.data(), nodes.data(), sizeof(BVHNode) * nodes.size()) == 0);
+			TEST_CHECK(context, singleThreadedOrder == order);
+		}
+
+		//Primitives that all sit in one spot, and positions that grow exponentially so that SAH only peels off a few per level.
+		const uint32_t count = 20000u;
+		std::vector<DirectX::XMFLOAT3> min(count, { 1.0f, 2.0f, 3.0f });
+		std::vector<DirectX::XMFLOAT3> max(count, { 1.5f, 2.5f, 3.5f });
+		BVHBuilder builder;
+		std::vector<BVHNode> nodes;
+		std::vector<uint32_t> order;
+		builder.Build(min.data(), max.data(), count, nodes, order);
+		TEST_CHECK(context, IsValidTree(nodes, order, min.data(), max.data(), count, 4u * builder.GetSettings().MaxLeafSize));
+
+		for (uint32_t i{ 0u }; i < count; ++i)
+		{
+			const float position = std::pow(1.002f, static_cast<float>(i));
+			min[i] = { position, 0.0f, 0.0f };
+			max[i] = { position * 1.001f, 1.0f, 1.0f };
+		}
+		builder.Build(min.data(), max.data(), count, nodes, order);
+		TEST_CHECK(context, IsValidTree(nodes, order, min.data(), max.data(), count, 4u * builder.GetSettings().MaxLeafSize));
+	}
+
+	//Moller-Trumbore in double precision, without culling back faces.
+	[[nodiscard]] bool IntersectTriangle(const ModelBVH::Triangle& triangle, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, double& distance) noexcept
+	{
+		const double dx = direction.x, dy = direction.y, dz = direction.z;
+		const double e1x = triangle.Edge1.x, e1y = triangle.Edge1.y, e1z = triangle.Edge1.z;
+		const double e2x = triangle.Edge2.x, e2y = triangle.Edge2.y, e2z = triangle.Edge2.z;
+		const double px = dy * e2z - dz * e2y, py = dz * e2x - dx * e2z, pz = dx * e2y - dy * e2x;
+		const double determinant = e1x * px + e1y * py + e1z * pz;
+		if (std::fabs(determinant) < 1.0e-12)
+			return false;
+
+		const double sx = static_cast<double>(origin.x) - triangle.Vertex0.x, sy = static_cast<double>(origin.y) - triangle.Vertex0.y, sz = static_cast<double>(origin.z) - triangle.Vertex0.z;
+		const double u = (sx * px + sy * py + sz * pz) / determinant;
+		if (u < 0.0 || u > 1.0)
+			return false;
+		const double qx = sy * e1z - sz * e1y, qy = sz * e1x - sx * e1z, qz = sx * e1y - sy * e1x;
+		const double v = (dx * qx + dy * qy + dz * qz) / determinant;
+		if (v < 0.0 || u + v > 1.0)
+			return false;
+		distance = (e2x * qx + e2y * qy + e2z * qz) / determinant;
+		return distance >= minDistance && distance <= maxDistance;
+	}
+
+	//Closest hit over every triangle, FLT_MAX when there is none.
+	[[nodiscard]] double IntersectBruteForce(const std::vector<ModelBVH::Triangle>& triangles, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance) noexcept
+	{
+		double closest = FLT_MAX;
+		for (const ModelBVH::Triangle& triangle : triangles)
+		{
+			double distance = 0.0;
+			if (IntersectTriangle(triangle, origin, direction, 0.0f, maxDistance, distance))
+			{
+				closest = std::min(closest, distance);
+			}
+		}
+		return closest;
+	}
+
+	//The BVHs test in single precision, so a hit may only differ from the reference by rounding.
+	[[nodiscard]] bool IsSameHit(bool hit, float distance, double expected) noexcept
+	{
+		if (!hit || expected == FLT_MAX)
+			return hit == (expected != FLT_MAX);
+		return std::fabs(distance - expected) <= 1.0e-4 * std::max(1.0, expected);
+	}
+
+	void TestModelBVH(TestContext& context) noexcept
+	{
+		//A soup of random triangles, from two meshes.
+		std::mt19937 generator(7u);
+		std::uniform_real_distribution<float> distributionPos(-20.0f, 20.0f);
+		std::uniform_real_distribution<float> distributionEdge(-2.0f, 2.0f);
+		const uint32_t nrOfTriangles = 3000u;
+		std::vector<ModelBVH::Triangle> triangles(nrOfTriangles);
+		for (uint32_t i{ 0u }; i < nrOfTriangles; ++i)
+		{
+			ModelBVH::Triangle& triangle = triangles[i];
+			triangle.Vertex0 = { distributionPos(generator), distributionPos(generator), distributionPos(generator) };
+			triangle.Edge1 = { distributionEdge(generator), distributionEdge(generator), distributionEdge(generator) };
+			triangle.Edge2 = { distributionEdge(generator), distributionEdge(generator), distributionEdge(generator) };
+			triangle.MeshIndex = i % 2u;
+			triangle.TriangleIndex = i / 2u;
+		}
+		const std::vector<ModelBVH::Triangle> reference = triangles;
+		ModelBVH bvh;
+		bvh.Build(std::move(triangles));
+		TEST_CHECK(context, bvh.IsBuilt() && bvh.GetNrOfTriangles() == nrOfTriangles && bvh.GetWideBVH().IsBuilt());
+
+		//Rays from outside the soup towards points inside it, so most of them hit and some pass through.
+		std::uniform_real_distribution<float> distributionDirection(-1.0f, 1.0f);
+		const uint32_t nrOfRays = 2000u;
+		uint32_t nrOfHits = 0u;
+		uint32_t nrOfClosestMismatches = 0u;
+		uint32_t nrOfAnyMismatches = 0u;
+		uint32_t nrOfPacketMismatches = 0u;
+		uint32_t nrOfWrongTriangles = 0u;
+		RayPacket packet;
+		double packetExpected[RayPacket::s_Size] = {};
+		for (uint32_t ray{ 0u }; ray < nrOfRays; ++ray)
+		{
+			const DirectX::XMFLOAT3 target = { distributionPos(generator), distributionPos(generator), distributionPos(generator) };
+			DirectX::XMFLOAT3 direction = { distributionDirection(generator), distributionDirection(generator), distributionDirection(generator) };
+			const DirectX::XMFLOAT3 origin = { target.x - 40.0f * direction.x, target.y - 40.0f * direction.y, target.z - 40.0f * direction.z };
+			//Every fourth ray is cut short, so that hits past the end of the ray have to be ignored.
+			const float maxDistance = ray % 4u == 0u ? 40.0f : FLT_MAX;
+			const double expected = IntersectBruteForce(reference, origin, direction, maxDistance);
+			nrOfHits += expected != FLT_MAX;
+
+			RayHit hit;
+			const bool isHit = bvh.Intersect(origin, direction, 0.0f, maxDistance, hit);
+			nrOfClosestMismatches += !IsSameHit(isHit, hit.Distance, expected);
+			RayHit binaryHit;
+			const bool isBinaryHit = bvh.IntersectBinary(origin, direction, 0.0f, maxDistance, binaryHit);
+			nrOfClosestMismatches += !IsSameHit(isBinaryHit, binaryHit.Distance, expected);
+			nrOfAnyMismatches += bvh.IntersectAny(origin, direction, 0.0f, maxDistance) != (expected != FLT_MAX);
+			nrOfAnyMismatches += bvh.IntersectAnyBinary(origin, direction, 0.0f, maxDistance) != (expected != FLT_MAX);
+
+			//The hit names the triangle it hit, with the barycentrics of the point along the ray.
+			if (isHit)
+			{
+				const ModelBVH::Triangle& triangle = reference[hit.TriangleIndex * 2u + hit.MeshIndex];
+				double distance = 0.0;
+				nrOfWrongTriangles += !IntersectTriangle(triangle, origin, direction, 0.0f, FLT_MAX, distance) || std::fabs(distance - hit.Distance) > 1.0e-4 * std::max(1.0, distance);
+			}
+
+			const uint32_t lane = ray % RayPacket::s_Size;
+			packet.Set(lane, origin, direction, 0.0f, maxDistance);
+			packetExpected[lane] = expected;
+			if (lane == RayPacket::s_Size - 1u)
+			{
+				//Half the packets only trace some of their rays.
+				packet.ActiveMask = (ray / RayPacket::s_Size) % 2u == 0u ? 0xFFu : 0x5Au;
+				RayHit hits[RayPacket::s_Size];
+				const uint32_t hitMask = bvh.Intersect(packet, hits);
+				const uint32_t anyHitMask = bvh.IntersectAny(packet);
+				for (uint32_t i{ 0u }; i < RayPacket::s_Size; ++i)
+				{
+					const bool isActive = (packet.ActiveMask >> i) & 1u;
+					const bool expectedHit = isActive && packetExpected[i] != FLT_MAX;
+					const bool isPacketHit = (hitMask >> i) & 1u;
+					nrOfPacketMismatches += isPacketHit != expectedHit || (isPacketHit && !IsSameHit(true, hits[i].Distance, packetExpected[i]));
+					nrOfPacketMismatches += static_cast<bool>((anyHitMask >> i) & 1u) != expectedHit;
+				}
+			}
+		}
+		TEST_CHECK(context, nrOfHits > nrOfRays / 4u && nrOfHits < nrOfRays);
+		TEST_CHECK(context, nrOfClosestMismatches == 0u);
+		TEST_CHECK(context, nrOfAnyMismatches == 0u);
+		TEST_CHECK(context, nrOfPacketMismatches == 0u);
+		TEST_CHECK(context, nrOfWrongTriangles == 0u);
+	}
+
+	void MakeRandomBounds(std::vector<DirectX::BoundingBox>& bounds, uint32_t count, std::mt19937& generator) noexcept
+	{
+		std::uniform_real_distribution<float> distributionPos(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> distributionExtents(0.5f, 10.0f);
+		bounds.resize(count);
+		for (DirectX::BoundingBox& box : bounds)
+		{
+			box.Center = DirectX::XMFLOAT3(distributionPos(generator), distributionPos(generator), distributionPos(generator));
+			box.Extents = DirectX::XMFLOAT3(distributionExtents(generator), distributionExtents(generator), distributionExtents(generator));
+		}
+	}
+
+	//Checks the queries against testing every item.
+	void TestSceneBVHQueries(TestContext& context, const SceneBVH& bvh, const std::vector<DirectX::BoundingBox>& bounds, std::mt19937& generator) noexcept
+	{
+		const uint32_t nrOfItems = static_cast<uint32_t>(bounds.size());
+
+		//The frustum query finds the same objects as the flat culler.
+		DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0.0f, 0.0f, -600.0f, 1.0f), DirectX::XMVectorSet(100.0f, 0.0f, 0.0f, 1.0f), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+		DirectX::XMFLOAT4X4 viewProjection;
+		DirectX::XMStoreFloat4x4(&viewProjection, DirectX::XMMatrixMultiply(view, projection));
+		const FrustumPlanes frustum = FrustumCuller::ExtractPlanes(viewProjection);
+		FrustumCuller culler;
+		for (const DirectX::BoundingBox& box : bounds)
+		{
+			culler.AddBox(box);
+		}
+		std::vector<uint32_t> expected;
+		(void)culler.CullScalar(frustum, expected);
+		std::vector<uint32_t> result;
+		bvh.QueryFrustum(frustum, result);
+		std::sort(result.begin(), result.end());
+		TEST_CHECK(context, !expected.empty() && result == expected);
+
+		//The sphere query finds every box whose closest point is within the radius.
+		std::uniform_real_distribution<float> distributionPos(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> distributionRadius(1.0f, 100.0f);
+		bool isSphereExpected = true;
+		for (uint32_t query{ 0u }; query < 100u; ++query)
+		{
+			DirectX::BoundingSphere sphere;
+			sphere.Center = DirectX::XMFLOAT3(distributionPos(generator), distributionPos(generator), distributionPos(generator));
+			sphere.Radius = distributionRadius(generator);
+			expected.clear();
+			for (uint32_t i{ 0u }; i < nrOfItems; ++i)
+			{
+				const DirectX::XMFLOAT3& c = bounds[i].Center;
+				const DirectX::XMFLOAT3& e = bounds[i].Extents;
+				const float dx = std::max(std::fabs(sphere.Center.x - c.x) - e.x, 0.0f);
+				const float dy = std::max(std::fabs(sphere.Center.y - c.y) - e.y, 0.0f);
+				const float dz = std::max(std::fabs(sphere.Center.z - c.z) - e.z, 0.0f);
+				if (dx * dx + dy * dy + dz * dz <= sphere.Radius * sphere.Radius)
+				{
+					expected.push_back(i);
+				}
+			}
+			result.clear();
+			bvh.QuerySphere(sphere, result);
+			std::sort(result.begin(), result.end());
+			isSphereExpected &= result == expected;
+		}
+		TEST_CHECK(context, isSphereExpected);
+
+		//The ray query finds every box the ray passes through before its end.
+		std::uniform_real_distribution<float> distributionDirection(-1.0f, 1.0f);
+		bool isRayExpected = true;
+		for (uint32_t query{ 0u }; query < 100u; ++query)
+		{
+			const DirectX::XMFLOAT3 origin = { distributionPos(generator), distributionPos(generator), distributionPos(generator) };
+			const DirectX::XMFLOAT3 direction = { distributionDirection(generator), distributionDirection(generator), distributionDirection(generator) };
+			const DirectX::XMFLOAT3 inverseDirection = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+			const float maxDistance = 800.0f;
+			expected.clear();
+			for (uint32_t i{ 0u }; i < nrOfItems; ++i)
+			{
+				const DirectX::XMFLOAT3& c = bounds[i].Center;
+				const DirectX::XMFLOAT3& e = bounds[i].Extents;
+				const float tx1 = (c.x - e.x - origin.x) * inverseDirection.x, tx2 = (c.x + e.x - origin.x) * inverseDirection.x;
+				const float ty1 = (c.y - e.y - origin.y) * inverseDirection.y, ty2 = (c.y + e.y - origin.y) * inverseDirection.y;
+				const float tz1 = (c.z - e.z - origin.z) * inverseDirection.z, tz2 = (c.z + e.z - origin.z) * inverseDirection.z;
+				const float tEnter = std::max(std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::min(tz1, tz2)), 0.0f);
+				const float tExit = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::max(tz1, tz2));
+				if (tExit >= tEnter && tEnter <= maxDistance)
+				{
+					expected.push_back(i);
+				}
+			}
+			result.clear();
+			bvh.QueryRay(origin, direction, maxDistance, result);
+			std::sort(result.begin(), result.end());
+			isRayExpected &= result == expected;
+		}
+		TEST_CHECK(context, isRayExpected);
+	}
+
+	void TestSceneBVH(TestContext& context) noexcept
+	{
+		std::mt19937 generator(8u);
+		std::vector<DirectX::BoundingBox> bounds;
+		MakeRandomBounds(bounds, 5000u, generator);
+		SceneBVH bvh;
+		bvh.Build(bounds);
+		TEST_CHECK(context, bvh.IsBuilt() && bvh.GetItemIndices().size() == bounds.size());
+		TestSceneBVHQueries(context, bvh, bounds, generator);
+
+		//Objects that move a little are refitted, objects that move far degrade their subtrees until they are rebuilt.
+		//The queries stay exact either way.
+		std::uniform_real_distribution<float> distributionOffset(-5.0f, 5.0f);
+		for (uint32_t frame{ 0u }; frame < 3u; ++frame)
+		{
+			for (DirectX::BoundingBox& box : bounds)
+			{
+				box.Center.x += distributionOffset(generator);
+				box.Center.z += distributionOffset(generator);
+			}
+			bvh.Refit(bounds);
+		}
+		TestSceneBVHQueries(context, bvh, bounds, generator);
+
+		std::vector<DirectX::BoundingBox> scattered;
+		MakeRandomBounds(scattered, 5000u, generator);
+		bvh.Refit(scattered);
+		TEST_CHECK(context, bvh.GetNrOfSubtreeRebuilds() > 0u);
+		TestSceneBVHQueries(context, bvh, scattered, generator);
+	}
+}
+
+void RunBVHTests(TestContext& context) noexcept
+{
+	context.BeginGroup("BVHBuilder");
+	TestBVHBuilder(context);
+	context.BeginGroup("ModelBVH");
+	TestModelBVH(context);
+	context.BeginGroup("SceneBVH");
+	TestSceneBVH(context);
+}
@@ -0,0 +1,294 @@
+#include "pch.h"
+#include "Tests.h"
+#include "CommandListPool.h"
+#include "CommandRecorder.h"
+
+namespace
+{
+	enum class MockCommand : uint32_t
+	{
+		PipelineState = 0,
+		RootSignature,
+		RootView,
+		RootConstant,
+		Draw,
+		ExecuteIndirect
+	};
+
+	//Command list that keeps the calls that reached it and the state the pool left it in.
+	struct MockCommandList
+	{
+		bool IsOpen = false;
+		uint32_t NrOfResets = 0u;
+		std::vector<MockCommand> Commands = {};
+		//What RecordParallel handed to the list, in recording order.
+		std::vector<uint32_t> Items = {};
+
+		void SetPipelineState(ID3D12PipelineState*) noexcept { Commands.push_back(MockCommand::PipelineState); }
+		void SetGraphicsRootSignature(ID3D12RootSignature*) noexcept { Commands.push_back(MockCommand::RootSignature); }
+		void SetGraphicsRootShaderResourceView(uint32_t, D3D12_GPU_VIRTUAL_ADDRESS) noexcept { Commands.push_back(MockCommand::RootView); }
+		void SetGraphicsRootConstantBufferView(uint32_t, D3D12_GPU_VIRTUAL_ADDRESS) noexcept { Commands.push_back(MockCommand::RootView); }
+		void SetGraphicsRoot32BitConstant(uint32_t, uint32_t, uint32_t) noexcept { Commands.push_back(MockCommand::RootConstant); }
+		void SetGraphicsRoot32BitConstants(uint32_t, uint32_t, const void*, uint32_t) noexcept { Commands.push_back(MockCommand::RootConstant); }
+		void DrawInstanced(uint32_t, uint32_t, uint32_t, uint32_t) noexcept { Commands.push_back(MockCommand::Draw); }
+		void ExecuteIndirect(ID3D12CommandSignature*, uint32_t, ID3D12Resource*, uint64_t, ID3D12Resource*, uint64_t) noexcept { Commands.push_back(MockCommand::ExecuteIndirect); }
+
+		[[nodiscard]] uint32_t Count(MockCommand command) const noexcept { return static_cast<uint32_t>(std::count(Commands.begin(), Commands.end(), command)); }
+	};
+
+	class MockCommandListBackend
+	{
+	public:
+		using CommandList = MockCommandList;
+
+		void Create(CommandList& commandList) noexcept
+		{
+			commandList.IsOpen = false;
+			m_NrOfCreated++;
+		}
+		void Reset(CommandList& commandList) noexcept
+		{
+			commandList.IsOpen = true;
+			commandList.NrOfResets++;
+			commandList.Commands.clear();
+			commandList.Items.clear();
+		}
+		void Close(CommandList& commandList) noexcept
+		{
+			commandList.IsOpen = false;
+			m_NrOfClosed.fetch_add(1u, std::memory_order_relaxed);
+		}
+
+		[[nodiscard]] constexpr uint32_t GetNrOfCreated() const noexcept { return m_NrOfCreated; }
+		[[nodiscard]] uint32_t GetNrOfClosed() const noexcept { return m_NrOfClosed.load(std::memory_order_relaxed); }
+	private:
+		uint32_t m_NrOfCreated = 0u;
+		//Closed on the threads of the pool.
+		std::atomic<uint32_t> m_NrOfClosed = 0u;
+	};
+
+	using MockCommandListPool = CommandListPoolT<MockCommandListBackend>;
+	using MockCommandRecorder = CommandRecorderT<MockCommandList>;
+
+	//The recorder only compares the interfaces, they are never called.
+	template<typename T>
+	T* MakeHandle(uintptr_t value) noexcept
+	{
+		return reinterpret_cast<T*>(value);
+	}
+
+	void TestAcquireAndRelease(TestContext& context) noexcept
+	{
+		MockCommandListPool pool;
+		MockCommandList& first = pool.Acquire(0u);
+		TEST_CHECK(context, first.IsOpen && pool.GetNrOfCommandLists() == 1u);
+		pool.Release(first, 5u);
+
+		//The GPU has not reached the fence of the first list yet.
+		MockCommandList& second = pool.Acquire(4u);
+		TEST_CHECK(context, &second != &first && pool.GetNrOfCommandLists() == 2u);
+		pool.Release(second, 6u);
+
+		MockCommandList& reused = pool.Acquire(5u);
+		TEST_CHECK(context, &reused == &first);
+		TEST_CHECK(context, reused.IsOpen && reused.NrOfResets == 2u);
+		TEST_CHECK(context, pool.GetNrOfCommandLists() == 2u && pool.GetNrOfInFlight() == 1u);
+		TEST_CHECK(context, pool.GetBackend().GetNrOfCreated() == 2u);
+	}
+
+	void TestChunkRanges(TestContext& context) noexcept
+	{
+		const uint32_t counts[] = { 0u, 1u, 7u, 100u, 1001u, 65536u };
+		const uint32_t chunkCounts[] = { 1u, 2u, 3u, 8u, 13u, 64u };
+		for (uint32_t count : counts)
+		{
+			for (uint32_t nrOfChunks : chunkCounts)
+			{
+				//The chunks cover the range in order without gaps, and differ in size by at most one.
+				uint32_t expectedBegin = 0u;
+				uint32_t minSize = UINT32_MAX;
+				uint32_t maxSize = 0u;
+				bool isContiguous = true;
+				for (uint32_t chunk{ 0u }; chunk < nrOfChunks; ++chunk)
+				{
+					uint32_t begin = 0u;
+					uint32_t end = 0u;
+					MockCommandListPool::GetChunkRange(count, nrOfChunks, chunk, begin, end);
+					isContiguous &= begin == expectedBegin && end >= begin;
+					expectedBegin = end;
+					minSize = std::min(minSize, end - begin);
+					maxSize = std::max(maxSize, end - begin);
+				}
+				TEST_CHECK(context, isContiguous && expectedBegin == count);
+				TEST_CHECK(context, maxSize - minSize <= 1u);
+			}
+		}
+	}
+
+	void TestRecordParallel(TestContext& context) noexcept
+	{
+		MockCommandListPool pool;
+		const uint32_t nrOfThreads = ThreadPool::Get().GetNrOfThreads();
+
+		pool.RecordParallel(0u, 1u, 0u, [](uint32_t, MockCommandList&, uint32_t, uint32_t) noexcept {});
+		TEST_CHECK(context, pool.GetRecorded().empty() && pool.GetNrOfCommandLists() == 0u);
+
+		const uint32_t count = 10000u;
+		const uint32_t minChunkSize = 100u;
+		std::atomic<uint32_t> nrOfCalls = 0u;
+		auto record = [&nrOfCalls](uint32_t, MockCommandList& commandList, uint32_t begin, uint32_t end) noexcept
+		{
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				commandList.Items.push_back(i);
+			}
+			nrOfCalls.fetch_add(1u, std::memory_order_relaxed);
+		};
+		pool.RecordParallel(count, minChunkSize, 0u, record);
+
+		const uint32_t expectedNrOfChunks = std::min((count + minChunkSize - 1u) / minChunkSize, nrOfThreads);
+		const std::vector<MockCommandList*>& recorded = pool.GetRecorded();
+		TEST_CHECK(context, recorded.size() == expectedNrOfChunks && nrOfCalls.load() == expectedNrOfChunks);
+		TEST_CHECK(context, pool.GetBackend().GetNrOfClosed() == expectedNrOfChunks);
+
+		//Executed in the order of GetRecorded, the lists hold every item once and in order.
+		std::vector<uint32_t> items;
+		bool areClosed = true;
+		for (const MockCommandList* pCommandList : recorded)
+		{
+			items.insert(items.end(), pCommandList->Items.begin(), pCommandList->Items.end());
+			areClosed &= !pCommandList->IsOpen;
+		}
+		bool isInOrder = items.size() == count;
+		for (uint32_t i{ 0u }; isInOrder && i < count; ++i)
+		{
+			isInOrder = items[i] == i;
+		}
+		TEST_CHECK(context, isInOrder);
+		TEST_CHECK(context, areClosed);
+
+		//The lists are only recycled once the fence they were released with has been reached.
+		pool.ReleaseRecorded(10u);
+		TEST_CHECK(context, pool.GetRecorded().empty() && pool.GetNrOfInFlight() == expectedNrOfChunks);
+		pool.RecordParallel(count, minChunkSize, 9u, record);
+		TEST_CHECK(context, pool.GetNrOfCommandLists() == 2u * expectedNrOfChunks);
+		pool.ReleaseRecorded(11u);
+		pool.RecordParallel(count, minChunkSize, 11u, record);
+		TEST_CHECK(context, pool.GetNrOfCommandLists() == 2u * expectedNrOfChunks);
+		pool.ReleaseRecorded(12u);
+	}
+
+	void TestCommandRecorder(TestContext& context) noexcept
+	{
+		MockCommandList commandList;
+		MockCommandRecorder recorder;
+		recorder.Begin(&commandList);
+
+		ID3D12PipelineState* pPipelineA = MakeHandle<ID3D12PipelineState>(1u);
+		ID3D12PipelineState* pPipelineB = MakeHandle<ID3D12PipelineState>(2u);
+		ID3D12RootSignature* pRootSignatureA = MakeHandle<ID3D12RootSignature>(3u);
+		ID3D12RootSignature* pRootSignatureB = MakeHandle<ID3D12RootSignature>(4u);
+
+		recorder.SetPipelineState(pPipelineA);
+		recorder.SetPipelineState(pPipelineA);
+		recorder.SetPipelineState(pPipelineB);
+		TEST_CHECK(context, commandList.Count(MockCommand::PipelineState) == 2u);
+
+		recorder.SetGraphicsRootSignature(pRootSignatureA);
+		recorder.SetGraphicsRootShaderResourceView(1u, 0x1000u);
+		recorder.SetGraphicsRootShaderResourceView(1u, 0x1000u);
+		//The same address as another kind of view is a different binding.
+		recorder.SetGraphicsRootConstantBufferView(1u, 0x1000u);
+		TEST_CHECK(context, commandList.Count(MockCommand::RootView) == 2u);
+
+		//A new root signature leaves the root parameters undefined, the pipeline state stays bound.
+		recorder.SetGraphicsRootSignature(pRootSignatureA);
+		TEST_CHECK(context, commandList.Count(MockCommand::RootSignature) == 1u);
+		recorder.SetGraphicsRootSignature(pRootSignatureB);
+		recorder.SetGraphicsRootConstantBufferView(1u, 0x1000u);
+		recorder.SetPipelineState(pPipelineB);
+		TEST_CHECK(context, commandList.Count(MockCommand::RootView) == 3u && commandList.Count(MockCommand::PipelineState) == 2u);
+
+		//A range of constants is only dropped when every constant in it is known and equal.
+		const uint32_t constants[4] = { 5u, 6u, 7u, 8u };
+		recorder.SetGraphicsRoot32BitConstant(6u, 5u, 0u);
+		recorder.SetGraphicsRoot32BitConstant(6u, 5u, 0u);
+		recorder.SetGraphicsRoot32BitConstants(6u, 4u, constants, 0u);
+		recorder.SetGraphicsRoot32BitConstants(6u, 4u, constants, 0u);
+		recorder.SetGraphicsRoot32BitConstant(6u, 7u, 2u);
+		recorder.SetGraphicsRoot32BitConstant(6u, 9u, 2u);
+		TEST_CHECK(context, commandList.Count(MockCommand::RootConstant) == 3u);
+
+		//Draws always pass, ExecuteIndirect forgets the root parameters.
+		recorder.DrawInstanced(3u, 1u, 0u, 0u);
+		recorder.DrawInstanced(3u, 1u, 0u, 0u);
+		recorder.ExecuteIndirect(nullptr, 1u, nullptr, 0u, nullptr, 0u);
+		recorder.SetGraphicsRoot32BitConstant(6u, 5u, 0u);
+		recorder.SetGraphicsRootConstantBufferView(1u, 0x1000u);
+		recorder.SetPipelineState(pPipelineB);
+		TEST_CHECK(context, commandList.Count(MockCommand::Draw) == 2u && commandList.Count(MockCommand::ExecuteIndirect) == 1u);
+		TEST_CHECK(context, commandList.Count(MockCommand::RootConstant) == 4u && commandList.Count(MockCommand::RootView) == 4u);
+		TEST_CHECK(context, commandList.Count(MockCommand::PipelineState) == 2u);
+
+		//Every Set call is counted once, as issued or as elided.
+		const uint32_t nrOfSetCommands = static_cast<uint32_t>(commandList.Commands.size()) - commandList.Count(MockCommand::Draw) - commandList.Count(MockCommand::ExecuteIndirect);
+		TEST_CHECK(context, recorder.GetNrOfIssued() == nrOfSetCommands && recorder.GetNrOfElided() == 8u);
+
+		//Nothing is assumed to be bound on a new list.
+		MockCommandList nextCommandList;
+		recorder.Begin(&nextCommandList);
+		recorder.SetPipelineState(pPipelineB);
+		recorder.SetGraphicsRootSignature(pRootSignatureB);
+		TEST_CHECK(context, nextCommandList.Commands.size() == 2u);
+	}
+}
+
+void RunCommandTests(TestContext& context) noexcept
+{
+	context.BeginGroup("CommandListPool");
+	TestAcquireAndRelease(context);
+	TestChunkRanges(context);
+	TestRecordParallel(context);
+	context.BeginGroup("CommandRecorder");
+	TestCommandRecorder(context);
+}
+
+//Times recording the draws of a frame over one to all threads. Every draw goes through a recorder like the renderer's chunks do.
+void RunCommandBenchmarks() noexcept
+{
+	const uint32_t nrOfDraws = 200000u;
+	const uint32_t nrOfRuns = 5u;
+	ID3D12PipelineState* pipelines[4] = { MakeHandle<ID3D12PipelineState>(1u), MakeHandle<ID3D12PipelineState>(2u), MakeHandle<ID3D12PipelineState>(3u), MakeHandle<ID3D12PipelineState>(4u) };
+
+	MockCommandListPool pool;
+	std::vector<MockCommandRecorder> recorders(ThreadPool::Get().GetNrOfThreads());
+	uint64_t fenceValue = 0u;
+	double singleChunkTime = 0.0;
+	printf("Command list pool, %d draws\n", nrOfDraws);
+	for (uint32_t nrOfChunks{ 1u }; nrOfChunks <= ThreadPool::Get().GetNrOfThreads(); nrOfChunks *= 2u)
+	{
+		double bestTime = DBL_MAX;
+		for (uint32_t run{ 0u }; run < nrOfRuns; ++run)
+		{
+			pool.RecordParallel(nrOfDraws, (nrOfDraws + nrOfChunks - 1u) / nrOfChunks, fenceValue, [&](uint32_t chunkIndex, MockCommandList& commandList, uint32_t begin, uint32_t end) noexcept
+				{
+					MockCommandRecorder& recorder = recorders[chunkIndex];
+					recorder.Begin(&commandList);
+					for (uint32_t i{ begin }; i < end; ++i)
+					{
+						recorder.SetPipelineState(pipelines[(i / 1024u) % 4u]);
+						recorder.SetGraphicsRootShaderResourceView(1u, 0x10000u * (i / 16u));
+						recorder.SetGraphicsRoot32BitConstant(6u, i, 0u);
+						recorder.DrawInstanced(36u, 1u, 0u, 0u);
+					}
+				});
+			bestTime = std::min(bestTime, pool.GetRecordTime());
+			pool.ReleaseRecorded(++fenceValue);
+		}
+		if (nrOfChunks == 1u)
+		{
+			singleChunkTime = bestTime;
+		}
+		printf("  %d chunks: %.3f ms, %.2fx, %d lists\n", nrOfChunks, bestTime, bestTime > 0.0 ? singleChunkTime / bestTime : 0.0, pool.GetNrOfCommandLists());
+	}
+}
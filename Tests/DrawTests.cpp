@@ -0,0 +1,663 @@
+#include "pch.h"
+#include "Tests.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "DrawList.h"
+#include "RetainedDrawList.h"
+#include "InstanceBatcher.h"
+#include "IndirectDrawBuilder.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	//A camera at the origin that looks down the z axis, like the one of the scene.
+	DirectX::XMFLOAT4X4 GetTestViewProjection() noexcept
+	{
+		DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+		DirectX::XMFLOAT4X4 viewProjection;
+		DirectX::XMStoreFloat4x4(&viewProjection, DirectX::XMMatrixMultiply(view, projection));
+		return viewProjection;
+	}
+
+	FrustumPlanes GetTestFrustum() noexcept
+	{
+		return FrustumCuller::ExtractPlanes(GetTestViewProjection());
+	}
+
+	void AddRandomBoxes(FrustumCuller& culler, uint32_t nrOfBoxes, std::mt19937& generator) noexcept
+	{
+		std::uniform_real_distribution<float> distributionPos(-1200.0f, 1200.0f);
+		std::uniform_real_distribution<float> distributionExtents(0.5f, 10.0f);
+		culler.Clear();
+		culler.Reserve(nrOfBoxes);
+		for (uint32_t i{ 0u }; i < nrOfBoxes; ++i)
+		{
+			DirectX::BoundingBox box;
+			box.Center = DirectX::XMFLOAT3(distributionPos(generator), distributionPos(generator), distributionPos(generator));
+			box.Extents = DirectX::XMFLOAT3(distributionExtents(generator), distributionExtents(generator), distributionExtents(generator));
+			culler.AddBox(box);
+		}
+	}
+
+	//Packets with few pipelines and meshes, so that many of them share state and the stability of the sort matters.
+	void AddRandomPackets(DrawList& drawList, uint32_t nrOfPackets, std::mt19937& generator) noexcept
+	{
+		std::uniform_int_distribution<uint32_t> distributionPipeline(0u, 3u);
+		std::uniform_int_distribution<uint32_t> distributionMesh(0u, 63u);
+		std::uniform_real_distribution<float> distributionDepth(-10.0f, 1100.0f);
+		drawList.Clear();
+		drawList.Reserve(nrOfPackets);
+		for (uint32_t i{ 0u }; i < nrOfPackets; ++i)
+		{
+			const uint32_t meshIndex = distributionMesh(generator);
+			//Every tenth depth is repeated, so that equal keys occur.
+			const float depth = i % 10u == 0u ? 50.0f : distributionDepth(generator);
+			drawList.Add({ DrawList::MakeSortKey(distributionPipeline(generator), meshIndex, depth, 1000.0f), i, meshIndex });
+		}
+	}
+
+	[[nodiscard]] bool IsEqual(const DrawPacket& first, const DrawPacket& second) noexcept
+	{
+		return first.SortKey == second.SortKey && first.ObjectIndex == second.ObjectIndex && first.MeshIndex == second.MeshIndex;
+	}
+
+	//Meshes the batcher only compares and hands on, so any distinct addresses do.
+	std::vector<const Mesh*> MakeTestMeshes(const std::vector<uint8_t>& storage) noexcept
+	{
+		std::vector<const Mesh*> meshes(storage.size());
+		for (uint32_t i{ 0u }; i < storage.size(); ++i)
+		{
+			meshes[i] = reinterpret_cast<const Mesh*>(&storage[i]);
+		}
+		return meshes;
+	}
+
+	//Instance data that tells every object apart.
+	void MakeTestInstances(std::vector<InstanceData>& instances, uint32_t nrOfObjects) noexcept
+	{
+		instances.resize(nrOfObjects);
+		for (uint32_t i{ 0u }; i < nrOfObjects; ++i)
+		{
+			InstanceData& instance = instances[i];
+			instance = {};
+			DirectX::XMStoreFloat4x4(&instance.WorldMatrix, DirectX::XMMatrixTranslation(static_cast<float>(i), 1.0f, 2.0f));
+			instance.Color = { static_cast<float>(i & 255u) / 255.0f, 0.5f, 0.25f, 1.0f };
+			instance.LightOffset = i * 3u;
+			instance.NrOfLights = i % 7u;
+			instance.VisibilityOffset = i * 2u;
+			instance.NrOfVisibilityLights = i % 5u;
+		}
+	}
+
+	//Sorted packets of random objects, several per object, with few pipelines and meshes.
+	void AddRandomObjectPackets(DrawList& drawList, uint32_t nrOfPackets, uint32_t nrOfObjects, std::mt19937& generator) noexcept
+	{
+		std::uniform_int_distribution<uint32_t> distributionObject(0u, nrOfObjects - 1u);
+		std::uniform_int_distribution<uint32_t> distributionPipeline(0u, 3u);
+		std::uniform_int_distribution<uint32_t> distributionMesh(0u, 63u);
+		std::uniform_real_distribution<float> distributionDepth(0.0f, 1000.0f);
+		drawList.Clear();
+		drawList.Reserve(nrOfPackets);
+		for (uint32_t i{ 0u }; i < nrOfPackets; ++i)
+		{
+			const uint32_t meshIndex = distributionMesh(generator);
+			drawList.Add({ DrawList::MakeSortKey(distributionPipeline(generator), meshIndex, distributionDepth(generator), 1000.0f), distributionObject(generator), meshIndex });
+		}
+		drawList.Sort();
+	}
+
+	//Gathers the instances of every pipeline and mesh on its own, by walking the whole list for each of them in key order.
+	void GatherPerMesh(const std::vector<InstanceData>& objectInstances, const DrawList& drawList, const std::vector<const Mesh*>& meshes, std::vector<InstanceData>& instanceData, std::vector<InstanceBatch>& batches) noexcept
+	{
+		const std::vector<DrawPacket>& packets = drawList.GetPackets();
+		std::vector<uint64_t> stateKeys;
+		for (const DrawPacket& packet : packets)
+		{
+			stateKeys.push_back(packet.SortKey & DrawList::s_StateMask);
+		}
+		std::sort(stateKeys.begin(), stateKeys.end());
+		stateKeys.erase(std::unique(stateKeys.begin(), stateKeys.end()), stateKeys.end());
+
+		instanceData.clear();
+		batches.clear();
+		for (uint64_t stateKey : stateKeys)
+		{
+			InstanceBatch batch = { nullptr, static_cast<uint32_t>(instanceData.size()), 0u };
+			for (const DrawPacket& packet : packets)
+			{
+				if ((packet.SortKey & DrawList::s_StateMask) != stateKey)
+					continue;
+
+				batch.pMesh = meshes[packet.MeshIndex];
+				batch.InstanceCount++;
+				instanceData.push_back(objectInstances[packet.ObjectIndex]);
+			}
+			batches.push_back(batch);
+		}
+	}
+
+	[[nodiscard]] bool AreBatchesEqual(const InstanceBatcher& batcher, const std::vector<InstanceData>& instanceData, const std::vector<InstanceBatch>& batches) noexcept
+	{
+		const std::vector<InstanceBatch>& batcherBatches = batcher.GetBatches();
+		const std::vector<InstanceData>& batcherInstanceData = batcher.GetInstanceData();
+		if (batcherBatches.size() != batches.size() || batcherInstanceData.size() != instanceData.size())
+			return false;
+		for (uint32_t i{ 0u }; i < batches.size(); ++i)
+		{
+			if (batcherBatches[i].pMesh != batches[i].pMesh || batcherBatches[i].InstanceOffset != batches[i].InstanceOffset || batcherBatches[i].InstanceCount != batches[i].InstanceCount)
+				return false;
+		}
+		return instanceData.empty() || std::memcmp(batcherInstanceData.data(), instanceData.data(), sizeof(InstanceData) * instanceData.size()) == 0;
+	}
+
+	//An object drawn through the retained list, with the state keys of its meshes and the depth it was last added with.
+	struct RetainedObject
+	{
+		uint64_t StateKeys[3];
+		uint32_t NrOfStateKeys;
+		uint64_t DepthKey;
+	};
+
+	void RandomizeObject(RetainedObject& object, std::mt19937& generator) noexcept
+	{
+		std::uniform_int_distribution<uint32_t> distributionPipeline(0u, 3u);
+		std::uniform_int_distribution<uint32_t> distributionMesh(0u, 63u);
+		std::uniform_int_distribution<uint32_t> distributionCount(1u, 3u);
+		std::uniform_real_distribution<float> distributionDepth(-10.0f, 1100.0f);
+		object.NrOfStateKeys = distributionCount(generator);
+		for (uint32_t i{ 0u }; i < object.NrOfStateKeys; ++i)
+		{
+			object.StateKeys[i] = DrawList::MakeStateKey(distributionPipeline(generator), distributionMesh(generator));
+		}
+		object.DepthKey = DrawList::QuantizeDepth(distributionDepth(generator), 1000.0f);
+	}
+
+	void AddObjectPackets(DrawList& drawList, const RetainedObject& object, uint32_t objectIndex) noexcept
+	{
+		for (uint32_t i{ 0u }; i < object.NrOfStateKeys; ++i)
+		{
+			drawList.Add({ object.StateKeys[i] | object.DepthKey, objectIndex, DrawList::GetMeshIndex(object.StateKeys[i]) });
+		}
+	}
+
+	//The same packets, whatever the order of equal keys.
+	[[nodiscard]] bool HaveSamePackets(std::vector<DrawPacket> first, std::vector<DrawPacket> second) noexcept
+	{
+		auto isLess = [](const DrawPacket& a, const DrawPacket& b) { return std::tie(a.SortKey, a.ObjectIndex, a.MeshIndex) < std::tie(b.SortKey, b.ObjectIndex, b.MeshIndex); };
+		std::sort(first.begin(), first.end(), isLess);
+		std::sort(second.begin(), second.end(), isLess);
+		return first.size() == second.size() && std::equal(first.begin(), first.end(), second.begin(), IsEqual);
+	}
+
+	void TestFrustumCuller(TestContext& context) noexcept
+	{
+		const FrustumPlanes frustum = GetTestFrustum();
+		FrustumCuller culler;
+
+		//A box in front of the camera is visible, one behind it or past the far plane is not.
+		DirectX::BoundingBox box;
+		box.Extents = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+		const DirectX::XMFLOAT3 centers[3] = { { 0.0f, 0.0f, 10.0f }, { 0.0f, 0.0f, -10.0f }, { 0.0f, 0.0f, 1100.0f } };
+		for (const DirectX::XMFLOAT3& center : centers)
+		{
+			box.Center = center;
+			culler.AddBox(box);
+		}
+		TEST_CHECK(context, culler.Cull(frustum) == 1u && culler.GetVisibleIndices()[0] == 0u);
+		TEST_CHECK(context, culler.GetNrOfCulled() == 2u);
+
+		//The AVX2 kernel writes the same indices as the scalar reference, also for the boxes in the tail of the last register.
+		std::mt19937 generator(1u);
+		const uint32_t counts[] = { 0u, 1u, 7u, 8u, 9u, 31u, 1000u, 100003u };
+		std::vector<uint32_t> expected;
+		for (uint32_t count : counts)
+		{
+			AddRandomBoxes(culler, count, generator);
+			const uint32_t nrOfVisible = culler.Cull(frustum);
+			const uint32_t nrOfExpected = culler.CullScalar(frustum, expected);
+			TEST_CHECK(context, nrOfVisible == nrOfExpected && culler.GetNrOfVisible() == nrOfVisible);
+			TEST_CHECK(context, std::equal(expected.begin(), expected.begin() + nrOfExpected, culler.GetVisibleIndices()));
+		}
+	}
+
+	void TestOcclusionCuller(TestContext& context) noexcept
+	{
+		//A wall 10 units in front of the camera, 6 units wide and high, facing it.
+		const std::vector<DirectX::XMFLOAT3> positions = { { -3.0f, -3.0f, 10.0f }, { -3.0f, 3.0f, 10.0f }, { 3.0f, 3.0f, 10.0f }, { 3.0f, -3.0f, 10.0f } };
+		const std::vector<uint32_t> indices = { 0u, 1u, 2u, 0u, 2u, 3u };
+		DirectX::XMFLOAT4X4 world;
+		DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
+
+		OcclusionCuller culler;
+		culler.BeginFrame(GetTestViewProjection());
+		culler.RenderOccluders();
+		TEST_CHECK(context, culler.IsVisible(DirectX::BoundingBox({ 0.0f, 0.0f, 20.0f }, { 1.0f, 1.0f, 1.0f })));
+
+		culler.BeginFrame(GetTestViewProjection());
+		culler.AddOccluder(world, positions, indices);
+		culler.RenderOccluders();
+		TEST_CHECK(context, culler.GetStats().NrOfOccluders == 1u && culler.GetStats().NrOfOccluderTriangles == 2u);
+
+		//Behind the wall, in front of it, behind it but beside it, and behind it but larger than it.
+		const std::vector<DirectX::BoundingBox> boxes =
+		{
+			DirectX::BoundingBox({ 0.0f, 0.0f, 20.0f }, { 1.0f, 1.0f, 1.0f }),
+			DirectX::BoundingBox({ 0.0f, 0.0f, 5.0f }, { 1.0f, 1.0f, 1.0f }),
+			DirectX::BoundingBox({ 10.0f, 0.0f, 20.0f }, { 1.0f, 1.0f, 1.0f }),
+			DirectX::BoundingBox({ 0.0f, 0.0f, 20.0f }, { 8.0f, 1.0f, 1.0f })
+		};
+		TEST_CHECK(context, !culler.IsVisible(boxes[0]));
+		TEST_CHECK(context, culler.IsVisible(boxes[1]));
+		TEST_CHECK(context, culler.IsVisible(boxes[2]));
+		TEST_CHECK(context, culler.IsVisible(boxes[3]));
+		//A box that reaches through the wall is not hidden by it.
+		TEST_CHECK(context, culler.IsVisible(DirectX::BoundingBox({ 0.0f, 0.0f, 10.0f }, { 1.0f, 1.0f, 1.0f })));
+
+		const std::vector<uint32_t> testIndices = { 3u, 0u, 2u, 1u, 0u };
+		std::vector<uint8_t> visibility;
+		culler.TestBoxes(boxes, testIndices, visibility);
+		TEST_CHECK(context, visibility == std::vector<uint8_t>({ 1u, 0u, 1u, 1u, 0u }));
+		TEST_CHECK(context, culler.GetStats().NrOfTested == 5u && culler.GetStats().NrOfOccluded == 2u);
+	}
+
+	void TestDrawListKeys(TestContext& context) noexcept
+	{
+		//The state is above the depth, the pipeline above the mesh.
+		TEST_CHECK(context, DrawList::MakeSortKey(0u, 1u, 999.0f, 1000.0f) < DrawList::MakeSortKey(1u, 0u, 0.0f, 1000.0f));
+		TEST_CHECK(context, DrawList::MakeSortKey(1u, 0u, 999.0f, 1000.0f) < DrawList::MakeSortKey(1u, 1u, 0.0f, 1000.0f));
+		TEST_CHECK(context, DrawList::GetMeshIndex(DrawList::MakeSortKey(7u, 123456u, 10.0f, 1000.0f)) == 123456u);
+		TEST_CHECK(context, (DrawList::MakeSortKey(7u, 123456u, 10.0f, 1000.0f) & DrawList::s_StateMask) == DrawList::MakeStateKey(7u, 123456u));
+
+		//Depth keeps its order and is clamped to the range.
+		TEST_CHECK(context, DrawList::QuantizeDepth(1.0f, 1000.0f) < DrawList::QuantizeDepth(2.0f, 1000.0f));
+		TEST_CHECK(context, DrawList::QuantizeDepth(-5.0f, 1000.0f) == DrawList::QuantizeDepth(0.0f, 1000.0f));
+		TEST_CHECK(context, DrawList::QuantizeDepth(5000.0f, 1000.0f) == DrawList::QuantizeDepth(1000.0f, 1000.0f));
+		TEST_CHECK(context, (DrawList::QuantizeDepth(1000.0f, 1000.0f) & DrawList::s_StateMask) == 0u);
+	}
+
+	void TestDrawListSort(TestContext& context) noexcept
+	{
+		//Sizes below and above the size at which the sort is split over the threads.
+		std::mt19937 generator(2u);
+		const uint32_t counts[] = { 0u, 1u, 2u, 1000u, 4097u, 100000u };
+		DrawList drawList;
+		for (uint32_t count : counts)
+		{
+			AddRandomPackets(drawList, count, generator);
+			std::vector<DrawPacket> expected = drawList.GetPackets();
+			std::stable_sort(expected.begin(), expected.end(), [](const DrawPacket& first, const DrawPacket& second) { return first.SortKey < second.SortKey; });
+
+			drawList.Sort();
+			const std::vector<DrawPacket>& packets = drawList.GetPackets();
+			TEST_CHECK(context, packets.size() == expected.size() && std::equal(packets.begin(), packets.end(), expected.begin(), IsEqual));
+
+			//Sorted, the state only changes once per pipeline and mesh pair.
+			uint32_t nrOfStates = 0u;
+			for (uint32_t i{ 0u }; i < count; ++i)
+			{
+				nrOfStates += i == 0u || (expected[i].SortKey & DrawList::s_StateMask) != (expected[i - 1u].SortKey & DrawList::s_StateMask);
+			}
+			TEST_CHECK(context, drawList.CountStateChanges() == (nrOfStates > 0u ? nrOfStates - 1u : 0u));
+		}
+	}
+
+	void TestRetainedDrawList(TestContext& context) noexcept
+	{
+		const uint32_t nrOfObjects = 2000u;
+		std::mt19937 generator(6u);
+		std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+		std::vector<RetainedObject> objects(nrOfObjects);
+		//Objects that changed since they were last submitted.
+		std::vector<uint8_t> isDirty(nrOfObjects, 1u);
+		for (RetainedObject& object : objects)
+		{
+			RandomizeObject(object, generator);
+		}
+
+		//Every frame a tenth of the objects change, a few are replaced by new objects at the same index, and a fifth is not drawn.
+		//The list has to hold the packets of exactly the drawn objects, sorted, like sorting all of them every frame does.
+		RetainedDrawList retainedDrawList;
+		DrawList drawList;
+		DrawList expected;
+		bool isSorted = true;
+		bool isEqual = true;
+		bool areCountsEqual = true;
+		for (uint32_t frame{ 0u }; frame < 20u; ++frame)
+		{
+			retainedDrawList.BeginFrame();
+			expected.Clear();
+			for (uint32_t i{ 0u }; i < nrOfObjects; ++i)
+			{
+				const float change = distribution(generator);
+				if (frame > 0u && change < 0.02f)
+				{
+					retainedDrawList.Remove(i);
+					RandomizeObject(objects[i], generator);
+					isDirty[i] = 1u;
+				}
+				else if (frame > 0u && change < 0.1f)
+				{
+					RandomizeObject(objects[i], generator);
+					isDirty[i] = 1u;
+				}
+				if (distribution(generator) < 0.2f)
+					continue;
+
+				const bool addPackets = retainedDrawList.Submit(i, isDirty[i] != 0u);
+				isDirty[i] = 0u;
+				AddObjectPackets(expected, objects[i], i);
+				if (addPackets)
+				{
+					for (uint32_t j{ 0u }; j < objects[i].NrOfStateKeys; ++j)
+					{
+						retainedDrawList.Add({ objects[i].StateKeys[j] | objects[i].DepthKey, i, DrawList::GetMeshIndex(objects[i].StateKeys[j]) });
+					}
+				}
+			}
+			retainedDrawList.Build(drawList);
+
+			const std::vector<DrawPacket>& packets = drawList.GetPackets();
+			isSorted &= std::is_sorted(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.SortKey < b.SortKey; });
+			isEqual &= HaveSamePackets(packets, expected.GetPackets());
+			areCountsEqual &= retainedDrawList.GetNrOfReusedPackets() + retainedDrawList.GetNrOfSortedPackets() == drawList.GetNrOfPackets();
+		}
+		TEST_CHECK(context, isSorted);
+		TEST_CHECK(context, isEqual);
+		TEST_CHECK(context, areCountsEqual);
+		//Only the changed, replaced and newly drawn objects had to be sorted.
+		TEST_CHECK(context, retainedDrawList.GetNrOfReusedPackets() > drawList.GetNrOfPackets() / 2u);
+
+		retainedDrawList.Clear();
+		retainedDrawList.BeginFrame();
+		retainedDrawList.Build(drawList);
+		TEST_CHECK(context, drawList.GetNrOfPackets() == 0u && retainedDrawList.GetNrOfRetainedPackets() == 0u);
+	}
+
+	void TestInstanceBatcher(TestContext& context) noexcept
+	{
+		std::vector<uint8_t> meshStorage(64u);
+		const std::vector<const Mesh*> meshes = MakeTestMeshes(meshStorage);
+		std::vector<InstanceData> objectInstances;
+		std::vector<InstanceData> instanceData;
+		std::vector<InstanceBatch> batches;
+		InstanceBatcher batcher;
+		DrawList drawList;
+
+		batcher.Build(objectInstances, drawList, meshes);
+		TEST_CHECK(context, batcher.GetBatches().empty() && batcher.GetInstanceData().empty() && batcher.GetNrOfDrawsBefore() == 0u);
+
+		//From a single packet to enough that every state is drawn many times, with objects drawn by several packets.
+		std::mt19937 generator(8u);
+		const uint32_t nrOfPackets[] = { 1u, 10u, 1000u, 20000u };
+		for (uint32_t count : nrOfPackets)
+		{
+			const uint32_t nrOfObjects = std::max(count / 4u, 1u);
+			MakeTestInstances(objectInstances, nrOfObjects);
+			AddRandomObjectPackets(drawList, count, nrOfObjects, generator);
+			batcher.Build(objectInstances, drawList, meshes);
+			GatherPerMesh(objectInstances, drawList, meshes, instanceData, batches);
+			TEST_CHECK(context, AreBatchesEqual(batcher, instanceData, batches));
+			TEST_CHECK(context, batcher.GetNrOfDrawsBefore() == count && batcher.GetNrOfDrawsAfter() == drawList.CountStateChanges() + 1u);
+		}
+
+		//Packets of one mesh on two pipelines are two draws.
+		MakeTestInstances(objectInstances, 4u);
+		drawList.Clear();
+		drawList.Add({ DrawList::MakeSortKey(0u, 5u, 1.0f, 1000.0f), 0u, 5u });
+		drawList.Add({ DrawList::MakeSortKey(0u, 5u, 2.0f, 1000.0f), 1u, 5u });
+		drawList.Add({ DrawList::MakeSortKey(1u, 5u, 1.0f, 1000.0f), 2u, 5u });
+		drawList.Add({ DrawList::MakeSortKey(1u, 5u, 3.0f, 1000.0f), 3u, 5u });
+		drawList.Sort();
+		batcher.Build(objectInstances, drawList, meshes);
+		const std::vector<InstanceBatch>& twoBatches = batcher.GetBatches();
+		TEST_CHECK(context, twoBatches.size() == 2u && twoBatches[0].InstanceOffset == 0u && twoBatches[0].InstanceCount == 2u && twoBatches[1].InstanceOffset == 2u && twoBatches[1].InstanceCount == 2u);
+		TEST_CHECK(context, twoBatches.size() == 2u && twoBatches[0].pMesh == meshes[5] && twoBatches[1].pMesh == meshes[5]);
+	}
+
+	void TestIndirectDrawRecords(TestContext& context) noexcept
+	{
+		//The stores fill the record the way the command signature reads it, and zero the draw's start locations and the padding.
+		IndirectDrawArguments record;
+		std::memset(&record, 0xff, sizeof(IndirectDrawArguments));
+		IndirectDrawBuilder::WriteRecord(0x1122334455667788u, 0x99aabbccddeeff00u, 0x0123456789abcdefu, 36u, 1000u, 24u, &record);
+
+		IndirectDrawArguments expected;
+		std::memset(&expected, 0, sizeof(IndirectDrawArguments));
+		expected.VertexBuffer = 0x1122334455667788u;
+		expected.IndexBuffer = 0x99aabbccddeeff00u;
+		expected.AmbientOcclusionBuffer = 0x0123456789abcdefu;
+		expected.InstanceOffset = 1000u;
+		expected.Draw.VertexCountPerInstance = 36u;
+		expected.Draw.InstanceCount = 24u;
+		TEST_CHECK(context, std::memcmp(&record, &expected, sizeof(IndirectDrawArguments)) == 0);
+
+		//Records next to each other are not touched.
+		IndirectDrawArguments records[3];
+		std::memset(records, 0xff, sizeof(records));
+		IndirectDrawBuilder::WriteRecord(1u, 2u, 3u, 4u, 5u, 6u, &records[1]);
+		const uint8_t* pFirst = reinterpret_cast<const uint8_t*>(&records[0]);
+		const uint8_t* pLast = reinterpret_cast<const uint8_t*>(&records[2]);
+		TEST_CHECK(context, std::all_of(pFirst, pFirst + sizeof(IndirectDrawArguments), [](uint8_t value) { return value == 0xffu; }));
+		TEST_CHECK(context, std::all_of(pLast, pLast + sizeof(IndirectDrawArguments), [](uint8_t value) { return value == 0xffu; }));
+		TEST_CHECK(context, records[1].Draw.InstanceCount == 6u && records[1].InstanceOffset == 5u && records[1].Draw.StartInstanceLocation == 0u);
+	}
+
+	//Culls a million boxes with the AVX2 kernel and with the scalar reference.
+	void BenchmarkFrustumCuller(uint32_t nrOfRuns) noexcept
+	{
+		const uint32_t nrOfBoxes = 1000000u;
+		std::mt19937 generator(1u);
+		FrustumCuller culler;
+		AddRandomBoxes(culler, nrOfBoxes, generator);
+		const FrustumPlanes frustum = GetTestFrustum();
+		std::vector<uint32_t> visibleIndices;
+		visibleIndices.reserve(nrOfBoxes);
+
+		double kernelTime = DBL_MAX;
+		double scalarTime = DBL_MAX;
+		for (uint32_t run{ 0u }; run < nrOfRuns; ++run)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			(void)culler.Cull(frustum);
+			kernelTime = std::min(kernelTime, GetElapsedTime(start));
+
+			start = std::chrono::high_resolution_clock::now();
+			(void)culler.CullScalar(frustum, visibleIndices);
+			scalarTime = std::min(scalarTime, GetElapsedTime(start));
+		}
+		printf("Frustum culling, %d boxes, %d visible\n", nrOfBoxes, culler.GetNrOfVisible());
+		printf("  AVX2: %.3f ms, scalar: %.3f ms, %.2fx\n", kernelTime, scalarTime, kernelTime > 0.0 ? scalarTime / kernelTime : 0.0);
+	}
+
+	//Sorts 100k packets with the radix sort and with std::stable_sort.
+	void BenchmarkDrawListSort(uint32_t nrOfRuns) noexcept
+	{
+		const uint32_t nrOfPackets = 100000u;
+		std::mt19937 generator(2u);
+		DrawList drawList;
+		double radixTime = DBL_MAX;
+		double stableSortTime = DBL_MAX;
+		for (uint32_t run{ 0u }; run < nrOfRuns; ++run)
+		{
+			AddRandomPackets(drawList, nrOfPackets, generator);
+			std::vector<DrawPacket> packets = drawList.GetPackets();
+			drawList.Sort();
+			radixTime = std::min(radixTime, drawList.GetSortTime());
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::stable_sort(packets.begin(), packets.end(), [](const DrawPacket& first, const DrawPacket& second) { return first.SortKey < second.SortKey; });
+			stableSortTime = std::min(stableSortTime, GetElapsedTime(start));
+		}
+		printf("Draw list sort, %d packets, %d state changes\n", nrOfPackets, drawList.CountStateChanges());
+		printf("  Radix: %.3f ms, std::stable_sort: %.3f ms, %.2fx\n", radixTime, stableSortTime, radixTime > 0.0 ? stableSortTime / radixTime : 0.0);
+	}
+
+	//Builds the sorted packets of 100k objects of which a tenth changes every frame, by adding and sorting all of them like
+	//before and through the retained list. Every object is drawn, the first frames that fill the retained list are not timed.
+	void BenchmarkRetainedDrawList(uint32_t nrOfRuns) noexcept
+	{
+		const uint32_t nrOfObjects = 100000u;
+		std::mt19937 generator(7u);
+		std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+		std::vector<RetainedObject> objects(nrOfObjects);
+		std::vector<uint8_t> hasChanged(nrOfObjects, 1u);
+		for (RetainedObject& object : objects)
+		{
+			RandomizeObject(object, generator);
+		}
+
+		RetainedDrawList retainedDrawList;
+		DrawList drawList;
+		DrawList sortedDrawList;
+		double sortTime = DBL_MAX;
+		double retainedTime = DBL_MAX;
+		for (uint32_t run{ 0u }; run < nrOfRuns + 2u; ++run)
+		{
+			for (uint32_t i{ 0u }; i < nrOfObjects && run > 0u; ++i)
+			{
+				if (distribution(generator) < 0.1f)
+				{
+					RandomizeObject(objects[i], generator);
+					hasChanged[i] = 1u;
+				}
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			sortedDrawList.Clear();
+			for (uint32_t i{ 0u }; i < nrOfObjects; ++i)
+			{
+				AddObjectPackets(sortedDrawList, objects[i], i);
+			}
+			sortedDrawList.Sort();
+			const double time = GetElapsedTime(start);
+
+			start = std::chrono::high_resolution_clock::now();
+			retainedDrawList.BeginFrame();
+			for (uint32_t i{ 0u }; i < nrOfObjects; ++i)
+			{
+				if (retainedDrawList.Submit(i, hasChanged[i] != 0u))
+				{
+					for (uint32_t j{ 0u }; j < objects[i].NrOfStateKeys; ++j)
+					{
+						retainedDrawList.Add({ objects[i].StateKeys[j] | objects[i].DepthKey, i, DrawList::GetMeshIndex(objects[i].StateKeys[j]) });
+					}
+				}
+				hasChanged[i] = 0u;
+			}
+			retainedDrawList.Build(drawList);
+			if (run >= 2u)
+			{
+				sortTime = std::min(sortTime, time);
+				retainedTime = std::min(retainedTime, GetElapsedTime(start));
+			}
+		}
+		printf("Retained draw list, %d objects, %d packets, a tenth of the objects changes every frame\n", nrOfObjects, drawList.GetNrOfPackets());
+		printf("  Add and sort all: %.3f ms, retained: %.3f ms (%d reused, %d sorted), %.2fx\n", sortTime, retainedTime, retainedDrawList.GetNrOfReusedPackets(), retainedDrawList.GetNrOfSortedPackets(), retainedTime > 0.0 ? sortTime / retainedTime : 0.0);
+	}
+
+	//Batches 100k sorted packets of 25k objects into instanced draws, against gathering the instances of every mesh on its own.
+	void BenchmarkInstanceBatcher(uint32_t nrOfRuns) noexcept
+	{
+		const uint32_t nrOfPackets = 100000u;
+		const uint32_t nrOfObjects = 25000u;
+		std::vector<uint8_t> meshStorage(64u);
+		const std::vector<const Mesh*> meshes = MakeTestMeshes(meshStorage);
+		std::vector<InstanceData> objectInstances;
+		MakeTestInstances(objectInstances, nrOfObjects);
+		std::mt19937 generator(9u);
+		DrawList drawList;
+		AddRandomObjectPackets(drawList, nrOfPackets, nrOfObjects, generator);
+
+		InstanceBatcher batcher;
+		std::vector<InstanceData> instanceData;
+		std::vector<InstanceBatch> batches;
+		double buildTime = DBL_MAX;
+		double perMeshTime = DBL_MAX;
+		for (uint32_t run{ 0u }; run < nrOfRuns; ++run)
+		{
+			batcher.Build(objectInstances, drawList, meshes);
+			buildTime = std::min(buildTime, batcher.GetBuildTime());
+
+			auto start = std::chrono::high_resolution_clock::now();
+			GatherPerMesh(objectInstances, drawList, meshes, instanceData, batches);
+			perMeshTime = std::min(perMeshTime, GetElapsedTime(start));
+		}
+		printf("Instance batching, %d packets of %d objects, %d draws before, %d after\n", nrOfPackets, nrOfObjects, batcher.GetNrOfDrawsBefore(), batcher.GetNrOfDrawsAfter());
+		printf("  Batcher on %d threads: %.3f ms, gather per mesh: %.3f ms%s\n", ThreadPool::Get().GetNrOfThreads(), buildTime, perMeshTime, AreBatchesEqual(batcher, instanceData, batches) ? "" : " MISMATCH");
+	}
+
+	//Writes the ExecuteIndirect records of 100k batches with the stores, on one thread and split like Build does,
+	//against assigning the members one by one.
+	void BenchmarkIndirectDrawRecords(uint32_t nrOfRuns) noexcept
+	{
+		const uint32_t nrOfRecords = 100000u;
+		std::vector<IndirectDrawArguments> records(nrOfRecords);
+		double storeTime = DBL_MAX;
+		double parallelStoreTime = DBL_MAX;
+		double assignTime = DBL_MAX;
+		for (uint32_t run{ 0u }; run < nrOfRuns; ++run)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i{ 0u }; i < nrOfRecords; ++i)
+			{
+				IndirectDrawBuilder::WriteRecord(0x10000ull * i, 0x20000ull * i, 0x30000ull * i, 36u, i, 1u + (i & 15u), &records[i]);
+			}
+			storeTime = std::min(storeTime, GetElapsedTime(start));
+
+			start = std::chrono::high_resolution_clock::now();
+			ThreadPool::Get().ParallelFor(nrOfRecords, 1024u, [&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t i{ begin }; i < end; ++i)
+					{
+						IndirectDrawBuilder::WriteRecord(0x10000ull * i, 0x20000ull * i, 0x30000ull * i, 36u, i, 1u + (i & 15u), &records[i]);
+					}
+				});
+			parallelStoreTime = std::min(parallelStoreTime, GetElapsedTime(start));
+
+			start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i{ 0u }; i < nrOfRecords; ++i)
+			{
+				IndirectDrawArguments& record = records[i];
+				record.VertexBuffer = 0x10000ull * i;
+				record.IndexBuffer = 0x20000ull * i;
+				record.AmbientOcclusionBuffer = 0x30000ull * i;
+				record.InstanceOffset = i;
+				record.Draw.VertexCountPerInstance = 36u;
+				record.Draw.InstanceCount = 1u + (i & 15u);
+				record.Draw.StartVertexLocation = 0u;
+				record.Draw.StartInstanceLocation = 0u;
+			}
+			assignTime = std::min(assignTime, GetElapsedTime(start));
+		}
+		printf("Indirect draw records, %d records\n", nrOfRecords);
+		printf("  Stores: %.3f ms, stores on %d threads: %.3f ms, member assignment: %.3f ms\n", storeTime, ThreadPool::Get().GetNrOfThreads(), parallelStoreTime, assignTime);
+	}
+}
+
+void RunDrawTests(TestContext& context) noexcept
+{
+	context.BeginGroup("FrustumCuller");
+	TestFrustumCuller(context);
+	context.BeginGroup("OcclusionCuller");
+	TestOcclusionCuller(context);
+	context.BeginGroup("DrawList");
+	TestDrawListKeys(context);
+	TestDrawListSort(context);
+	context.BeginGroup("RetainedDrawList");
+	TestRetainedDrawList(context);
+	context.BeginGroup("InstanceBatcher");
+	TestInstanceBatcher(context);
+	context.BeginGroup("IndirectDrawBuilder");
+	TestIndirectDrawRecords(context);
+}
+
+void RunDrawBenchmarks() noexcept
+{
+	const uint32_t nrOfRuns = 5u;
+	BenchmarkFrustumCuller(nrOfRuns);
+	BenchmarkDrawListSort(nrOfRuns);
+	BenchmarkRetainedDrawList(nrOfRuns);
+	BenchmarkInstanceBatcher(nrOfRuns);
+	BenchmarkIndirectDrawRecords(nrOfRuns);
+}
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "Tests.h"
+#include "LightClusterBuilder.h"
+
+namespace
+{
+	constexpr float s_NearZ = 0.1f;
+	constexpr float s_FarZ = 1000.0f;
+
+	//Lights spread over the frustum and a bit past it, so that some only reach into the clusters from the outside.
+	void MakeRandomLights(std::vector<PointLight>& lights, uint32_t count, float depth, std::mt19937& generator) noexcept
+	{
+		std::uniform_real_distribution<float> distributionXY(-depth, depth);
+		std::uniform_real_distribution<float> distributionZ(-0.1f * depth, depth);
+		std::uniform_real_distribution<float> distributionColor(0.05f, 1.0f);
+		lights.resize(count);
+		for (PointLight& light : lights)
+		{
+			light = {};
+			light.Position = { distributionXY(generator), distributionXY(generator), distributionZ(generator) };
+			light.Color = { distributionColor(generator), distributionColor(generator), distributionColor(generator) };
+			light.Radius = LightManager::ComputeRadius(light.Color, 0.05f);
+		}
+	}
+
+	//Every cluster's list is sorted, and the lists follow each other in cluster order.
+	[[nodiscard]] bool AreListsSorted(const LightClusterBuilder& builder, uint32_t nrOfLights) noexcept
+	{
+		const std::vector<LightRange>& ranges = builder.GetClusterRanges();
+		const std::vector<uint32_t>& indices = builder.GetLightIndices();
+		uint32_t offset = 0u;
+		for (const LightRange& range : ranges)
+		{
+			if (range.Offset != offset)
+				return false;
+			for (uint32_t i{ range.Offset }; i < range.Offset + range.Count; ++i)
+			{
+				if (indices[i] >= nrOfLights || (i > range.Offset && indices[i] <= indices[i - 1u]))
+					return false;
+			}
+			offset += range.Count;
+		}
+		return offset == indices.size();
+	}
+
+	[[nodiscard]] bool IsInside(const DirectX::XMFLOAT3& point, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, float epsilon) noexcept
+	{
+		return point.x >= min.x - epsilon && point.x <= max.x + epsilon && point.y >= min.y - epsilon && point.y <= max.y + epsilon && point.z >= min.z - epsilon && point.z <= max.z + epsilon;
+	}
+
+	void TestClusterBounds(TestContext& context, const LightClusterBuilder& builder, float projectionX, float projectionY) noexcept
+	{
+		//The pixel shader finds the cluster of a view space point from its screen position and the log of its depth.
+		//The point has to be inside the bounds the lights were tested against.
+		std::mt19937 generator(4u);
+		std::uniform_real_distribution<float> distributionNDC(-0.999f, 0.999f);
+		std::uniform_real_distribution<float> distributionLogDepth(std::log(s_NearZ), std::log(s_FarZ));
+		bool isInside = true;
+		for (uint32_t i{ 0u }; i < 10000u; ++i)
+		{
+			const float ndcX = distributionNDC(generator);
+			const float ndcY = distributionNDC(generator);
+			const float depth = std::exp(distributionLogDepth(generator));
+			const DirectX::XMFLOAT3 point = { ndcX * depth / projectionX, ndcY * depth / projectionY, depth };
+
+			const uint32_t x = std::min(static_cast<uint32_t>((ndcX * 0.5f + 0.5f) * LightClusterBuilder::s_DimX), LightClusterBuilder::s_DimX - 1u);
+			const uint32_t y = std::min(static_cast<uint32_t>((0.5f - ndcY * 0.5f) * LightClusterBuilder::s_DimY), LightClusterBuilder::s_DimY - 1u);
+			const float slice = std::log(depth) * builder.GetDepthScale() + builder.GetDepthBias();
+			const uint32_t z = std::min(static_cast<uint32_t>(std::max(slice, 0.0f)), LightClusterBuilder::s_DimZ - 1u);
+			const uint32_t clusterIndex = LightClusterBuilder::GetClusterIndex(x, y, z);
+			isInside &= IsInside(point, builder.GetClusterMin(clusterIndex), builder.GetClusterMax(clusterIndex), 1e-3f * depth);
+		}
+		TEST_CHECK(context, isInside);
+	}
+
+	void TestLightClusters(TestContext& context) noexcept
+	{
+		const float fovY = DirectX::XMConvertToRadians(45.0f);
+		DirectX::XMFLOAT4X4 projection;
+		DirectX::XMStoreFloat4x4(&projection, DirectX::XMMatrixPerspectiveFovLH(fovY, 16.0f / 9.0f, s_NearZ, s_FarZ));
+		LightClusterBuilder builder;
+		builder.SetProjection(projection._11, projection._22, s_NearZ, s_FarZ);
+		TestClusterBounds(context, builder, projection._11, projection._22);
+
+		DirectX::XMFLOAT4X4 view;
+		DirectX::XMStoreFloat4x4(&view, DirectX::XMMatrixIdentity());
+		std::vector<PointLight> lights;
+		builder.Build(view, lights);
+		TEST_CHECK(context, builder.GetLightIndices().empty() && builder.GetNrOfOccupiedClusters() == 0u);
+		TEST_CHECK(context, builder.GetClusterRanges().size() == LightClusterBuilder::s_NrOfClusters);
+
+		//Counts around the eight lights of a sweep, and enough lights that the clusters hold many each.
+		std::mt19937 generator(5u);
+		const uint32_t counts[] = { 1u, 7u, 8u, 9u, 100u, 1000u, 4096u };
+		for (uint32_t count : counts)
+		{
+			MakeRandomLights(lights, count, 200.0f, generator);
+			builder.Build(view, lights);
+			TEST_CHECK(context, builder.CountMismatches(view, lights) == 0u);
+			TEST_CHECK(context, AreListsSorted(builder, count));
+			TEST_CHECK(context, builder.GetNrOfOccupiedClusters() > 0u);
+		}
+
+		//The lights are moved into view space before they are assigned.
+		DirectX::XMStoreFloat4x4(&view, DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(30.0f, 10.0f, -50.0f, 1.0f), DirectX::XMVectorSet(0.0f, 0.0f, 100.0f, 1.0f), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		builder.Build(view, lights);
+		TEST_CHECK(context, builder.CountMismatches(view, lights) == 0u);
+		TEST_CHECK(context, AreListsSorted(builder, static_cast<uint32_t>(lights.size())));
+
+		//A light past the far plane or behind the camera reaches no cluster.
+		DirectX::XMStoreFloat4x4(&view, DirectX::XMMatrixIdentity());
+		lights.resize(2u);
+		lights[0].Position = { 0.0f, 0.0f, s_FarZ + 2.0f * lights[0].Radius };
+		lights[1].Position = { 0.0f, 0.0f, -2.0f * lights[1].Radius };
+		builder.Build(view, lights);
+		TEST_CHECK(context, builder.GetLightIndices().empty());
+	}
+}
+
+void RunLightClusterTests(TestContext& context) noexcept
+{
+	context.BeginGroup("LightClusterBuilder");
+	TestLightClusters(context);
+}
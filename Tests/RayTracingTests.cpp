@@ -0,0 +1,285 @@
+#include "pch.h"
+#include "Tests.h"
+#include "TLASUpdatePolicy.h"
+#include "TLASInstancePacker.h"
+#include "BLASBuildPlanner.h"
+#include "BLASCompactor.h"
+
+namespace
+{
+	void MakeRandomTransforms(std::vector<DirectX::XMFLOAT4X4>& transforms, uint32_t count, std::mt19937& generator) noexcept
+	{
+		std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+		transforms.resize(count);
+		for (DirectX::XMFLOAT4X4& transform : transforms)
+		{
+			for (uint32_t row{ 0u }; row < 4u; ++row)
+			{
+				for (uint32_t column{ 0u }; column < 4u; ++column)
+				{
+					transform.m[row][column] = distribution(generator);
+				}
+			}
+		}
+	}
+
+	//The description holds the first three rows of the transposed world matrix.
+	[[nodiscard]] bool IsPackedTransform(const D3D12_RAYTRACING_INSTANCE_DESC& instanceDesc, const DirectX::XMFLOAT4X4& transform) noexcept
+	{
+		bool isEqual = true;
+		for (uint32_t row{ 0u }; row < 3u; ++row)
+		{
+			for (uint32_t column{ 0u }; column < 4u; ++column)
+			{
+				isEqual &= instanceDesc.Transform[row][column] == transform.m[column][row];
+			}
+		}
+		return isEqual;
+	}
+
+	void TestTLASUpdatePolicy(TestContext& context) noexcept
+	{
+		TLASUpdatePolicy policy(3u);
+		const TLASBuildReason expectedReasons[] =
+		{
+			TLASBuildReason::FIRST_BUILD, TLASBuildReason::REFIT, TLASBuildReason::REFIT, TLASBuildReason::REFIT, TLASBuildReason::UPDATE_LIMIT_REACHED,
+			TLASBuildReason::REFIT, TLASBuildReason::INSTANCE_COUNT_CHANGED, TLASBuildReason::INVALIDATED, TLASBuildReason::REFIT
+		};
+		const uint32_t instanceCounts[] = { 10u, 10u, 10u, 10u, 10u, 10u, 11u, 11u, 11u };
+		bool isExpected = true;
+		for (uint32_t frame{ 0u }; frame < 9u; ++frame)
+		{
+			if (frame == 7u)
+			{
+				policy.Invalidate();
+			}
+			const TLASBuildDecision& decision = policy.Decide(instanceCounts[frame]);
+			const TLASBuildType expectedType = expectedReasons[frame] == TLASBuildReason::REFIT ? TLASBuildType::UPDATE : TLASBuildType::BUILD;
+			isExpected &= decision.Reason == expectedReasons[frame] && decision.Type == expectedType && decision.FrameNumber == frame && decision.NrOfInstances == instanceCounts[frame];
+		}
+		TEST_CHECK(context, isExpected);
+		TEST_CHECK(context, policy.GetNrOfBuilds() == 4u && policy.GetNrOfUpdates() == 5u);
+		TEST_CHECK(context, policy.GetLastDecision().NrOfUpdatesSinceBuild == 1u);
+
+		//An invalidation wins over a changed instance count.
+		policy.Invalidate();
+		TEST_CHECK(context, policy.Decide(12u).Reason == TLASBuildReason::INVALIDATED);
+
+		//The log keeps the last decisions, oldest first.
+		for (uint32_t frame{ 0u }; frame < TLASUpdatePolicy::s_DecisionLogSize; ++frame)
+		{
+			(void)policy.Decide(12u);
+		}
+		const std::deque<TLASBuildDecision>& log = policy.GetDecisionLog();
+		TEST_CHECK(context, log.size() == TLASUpdatePolicy::s_DecisionLogSize);
+		TEST_CHECK(context, log.front().FrameNumber == 10u && log.back().FrameNumber == 9u + TLASUpdatePolicy::s_DecisionLogSize);
+		TEST_CHECK(context, std::string(TLASUpdatePolicy::GetReasonName(TLASBuildReason::UPDATE_LIMIT_REACHED)) == "Update limit reached");
+	}
+
+	void TestTLASBuildDescription(TestContext& context) noexcept
+	{
+		//Every build allows the updates after it, only updates perform one.
+		const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = TLASUpdatePolicy::GetBuildFlags(TLASBuildType::BUILD);
+		const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS updateFlags = TLASUpdatePolicy::GetBuildFlags(TLASBuildType::UPDATE);
+		TEST_CHECK(context, (buildFlags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE) != 0 && (buildFlags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE) == 0);
+		TEST_CHECK(context, (updateFlags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE) != 0 && (updateFlags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE) != 0);
+
+		TLASBuildDecision decision = {};
+		decision.NrOfInstances = 42u;
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC description = {};
+		TLASUpdatePolicy::FillBuildDescription(decision, 0x1000u, 0x2000u, 0x3000u, description);
+		TEST_CHECK(context, description.Inputs.Type == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL && description.Inputs.NumDescs == 42u);
+		TEST_CHECK(context, description.Inputs.InstanceDescs == 0x1000u && description.DestAccelerationStructureData == 0x2000u && description.ScratchAccelerationStructureData == 0x3000u);
+		TEST_CHECK(context, description.SourceAccelerationStructureData == 0u && description.Inputs.Flags == buildFlags);
+
+		decision.Type = TLASBuildType::UPDATE;
+		TLASUpdatePolicy::FillBuildDescription(decision, 0x1000u, 0x2000u, 0x3000u, description);
+		TEST_CHECK(context, description.SourceAccelerationStructureData == 0x2000u && description.Inputs.Flags == updateFlags);
+	}
+
+	void TestTLASInstancePacker(TestContext& context) noexcept
+	{
+		//Odd counts also go through the single matrix tail.
+		std::mt19937 generator(3u);
+		const uint32_t counts[] = { 1u, 2u, 3u, 4097u };
+		for (uint32_t count : counts)
+		{
+			std::vector<DirectX::XMFLOAT4X4> transforms;
+			MakeRandomTransforms(transforms, count, generator);
+			std::vector<const DirectX::XMFLOAT4X4*> pTransforms(count);
+			std::vector<uint32_t> versions(count, 0u);
+			for (uint32_t i{ 0u }; i < count; ++i)
+			{
+				pTransforms[i] = &transforms[i];
+			}
+
+			//The rest of the description is left as it was.
+			std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs(count);
+			std::memset(instanceDescs.data(), 0xab, sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * count);
+			TLASInstancePacker packer;
+			packer.Reset(count);
+			TEST_CHECK(context, packer.Pack(pTransforms.data(), versions.data(), count, instanceDescs.data()) == count);
+			bool isPacked = true;
+			bool isUntouched = true;
+			for (uint32_t i{ 0u }; i < count; ++i)
+			{
+				isPacked &= IsPackedTransform(instanceDescs[i], transforms[i]);
+				const uint8_t* pRest = reinterpret_cast<const uint8_t*>(&instanceDescs[i]) + sizeof(float) * 12u;
+				isUntouched &= std::all_of(pRest, pRest + sizeof(D3D12_RAYTRACING_INSTANCE_DESC) - sizeof(float) * 12u, [](uint8_t value) { return value == 0xabu; });
+			}
+			TEST_CHECK(context, isPacked && isUntouched);
+
+			//Only the instances with a new version are written again.
+			TEST_CHECK(context, packer.Pack(pTransforms.data(), versions.data(), count, instanceDescs.data()) == 0u);
+			MakeRandomTransforms(transforms, count, generator);
+			uint32_t nrOfChanged = 0u;
+			for (uint32_t i{ 0u }; i < count; i += 3u)
+			{
+				versions[i]++;
+				nrOfChanged++;
+			}
+			TEST_CHECK(context, packer.Pack(pTransforms.data(), versions.data(), count, instanceDescs.data()) == nrOfChanged);
+			bool isRepacked = true;
+			for (uint32_t i{ 0u }; i < count; ++i)
+			{
+				isRepacked &= IsPackedTransform(instanceDescs[i], transforms[i]) == (i % 3u == 0u);
+			}
+			TEST_CHECK(context, isRepacked);
+		}
+	}
+
+	void TestBLASBuildPlanner(TestContext& context) noexcept
+	{
+		BLASBuildPlanner emptyPlanner;
+		emptyPlanner.Plan();
+		TEST_CHECK(context, emptyPlanner.GetNrOfBatches() == 0u && emptyPlanner.GetScratchBufferSize() == 0u);
+
+		//Sizes are aligned, the third build does not fit the rest of the budget and the fourth is larger than the budget on its own.
+		BLASBuildPlanner planner(1024u);
+		planner.Add(100u, 300u);
+		planner.Add(256u, 512u);
+		planner.Add(1u, 512u);
+		planner.Add(1000u, 2000u);
+		planner.Add(1u, 1u);
+		planner.Plan();
+		TEST_CHECK(context, BLASBuildPlanner::AlignUp(1u) == 256u && BLASBuildPlanner::AlignUp(256u) == 256u && BLASBuildPlanner::AlignUp(257u) == 512u);
+		TEST_CHECK(context, planner.GetNrOfBatches() == 4u);
+		TEST_CHECK(context, planner.GetPlacement(0u).Batch == 0u && planner.GetPlacement(1u).Batch == 0u && planner.GetPlacement(1u).ScratchOffset == 512u);
+		TEST_CHECK(context, planner.GetPlacement(2u).Batch == 1u && planner.GetPlacement(2u).ScratchOffset == 0u);
+		TEST_CHECK(context, planner.GetPlacement(3u).Batch == 2u && planner.GetPlacement(4u).Batch == 3u);
+		TEST_CHECK(context, planner.GetPlacement(3u).ResultOffset == 768u && planner.GetResultBufferSize() == 2048u);
+		TEST_CHECK(context, planner.GetScratchBufferSize() == 2048u && planner.GetUnpooledScratchSize() == 3840u);
+
+		//Builds in the same batch never share scratch memory.
+		bool isDisjoint = true;
+		for (uint32_t i{ 0u }; i < planner.GetNrOfBuilds(); ++i)
+		{
+			for (uint32_t j{ i + 1u }; j < planner.GetNrOfBuilds(); ++j)
+			{
+				const BLASBuildPlacement& first = planner.GetPlacement(i);
+				const BLASBuildPlacement& second = planner.GetPlacement(j);
+				isDisjoint &= first.Batch != second.Batch || first.ScratchOffset != second.ScratchOffset;
+			}
+		}
+		TEST_CHECK(context, isDisjoint);
+
+		const uint64_t sizes[3] = { 10u, 300u, 256u };
+		uint64_t offsets[3] = {};
+		TEST_CHECK(context, BLASBuildPlanner::PlaceBuffers(sizes, 3u, offsets) == 1024u && offsets[1] == 256u && offsets[2] == 768u);
+	}
+
+	void TestBLASCompactor(TestContext& context) noexcept
+	{
+		BLASCompactor compactor(4096u);
+		compactor.Add("Sphere", 65536u, 8192u);
+		compactor.Add("Cube", 8192u, 1024u);
+		compactor.Add("Sphere", 32768u, 4096u);
+		TEST_CHECK(context, BLASCompactor::GetPostbuildInfoOffset(2u) == 16u && compactor.GetPostbuildInfoSize() == 24u);
+		TEST_CHECK(context, !compactor.ShouldCompact(0u));
+
+		//The cube saves less than the minimum and is kept as it is.
+		const uint64_t compactedSizes[3] = { 16384u, 6144u, 28672u };
+		TEST_CHECK(context, compactor.SetCompactedSizes(compactedSizes, 3u) == 2u);
+		TEST_CHECK(context, compactor.GetStage(1u) == BLASStage::SIZE_KNOWN && compactor.GetResultBytes(0u) == 65536u);
+		BLASMemoryReportEntry totals = compactor.GetMemoryTotals();
+		TEST_CHECK(context, totals.ScratchBytesAfter == 13312u);
+
+		compactor.FinishCompaction();
+		TEST_CHECK(context, compactor.GetStage(0u) == BLASStage::COMPACTED && compactor.GetStage(1u) == BLASStage::KEPT && compactor.GetStage(2u) == BLASStage::COMPACTED);
+		TEST_CHECK(context, compactor.GetResultBytes(0u) == 16384u && compactor.GetResultBytes(1u) == 8192u);
+
+		const std::vector<BLASMemoryReportEntry> report = compactor.GetMemoryReport();
+		TEST_CHECK(context, report.size() == 2u && report[0].ModelName == "Cube" && report[1].ModelName == "Sphere");
+		TEST_CHECK(context, report[1].NrOfStructures == 2u && report[1].ResultBytesBefore == 98304u && report[1].ResultBytesAfter == 45056u);
+		totals = compactor.GetMemoryTotals();
+		TEST_CHECK(context, totals.ResultBytesAfter == 53248u && totals.ScratchBytesBefore == 13312u && totals.ScratchBytesAfter == 0u);
+	}
+}
+
+void RunRayTracingTests(TestContext& context) noexcept
+{
+	context.BeginGroup("TLASUpdatePolicy");
+	TestTLASUpdatePolicy(context);
+	TestTLASBuildDescription(context);
+	context.BeginGroup("TLASInstancePacker");
+	TestTLASInstancePacker(context);
+	context.BeginGroup("BLASBuildPlanner");
+	TestBLASBuildPlanner(context);
+	context.BeginGroup("BLASCompactor");
+	TestBLASCompactor(context);
+}
+
+//Times writing the instance transforms with the packer, against transposing every matrix into a copy of the descriptions
+//and copying all of them to the upload buffer, for all instances and for a tenth of them changed.
+void RunRayTracingBenchmarks() noexcept
+{
+	const uint32_t nrOfInstances = 100000u;
+	const uint32_t nrOfRuns = 5u;
+	std::mt19937 generator(3u);
+	std::vector<DirectX::XMFLOAT4X4> transforms;
+	MakeRandomTransforms(transforms, nrOfInstances, generator);
+	std::vector<const DirectX::XMFLOAT4X4*> pTransforms(nrOfInstances);
+	for (uint32_t i{ 0u }; i < nrOfInstances; ++i)
+	{
+		pTransforms[i] = &transforms[i];
+	}
+	std::vector<uint32_t> versions(nrOfInstances, 0u);
+	std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs(nrOfInstances);
+	std::vector<D3D12_RAYTRACING_INSTANCE_DESC> uploadBuffer(nrOfInstances);
+
+	double copyTime = DBL_MAX;
+	double packTime = DBL_MAX;
+	double changedPackTime = DBL_MAX;
+	TLASInstancePacker packer;
+	for (uint32_t run{ 0u }; run < nrOfRuns; ++run)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i{ 0u }; i < nrOfInstances; ++i)
+		{
+			DirectX::XMFLOAT4X4 transposed;
+			DirectX::XMStoreFloat4x4(&transposed, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(pTransforms[i])));
+			for (uint32_t row{ 0u }; row < 3u; ++row)
+			{
+				for (uint32_t column{ 0u }; column < 4u; ++column)
+				{
+					instanceDescs[i].Transform[row][column] = transposed.m[row][column];
+				}
+			}
+		}
+		std::memcpy(uploadBuffer.data(), instanceDescs.data(), sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * nrOfInstances);
+		copyTime = std::min(copyTime, GetElapsedTime(start));
+
+		packer.Reset(nrOfInstances);
+		(void)packer.Pack(pTransforms.data(), versions.data(), nrOfInstances, uploadBuffer.data());
+		packTime = std::min(packTime, packer.GetPackTime());
+
+		for (uint32_t i{ run }; i < nrOfInstances; i += 10u)
+		{
+			versions[i]++;
+		}
+		(void)packer.Pack(pTransforms.data(), versions.data(), nrOfInstances, uploadBuffer.data());
+		changedPackTime = std::min(changedPackTime, packer.GetPackTime());
+	}
+	printf("TLAS instance transforms, %d instances\n", nrOfInstances);
+	printf("  Transpose and copy: %.3f ms, packer: %.3f ms, %.2fx, packer with a tenth changed: %.3f ms\n", copyTime, packTime, packTime > 0.0 ? copyTime / packTime : 0.0, changedPackTime);
+}
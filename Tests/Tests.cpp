@@ -0,0 +1,69 @@
+#include "pch.h"
+#include "Tests.h"
+#include "ThreadPool.h"
+
+void TestContext::BeginGroup(const char* pName) noexcept
+{
+	EndGroup();
+	m_pGroupName = pName;
+	m_NrOfGroupChecks = 0u;
+	m_NrOfGroupFailed = 0u;
+}
+
+void TestContext::EndGroup() noexcept
+{
+	if (!m_pGroupName)
+		return;
+
+	printf("%s: %d checks%s\n", m_pGroupName, m_NrOfGroupChecks, m_NrOfGroupFailed == 0u ? ", passed" : "");
+	if (m_NrOfGroupFailed > 0u)
+	{
+		printf("  %d FAILED\n", m_NrOfGroupFailed);
+	}
+	m_pGroupName = nullptr;
+}
+
+bool TestContext::Check(bool passed, const char* pExpression, const char* pFile, uint32_t line) noexcept
+{
+	m_NrOfChecks++;
+	m_NrOfGroupChecks++;
+	if (!passed)
+	{
+		m_NrOfFailed++;
+		m_NrOfGroupFailed++;
+		printf("  Failed: %s\n    %s(%d)\n", pExpression, pFile, line);
+	}
+	return passed;
+}
+
+//Runs every test and returns 1 if any check failed. -benchmark runs the benchmarks after the tests.
+int main(int argc, char** argv)
+{
+	bool runBenchmarks = false;
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		runBenchmarks |= std::string(argv[i]) == "-benchmark";
+	}
+
+	ThreadPool::Get().Initialize();
+	printf("%d threads\n", ThreadPool::Get().GetNrOfThreads());
+
+	TestContext context;
+	RunCommandTests(context);
+	RunDrawTests(context);
+	RunRayTracingTests(context);
+	RunLightClusterTests(context);
+	RunBVHTests(context);
+	context.EndGroup();
+	printf("%d checks, %d failed\n", context.GetNrOfChecks(), context.GetNrOfFailed());
+
+	if (runBenchmarks)
+	{
+		RunDrawBenchmarks();
+		RunCommandBenchmarks();
+		RunRayTracingBenchmarks();
+	}
+
+	ThreadPool::Get().OnShutDown();
+	return context.GetNrOfFailed() == 0u ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+//Counts the checks of the tests and prints the ones that fail with where they are.
+//The checks run in every configuration, unlike DBG_ASSERT, so the tests also cover the release builds of the systems.
+class TestContext
+{
+public:
+	TestContext() noexcept = default;
+	~TestContext() noexcept = default;
+
+	//Starts a group of checks, printed with its number of failures when the next group starts or the run ends.
+	void BeginGroup(const char* pName) noexcept;
+	void EndGroup() noexcept;
+	bool Check(bool passed, const char* pExpression, const char* pFile, uint32_t line) noexcept;
+
+	[[nodiscard]] constexpr uint32_t GetNrOfChecks() const noexcept { return m_NrOfChecks; }
+	[[nodiscard]] constexpr uint32_t GetNrOfFailed() const noexcept { return m_NrOfFailed; }
+private:
+	const char* m_pGroupName = nullptr;
+	uint32_t m_NrOfGroupChecks = 0u;
+	uint32_t m_NrOfGroupFailed = 0u;
+	uint32_t m_NrOfChecks = 0u;
+	uint32_t m_NrOfFailed = 0u;
+};
+
+#define TEST_CHECK(context, expression) (context).Check((expression), #expression, __FILE__, __LINE__)
+
+//Milliseconds since start, the way the systems time themselves.
+[[nodiscard]] inline double GetElapsedTime(std::chrono::high_resolution_clock::time_point start) noexcept
+{
+	auto dif = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+	return static_cast<double>(dif.count()) * 0.001;
+}
+
+//Every file covers the systems of one part of the renderer that run without a device, against mocks or brute force references.
+//The benchmarks time the CPU side of the same systems at the sizes of large scenes.
+void RunCommandTests(TestContext& context) noexcept;
+void RunCommandBenchmarks() noexcept;
+void RunDrawTests(TestContext& context) noexcept;
+void RunDrawBenchmarks() noexcept;
+void RunRayTracingTests(TestContext& context) noexcept;
+void RunRayTracingBenchmarks() noexcept;
+void RunLightClusterTests(TestContext& context) noexcept;
+void RunBVHTests(TestContext& context) noexcept;
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+ThreadPool ThreadPool::s_Instance;
+
+namespace
+{
+	thread_local uint32_t t_ThreadIndex = 0u;
+}
+
+ThreadPool& ThreadPool::Get() noexcept
+{
+	return s_Instance;
+}
+
+ThreadPool::~ThreadPool() noexcept
+{
+	OnShutDown();
+}
+
+void ThreadPool::Initialize(uint32_t nrOfWorkers) noexcept
+{
+	DBG_ASSERT(m_Workers.empty(), "The thread pool is already initialized.");
+
+	if (nrOfWorkers == 0u)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		nrOfWorkers = hardwareThreads > 1u ? hardwareThreads - 1u : 1u;
+	}
+
+	m_ShuttingDown = false;
+	m_OwnerThread = std::this_thread::get_id();
+	m_Workers.reserve(nrOfWorkers);
+	for (uint32_t i{ 0u }; i < nrOfWorkers; ++i)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i + 1u);
+	}
+}
+
+void ThreadPool::OnShutDown() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(m_TaskMutex);
+		m_ShuttingDown = true;
+	}
+	m_TaskCondition.notify_all();
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+	m_Workers.clear();
+}
+
+void ThreadPool::Submit(std::function<void()> task, TaskCounter& counter) noexcept
+{
+	counter.Pending.fetch_add(1u, std::memory_order_relaxed);
+
+	//Without workers the task is executed right away.
+	if (m_Workers.empty())
+	{
+		task();
+		counter.Pending.fetch_sub(1u, std::memory_order_release);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_TaskMutex);
+		m_Tasks.push_back({ std::move(task), &counter });
+	}
+	m_TaskCondition.notify_one();
+}
+
+void ThreadPool::Wait(TaskCounter& counter) noexcept
+{
+	while (counter.Pending.load(std::memory_order_acquire) > 0u)
+	{
+		if (!TryExecuteTask())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void ThreadPool::ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& function) noexcept
+{
+	if (count == 0u)
+		return;
+
+	grainSize = std::max(grainSize, 1u);
+	if (count <= grainSize || m_Workers.empty())
+	{
+		function(0u, count);
+		return;
+	}
+
+	TaskCounter counter;
+	for (uint32_t begin{ grainSize }; begin < count; begin += grainSize)
+	{
+		uint32_t end = std::min(begin + grainSize, count);
+		Submit([&function, begin, end]() { function(begin, end); }, counter);
+	}
+	//The first range is executed here instead of sitting idle.
+	function(0u, grainSize);
+	Wait(counter);
+}
+
+uint32_t ThreadPool::GetThreadIndex() noexcept
+{
+	return t_ThreadIndex;
+}
+
+bool ThreadPool::IsPoolThread() const noexcept
+{
+	return t_ThreadIndex != 0u || std::this_thread::get_id() == m_OwnerThread;
+}
+
+void ThreadPool::WorkerLoop(uint32_t threadIndex) noexcept
+{
+	t_ThreadIndex = threadIndex;
+	while (true)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(m_TaskMutex);
+			m_TaskCondition.wait(lock, [this]() { return m_ShuttingDown || !m_Tasks.empty(); });
+			if (m_Tasks.empty())
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+		task.Function();
+		task.pCounter->Pending.fetch_sub(1u, std::memory_order_release);
+	}
+}
+
+bool ThreadPool::TryExecuteTask() noexcept
+{
+	Task task;
+	{
+		std::lock_guard<std::mutex> lock(m_TaskMutex);
+		if (m_Tasks.empty())
+			return false;
+
+		task = std::move(m_Tasks.front());
+		m_Tasks.pop_front();
+	}
+	{
+		//The task has nothing to do with the scopes the waiting thread has open, so its own scopes start at the root.
+		ProfileScope taskScope{ Profiler::s_pTaskName };
+		task.Function();
+	}
+	task.pCounter->Pending.fetch_sub(1u, std::memory_order_release);
+	return true;
+}
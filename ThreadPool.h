@@ -0,0 +1,51 @@
+#pragma once
+
+//Counts the tasks that are still pending. Used to wait for a group of tasks.
+struct TaskCounter
+{
+	std::atomic<uint32_t> Pending = 0u;
+};
+
+//Pool of worker threads that the CPU side systems (culling, sorting, building) split their work over.
+//Threads that wait for a task group help out by executing queued tasks, so work can be submitted from inside a task.
+class ThreadPool
+{
+public:
+	[[nodiscard]] static ThreadPool& Get() noexcept;
+	//Starts the workers. 0 uses one worker per hardware thread except the calling one.
+	void Initialize(uint32_t nrOfWorkers = 0u) noexcept;
+	void OnShutDown() noexcept;
+
+	void Submit(std::function<void()> task, TaskCounter& counter) noexcept;
+	//Executes queued tasks until all tasks of the counter have finished.
+	void Wait(TaskCounter& counter) noexcept;
+	//Splits [0, count) into ranges of at most grainSize and calls function(begin, end) for each of them.
+	//The calling thread takes part in the work and the function returns when all ranges are done.
+	void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& function) noexcept;
+
+	//Number of threads that can execute tasks, including the calling thread.
+	[[nodiscard]] uint32_t GetNrOfThreads() const noexcept { return static_cast<uint32_t>(m_Workers.size()) + 1u; }
+	//0 for the thread that owns the pool, 1 to GetNrOfThreads() - 1 for the workers. Threads outside the pool get 0 as well.
+	[[nodiscard]] static uint32_t GetThreadIndex() noexcept;
+	//True for the workers and the thread that initialized the pool, the threads whose index is their own.
+	[[nodiscard]] bool IsPoolThread() const noexcept;
+private:
+	ThreadPool() noexcept = default;
+	~ThreadPool() noexcept;
+	void WorkerLoop(uint32_t threadIndex) noexcept;
+	bool TryExecuteTask() noexcept;
+private:
+	struct Task
+	{
+		std::function<void()> Function;
+		TaskCounter* pCounter = nullptr;
+	};
+
+	static ThreadPool s_Instance;
+	std::vector<std::thread> m_Workers = {};
+	std::deque<Task> m_Tasks = {};
+	std::mutex m_TaskMutex;
+	std::condition_variable m_TaskCondition;
+	bool m_ShuttingDown = false;
+	std::thread::id m_OwnerThread = {};
+};
@@ -31,7 +31,10 @@ void VertexObject::Initialize(
 	DirectX::XMMATRIX tempScaleMatrix = {};
 	tempScaleMatrix = DirectX::XMMatrixScalingFromVector(DirectX::XMVectorSet(scale, scale, scale, 1.0f));
 	DirectX::XMStoreFloat4x4(&m_Transform, tempScaleMatrix * tempRotMatrix * tempPosMatrix);
-	SetConstantBufferView(std::move(MemoryManager::Get().CreateConstantBuffer("Transforms", "ShaderBindables", "TransformsRange", sizeof(DirectX::XMFLOAT4X4))));
+	m_Versions.Transform++;
+	m_Versions.Color++;
+	m_Versions.Mesh++;
+	UpdateWorldBounds();
 }
 
 void VertexObject::Update(float deltaTime)
@@ -40,6 +43,10 @@ void VertexObject::Update(float deltaTime)
 
 	auto m = DirectX::XMLoadFloat4x4(&m_Transform);
 
+	//Static objects keep their transform, and with it their cached world bounds.
+	if (m_UpdateType == NONE)
+		return;
+
 	DirectX::XMVECTOR scale;
 	DirectX::XMVECTOR rotationQuat;
 	DirectX::XMVECTOR translation;
@@ -95,7 +102,31 @@ void VertexObject::Update(float deltaTime)
 	DirectX::XMFLOAT4X4 tempTransform;
 	DirectX::XMStoreFloat4x4(&tempTransform, m);
 	SetTransform(tempTransform);
+}
+
+void VertexObject::SetTransform(const DirectX::XMFLOAT4X4& transform) noexcept
+{
+	m_Transform = transform;
+	m_Versions.Transform++;
+	UpdateWorldBounds();
+}
+
+void VertexObject::SetColor(const DirectX::XMFLOAT4& color) noexcept
+{
+	m_Color = color;
+	m_Versions.Color++;
+}
 
-	m = DirectX::XMMatrixTranspose(m);
-	MemoryManager::Get().UpdateConstantBuffer(m_TransformConstantBufferView, &m, sizeof(DirectX::XMFLOAT4X4));
+void VertexObject::SetModel(std::shared_ptr<Model> objectModel) noexcept
+{
+	m_pModel = std::move(objectModel);
+	m_Versions.Mesh++;
+	UpdateWorldBounds();
 }
+
+void VertexObject::UpdateWorldBounds() noexcept
+{
+	DirectX::XMMATRIX transform = DirectX::XMLoadFloat4x4(&m_Transform);
+	m_pModel->GetBoundingBox().Transform(m_WorldBoundingBox, transform);
+	m_pModel->GetBoundingSphere().Transform(m_WorldBoundingSphere, transform);
+}
\ No newline at end of file
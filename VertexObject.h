@@ -10,6 +10,14 @@ enum UpdateType
 	MOVEBACKANDFORTH
 };
 
+//Each counter is bumped when that part of the object changes, so that data cached from the object can tell when it is stale.
+struct ObjectVersions
+{
+	uint32_t Transform = 0u;
+	uint32_t Color = 0u;
+	uint32_t Mesh = 0u;
+};
+
 class VertexObject
 {
 public:
@@ -29,16 +37,33 @@ public:
 
 	const DirectX::XMFLOAT4X4& GetTransform() const { return m_Transform; }
 	const std::shared_ptr<Model>& GetModel() const { return m_pModel; }
-	void SetTransform(const DirectX::XMFLOAT4X4& transform) noexcept { m_Transform = transform; }
-	[[nodiscard]] constexpr ConstantBufferView& GetTransformConstantBufferView() { return m_TransformConstantBufferView; }
-	[[nodiscard]] constexpr DirectX::XMFLOAT4& GetColor() { return m_Color; }
+	[[nodiscard]] const DirectX::BoundingBox& GetWorldBoundingBox() const noexcept { return m_WorldBoundingBox; }
+	[[nodiscard]] const DirectX::BoundingSphere& GetWorldBoundingSphere() const noexcept { return m_WorldBoundingSphere; }
+	void SetTransform(const DirectX::XMFLOAT4X4& transform) noexcept;
+	void SetColor(const DirectX::XMFLOAT4& color) noexcept;
+	//Swaps the model, for example when switching level of detail.
+	void SetModel(std::shared_ptr<Model> objectModel) noexcept;
+	[[nodiscard]] const DirectX::XMFLOAT4& GetColor() const noexcept { return m_Color; }
+	[[nodiscard]] const ObjectVersions& GetVersions() const noexcept { return m_Versions; }
+	[[nodiscard]] constexpr bool IsStatic() const noexcept { return m_UpdateType == NONE; }
+	//Slot of the object in the renderer's draw packet cache.
+	[[nodiscard]] constexpr uint32_t GetDrawCacheIndex() const noexcept { return m_DrawCacheIndex; }
+	void SetDrawCacheIndex(uint32_t drawCacheIndex) noexcept { m_DrawCacheIndex = drawCacheIndex; }
+	//Index of the object in the scene's object list, set every time the scene gathers its objects.
+	[[nodiscard]] constexpr uint32_t GetSceneIndex() const noexcept { return m_SceneIndex; }
+	void SetSceneIndex(uint32_t sceneIndex) noexcept { m_SceneIndex = sceneIndex; }
 private:
-	void SetConstantBufferView(const ConstantBufferView& transformBuffer) noexcept { m_TransformConstantBufferView = transformBuffer; }
+	void UpdateWorldBounds() noexcept;
 private:
 	DirectX::XMFLOAT4 m_Color = {};
 	DirectX::XMFLOAT4X4 m_Transform = {};
-	ConstantBufferView m_TransformConstantBufferView;
+	//Cached world space bounds of the model, only recalculated when the transform changes.
+	DirectX::BoundingBox m_WorldBoundingBox = {};
+	DirectX::BoundingSphere m_WorldBoundingSphere = {};
 	std::shared_ptr<Model> m_pModel = nullptr;
+	ObjectVersions m_Versions = {};
+	uint32_t m_DrawCacheIndex = UINT32_MAX;
+	uint32_t m_SceneIndex = UINT32_MAX;
 	UpdateType m_UpdateType = SPIN;
 	bool resizeFlag = false;
 
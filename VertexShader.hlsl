@@ -4,15 +4,35 @@ struct Vertex
     float3 inNormal;
 };
 
+struct InstanceData
+{
+    matrix worldMatrix;
+    float4 color;
+    //Range of the light indices of the object.
+    uint lightOffset;
+    uint nrOfLights;
+    //Row of the baked light visibility, see the pixel shader.
+    uint visibilityOffset;
+    uint nrOfVisibilityLights;
+};
+
 struct VS_OUT
 {
     float4 outPositionCS    : SV_Position;
     float4 outPosWorld      : POSWORLD;
     float3 outNormal        : NORMAL;
+    nointerpolation float4 outColor : COLOR;
+    float outAmbientOcclusion : AMBIENTOCCLUSION;
+    nointerpolation uint2 outLights : LIGHTS;
+    nointerpolation uint2 outVisibility : VISIBILITY;
+    float outViewDepth : VIEWDEPTH;
 };
 
 StructuredBuffer<Vertex> vertices : register(t0, space0);
 StructuredBuffer<unsigned int> indices: register(t1, space0);
+StructuredBuffer<InstanceData> instances : register(t2, space0);
+//Baked ambient occlusion, one byte per vertex.
+ByteAddressBuffer ambientOcclusion : register(t3, space0);
 
 struct VPConstantBuffer
 {
@@ -21,19 +41,26 @@ struct VPConstantBuffer
 
 ConstantBuffer<VPConstantBuffer> vpConstantBuffer : register(b0, space0);
 
-cbuffer WorldConstantBuffer : register(b1, space0)
+cbuffer InstanceConstantBuffer : register(b1, space0)
 {
-    matrix worldMatrix;
+    uint instanceOffset;
 };
 
-VS_OUT main(uint vertexID : SV_VertexID)
+VS_OUT main(uint vertexID : SV_VertexID, uint instanceID : SV_InstanceID)
 {
-    Vertex input = vertices[indices[vertexID]];
+    uint vertexIndex = indices[vertexID];
+    Vertex input = vertices[vertexIndex];
+    InstanceData instance = instances[instanceOffset + instanceID];
     VS_OUT vsOut = (VS_OUT)0;
-    vsOut.outPosWorld = mul(float4(input.inPositionLS, 1.0f), worldMatrix);
+    vsOut.outPosWorld = mul(float4(input.inPositionLS, 1.0f), instance.worldMatrix);
     
     vsOut.outPositionCS = mul(vsOut.outPosWorld, vpConstantBuffer.VPMatrix);
-    vsOut.outNormal = normalize(mul(float4(normalize(input.inNormal), 0.0f), worldMatrix).xyz);
+    vsOut.outNormal = normalize(mul(float4(normalize(input.inNormal), 0.0f), instance.worldMatrix).xyz);
+    vsOut.outColor = instance.color;
+    vsOut.outAmbientOcclusion = float((ambientOcclusion.Load(vertexIndex & ~3u) >> ((vertexIndex & 3u) * 8u)) & 0xFFu) / 255.0f;
+    vsOut.outLights = uint2(instance.lightOffset, instance.nrOfLights);
+    vsOut.outVisibility = uint2(instance.visibilityOffset, instance.nrOfVisibilityLights);
+    vsOut.outViewDepth = vsOut.outPositionCS.w;
     
     return vsOut;
 }
\ No newline at end of file
@@ -0,0 +1,510 @@
+#include "pch.h"
+#include "WideBVH.h"
+#include "ModelBVH.h"
+
+namespace
+{
+	//Every pop of an inner node pushes at most seven more entries than it removes, and the wide tree is never deeper than the binary one.
+	constexpr uint32_t s_StackSize = 7u * BVHBuilder::s_MaxDepth + 1u;
+
+	struct TraversalEntry
+	{
+		uint32_t Index;
+		uint32_t NrOfPackets;
+		//Single rays: entry distance of the child. Packets: mask of the rays that hit the child.
+		union
+		{
+			float Distance;
+			uint32_t RayMask;
+		};
+	};
+
+	//A ray prepared for the AVX2 slab test, every component broadcast to all eight lanes.
+	struct WideRay
+	{
+		__m256 OriginX, OriginY, OriginZ;
+		__m256 DirectionX, DirectionY, DirectionZ;
+		__m256 InverseX, InverseY, InverseZ;
+		//Origin times inverse direction, so that the slab distances become one fused multiply subtract.
+		__m256 ScaledOriginX, ScaledOriginY, ScaledOriginZ;
+	};
+
+	//Axis aligned directions would give infinite inverses and NaN distances for boxes that touch the origin's plane.
+	float SafeInverse(float value) noexcept
+	{
+		return std::fabs(value) < 1.0e-20f ? std::copysign(1.0e20f, value) : 1.0f / value;
+	}
+
+	WideRay MakeWideRay(float originX, float originY, float originZ, float directionX, float directionY, float directionZ) noexcept
+	{
+		const float inverseX = SafeInverse(directionX);
+		const float inverseY = SafeInverse(directionY);
+		const float inverseZ = SafeInverse(directionZ);
+
+		WideRay ray;
+		ray.OriginX = _mm256_set1_ps(originX);
+		ray.OriginY = _mm256_set1_ps(originY);
+		ray.OriginZ = _mm256_set1_ps(originZ);
+		ray.DirectionX = _mm256_set1_ps(directionX);
+		ray.DirectionY = _mm256_set1_ps(directionY);
+		ray.DirectionZ = _mm256_set1_ps(directionZ);
+		ray.InverseX = _mm256_set1_ps(inverseX);
+		ray.InverseY = _mm256_set1_ps(inverseY);
+		ray.InverseZ = _mm256_set1_ps(inverseZ);
+		ray.ScaledOriginX = _mm256_set1_ps(originX * inverseX);
+		ray.ScaledOriginY = _mm256_set1_ps(originY * inverseY);
+		ray.ScaledOriginZ = _mm256_set1_ps(originZ * inverseZ);
+		return ray;
+	}
+
+	//Slab test of the ray against all children of the node. Returns the mask of the children that are hit.
+	uint32_t IntersectChildren(const WideBVHNode& node, const WideRay& ray, float minDistance, float maxDistance, __m256& entryDistances) noexcept
+	{
+		const __m256 tx1 = _mm256_fmsub_ps(_mm256_load_ps(node.MinX), ray.InverseX, ray.ScaledOriginX);
+		const __m256 tx2 = _mm256_fmsub_ps(_mm256_load_ps(node.MaxX), ray.InverseX, ray.ScaledOriginX);
+		const __m256 ty1 = _mm256_fmsub_ps(_mm256_load_ps(node.MinY), ray.InverseY, ray.ScaledOriginY);
+		const __m256 ty2 = _mm256_fmsub_ps(_mm256_load_ps(node.MaxY), ray.InverseY, ray.ScaledOriginY);
+		const __m256 tz1 = _mm256_fmsub_ps(_mm256_load_ps(node.MinZ), ray.InverseZ, ray.ScaledOriginZ);
+		const __m256 tz2 = _mm256_fmsub_ps(_mm256_load_ps(node.MaxZ), ray.InverseZ, ray.ScaledOriginZ);
+
+		__m256 tEnter = _mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2));
+		tEnter = _mm256_max_ps(tEnter, _mm256_max_ps(_mm256_min_ps(tz1, tz2), _mm256_set1_ps(minDistance)));
+		__m256 tExit = _mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2));
+		tExit = _mm256_min_ps(tExit, _mm256_min_ps(_mm256_max_ps(tz1, tz2), _mm256_set1_ps(maxDistance)));
+
+		entryDistances = tEnter;
+		return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tEnter, tExit, _CMP_LE_OQ))) & node.ChildMask;
+	}
+
+	//Moller-Trumbore against the eight triangles of the packet, without culling. Returns the mask of the triangles that are hit.
+	uint32_t IntersectTriangles(const TrianglePacket& packet, const WideRay& ray, float minDistance, float maxDistance, __m256& distances, __m256& u, __m256& v) noexcept
+	{
+		const __m256 edge1X = _mm256_load_ps(packet.Edge1X);
+		const __m256 edge1Y = _mm256_load_ps(packet.Edge1Y);
+		const __m256 edge1Z = _mm256_load_ps(packet.Edge1Z);
+		const __m256 edge2X = _mm256_load_ps(packet.Edge2X);
+		const __m256 edge2Y = _mm256_load_ps(packet.Edge2Y);
+		const __m256 edge2Z = _mm256_load_ps(packet.Edge2Z);
+
+		//p = direction x edge2
+		const __m256 pX = _mm256_fmsub_ps(ray.DirectionY, edge2Z, _mm256_mul_ps(ray.DirectionZ, edge2Y));
+		const __m256 pY = _mm256_fmsub_ps(ray.DirectionZ, edge2X, _mm256_mul_ps(ray.DirectionX, edge2Z));
+		const __m256 pZ = _mm256_fmsub_ps(ray.DirectionX, edge2Y, _mm256_mul_ps(ray.DirectionY, edge2X));
+		const __m256 determinant = _mm256_fmadd_ps(edge1X, pX, _mm256_fmadd_ps(edge1Y, pY, _mm256_mul_ps(edge1Z, pZ)));
+		const __m256 absoluteDeterminant = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), determinant);
+		__m256 mask = _mm256_cmp_ps(absoluteDeterminant, _mm256_set1_ps(1.0e-12f), _CMP_GE_OQ);
+		const __m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1.0f), determinant);
+
+		const __m256 sX = _mm256_sub_ps(ray.OriginX, _mm256_load_ps(packet.Vertex0X));
+		const __m256 sY = _mm256_sub_ps(ray.OriginY, _mm256_load_ps(packet.Vertex0Y));
+		const __m256 sZ = _mm256_sub_ps(ray.OriginZ, _mm256_load_ps(packet.Vertex0Z));
+		u = _mm256_mul_ps(_mm256_fmadd_ps(sX, pX, _mm256_fmadd_ps(sY, pY, _mm256_mul_ps(sZ, pZ))), inverseDeterminant);
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_GE_OQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+
+		//q = s x edge1
+		const __m256 qX = _mm256_fmsub_ps(sY, edge1Z, _mm256_mul_ps(sZ, edge1Y));
+		const __m256 qY = _mm256_fmsub_ps(sZ, edge1X, _mm256_mul_ps(sX, edge1Z));
+		const __m256 qZ = _mm256_fmsub_ps(sX, edge1Y, _mm256_mul_ps(sY, edge1X));
+		v = _mm256_mul_ps(_mm256_fmadd_ps(ray.DirectionX, qX, _mm256_fmadd_ps(ray.DirectionY, qY, _mm256_mul_ps(ray.DirectionZ, qZ))), inverseDeterminant);
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GE_OQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+
+		distances = _mm256_mul_ps(_mm256_fmadd_ps(edge2X, qX, _mm256_fmadd_ps(edge2Y, qY, _mm256_mul_ps(edge2Z, qZ))), inverseDeterminant);
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(distances, _mm256_set1_ps(minDistance), _CMP_GE_OQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(distances, _mm256_set1_ps(maxDistance), _CMP_LE_OQ));
+		return static_cast<uint32_t>(_mm256_movemask_ps(mask));
+	}
+
+	//Tests the packets of a leaf. Keeps the closest hit unless AnyHit is set, in which case it returns on the first one.
+	template<bool AnyHit>
+	bool IntersectLeaf(const TrianglePacket* pPackets, uint32_t nrOfPackets, const WideRay& ray, float minDistance, float& maxDistance, RayHit& hit) noexcept
+	{
+		bool found = false;
+		for (uint32_t packet{ 0u }; packet < nrOfPackets; ++packet)
+		{
+			alignas(32) float distances[8];
+			alignas(32) float u[8];
+			alignas(32) float v[8];
+			__m256 distancesWide, uWide, vWide;
+			uint32_t mask = IntersectTriangles(pPackets[packet], ray, minDistance, maxDistance, distancesWide, uWide, vWide);
+			if (mask == 0u)
+				continue;
+
+			if constexpr (AnyHit)
+			{
+				return true;
+			}
+			_mm256_store_ps(distances, distancesWide);
+			_mm256_store_ps(u, uWide);
+			_mm256_store_ps(v, vWide);
+			for (; mask != 0u; mask &= mask - 1u)
+			{
+				const uint32_t lane = _tzcnt_u32(mask);
+				if (distances[lane] > maxDistance)
+					continue;
+
+				maxDistance = distances[lane];
+				hit.Distance = distances[lane];
+				hit.U = u[lane];
+				hit.V = v[lane];
+				hit.MeshIndex = pPackets[packet].MeshIndex[lane];
+				hit.TriangleIndex = pPackets[packet].TriangleIndex[lane];
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	//Unused slots get inverted bounds and are masked out by the child mask.
+	WideBVHNode MakeEmptyNode() noexcept
+	{
+		WideBVHNode node;
+		std::fill_n(node.MinX, 8u, FLT_MAX);
+		std::fill_n(node.MinY, 8u, FLT_MAX);
+		std::fill_n(node.MinZ, 8u, FLT_MAX);
+		std::fill_n(node.MaxX, 8u, -FLT_MAX);
+		std::fill_n(node.MaxY, 8u, -FLT_MAX);
+		std::fill_n(node.MaxZ, 8u, -FLT_MAX);
+		std::fill_n(node.Child, 8u, UINT32_MAX);
+		std::fill_n(node.NrOfPackets, 8u, 0u);
+		node.ChildMask = 0u;
+		return node;
+	}
+
+	void SetChildBounds(WideBVHNode& node, uint32_t child, const BVHNode& binaryNode) noexcept
+	{
+		node.MinX[child] = binaryNode.Min.x;
+		node.MinY[child] = binaryNode.Min.y;
+		node.MinZ[child] = binaryNode.Min.z;
+		node.MaxX[child] = binaryNode.Max.x;
+		node.MaxY[child] = binaryNode.Max.y;
+		node.MaxZ[child] = binaryNode.Max.z;
+	}
+
+	//Pushes the hit children so that the closest one ends up on top of the stack.
+	//Returns false without pushing anything when they do not fit, the traversal then has to stop.
+	[[nodiscard]] bool PushSorted(TraversalEntry* pStack, uint32_t& stackSize, TraversalEntry* pChildren, const float* pDistances, uint32_t nrOfChildren) noexcept
+	{
+		if (stackSize + nrOfChildren > s_StackSize)
+		{
+			DBG_ASSERT(false, "The BVH is too deep for the traversal stack.");
+			return false;
+		}
+		float sortedDistances[8];
+		for (uint32_t i{ 0u }; i < nrOfChildren; ++i)
+		{
+			//Insertion sort, furthest first.
+			const TraversalEntry entry = pChildren[i];
+			const float distance = pDistances[i];
+			uint32_t j = i;
+			for (; j > 0u && sortedDistances[j - 1u] < distance; --j)
+			{
+				sortedDistances[j] = sortedDistances[j - 1u];
+				pStack[stackSize + j] = pStack[stackSize + j - 1u];
+			}
+			sortedDistances[j] = distance;
+			pStack[stackSize + j] = entry;
+		}
+		stackSize += nrOfChildren;
+		return true;
+	}
+}
+
+void WideBVH::Build(const ModelBVH& binaryBVH) noexcept
+{
+	m_Nodes.clear();
+	m_Packets.clear();
+	const std::vector<BVHNode>& binaryNodes = binaryBVH.GetNodes();
+	if (binaryNodes.empty())
+		return;
+
+	//Children are always stored after their parent, so walking backwards sums up every subtree.
+	std::vector<uint32_t> subtreeTriangles(binaryNodes.size());
+	for (size_t i{ binaryNodes.size() }; i-- > 0u;)
+	{
+		const BVHNode& node = binaryNodes[i];
+		subtreeTriangles[i] = node.Count > 0u ? node.Count : subtreeTriangles[node.LeftFirst] + subtreeTriangles[node.LeftFirst + 1u];
+	}
+
+	m_Nodes.reserve(binaryNodes.size() / 4u + 1u);
+	m_Packets.reserve(subtreeTriangles[0] / 4u + 1u);
+	if (binaryNodes[0].Count > 0u || subtreeTriangles[0] <= s_MaxLeafTriangles)
+	{
+		//Small enough to be a single leaf under the root.
+		WideBVHNode root = MakeEmptyNode();
+		SetChildBounds(root, 0u, binaryNodes[0]);
+		root.Child[0] = AddLeafPackets(binaryBVH, 0u, subtreeTriangles[0]);
+		root.NrOfPackets[0] = static_cast<uint32_t>(m_Packets.size()) - root.Child[0];
+		root.ChildMask = 1u;
+		m_Nodes.push_back(root);
+		return;
+	}
+	CollapseNode(binaryBVH, subtreeTriangles, 0u);
+}
+
+bool WideBVH::Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept
+{
+	return TraverseRay<false>(origin, direction, minDistance, maxDistance, hit);
+}
+
+bool WideBVH::IntersectAny(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance) const noexcept
+{
+	RayHit hit = {};
+	return TraverseRay<true>(origin, direction, minDistance, maxDistance, hit);
+}
+
+uint32_t WideBVH::Intersect(const RayPacket& packet, RayHit hits[RayPacket::s_Size]) const noexcept
+{
+	return TraversePacket<false>(packet, hits);
+}
+
+uint32_t WideBVH::IntersectAny(const RayPacket& packet) const noexcept
+{
+	return TraversePacket<true>(packet, nullptr);
+}
+
+uint32_t WideBVH::CollapseNode(const ModelBVH& binaryBVH, const std::vector<uint32_t>& subtreeTriangles, uint32_t binaryIndex) noexcept
+{
+	const std::vector<BVHNode>& binaryNodes = binaryBVH.GetNodes();
+
+	//Open the child with the largest surface area until there are eight, leaves and small subtrees stay closed.
+	uint32_t children[s_Width] = { binaryNodes[binaryIndex].LeftFirst, binaryNodes[binaryIndex].LeftFirst + 1u };
+	uint32_t nrOfChildren = 2u;
+	while (nrOfChildren < s_Width)
+	{
+		uint32_t bestChild = UINT32_MAX;
+		float bestArea = -1.0f;
+		for (uint32_t i{ 0u }; i < nrOfChildren; ++i)
+		{
+			const BVHNode& child = binaryNodes[children[i]];
+			if (child.Count > 0u || subtreeTriangles[children[i]] <= s_MaxLeafTriangles)
+				continue;
+
+			const float x = child.Max.x - child.Min.x;
+			const float y = child.Max.y - child.Min.y;
+			const float z = child.Max.z - child.Min.z;
+			const float area = x * y + y * z + z * x;
+			if (area > bestArea)
+			{
+				bestArea = area;
+				bestChild = i;
+			}
+		}
+		if (bestChild == UINT32_MAX)
+			break;
+
+		const uint32_t opened = children[bestChild];
+		children[bestChild] = binaryNodes[opened].LeftFirst;
+		children[nrOfChildren++] = binaryNodes[opened].LeftFirst + 1u;
+	}
+
+	const uint32_t nodeIndex = static_cast<uint32_t>(m_Nodes.size());
+	m_Nodes.push_back({});
+	WideBVHNode node = MakeEmptyNode();
+	node.ChildMask = (1u << nrOfChildren) - 1u;
+	for (uint32_t i{ 0u }; i < nrOfChildren; ++i)
+	{
+		const BVHNode& child = binaryNodes[children[i]];
+		SetChildBounds(node, i, child);
+		if (child.Count > 0u || subtreeTriangles[children[i]] <= s_MaxLeafTriangles)
+		{
+			node.Child[i] = AddLeafPackets(binaryBVH, children[i], subtreeTriangles[children[i]]);
+			node.NrOfPackets[i] = static_cast<uint32_t>(m_Packets.size()) - node.Child[i];
+		}
+		else
+		{
+			node.Child[i] = CollapseNode(binaryBVH, subtreeTriangles, children[i]);
+		}
+	}
+	m_Nodes[nodeIndex] = node;
+	return nodeIndex;
+}
+
+uint32_t WideBVH::AddLeafPackets(const ModelBVH& binaryBVH, uint32_t binaryIndex, uint32_t nrOfTriangles) noexcept
+{
+	const std::vector<BVHNode>& binaryNodes = binaryBVH.GetNodes();
+	const std::vector<ModelBVH::Triangle>& triangles = binaryBVH.GetTriangles();
+
+	//The triangles of a subtree are one range in leaf order, starting at its leftmost leaf.
+	uint32_t leftmost = binaryIndex;
+	while (binaryNodes[leftmost].Count == 0u)
+	{
+		leftmost = binaryNodes[leftmost].LeftFirst;
+	}
+	const uint32_t first = binaryNodes[leftmost].LeftFirst;
+
+	const uint32_t firstPacket = static_cast<uint32_t>(m_Packets.size());
+	for (uint32_t i{ 0u }; i < nrOfTriangles; i += 8u)
+	{
+		TrianglePacket packet = {};
+		for (uint32_t lane{ 0u }; lane < 8u && i + lane < nrOfTriangles; ++lane)
+		{
+			const ModelBVH::Triangle& triangle = triangles[first + i + lane];
+			packet.Vertex0X[lane] = triangle.Vertex0.x;
+			packet.Vertex0Y[lane] = triangle.Vertex0.y;
+			packet.Vertex0Z[lane] = triangle.Vertex0.z;
+			packet.Edge1X[lane] = triangle.Edge1.x;
+			packet.Edge1Y[lane] = triangle.Edge1.y;
+			packet.Edge1Z[lane] = triangle.Edge1.z;
+			packet.Edge2X[lane] = triangle.Edge2.x;
+			packet.Edge2Y[lane] = triangle.Edge2.y;
+			packet.Edge2Z[lane] = triangle.Edge2.z;
+			packet.MeshIndex[lane] = triangle.MeshIndex;
+			packet.TriangleIndex[lane] = triangle.TriangleIndex;
+		}
+		m_Packets.push_back(packet);
+	}
+	return firstPacket;
+}
+
+template<bool AnyHit>
+bool WideBVH::TraverseRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept
+{
+	if (m_Nodes.empty())
+		return false;
+
+	const WideRay ray = MakeWideRay(origin.x, origin.y, origin.z, direction.x, direction.y, direction.z);
+	TraversalEntry stack[s_StackSize];
+	uint32_t stackSize = 0u;
+	stack[stackSize++] = { 0u, 0u, { minDistance } };
+	bool found = false;
+	while (stackSize > 0u)
+	{
+		const TraversalEntry entry = stack[--stackSize];
+		//Something closer was found after the entry was pushed.
+		if (entry.Distance > maxDistance)
+			continue;
+
+		if (entry.NrOfPackets > 0u)
+		{
+			if (IntersectLeaf<AnyHit>(m_Packets.data() + entry.Index, entry.NrOfPackets, ray, minDistance, maxDistance, hit))
+			{
+				if constexpr (AnyHit)
+				{
+					return true;
+				}
+				found = true;
+			}
+			continue;
+		}
+
+		const WideBVHNode& node = m_Nodes[entry.Index];
+		__m256 entryDistancesWide;
+		uint32_t mask = IntersectChildren(node, ray, minDistance, maxDistance, entryDistancesWide);
+		if (mask == 0u)
+			continue;
+
+		alignas(32) float entryDistances[8];
+		_mm256_store_ps(entryDistances, entryDistancesWide);
+		TraversalEntry children[8];
+		float distances[8];
+		uint32_t nrOfChildren = 0u;
+		for (; mask != 0u; mask &= mask - 1u)
+		{
+			const uint32_t child = _tzcnt_u32(mask);
+			children[nrOfChildren] = { node.Child[child], node.NrOfPackets[child], { entryDistances[child] } };
+			distances[nrOfChildren++] = entryDistances[child];
+		}
+		//A tree too deep for the stack reports a miss rather than a hit that may not be the closest one.
+		if (!PushSorted(stack, stackSize, children, distances, nrOfChildren))
+			return false;
+	}
+	return found;
+}
+
+template<bool AnyHit>
+uint32_t WideBVH::TraversePacket(const RayPacket& packet, RayHit* pHits) const noexcept
+{
+	uint32_t activeMask = packet.ActiveMask & 0xFFu;
+	if (m_Nodes.empty() || activeMask == 0u)
+		return 0u;
+
+	WideRay rays[RayPacket::s_Size];
+	float maxDistances[RayPacket::s_Size];
+	for (uint32_t mask{ activeMask }; mask != 0u; mask &= mask - 1u)
+	{
+		const uint32_t ray = _tzcnt_u32(mask);
+		rays[ray] = MakeWideRay(packet.OriginX[ray], packet.OriginY[ray], packet.OriginZ[ray], packet.DirectionX[ray], packet.DirectionY[ray], packet.DirectionZ[ray]);
+		maxDistances[ray] = packet.MaxDistance[ray];
+	}
+
+	TraversalEntry stack[s_StackSize];
+	uint32_t stackSize = 0u;
+	TraversalEntry root = { 0u, 0u, {} };
+	root.RayMask = activeMask;
+	stack[stackSize++] = root;
+	uint32_t hitMask = 0u;
+	while (stackSize > 0u)
+	{
+		const TraversalEntry entry = stack[--stackSize];
+		//Any hit rays leave the packet as soon as they hit something.
+		const uint32_t rayMask = entry.RayMask & activeMask;
+		if (rayMask == 0u)
+			continue;
+
+		if (entry.NrOfPackets > 0u)
+		{
+			for (uint32_t mask{ rayMask }; mask != 0u; mask &= mask - 1u)
+			{
+				const uint32_t ray = _tzcnt_u32(mask);
+				RayHit anyHit = {};
+				if (!IntersectLeaf<AnyHit>(m_Packets.data() + entry.Index, entry.NrOfPackets, rays[ray], packet.MinDistance[ray], maxDistances[ray], AnyHit ? anyHit : pHits[ray]))
+					continue;
+
+				hitMask |= 1u << ray;
+				if constexpr (AnyHit)
+				{
+					activeMask &= ~(1u << ray);
+				}
+			}
+			if constexpr (AnyHit)
+			{
+				if (activeMask == 0u)
+					break;
+			}
+			continue;
+		}
+
+		//Every ray tests all children, a child is visited by the rays that hit it, closest child first for the nearest of those rays.
+		const WideBVHNode& node = m_Nodes[entry.Index];
+		uint32_t childRayMasks[8] = {};
+		uint32_t childMask = 0u;
+		__m256 nearestEntry = _mm256_set1_ps(FLT_MAX);
+		for (uint32_t mask{ rayMask }; mask != 0u; mask &= mask - 1u)
+		{
+			const uint32_t ray = _tzcnt_u32(mask);
+			__m256 entryDistances;
+			uint32_t hitChildren = IntersectChildren(node, rays[ray], packet.MinDistance[ray], maxDistances[ray], entryDistances);
+			if (hitChildren == 0u)
+				continue;
+
+			const __m256 hitLanes = _mm256_castsi256_ps(_mm256_cmpgt_epi32(
+				_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(hitChildren)), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)), _mm256_setzero_si256()));
+			nearestEntry = _mm256_min_ps(nearestEntry, _mm256_blendv_ps(_mm256_set1_ps(FLT_MAX), entryDistances, hitLanes));
+			childMask |= hitChildren;
+			for (; hitChildren != 0u; hitChildren &= hitChildren - 1u)
+			{
+				childRayMasks[_tzcnt_u32(hitChildren)] |= 1u << ray;
+			}
+		}
+		if (childMask == 0u)
+			continue;
+
+		alignas(32) float nearestDistances[8];
+		_mm256_store_ps(nearestDistances, nearestEntry);
+		TraversalEntry children[8];
+		float distances[8];
+		uint32_t nrOfChildren = 0u;
+		for (; childMask != 0u; childMask &= childMask - 1u)
+		{
+			const uint32_t child = _tzcnt_u32(childMask);
+			children[nrOfChildren] = { node.Child[child], node.NrOfPackets[child], {} };
+			children[nrOfChildren].RayMask = childRayMasks[child];
+			distances[nrOfChildren++] = nearestDistances[child];
+		}
+		if (!PushSorted(stack, stackSize, children, distances, nrOfChildren))
+			return 0u;
+	}
+	return hitMask;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "Ray.h"
+
+class ModelBVH;
+
+//Node with up to eight children whose bounds are stored as structure of arrays, so that one AVX2 slab test covers all of them.
+struct alignas(32) WideBVHNode
+{
+	float MinX[8];
+	float MinY[8];
+	float MinZ[8];
+	float MaxX[8];
+	float MaxY[8];
+	float MaxZ[8];
+	//Inner child: index of the node. Leaf child: index of the first triangle packet.
+	uint32_t Child[8];
+	//Number of triangle packets of a leaf child, 0 for inner children.
+	uint32_t NrOfPackets[8];
+	//Bit i is set when child i is used.
+	uint32_t ChildMask;
+};
+
+//Eight triangles in structure of arrays layout, tested against a ray at once.
+//Unused slots are degenerate triangles that are never hit.
+struct alignas(32) TrianglePacket
+{
+	float Vertex0X[8];
+	float Vertex0Y[8];
+	float Vertex0Z[8];
+	float Edge1X[8];
+	float Edge1Y[8];
+	float Edge1Z[8];
+	float Edge2X[8];
+	float Edge2Y[8];
+	float Edge2Z[8];
+	uint32_t MeshIndex[8];
+	uint32_t TriangleIndex[8];
+};
+
+//Eight wide BVH collapsed from a model's binary BVH, traversed with AVX2.
+//Single rays test the eight children of a node and the eight triangles of a packet at once.
+//Ray packets share one traversal, every stack entry carries the mask of the rays that still have to visit it.
+//The any hit queries end a ray on its first hit, like RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH in the pixel shader.
+class WideBVH
+{
+public:
+	static constexpr uint32_t s_Width = 8u;
+	//Subtrees with at most this many triangles become one leaf, which fills exactly one packet.
+	static constexpr uint32_t s_MaxLeafTriangles = 8u;
+public:
+	WideBVH() noexcept = default;
+	~WideBVH() noexcept = default;
+
+	void Build(const ModelBVH& binaryBVH) noexcept;
+
+	bool Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept;
+	[[nodiscard]] bool IntersectAny(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance) const noexcept;
+	//Closest hits of the active rays of the packet. Returns the mask of the rays that hit something.
+	uint32_t Intersect(const RayPacket& packet, RayHit hits[RayPacket::s_Size]) const noexcept;
+	//Returns the mask of the active rays that hit anything.
+	[[nodiscard]] uint32_t IntersectAny(const RayPacket& packet) const noexcept;
+
+	[[nodiscard]] constexpr bool IsBuilt() const noexcept { return !m_Nodes.empty(); }
+	[[nodiscard]] uint32_t GetNrOfNodes() const noexcept { return static_cast<uint32_t>(m_Nodes.size()); }
+	[[nodiscard]] uint32_t GetNrOfPackets() const noexcept { return static_cast<uint32_t>(m_Packets.size()); }
+private:
+	uint32_t CollapseNode(const ModelBVH& binaryBVH, const std::vector<uint32_t>& subtreeTriangles, uint32_t binaryIndex) noexcept;
+	uint32_t AddLeafPackets(const ModelBVH& binaryBVH, uint32_t binaryIndex, uint32_t nrOfTriangles) noexcept;
+
+	template<bool AnyHit>
+	bool TraverseRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float minDistance, float maxDistance, RayHit& hit) const noexcept;
+	template<bool AnyHit>
+	uint32_t TraversePacket(const RayPacket& packet, RayHit* pHits) const noexcept;
+private:
+	std::vector<WideBVHNode> m_Nodes = {};
+	std::vector<TrianglePacket> m_Packets = {};
+	//Set when the whole model fits in the root's leaf, the root node then only holds that leaf.
+	bool m_RootIsLeaf = false;
+};
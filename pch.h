@@ -10,6 +10,9 @@
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <DirectXColors.h>
+#include <DirectXCollision.h>
+#include <immintrin.h>
+#include <intrin.h>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -35,6 +38,15 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <filesystem>
 
 #include "DXHelper.h"
 